@@ -68,6 +68,7 @@ AAAThread::AAAThread(ICallbackAAA *aaaDone, UltraLowLight *ull, I3AControls *aaa
     }
     mFaceState.num_faces = 0;
     CLEAR(mCachedStatsEventMsg);
+    CLEAR(mStatsMailbox);
 }
 
 AAAThread::~AAAThread()
@@ -229,18 +230,51 @@ bool AAAThread::atomIspNotify(IAtomIspObserver::Message *msg, const ObserverStat
     return false;
 }
 
+/**
+ * Posts a statistics event to the mailbox, see StatsMailbox
+ *
+ * The message is only queued if the previous one was handled already,
+ * otherwise the event replaces the pending one.
+ */
 status_t AAAThread::newStats(timeval &t, unsigned int seqNo)
 {
     LOG2("@%s", __FUNCTION__);
     Message msg;
 
-    msg.id = MESSAGE_ID_NEW_STATS_READY;
-    msg.data.stats.capture_timestamp = t;
-    msg.data.stats.sequence_number = seqNo;
+    {
+        Mutex::Autolock lock(mStatsLock);
+        mStatsMailbox.latest.capture_timestamp = t;
+        mStatsMailbox.latest.sequence_number = seqNo;
+        mStatsMailbox.events++;
+        mStatsMailbox.received++;
+        if (mStatsMailbox.pending) {
+            mStatsMailbox.dropped++;
+            return NO_ERROR;
+        }
+        mStatsMailbox.pending = true;
+    }
 
+    msg.id = MESSAGE_ID_NEW_STATS_READY;
     return mMessageQueue.send(&msg);
 }
 
+/**
+ * Takes the latest statistics event out of the mailbox
+ *
+ * \param event the latest event
+ * \return number of events received since the last take
+ */
+unsigned int AAAThread::takeStatsEvent(StatsEvent *event)
+{
+    Mutex::Autolock lock(mStatsLock);
+    unsigned int events = mStatsMailbox.events;
+
+    *event = mStatsMailbox.latest;
+    mStatsMailbox.events = 0;
+    mStatsMailbox.pending = false;
+    return events;
+}
+
 status_t AAAThread::newFrame(AtomBuffer *b)
 {
     LOG2("@%s", __FUNCTION__);
@@ -754,15 +788,23 @@ status_t AAAThread::handleMessageNewFrame(MessageNewFrame *msg)
  * Run 3A and DVS processing
  * We received message that new 3A statistics are ready
  */
-status_t AAAThread::handleMessageNewStats(MessageNewStats *msgFrame)
+status_t AAAThread::handleMessageNewStats()
 {
     LOG2("@%s", __FUNCTION__);
     status_t status = NO_ERROR;
     String8 sceneMode;
     bool sceneHdr = false;
-    Vector<Message> messages;
-    struct timeval capture_timestamp = msgFrame->capture_timestamp;
-    unsigned int capture_sequence_number = msgFrame->sequence_number;
+    StatsEvent event;
+    nsecs_t processStart, processTime;
+
+    // 3A & DVS stats are read with proprietary ioctl that returns the
+    // statistics of most recent frame done.
+    // The events that came while we were late were merged in the mailbox,
+    // the 3A process reads the statistics of the most recent frame.
+    unsigned int events = takeStatsEvent(&event);
+    if (events > 1)
+        LOG1("%u statistics events in 3A process mailbox, handling seq %u",
+             events, event.sequence_number);
 
     if (!m3ARunning)
         return status;
@@ -771,32 +813,29 @@ status_t AAAThread::handleMessageNewStats(MessageNewStats *msgFrame)
     if (mFlashStage != FLASH_STAGE_NA)
         return status;
 
+    // each merged event stands for one frame to skip
     if (mSkipStatistics > 0) {
-        LOG1("3A statistics skipped. Partially exposed or wait for exposure. (%d)", mSkipStatistics);
-        --mSkipStatistics;
-        return status;
-    }
-    // 3A & DVS stats are read with proprietary ioctl that returns the
-    // statistics of most recent frame done.
-    // Multiple newFrames indicates we are late and 3A process is going
-    // to read the statistics of the most recent frame.
-    // We flush the queue and use the most recent timestamp.
-    mMessageQueue.remove(MESSAGE_ID_NEW_STATS_READY, &messages);
-    if(!messages.isEmpty()) {
-        Vector<Message>::iterator it = messages.begin();
-        LOGW("%d frames in 3A process queue, handling timestamp "
-             "%lld instead of %lld\n", messages.size(),
-        ((long long)(it->data.stats.capture_timestamp.tv_sec)*1000000LL +
-         (long long)(it->data.stats.capture_timestamp.tv_usec)),
-        ((long long)(capture_timestamp.tv_sec)*1000000LL +
-         (long long)(capture_timestamp.tv_usec)));
-        capture_timestamp = it->data.stats.capture_timestamp;
-        capture_sequence_number = it->data.stats.sequence_number;
+        if (mSkipStatistics >= events) {
+            LOG1("3A statistics skipped. Partially exposed or wait for exposure. (%d)", mSkipStatistics);
+            mSkipStatistics -= events;
+            return status;
+        }
+        mSkipStatistics = 0;
     }
 
     if(m3ARunning){
         // Run 3A statistics
-        status = m3AControls->apply3AProcess(true, &capture_timestamp, mOrientation);
+        processStart = systemTime();
+        status = m3AControls->apply3AProcess(true, &event.capture_timestamp, mOrientation);
+        processTime = systemTime() - processStart;
+        LOG2("3A process of seq %u took %lldus", event.sequence_number, processTime / 1000);
+        {
+            Mutex::Autolock lock(mStatsLock);
+            mStatsMailbox.handled++;
+            mStatsMailbox.processTotal += processTime;
+            if (processTime > mStatsMailbox.processMax)
+                mStatsMailbox.processMax = processTime;
+        }
 
         // If auto-focus was requested, run auto-focus sequence
         if (status == NO_ERROR && mStartAF) {
@@ -931,6 +970,28 @@ void AAAThread::resetSmartSceneValues()
     mSmartSceneHdr = false;
 }
 
+/**
+ * Appends the statistics mailbox counters and the 3A processing time to
+ * out, followed by the per algorithm timing of the 3A library
+ */
+void AAAThread::dump(String8 &out)
+{
+    StatsMailbox mailbox;
+    {
+        Mutex::Autolock lock(mStatsLock);
+        mailbox = mStatsMailbox;
+    }
+
+    out.appendFormat("3A statistics: %u events, %u dropped, %u processed",
+                     mailbox.received, mailbox.dropped, mailbox.handled);
+    if (mailbox.handled > 0)
+        out.appendFormat(", %lldus avg, %lldus max",
+                         mailbox.processTotal / mailbox.handled / 1000,
+                         mailbox.processMax / 1000);
+    out.append("\n");
+    m3AControls->dumpTimings(out);
+}
+
 void AAAThread::orientationChanged(int orientation)
 {
     LOG1("@%s: orientation = %d", __FUNCTION__, orientation);
@@ -957,6 +1018,10 @@ status_t AAAThread::waitForAndExecuteMessage()
     if (msg.id != MESSAGE_ID_EXIT && PlatformData::isDisable3A(mCameraId)) {
         if (msg.id == MESSAGE_ID_AUTO_FOCUS)
             mCallbacksThread->autoFocusDone(true);
+        if (msg.id == MESSAGE_ID_NEW_STATS_READY) {
+            StatsEvent event;
+            takeStatsEvent(&event);
+        }
         mMessageQueue.reply(msg.id, status);
         return status;
     }
@@ -968,7 +1033,7 @@ status_t AAAThread::waitForAndExecuteMessage()
             break;
 
         case MESSAGE_ID_NEW_STATS_READY:
-            status = handleMessageNewStats(&msg.data.stats);
+            status = handleMessageNewStats();
             break;
 
         case MESSAGE_ID_ENABLE_AAA:
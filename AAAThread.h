@@ -105,6 +105,7 @@ public:
     status_t getFaces(ia_face_state& faceState) const;
     void getCurrentSmartScene(String8 &sceneMode, bool &sceneHdr);
     void resetSmartSceneValues();
+    void dump(String8 &out);
 
 // private types
 private:
@@ -148,12 +149,33 @@ private:
         FlashStage  value;
     };
 
-    // for MESSAGE_ID_NEW_STATS_READY
-    struct MessageNewStats {
+    // MESSAGE_ID_NEW_STATS_READY carries no data, the handler takes the
+    // latest statistics event from mStatsMailbox
+    struct StatsEvent {
         struct timeval capture_timestamp;
         unsigned int    sequence_number;
     };
 
+    /**
+     * Latest statistics event not handled yet.
+     *
+     * newStats() only queues MESSAGE_ID_NEW_STATS_READY when the mailbox
+     * is empty, a later event overwrites the pending one: 3A reads the
+     * statistics of the most recent frame anyway, so the older events
+     * would only delay it.
+     */
+    struct StatsMailbox {
+        StatsEvent latest;
+        bool pending;           /*!< a MESSAGE_ID_NEW_STATS_READY is queued */
+        unsigned int events;    /*!< events received since the last take */
+        // telemetry, see dump()
+        unsigned int received;
+        unsigned int dropped;
+        unsigned int handled;
+        nsecs_t processTotal;   /*!< time in apply3AProcess() */
+        nsecs_t processMax;
+    };
+
     // for MESSAGE_ID_NEW_FRAME
     struct MessageNewFrame {
         const AtomBuffer *buff;
@@ -174,7 +196,6 @@ private:
     union MessageData {
         MessageEnable enable;
         MessagePicture picture;
-        MessageNewStats stats;
         MessageNewFrame frame;
         MessageFlashStage flashStage;
         MessageSwitchInfo switchInfo;
@@ -195,7 +216,8 @@ private:
     status_t handleMessageEnable3A();
     status_t handleMessageAutoFocus();
     status_t handleMessageCancelAutoFocus();
-    status_t handleMessageNewStats(MessageNewStats *msg);
+    status_t handleMessageNewStats();
+    unsigned int takeStatsEvent(StatsEvent *event);
     status_t handleMessageNewFrame(MessageNewFrame *msg);
     status_t handleMessageRemoveRedEye(MessagePicture* msg);
     status_t handleMessageEnableAeLock(MessageEnable* msg);
@@ -253,6 +275,8 @@ private:
     bool mExtIsp;
     int mOrientation;
     IAtomIspObserver::Message mCachedStatsEventMsg;
+    Mutex mStatsLock;           /*!< protects mStatsMailbox */
+    StatsMailbox mStatsMailbox;
 
 }; // class AAAThread
 
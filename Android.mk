@@ -12,6 +12,11 @@ ifeq ($(BOARD_GRAPHIC_IS_GEN),true)
 LOCAL_CFLAGS += -DGRAPHIC_IS_GEN
 endif
 
+# gralloc handles carry a dma-buf the ISP can import
+ifeq ($(USE_CAMERA_GRALLOC_DMABUF),true)
+LOCAL_CFLAGS += -DGRALLOC_DMABUF
+endif
+
 ifeq ($(USE_CAMERA_IO_BREAKDOWN),true)
 LOCAL_CFLAGS += -DUSE_CAMERA_IO_BREAKDOWN
 endif
@@ -37,12 +42,15 @@ LOCAL_SRC_FILES := \
 	AtomHAL.cpp \
 	CameraConf.cpp \
 	ColorConverter.cpp \
+	ColorConverterKernels.cpp \
 	ImageScaler.cpp \
 	EXIFMaker.cpp \
 	SWJpegEncoder.cpp \
 	CallbacksThread.cpp \
 	LogHelper.cpp \
+	MessageQueueStats.cpp \
 	MemoryUtils.cpp \
+	MemoryFlush.cpp \
 	PlatformData.cpp \
 	CameraProfiles.cpp \
 	IntelParameters.cpp \
@@ -51,11 +59,15 @@ LOCAL_SRC_FILES := \
 	PostProcThread.cpp \
 	PanoramaThread.cpp \
 	AtomCommon.cpp \
+	AtomBufferPool.cpp \
+	IndexedFrameRing.cpp \
 	FaceDetector.cpp \
 	nv12rotation.cpp \
 	CameraDump.cpp \
+	StatsRecording.cpp \
 	CameraAreas.cpp \
 	BracketManager.cpp \
+	CapturePlanner.cpp \
 	OnlineBracket.cpp \
 	OfflineBracket.cpp \
 	GPUScaler.cpp \
@@ -74,6 +86,7 @@ LOCAL_SRC_FILES := \
 	v4l2dev/v4l2devicebase.cpp \
 	v4l2dev/v4l2videonode.cpp \
 	v4l2dev/v4l2subdevice.cpp \
+	v4l2dev/v4l2ioctlqueue.cpp \
 	AtomDvs2.cpp
 
 ifeq ($(USE_INTEL_JPEG), true)
@@ -222,5 +235,7 @@ LOCAL_MODULE_TAGS := optional
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(LOCAL_PATH)/tests/Android.mk
+
 endif  #ifeq ($(USE_CAMERA_HAL2),true)
 endif #ifeq ($(USE_CAMERA_STUB),false)
@@ -19,6 +19,8 @@
 #include <math.h>
 #include <time.h>
 #include <dlfcn.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <utils/String8.h>
 
 #include "LogHelper.h"
@@ -88,6 +90,14 @@ AtomAIQ::AtomAIQ(HWControlGroup &hwcg, int cameraId):
     ,mLensCI(hwcg.mLensCI)
     ,mISPAdaptor(NULL)
     ,mFileInjection(false)
+    ,mPreviewRuns(0)
+    ,mGbceStride(PlatformData::getGbceStride(cameraId))
+    ,mDsdStride(PlatformData::getDsdStride(cameraId))
+    ,mStatisticsTime(-1)
+    ,mStatsCapacity(0)
+    ,mIspParamsApplied(0)
+    ,mIspParamsFailed(0)
+    ,mIspParamsExpId(EXP_ID_INVALID)
     ,mCameraId(cameraId)
 {
     LOG1("@%s", __FUNCTION__);
@@ -106,6 +116,7 @@ AtomAIQ::AtomAIQ(HWControlGroup &hwcg, int cameraId):
     CLEAR(mIspInputParams);
     CLEAR(mDSDInputParameters);
     CLEAR(mDetectedSceneMode);
+    CLEAR(mStageTimings);
 }
 
 AtomAIQ::~AtomAIQ()
@@ -123,6 +134,11 @@ status_t AtomAIQ::init3A()
     mFileInjection = (mCameraId == INTEL_FILE_INJECT_CAMERA_ID);
     status_t status = _init3A();
 
+    if (status == NO_ERROR) {
+        initStatsRecording();
+        mISP->setIspParamsListener(this);
+    }
+
     return status;
 }
 
@@ -220,7 +236,25 @@ status_t AtomAIQ::_init3A()
     run3aInit();
 
     cameranvm_delete(aicNvm);
-    m3aState.stats = NULL;
+
+    // one statistics buffer for the session, changeSensorMode() only
+    // changes its grid
+    m3aState.stats = allocateStatistics(MAX_STATISTICS_WIDTH * MAX_STATISTICS_HEIGHT);
+    if (m3aState.stats == NULL) {
+        LOGE("Statistics memory allocation failed");
+        delete mAeState.stored_results;
+        mAeState.stored_results = NULL;
+        free(m3aState.faces);
+        m3aState.faces = NULL;
+        ia_aiq_deinit(m3aState.ia_aiq_handle);
+        m3aState.ia_aiq_handle = NULL;
+        delete mISPAdaptor;
+        mISPAdaptor = NULL;
+        ia_mkn_uninit(mMkn);
+        mMkn = NULL;
+        return NO_MEMORY;
+    }
+    mStatsCapacity = MAX_STATISTICS_WIDTH * MAX_STATISTICS_HEIGHT;
     m3aState.stats_valid = false;
     CLEAR(m3aState.results);
 
@@ -244,6 +278,13 @@ status_t AtomAIQ::getAiqConfig(ia_binary_data *cpfData)
 status_t AtomAIQ::deinit3A()
 {
     LOG1("@%s", __FUNCTION__);
+    if (mISP != NULL) {
+        mISP->setIspParamsListener(NULL);
+        // the queued ISP parameters point to the output of mISPAdaptor
+        mISP->reclaimAicParameter();
+    }
+    mStatsRecorder.close();
+    mStatsPlayer.close();
     if (mAeState.stored_results) {
         delete mAeState.stored_results;
         mAeState.stored_results = NULL;
@@ -251,6 +292,8 @@ status_t AtomAIQ::deinit3A()
     free(m3aState.faces);
     m3aState.faces = NULL;
     freeStatistics(m3aState.stats);
+    m3aState.stats = NULL;
+    mStatsCapacity = 0;
     ia_aiq_deinit(m3aState.ia_aiq_handle);
     delete mISPAdaptor;
     mISPAdaptor = NULL;
@@ -305,6 +348,7 @@ status_t AtomAIQ::switchModeAndRate(AtomMode mode, float fps)
     mAeInputParameters.frame_use = m3aState.frame_use;
     mAeInputParameters.manual_limits->manual_frame_time_us_min = (long) 1/fps*1000000;
     mAwbInputParameters.frame_use = m3aState.frame_use;
+    mPreviewRuns = 0;
 
     // In high speed recording, set the AE operation mode as action to notify AIQ
     if (mode == MODE_VIDEO && fps > DEFAULT_RECORDING_FPS) {
@@ -1069,9 +1113,12 @@ status_t AtomAIQ::deinitAeBracketing()
 /**
  * Apply a group of EV value for offline exposure bracketing
  *
+ * requestIds, when not NULL, tag the frames of the group in their
+ * AtomBuffer::result
+ *
  * return the expected applied exposure id. -1 in error
  */
-int AtomAIQ::applyEvGroup(float biases[], int depth, SensorAeConfig aeResults[])
+int AtomAIQ::applyEvGroup(float biases[], int depth, SensorAeConfig aeResults[], const int requestIds[])
 {
     struct atomisp_exposure exposures[depth];
     if (biases == NULL || aeResults == NULL || depth <= 1) {
@@ -1126,7 +1173,7 @@ int AtomAIQ::applyEvGroup(float biases[], int depth, SensorAeConfig aeResults[])
     }
 
     /* Apply ae group settings */
-    return mSensorCI->setExposureGroup(exposures, depth);
+    return mSensorCI->setExposureGroup(exposures, depth, requestIds);
 }
 
 // Exposure operations
@@ -1307,8 +1354,11 @@ status_t AtomAIQ::apply3AProcess(bool read_stats,
     LOG2("@%s: read_stats = %d", __FUNCTION__, read_stats);
     status_t status = NO_ERROR;
 
+    mStatisticsTime = -1;
     if (read_stats) {
+        nsecs_t start = systemTime();
         status = getStatistics(frame_timestamp, orientation);
+        mStatisticsTime = systemTime() - start;
     }
 
     if (m3aState.stats_valid) {
@@ -1493,6 +1543,7 @@ struct atomisp_3a_statistics * AtomAIQ::allocateStatistics(int grid_size)
     stats = (atomisp_3a_statistics*)malloc(sizeof(*stats));
     if (!stats)
         return NULL;
+    CLEAR(*stats);
 
     stats->data = (atomisp_3a_output*)malloc(grid_size * sizeof(*stats->data));
     if (!stats->data) {
@@ -1516,6 +1567,80 @@ void AtomAIQ::freeStatistics(struct atomisp_3a_statistics *stats)
     }
 }
 
+/**
+ * Sets the grid of the statistics buffer
+ *
+ * The buffer is allocated in init3A() for the largest grid the AIQ takes,
+ * so a sensor mode change normally reuses it. It is only reallocated for a
+ * larger grid.
+ */
+bool AtomAIQ::setStatisticsGrid(const struct atomisp_grid_info &grid)
+{
+    LOG1("@%s: grid %dx%d", __FUNCTION__, grid.s3a_width, grid.s3a_height);
+    int grid_size = grid.s3a_width * grid.s3a_height;
+
+    if (m3aState.stats == NULL || grid_size > mStatsCapacity) {
+        LOGW("Statistics grid %dx%d is larger than the buffer, reallocating",
+             grid.s3a_width, grid.s3a_height);
+        freeStatistics(m3aState.stats);
+        m3aState.stats = allocateStatistics(grid_size);
+        mStatsCapacity = m3aState.stats != NULL ? grid_size : 0;
+        if (m3aState.stats == NULL) {
+            LOGE("Statistics memory allocation failed");
+            return false;
+        }
+    }
+
+    m3aState.stats->grid_info = grid;
+    m3aState.stats_valid = false;
+    return true;
+}
+
+/**
+ * Starts the statistics recording or replay of the session, see StatsRecording.h
+ *
+ * When camera.hal.3a.replay names a recording, the statistics, the decoded
+ * exposure and the sensor descriptor given to the AIQ come from it instead
+ * of the ISP and the sensor. Otherwise, with the CAMERA_DEBUG_DUMP_3A_STATISTICS
+ * bit of camera.hal.debug, the statistics of the session are recorded.
+ */
+void AtomAIQ::initStatsRecording()
+{
+    LOG1("@%s", __FUNCTION__);
+    char path[PROPERTY_VALUE_MAX];
+
+    if (property_get("camera.hal.3a.replay", path, NULL) > 0) {
+        if (mStatsPlayer.open(path) == NO_ERROR)
+            LOGW("Camera %d replays the 3A statistics of %s", mCameraId, path);
+        return;
+    }
+
+    if (CameraDump::isDumpImageEnable(CAMERA_DEBUG_DUMP_3A_STATISTICS)) {
+        snprintf(path, sizeof(path), DUMPIMAGE_MEM_INT_PATH "3a_stats_%d_%ld.bin",
+                 mCameraId, (long)time(NULL));
+        mStatsRecorder.open(path, mCameraId);
+    }
+}
+
+/**
+ * Gives the statistics buffer and the sensor descriptor the sensor mode
+ * of the replayed recording
+ */
+bool AtomAIQ::applyReplaySensorMode()
+{
+    LOG1("@%s", __FUNCTION__);
+    const StatsSensorModeRecord &mode = mStatsPlayer.getSensorMode();
+
+    if (mode.grid.s3a_width == 0 || mode.grid.s3a_height == 0)
+        return false;
+
+    if (setStatisticsGrid(mode.grid) == false)
+        return false;
+
+    mAeSensorDescriptor = mode.descriptor;
+    return true;
+}
+
 /**
  * Helper method to store AE results into mAeState.stored_results
  *
@@ -1802,19 +1927,12 @@ bool AtomAIQ::changeSensorMode(void)
     LOG2("sensor descriptor: coarse_integration_time_max_margin %d", sd->coarse_integration_time_max_margin);
     LOG2("sensor descriptor: binning_factor_y %d", sensor_mode_data.binning_factor_y);
 
-    if (m3aState.stats)
-        freeStatistics(m3aState.stats);
-
     m3aState.curr_grid_info = m3aState.results.isp_params.info;
-    int grid_size = m3aState.curr_grid_info.s3a_width * m3aState.curr_grid_info.s3a_height;
-    m3aState.stats = allocateStatistics(grid_size);
-    if (m3aState.stats != NULL) {
-        m3aState.stats->grid_info = m3aState.curr_grid_info;
-        m3aState.stats_valid  = false;
-    } else {
-        LOGE("Statistics memory allocation failed");
+    if (setStatisticsGrid(m3aState.curr_grid_info) == false)
         return false;
-    }
+
+    if (mStatsRecorder.isOpen())
+        mStatsRecorder.writeSensorMode(m3aState.curr_grid_info, mAeSensorDescriptor);
 
     return true;
 }
@@ -1824,13 +1942,28 @@ status_t AtomAIQ::getStatistics(const struct timeval *frame_timestamp_struct, in
     LOG2("@%s", __FUNCTION__);
     status_t ret = NO_ERROR;
 
+    StatsFrameRecord replayFrame;
+    bool replay = mStatsPlayer.isOpen();
+
     PERFORMANCE_TRACES_AAA_PROFILER_START();
-    ret = mISP->getIspStatistics(m3aState.stats);
-    if (ret == -EAGAIN) {
-        LOGV("buffer for isp statistics reallocated according resolution changing\n");
-        if (changeSensorMode() == false)
-            LOGE("error in calling changeSensorMode()\n");
+    if (replay) {
+        ret = mStatsPlayer.readFrame(m3aState.stats, &replayFrame);
+        if (ret == -EAGAIN) {
+            if (applyReplaySensorMode() == false)
+                LOGE("error in applying the sensor mode of the replayed statistics");
+            ret = mStatsPlayer.readFrame(m3aState.stats, &replayFrame);
+        }
+        // changeSensorMode() sets the descriptor of the live sensor
+        if (ret == 0)
+            mAeSensorDescriptor = mStatsPlayer.getSensorMode().descriptor;
+    } else {
         ret = mISP->getIspStatistics(m3aState.stats);
+        if (ret == -EAGAIN) {
+            LOGV("buffer for isp statistics reallocated according resolution changing\n");
+            if (changeSensorMode() == false)
+                LOGE("error in calling changeSensorMode()\n");
+            ret = mISP->getIspStatistics(m3aState.stats);
+        }
     }
 
     if (m3aState.stats) {
@@ -1851,7 +1984,10 @@ status_t AtomAIQ::getStatistics(const struct timeval *frame_timestamp_struct, in
         statistics_input_parameters.af_grids = mAfGridArray;
         statistics_input_parameters.num_af_grids = NUM_EXPOSURES;
 
-        statistics_input_parameters.frame_timestamp = TIMEVAL2USECS(frame_timestamp_struct);
+        if (replay)
+            statistics_input_parameters.frame_timestamp = replayFrame.timestamp;
+        else
+            statistics_input_parameters.frame_timestamp = TIMEVAL2USECS(frame_timestamp_struct);
         statistics_input_parameters.frame_id = statistics_input_parameters.frame_timestamp + 1;
 
         statistics_input_parameters.frame_af_parameters = NULL;
@@ -1870,12 +2006,28 @@ status_t AtomAIQ::getStatistics(const struct timeval *frame_timestamp_struct, in
 
         //update the exposure params with the sensor metadata
         if (statistics_input_parameters.frame_ae_parameters) {
-            unsigned int exp_id = 0;
-            if (m3aState.stats)
-                exp_id = m3aState.stats->exp_id;
-            mISP->getDecodedExposureParams(statistics_input_parameters.frame_ae_parameters->exposures[0].sensor_exposure,
-                                           statistics_input_parameters.frame_ae_parameters->exposures[0].exposure,
-                                           exp_id);
+            ia_aiq_exposure_sensor_parameters *sensor_exposure =
+                statistics_input_parameters.frame_ae_parameters->exposures[0].sensor_exposure;
+            ia_aiq_exposure_parameters *exposure =
+                statistics_input_parameters.frame_ae_parameters->exposures[0].exposure;
+            if (replay) {
+                if (replayFrame.hasExposure) {
+                    *sensor_exposure = replayFrame.sensorExposure;
+                    *exposure = replayFrame.exposure;
+                }
+            } else {
+                unsigned int exp_id = 0;
+                if (m3aState.stats)
+                    exp_id = m3aState.stats->exp_id;
+                mISP->getDecodedExposureParams(sensor_exposure, exposure, exp_id);
+            }
+        }
+
+        if (mStatsRecorder.isOpen() && m3aState.stats) {
+            bool hasExposure = statistics_input_parameters.frame_ae_parameters != NULL;
+            mStatsRecorder.writeFrame(m3aState.stats, statistics_input_parameters.frame_timestamp,
+                hasExposure ? statistics_input_parameters.frame_ae_parameters->exposures[0].sensor_exposure : NULL,
+                hasExposure ? statistics_input_parameters.frame_ae_parameters->exposures[0].exposure : NULL);
         }
 
         if (mAfState.af_results) {
@@ -2291,38 +2443,153 @@ status_t AtomAIQ::runDSDMain()
     return NO_ERROR;
 }
 
+/**
+ * Tells whether a heavy stage (GBCE, DSD) runs in this iteration
+ *
+ * On preview, video and continuous frames the stage only runs every
+ * stride iterations and keeps its previous results in between. The phase
+ * spreads the strided stages over different frames. Still frames always
+ * run every stage.
+ */
+bool AtomAIQ::runStageThisFrame(int stride, int phase) const
+{
+    if (stride <= 1 || m3aState.frame_use == ia_aiq_frame_use_still)
+        return true;
+    return ((mPreviewRuns + phase) % stride) == 0;
+}
+
 status_t AtomAIQ::run3aMain()
 {
     LOG2("@%s", __FUNCTION__);
     status_t ret = NO_ERROR;
+    nsecs_t times[AIQ_STAGE_COUNT];
+    nsecs_t start;
 
     if (mBracketingRunning) {
         LOG1("@%s bracketing now, skip 3a running", __FUNCTION__);
         return ret;
     }
 
-    if(!mFileInjection)
+    // -1 marks the stages not run in this iteration
+    for (int i = 0; i < AIQ_STAGE_COUNT; i++)
+        times[i] = -1;
+    times[AIQ_STAGE_STATISTICS] = mStatisticsTime;
+
+    if(!mFileInjection) {
+        start = systemTime();
         ret |= runAfMain();
+        times[AIQ_STAGE_AF] = systemTime() - start;
+    }
 
     // if no DSD enable, should disable that
-    if(!mFileInjection)
+    if(!mFileInjection && runStageThisFrame(mDsdStride, 1)) {
+        start = systemTime();
         ret |= runDSDMain();
+        times[AIQ_STAGE_DSD] = systemTime() - start;
+    }
 
-    if(!mFileInjection)
+    if(!mFileInjection) {
+        start = systemTime();
         ret |= runAeMain();
+        times[AIQ_STAGE_AE] = systemTime() - start;
+    }
 
+    start = systemTime();
     runAwbMain();
-
-    if(mAeMode != CAM_AE_MODE_MANUAL)
-        ret |= runGBCEMain();
-    else
+    times[AIQ_STAGE_AWB] = systemTime() - start;
+
+    if(mAeMode != CAM_AE_MODE_MANUAL) {
+        // without results GBCE cannot wait for its turn
+        if (mGBCEResults == NULL || runStageThisFrame(mGbceStride, 0)) {
+            start = systemTime();
+            ret |= runGBCEMain();
+            times[AIQ_STAGE_GBCE] = systemTime() - start;
+        }
+    } else
         mGBCEResults = NULL;
 
     // get AIC result and apply into ISP
+    start = systemTime();
     ret |= runAICMain();
+    times[AIQ_STAGE_AIC] = systemTime() - start;
+
+    mPreviewRuns++;
+    recordStageTimes(times);
 
     return ret;
 }
+
+void AtomAIQ::recordStageTimes(const nsecs_t times[AIQ_STAGE_COUNT])
+{
+    Mutex::Autolock lock(mTimingLock);
+
+    for (int i = 0; i < AIQ_STAGE_COUNT; i++) {
+        if (times[i] < 0)
+            continue;
+        mStageTimings[i].runs++;
+        mStageTimings[i].total += times[i];
+        if (times[i] > mStageTimings[i].max)
+            mStageTimings[i].max = times[i];
+    }
+
+    LOG2("@%s: stats %lld af %lld dsd %lld ae %lld awb %lld gbce %lld aic %lld us", __FUNCTION__,
+         times[AIQ_STAGE_STATISTICS] / 1000, times[AIQ_STAGE_AF] / 1000,
+         times[AIQ_STAGE_DSD] / 1000, times[AIQ_STAGE_AE] / 1000,
+         times[AIQ_STAGE_AWB] / 1000, times[AIQ_STAGE_GBCE] / 1000,
+         times[AIQ_STAGE_AIC] / 1000);
+}
+
+/**
+ * Appends the run count and the average and maximum time of each 3A stage
+ * to out
+ */
+void AtomAIQ::dumpTimings(String8 &out)
+{
+    static const char *stageNames[AIQ_STAGE_COUNT] = {
+        "statistics", "af", "dsd", "ae", "awb", "gbce", "aic"
+    };
+    StageTiming timings[AIQ_STAGE_COUNT];
+
+    {
+        Mutex::Autolock lock(mTimingLock);
+        memcpy(timings, mStageTimings, sizeof(timings));
+    }
+
+    out.appendFormat("AIQ stages (gbce stride %d, dsd stride %d):\n", mGbceStride, mDsdStride);
+    for (int i = 0; i < AIQ_STAGE_COUNT; i++) {
+        if (timings[i].runs == 0)
+            continue;
+        out.appendFormat("  %-10s %8u runs %8lldus avg %8lldus max\n", stageNames[i],
+                         timings[i].runs, timings[i].total / timings[i].runs / 1000,
+                         timings[i].max / 1000);
+    }
+    out.appendFormat("ISP parameters: %d applied, %d failed, last for exp id %d (statistics at %d)\n",
+                     android_atomic_acquire_load(&mIspParamsApplied),
+                     android_atomic_acquire_load(&mIspParamsFailed),
+                     android_atomic_acquire_load(&mIspParamsExpId),
+                     m3aState.stats ? (int)m3aState.stats->exp_id : EXP_ID_INVALID);
+    mStatsRecorder.dump(out);
+    mStatsPlayer.dump(out);
+}
+
+/**
+ * The ISP parameters computed from the statistics of frameId reached the
+ * driver, or not. Called from the ISP parameter queue thread.
+ */
+void AtomAIQ::ispParamsApplied(int request, unsigned int frameId, int ret)
+{
+    LOG2("@%s: request 0x%x exp id %u ret %d", __FUNCTION__, request, frameId, ret);
+    if (request != (int)ATOMISP_IOC_S_PARAMETERS)
+        return;
+
+    if (ret < 0) {
+        android_atomic_inc(&mIspParamsFailed);
+        return;
+    }
+    android_atomic_inc(&mIspParamsApplied);
+    android_atomic_release_store(frameId, &mIspParamsExpId);
+}
+
 /*
 int AtomAIQ::run3aMain()
 {
@@ -2450,6 +2717,9 @@ status_t AtomAIQ::runAICMain()
         mIspInputParams.manual_brightness = 0;
         mIspInputParams.manual_hue = 0;
 
+        // the parameters of the previous frame point to the output of the
+        // ISP adaptor, they must be applied or dropped before it is rewritten
+        mISP->reclaimAicParameter();
         ret = mISPAdaptor->calculateIspParams(&mIspInputParams, &((m3aState.results).isp_output));
 
         /* Apply ISP settings */
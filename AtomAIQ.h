@@ -37,6 +37,7 @@ class I3AControls;
 #include "AtomFifo.h"
 #include "ICameraHwControls.h"
 #include "ia_face.h"
+#include "StatsRecording.h"
 
 namespace android {
 
@@ -218,12 +219,14 @@ protected:
  * All access to the imaging library go via AtomAIQ.
  *
  */
-class AtomAIQ : public I3AControls {
+class AtomAIQ : public I3AControls,
+                public IIspParamsListener {
 
 // constructor/destructor
 private:
     // Common functions for 3A, GBCE, AF etc.
     status_t run3aMain();
+    bool runStageThisFrame(int stride, int phase) const;
 
     //AE for flash
     int AeForFlash();
@@ -234,7 +237,10 @@ private:
     status_t getStatistics(const struct timeval *frame_timestamp, int orientation);
     struct atomisp_3a_statistics * allocateStatistics(int grid_size);
     void freeStatistics(struct atomisp_3a_statistics *stats);
+    bool setStatisticsGrid(const struct atomisp_grid_info &grid);
     bool needStatistics();
+    void initStatsRecording();
+    bool applyReplaySensorMode();
 
     // GBCE
     int setGammaEffect(bool inv_gamma);
@@ -371,7 +377,7 @@ public:
     status_t setManualFocus(int focus, bool applyNow);
     status_t setManualFocusIncrement(int step);
     status_t applyEv(float bias);
-    int      applyEvGroup(float biases[], int depth, SensorAeConfig aeResults[]);
+    int      applyEvGroup(float biases[], int depth, SensorAeConfig aeResults[], const int requestIds[]);
     status_t setEv(float bias);
     status_t getEv(float *ret);
 
@@ -397,6 +403,10 @@ public:
 
     // ISP processing functions
     status_t apply3AProcess(bool read_stats, struct timeval *frame_timestamp, int orientation);
+    void dumpTimings(String8 &out);
+
+    // IIspParamsListener override
+    virtual void ispParamsApplied(int request, unsigned int frameId, int ret);
 
     status_t startStillAf();
     status_t stopStillAf();
@@ -421,6 +431,28 @@ public:
     // set manual focus length
     void setManualFocusParameters(ia_aiq_manual_focus_parameters focusParameters);
 
+// private types
+private:
+    // steps of one 3A iteration, timed separately
+    enum AiqStage {
+        AIQ_STAGE_STATISTICS = 0,
+        AIQ_STAGE_AF,
+        AIQ_STAGE_DSD,
+        AIQ_STAGE_AE,
+        AIQ_STAGE_AWB,
+        AIQ_STAGE_GBCE,
+        AIQ_STAGE_AIC,
+        AIQ_STAGE_COUNT
+    };
+
+    struct StageTiming {
+        unsigned int runs;
+        nsecs_t total;
+        nsecs_t max;
+    };
+
+    void recordStageTimes(const nsecs_t times[AIQ_STAGE_COUNT]);
+
 // private members
 private:
     IHWIspControl *mISP;
@@ -496,6 +528,27 @@ private:
 
     bool mFileInjection; // Note: AtomAIQ contains custom logic when file injection is enabled
 
+    // GBCE and DSD only run every Nth preview frame, see runStageThisFrame()
+    unsigned int mPreviewRuns;  // run3aMain() calls since the last mode switch
+    int mGbceStride;
+    int mDsdStride;
+
+    // per stage timing, written by the 3A thread and read by dumpTimings()
+    Mutex mTimingLock;
+    StageTiming mStageTimings[AIQ_STAGE_COUNT];
+    nsecs_t mStatisticsTime;    // getStatistics() of the current iteration
+
+    int mStatsCapacity;         // cells in m3aState.stats->data
+
+    // ISP parameter writes, from ispParamsApplied() on the thread applying them
+    volatile int32_t mIspParamsApplied;
+    volatile int32_t mIspParamsFailed;
+    volatile int32_t mIspParamsExpId;   // exp id of the statistics of the last applied ones
+
+    // statistics recording and replay, see initStatsRecording()
+    StatsRecorder mStatsRecorder;
+    StatsPlayer mStatsPlayer;
+
     int mCameraId;
 }; // class AtomAIQ
 
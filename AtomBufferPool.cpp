@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Camera_AtomBufferPool"
+
+#include "LogHelper.h"
+#include "AtomBufferPool.h"
+#include "MemoryUtils.h"
+
+namespace android {
+
+AtomBufferPool::AtomBufferPool(Callbacks *callbacks) :
+    mCallbacks(callbacks)
+    ,mMemoryLimit(0)
+    ,mBytesHeld(0)
+    ,mBytesIdle(0)
+    ,mPeakBytesHeld(0)
+    ,mHits(0)
+    ,mMisses(0)
+    ,mEvictions(0)
+{
+    LOG1("@%s", __FUNCTION__);
+}
+
+AtomBufferPool::~AtomBufferPool()
+{
+    LOG1("@%s", __FUNCTION__);
+    Mutex::Autolock lock(mLock);
+
+    LOG1("buffer pool: %u hits, %u misses, %u evictions, peak %u bytes",
+         mHits, mMisses, mEvictions, mPeakBytesHeld);
+    while (!mEntries.isEmpty()) {
+        if (mEntries[0].inUse)
+            LOGW("Buffer %p still in use when destroying the pool", mEntries[0].buffer.dataPtr);
+        freeEntryLocked(0);
+    }
+}
+
+bool AtomBufferPool::matches(const Entry &entry, const AtomBuffer &formatDescriptor,
+                             AtomBufferType type, bool gfx)
+{
+    const AtomBuffer &buffer = entry.buffer;
+    return !entry.inUse
+           && entry.gfx == gfx
+           && buffer.type == type
+           && buffer.fourcc == formatDescriptor.fourcc
+           && buffer.width == formatDescriptor.width
+           && buffer.height == formatDescriptor.height
+           && buffer.bpl == formatDescriptor.bpl
+           && buffer.size >= formatDescriptor.size;
+}
+
+int AtomBufferPool::findLocked(const void *dataPtr)
+{
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        if (mEntries[i].buffer.dataPtr == dataPtr)
+            return i;
+    }
+    return -1;
+}
+
+void AtomBufferPool::freeEntryLocked(size_t index)
+{
+    Entry &entry = mEntries.editItemAt(index);
+
+    mBytesHeld -= entry.buffer.size;
+    if (!entry.inUse)
+        mBytesIdle -= entry.buffer.size;
+    MemoryUtils::freeAtomBuffer(entry.buffer);
+    mEntries.removeAt(index);
+}
+
+/**
+ * Frees idle buffers, oldest first, until the pool fits in its limit
+ */
+void AtomBufferPool::evictLocked()
+{
+    while (mBytesHeld > mMemoryLimit && mBytesIdle > 0) {
+        int oldest = -1;
+        for (size_t i = 0; i < mEntries.size(); i++) {
+            if (!mEntries[i].inUse
+                && (oldest < 0 || mEntries[i].lastUse < mEntries[oldest].lastUse))
+                oldest = i;
+        }
+        LOG1("@%s: freeing %dx%d buffer %p", __FUNCTION__, mEntries[oldest].buffer.width,
+             mEntries[oldest].buffer.height, mEntries[oldest].buffer.dataPtr);
+        freeEntryLocked(oldest);
+        mEvictions++;
+    }
+}
+
+status_t AtomBufferPool::acquire(AtomBuffer &aBuff, const AtomBuffer &formatDescriptor, bool gfx)
+{
+    LOG1("@%s: (%dx%d) s:%d fourcc %s %s", __FUNCTION__,
+         formatDescriptor.width, formatDescriptor.height, formatDescriptor.bpl,
+         v4l2Fmt2Str(formatDescriptor.fourcc), gfx ? "gfx" : "heap");
+    Mutex::Autolock lock(mLock);
+
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        if (matches(mEntries[i], formatDescriptor, aBuff.type, gfx)) {
+            Entry &entry = mEntries.editItemAt(i);
+            entry.inUse = true;
+            mBytesIdle -= entry.buffer.size;
+            aBuff = entry.buffer;
+            mHits++;
+            return NO_ERROR;
+        }
+    }
+
+    Entry entry;
+    entry.buffer = AtomBufferFactory::createAtomBuffer(aBuff.type);
+    if (gfx)
+        MemoryUtils::allocateGraphicBuffer(entry.buffer, formatDescriptor);
+    else
+        MemoryUtils::allocateAtomBuffer(entry.buffer, formatDescriptor, mCallbacks);
+    mMisses++;
+
+    if (entry.buffer.dataPtr == NULL) {
+        LOGE("@%s: allocation failed", __FUNCTION__);
+        MemoryUtils::freeAtomBuffer(entry.buffer);
+        aBuff.buff = NULL;
+        aBuff.dataPtr = NULL;
+        return NO_MEMORY;
+    }
+
+    entry.gfx = gfx;
+    entry.inUse = true;
+    entry.lastUse = 0;
+    mEntries.push(entry);
+    mBytesHeld += entry.buffer.size;
+    if (mBytesHeld > mPeakBytesHeld)
+        mPeakBytesHeld = mBytesHeld;
+    evictLocked();
+
+    aBuff = entry.buffer;
+    return NO_ERROR;
+}
+
+void AtomBufferPool::release(AtomBuffer &aBuff)
+{
+    LOG2("@%s: dataPtr %p", __FUNCTION__, aBuff.dataPtr);
+    if (aBuff.dataPtr == NULL)
+        return;
+
+    Mutex::Autolock lock(mLock);
+    int i = findLocked(aBuff.dataPtr);
+    if (i < 0) {
+        MemoryUtils::freeAtomBuffer(aBuff);
+        return;
+    }
+
+    Entry &entry = mEntries.editItemAt(i);
+
+    // metadata is attached by the users, it is not pooled
+    if (aBuff.metadata_buff != entry.buffer.metadata_buff)
+        MemoryUtils::freeAtomBufferMetadata(aBuff);
+
+    if (!entry.inUse) {
+        LOGE("@%s: buffer %p released twice", __FUNCTION__, aBuff.dataPtr);
+    } else {
+        entry.inUse = false;
+        entry.lastUse = systemTime();
+        mBytesIdle += entry.buffer.size;
+        evictLocked();  // may free entry
+    }
+
+    // the caller's copy must look freed, as after MemoryUtils::freeAtomBuffer()
+    aBuff.buff = NULL;
+    aBuff.metadata_buff = NULL;
+    aBuff.dataPtr = NULL;
+    aBuff.gfxInfo.gfxBuffer = NULL;
+    aBuff.gfxInfo.gfxBufferHandle = NULL;
+    aBuff.gfxInfo.locked = false;
+    aBuff.gfxInfo_rec.gfxBuffer = NULL;
+    aBuff.gfxInfo_rec.gfxBufferHandle = NULL;
+    aBuff.gfxInfo_rec.locked = false;
+}
+
+void AtomBufferPool::returnBuffer(AtomBuffer *buff)
+{
+    release(*buff);
+}
+
+void AtomBufferPool::setMemoryLimit(size_t bytes)
+{
+    LOG1("@%s: %u bytes", __FUNCTION__, bytes);
+    Mutex::Autolock lock(mLock);
+    mMemoryLimit = bytes;
+    evictLocked();
+}
+
+void AtomBufferPool::trim()
+{
+    LOG1("@%s", __FUNCTION__);
+    Mutex::Autolock lock(mLock);
+    size_t i = 0;
+    while (i < mEntries.size()) {
+        if (!mEntries[i].inUse)
+            freeEntryLocked(i);
+        else
+            i++;
+    }
+}
+
+void AtomBufferPool::dump(String8 &out)
+{
+    Mutex::Autolock lock(mLock);
+    uint32_t requests = mHits + mMisses;
+
+    out.appendFormat("AtomBufferPool: %u buffers, %u bytes held (%u idle, peak %u, limit %u)\n",
+                     mEntries.size(), mBytesHeld, mBytesIdle, mPeakBytesHeld, mMemoryLimit);
+    out.appendFormat("  %u requests, %u hits (%u%%), %u evictions\n", requests, mHits,
+                     requests ? mHits * 100 / requests : 0, mEvictions);
+    for (size_t i = 0; i < mEntries.size(); i++) {
+        const Entry &entry = mEntries[i];
+        out.appendFormat("  %dx%d s:%d %s type %d %s size %d%s\n",
+                         entry.buffer.width, entry.buffer.height, entry.buffer.bpl,
+                         v4l2Fmt2Str(entry.buffer.fourcc), entry.buffer.type,
+                         entry.gfx ? "gfx" : "heap", entry.buffer.size,
+                         entry.inUse ? " in use" : "");
+    }
+}
+
+}; // namespace android
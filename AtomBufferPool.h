@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_ATOM_BUFFER_POOL_H
+#define ANDROID_LIBCAMERA_ATOM_BUFFER_POOL_H
+
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include <utils/String8.h>
+#include "AtomCommon.h"
+
+namespace android {
+
+class Callbacks;
+
+/**
+ * \class AtomBufferPool
+ *
+ * Recycles the large AtomBuffer allocations (snapshot, postview, ULL copy
+ * buffers) of one camera instance across captures and mode switches.
+ *
+ * Buffers are matched on (fourcc, width, height, bpl, type) and on the
+ * memory they come from: heap via Callbacks or graphic buffers. A buffer
+ * handed out by acquire() is in use until release() or returnBuffer(), then
+ * it stays in the pool, idle, for the next acquire() of the same format.
+ * Idle buffers are freed least recently used first whenever the pool holds
+ * more than its memory limit, in-use buffers are never freed.
+ *
+ * The limit is 0 until the owner sets it, ControlThread sets it to the
+ * snapshot and postview memory of the last capture plan and trims the pool
+ * when preview stops and at release.
+ *
+ * The pool can be used from any thread.
+ */
+class AtomBufferPool : public IBufferOwner {
+public:
+    AtomBufferPool(Callbacks *callbacks);
+    virtual ~AtomBufferPool();
+
+// prevent copy constructor and assignment operator
+private:
+    AtomBufferPool(const AtomBufferPool& other);
+    AtomBufferPool& operator=(const AtomBufferPool& other);
+
+public:
+    /**
+     * Gets a buffer matching the format descriptor, reusing an idle one if
+     * possible. Replaces MemoryUtils::allocateAtomBuffer/allocateGraphicBuffer.
+     *
+     * \param aBuff buffer to fill in, its type selects the pool entry
+     * \param formatDescriptor format of the buffer
+     * \param gfx true to allocate a graphic buffer instead of heap
+     * \return NO_MEMORY if the allocation failed, aBuff.dataPtr is NULL then
+     */
+    status_t acquire(AtomBuffer &aBuff, const AtomBuffer &formatDescriptor, bool gfx = false);
+
+    /**
+     * Makes the buffer idle and clears the memory fields of aBuff like
+     * MemoryUtils::freeAtomBuffer(). Buffers that did not come from the
+     * pool are freed with MemoryUtils::freeAtomBuffer().
+     */
+    void release(AtomBuffer &aBuff);
+
+    // IBufferOwner, same as release()
+    virtual void returnBuffer(AtomBuffer *buff);
+
+    /**
+     * Sets the number of bytes above which idle buffers are freed, and
+     * frees them right away if the pool holds more
+     */
+    void setMemoryLimit(size_t bytes);
+
+    /**
+     * Frees all idle buffers
+     */
+    void trim();
+
+    /**
+     * Appends the hit rate and the memory held to out
+     */
+    void dump(String8 &out);
+
+private:
+    struct Entry {
+        AtomBuffer buffer;  /*!< as allocated, handed out by value */
+        bool gfx;
+        bool inUse;         /*!< false when idle */
+        nsecs_t lastUse;    /*!< when it became idle, for LRU eviction */
+    };
+
+    static bool matches(const Entry &entry, const AtomBuffer &formatDescriptor,
+                        AtomBufferType type, bool gfx);
+    int findLocked(const void *dataPtr);
+    void freeEntryLocked(size_t index);
+    void evictLocked();
+
+private:
+    Callbacks *mCallbacks;
+    Mutex mLock;
+    Vector<Entry> mEntries;
+    size_t mMemoryLimit;
+    size_t mBytesHeld;      /*!< memory of all entries */
+    size_t mBytesIdle;      /*!< memory of entries with no reference */
+    size_t mPeakBytesHeld;
+    uint32_t mHits;
+    uint32_t mMisses;
+    uint32_t mEvictions;
+};
+
+}; // namespace android
+
+#endif // ANDROID_LIBCAMERA_ATOM_BUFFER_POOL_H
@@ -246,6 +246,8 @@ AtomBuffer AtomBufferFactory::createAtomBuffer(AtomBufferType type,
     buf.auxBuf = NULL;
     buf.returnAfterCB = false;
     buf.sensorFrameId = -1;
+    CLEAR(buf.result);
+    buf.result.requestId = -1;
 
     return buf;
 }
@@ -164,6 +164,25 @@ struct GFXBufferInfo {
     int scalerId;
 };
 
+/*! \struct FrameResult
+ *
+ * Settings that were in effect for one frame
+ *
+ * The sensor values come from the exposure history of SensorHW, matched
+ * to the frame by its exposure id. Values are the raw sensor codes given
+ * to IHWSensorControl::setExposure() and setExposureGroup().
+ */
+struct FrameResult {
+    bool valid;                 /*!< false when the sensor settings of the frame are not known */
+    int requestId;              /*!< id of the exposure request that first reached this frame, -1 if none */
+    unsigned int coarseIntegrationTime;
+    unsigned int fineIntegrationTime;
+    unsigned int analogGain;
+    unsigned int digitalGain;
+    unsigned int aperture;
+    unsigned int ispParamsExpId; /*!< exp id of the statistics the ISP parameters in use were computed from */
+};
+
 /*! \struct AtomBuffer
  *
  * Container struct for buffers passed to/from Atom ISP
@@ -200,6 +219,7 @@ struct AtomBuffer {
     AtomBuffer *auxBuf;                 /*!< auxiliary buffer (metadata/jpeg), used in jpeg capture mode */
     bool returnAfterCB;                 /*!< flag indicating whether after the callback to camera service the buffer should be returned */
     int sensorFrameId;          /*!< Sensor frame id gotten from sensor meta data and set by AtomISP class. */
+    FrameResult result;         /*!< settings applied to the frame, set by AtomISP class when dequeued */
 };
 
 struct AAAWindowInfo {
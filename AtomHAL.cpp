@@ -20,6 +20,7 @@
 #include "LogHelper.h"
 #include "CameraConf.h"
 #include "PerformanceTraces.h"
+#include "MessageQueueStats.h"
 #include <utils/Log.h>
 #include <utils/threads.h>
 #include "PlatformData.h"
@@ -327,7 +328,12 @@ static void atom_release(struct camera_device * device)
 static int atom_dump(struct camera_device * device, int fd)
 {
     LOGD("%s", __FUNCTION__);
-    // TODO: implement
+    MessageQueueStats::dumpAll(fd);
+    if (!device)
+        return 0;
+    atom_camera *cam = (atom_camera *)(device->priv);
+    if (cam)
+        cam->control_thread->dump(fd);
     return 0;
 }
 
@@ -25,6 +25,7 @@
 #include "PanoramaThread.h"
 #include "CameraDump.h"
 #include "MemoryUtils.h"
+#include "AtomBufferPool.h"
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -96,6 +97,8 @@ AtomISP::AtomISP(int cameraId, sp<ScalerService> scalerService, Callbacks *callb
     ,mHALSDVEnabled(false)
     ,mUseMultiStreamsForSoC(PlatformData::useMultiStreamsForSoC(mCameraId))
     ,mHALZSLBuffers(NULL)
+    ,mHALZSLPreviewBuffers(MAX_V4L2_BUFFERS)
+    ,mHALZSLCaptureBuffers(sNumHALZSLBuffers)
     ,mContinuousJpegCaptureEnabled(false)
     ,mMultiStreamsHALZSLCaptureBuffers(NULL)
     ,mMultiStreamsHALZSLPostviewBuffers(NULL)
@@ -106,14 +109,20 @@ AtomISP::AtomISP(int cameraId, sp<ScalerService> scalerService, Callbacks *callb
     ,mBufferSharingSessionID(DEFAULT_BUFFER_SHARING_SESSION_ID)
     ,mNumPreviewBuffersQueued(0)
     ,mNumRecordingBuffersQueued(0)
+    ,mRecordingFrameReady(0)
+    ,mStatsExpId(0)
+    ,mIspParamsExpId(EXP_ID_INVALID)
+    ,mIspParamsListener(NULL)
     ,mNumCapturegBuffersQueued(0)
     ,mFlashTorchSetting(0)
     ,mContCaptPrepared(false)
+    ,mContRingBufferSize(0)
     ,mInitialSkips(0)
     ,mStatisticSkips(0)
     ,mDVSFrameSkips(0)
     ,mVideoZoomFrameSkips(0)
     ,mSessionId(0)
+    ,mShutterTime(0)
     ,mLowLight(false)
     ,mXnr(0)
     ,mZoomRatios(NULL)
@@ -137,6 +146,8 @@ AtomISP::AtomISP(int cameraId, sp<ScalerService> scalerService, Callbacks *callb
     CLEAR(mContCaptConfig);
     mPostviewBuffers.clear();
     mPreviewBuffers.clear();
+    mKeptPreviewBuffers.clear();
+    CLEAR(mPreviewBuffersFormat);
     CLEAR(mConfig);
     mFileInject.clear();
 }
@@ -195,6 +206,18 @@ status_t AtomISP::initDevice()
 
     PERFORMANCE_TRACES_BREAKDOWN_STEP("Open_Main_Device");
 
+    // the queue of a previous initDevice() works on the old main device
+    if (mIspParamsQueue != NULL) {
+        mIspParamsQueue->requestExitAndWait();
+        mIspParamsQueue.clear();
+    }
+    mIspParamsQueue = new V4L2IoctlQueue(mMainDevice);
+    mIspParamsQueue->setListener(this);
+    if (mIspParamsQueue->run("CamHAL_ISPPARAMS") != NO_ERROR) {
+        LOGW("Could not start the ISP parameter queue, parameters are applied directly");
+        mIspParamsQueue.clear();
+    }
+
     initFileInject();
 
     mSensorHW->selectActiveSensor(mMainDevice);
@@ -259,6 +282,9 @@ void AtomISP::deInitDevice()
         mDvs = NULL;
     }
 
+    if (mIspParamsQueue != NULL)
+        mIspParamsQueue->flush();
+    freeKeptPreviewBuffers();
     mMainDevice->close();
 }
 
@@ -495,7 +521,19 @@ AtomISP::~AtomISP()
     //       This is not needed for preview and recording buffers.
     freeSnapshotBuffers();
     freePostviewBuffers();
+    freeKeptPreviewBuffers();
 
+    // zero-copy HAL ZSL snapshots that were never returned
+    for (size_t i = 0; i < mHALZSLOrphanBuffers.size(); i++) {
+        LOGW("HAL ZSL buffer %p not returned", mHALZSLOrphanBuffers[i].dataPtr);
+        MemoryUtils::freeAtomBuffer(mHALZSLOrphanBuffers.editItemAt(i));
+    }
+    mHALZSLOrphanBuffers.clear();
+
+    if (mIspParamsQueue != NULL) {
+        mIspParamsQueue->requestExitAndWait();
+        mIspParamsQueue.clear();
+    }
     mMainDevice->close();
 
     // clear the sp to the devices to destroy the objects.
@@ -1248,6 +1286,8 @@ status_t AtomISP::allocateBuffers(AtomMode mode)
         }
         break;
     case MODE_CAPTURE:
+        // the snapshot buffers need the memory more than a preview restart
+        freeKeptPreviewBuffers();
         if ((status = allocateSnapshotBuffers()) != NO_ERROR)
             return status;
         break;
@@ -1386,6 +1426,11 @@ status_t AtomISP::stop()
     }
 
     runStopISPActions();
+    logSyscallCounts();
+
+    // parameters still queued belong to the stream that stops
+    if (mIspParamsQueue != NULL)
+        mIspParamsQueue->flush();
 
     switch (mMode) {
     case MODE_CONTINUOUS_JPEG:
@@ -1724,6 +1769,7 @@ status_t AtomISP::startRecording()
     } else {
         mNumRecordingBuffersQueued = 0; // halVS doesn't use rec bufs
     }
+    android_atomic_release_store(0, &mRecordingFrameReady);
 
     return status;
 
@@ -1745,6 +1791,7 @@ status_t AtomISP::stopRecording()
     }
 
     mRecordingDevice->stop();
+    android_atomic_release_store(0, &mRecordingFrameReady);
     freeRecordingBuffers();
     mRecordingDevice->close();
 
@@ -1858,6 +1905,10 @@ status_t AtomISP::requestContCapture(int numCaptures, int offset, unsigned int s
         return NO_ERROR;
     }
 
+    // the captured frames must get the parameters computed so far
+    if (mIspParamsQueue != NULL)
+        mIspParamsQueue->flush();
+
     struct atomisp_cont_capture_conf conf;
 
     CLEAR(conf);
@@ -1963,6 +2014,7 @@ status_t AtomISP::configureContinuousRingBuffer()
                                    numBuffers,
                                    "Continuous raw ringbuffer size") < 0)
         return UNKNOWN_ERROR;
+    mContRingBufferSize = numBuffers;
 
     // enable or disable raw buffer lock mode
     rawBufferLockEnable(mContCaptConfig.rawBufferLock);
@@ -1983,6 +2035,15 @@ int AtomISP::getContinuousCaptureNumber() const
     return mContCaptConfig.numCaptures;
 }
 
+/**
+ * Returns the number of raw frames in the continuous mode ringbuffer, as
+ * set by the last configureContinuousRingBuffer()
+ */
+int AtomISP::getContinuousRingBufferSize() const
+{
+    return mContRingBufferSize;
+}
+
 /**
  * Calculates the correct frame offset to capture to reach Zero
  * Shutter Lag.
@@ -1997,6 +2058,18 @@ int AtomISP::shutterLagZeroAlign() const
     return lagZeroOffset;
 }
 
+/**
+ * Sets the time the user pressed the shutter for the next HAL ZSL snapshot.
+ *
+ * \param shutterTime systemTime() at takePicture()
+ */
+void AtomISP::setShutterTime(nsecs_t shutterTime)
+{
+    LOG2("@%s", __FUNCTION__);
+    Mutex::Autolock lock(mHALZSLLock);
+    mShutterTime = shutterTime;
+}
+
 /**
  * Returns the minimum offset ISP supports.
  *
@@ -4098,24 +4171,25 @@ void AtomISP::dumpHALZSLPreviewBufs() {
 }
 
 /**
- * Waits for buffers to arrive in the given vector. If there aren't initially
+ * Waits for buffers to arrive in the given queue. If there aren't initially
  * any buffers, this sleeps and retries a predefined amount of cycles.
  *
  * Preconditions: snapshot case - mHALZSLLock is locked.
  *                preview case - mDevices[mPreviewDevice].mutex and
  *                               mHALZSLLock are locked in that order
- * \param vector of AtomBuffers
+ * \param queue Vector or IndexedFrameRing of AtomBuffers
  * \param snapshot: boolean to distinguish whether we are waiting for a
  *                  ZSL buffer to get a snapshot or preview frame.
- * \return true if there are buffers in the vector, false if not
+ * \return true if there are buffers in the queue, false if not
  */
-bool AtomISP::waitForHALZSLBuffer(Vector<AtomBuffer> &vector, bool snapshot)
+template <typename Queue>
+bool AtomISP::waitForHALZSLBuffer(Queue &queue, bool snapshot)
 {
     LOG2("@%s", __FUNCTION__);
     int retryCount = sHALZSLRetryCount;
     size_t size = 0;
     do {
-        size = vector.size();
+        size = queue.size();
         if (size == 0) {
             mHALZSLLock.unlock();
             if (!snapshot)
@@ -4348,6 +4422,7 @@ status_t AtomISP::getPreviewFrame(AtomBuffer *buff)
     mPreviewBuffers.editItemAt(index).status = (FrameBufferStatus)(bufInfo.vbuffer.reserved & FRAME_STATUS_MASK);
     mPreviewBuffers.editItemAt(index).size = bufInfo.vbuffer.bytesused;
     mPreviewBuffers.editItemAt(index).sensorFrameId = getSensorFrameId(mPreviewBuffers.editItemAt(index).expId);
+    fillFrameResult(&mPreviewBuffers.editItemAt(index));
 
     *buff = mPreviewBuffers[index];
 
@@ -4372,15 +4447,24 @@ status_t AtomISP::putHALZSLPreviewFrame(AtomBuffer *buff)
     size_t size = mHALZSLCaptureBuffers.size();
     LOG2("@%s cap buffers size was %d", __FUNCTION__, size);
 
-    if (size > sMaxHALZSLBuffersHeldInHAL) {
-        AtomBuffer buf = mHALZSLCaptureBuffers.itemAt(0);
+    // every buffer lent as a snapshot is one less in the ring, hold fewer
+    // in the FIFO so that the driver does not run short of buffers. After a
+    // lent buffer comes back more than one can be over the limit, they are
+    // queued together.
+    unsigned int ids[sNumHALZSLBuffers];
+    int count = 0;
+    while (size > sMaxHALZSLBuffersHeldInHAL - mHALZSLLentBuffers.size()) {
+        ids[count++] = mHALZSLCaptureBuffers.itemAt(0).id;
         mHALZSLCaptureBuffers.removeAt(0);
+        size--;
+    }
 
-        if (mPreviewDevice->putFrame(buf.id) < 0) {
-            return UNKNOWN_ERROR;
-        }
-        mNumPreviewBuffersQueued++;
+    if (count > 0) {
+        int queued = mPreviewDevice->putFrames(ids, count);
+        mNumPreviewBuffersQueued += queued;
         LOG2("@%s mNumPreviewBuffersQueued:%d", __FUNCTION__, mNumPreviewBuffersQueued);
+        if (queued < count)
+            return UNKNOWN_ERROR;
     }
 
     dumpHALZSLBufs();
@@ -4512,6 +4596,8 @@ void AtomISP::returnBuffer(AtomBuffer* buff)
 
         case ATOM_BUFFER_SNAPSHOT:
             buff->owner = 0;
+            if (mHALZSLEnabled && returnHALZSLBuffer(buff))
+                break;
             if (mMode != MODE_CONTINUOUS_JPEG && mMode != MODE_CONTINUOUS_JPEG_VIDEO) {
                 LOGE("Capture frame return on wrong mode");
                 break;
@@ -4546,6 +4632,7 @@ status_t AtomISP::setGraphicPreviewBuffers(const AtomBuffer *buffs, int numBuffs
     }
 
     freePreviewBuffers();
+    freeKeptPreviewBuffers();
 
     for (int i = 0; i < numBuffs; i++) {
         mPreviewBuffers.push(buffs[i]);
@@ -4567,10 +4654,13 @@ status_t AtomISP::getRecordingFrame(AtomBuffer *buff)
 
     CLEAR(buf);
 
-    int pollResult = mRecordingDevice->poll(0);
-    if (pollResult < 1) {
-        LOG2("No data in recording device, poll result: %d", pollResult);
-        return NOT_ENOUGH_DATA;
+    // the preview poll may already have seen the frame, see pollPreviewDevice()
+    if (android_atomic_acquire_cas(1, 0, &mRecordingFrameReady) != 0) {
+        int pollResult = mRecordingDevice->poll(0);
+        if (pollResult < 1) {
+            LOG2("No data in recording device, poll result: %d", pollResult);
+            return NOT_ENOUGH_DATA;
+        }
     }
 
     int index = mRecordingDevice->grabFrame(&buf);
@@ -4582,6 +4672,7 @@ status_t AtomISP::getRecordingFrame(AtomBuffer *buff)
     LOG2("Device: %d. Grabbed frame of size: %d", mRecordingDevice->mId, buf.vbuffer.bytesused);
     mRecordingBuffers[index].id = index;
     mRecordingBuffers[index].expId = (buf.vbuffer.reserved >> 16) & 0xFFFF;
+    fillFrameResult(&mRecordingBuffers[index]);
     mRecordingBuffers[index].frameCounter = mRecordingDevice->getFrameCount();
     mRecordingBuffers[index].ispPrivate = mSessionId;
     mRecordingBuffers[index].capture_timestamp = buf.vbuffer.timestamp;
@@ -4684,12 +4775,10 @@ status_t AtomISP::setPostviewBuffers(Vector<AtomBuffer> *buffs, int numBuffs, bo
  */
 AtomBuffer* AtomISP::findMatchingHALZSLPreviewFrame(int frameCounter)
 {
-    Vector<AtomBuffer>::iterator it = mHALZSLPreviewBuffers.begin();
-    for (;it != mHALZSLPreviewBuffers.end(); ++it)
-        if (it->frameCounter == frameCounter) {
-            return it;
-        }
-    return NULL;
+    int index = mHALZSLPreviewBuffers.findByFrameCounter(frameCounter);
+    if (index < 0)
+        return NULL;
+    return &mHALZSLPreviewBuffers.editItemAt(index);
 }
 
 void AtomISP::copyOrScaleHALZSLBuffer(const AtomBuffer &captureBuf, const AtomBuffer *previewBuf,
@@ -4725,7 +4814,146 @@ void AtomISP::copyOrScaleHALZSLBuffer(const AtomBuffer &captureBuf, const AtomBu
         mScaler->scaleAndZoom(&captureBuf, targetBuf, zoomFactor);
 }
 
-status_t AtomISP::getHALZSLSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf)
+/**
+ * Hands out the HAL ZSL capture buffer itself as the snapshot instead of
+ * copying it, when it needs no scaling. Called with mHALZSLLock held.
+ *
+ * The buffer leaves the capture FIFO and the preview ring until it comes
+ * back through returnBuffer(). Meanwhile putHALZSLPreviewFrame() keeps
+ * fewer frames in the FIFO, so the driver queue does not run dry.
+ *
+ * \param index position of captureBuf in mHALZSLCaptureBuffers
+ * \param captureBuf the selected capture frame
+ * \param snapshotBuf filled with the capture buffer
+ * \param zoomFactor current digital zoom
+ * \return false if the buffer cannot be lent and has to be copied
+ */
+bool AtomISP::lendHALZSLBuffer(int index, const AtomBuffer &captureBuf, AtomBuffer *snapshotBuf, float zoomFactor)
+{
+    const AtomBuffer &localBuf = mSnapshotBuffers[0];
+
+    if (zoomFactor != 1.0f || localBuf.fourcc != mConfig.HALZSL.fourcc ||
+            localBuf.width != mConfig.HALZSL.width || localBuf.height != mConfig.HALZSL.height)
+        return false;
+
+    if (mHALZSLLentBuffers.size() >= sMaxHALZSLBuffersLent) {
+        LOG1("@%s: %d buffers already lent, copying", __FUNCTION__, mHALZSLLentBuffers.size());
+        return false;
+    }
+
+    mHALZSLCaptureBuffers.removeAt(index);
+    mHALZSLLentBuffers.push(captureBuf);
+
+    *snapshotBuf = captureBuf;
+    snapshotBuf->frameCounter = mMainDevice->getFrameCount();
+    snapshotBuf->ispPrivate = mSessionId;
+    snapshotBuf->type = ATOM_BUFFER_SNAPSHOT;
+    snapshotBuf->owner = this;
+
+    LOG1("@%s: lent buffer %d (%p), %d lent", __FUNCTION__, captureBuf.id,
+         captureBuf.dataPtr, mHALZSLLentBuffers.size());
+    return true;
+}
+
+/**
+ * Takes back a snapshot lent by lendHALZSLBuffer() and queues it to the
+ * preview device again. The snapshot is then pointed back at the snapshot
+ * buffer a copy would have used, which is what the caller keeps track of.
+ *
+ * \return false if the buffer was not lent by the HAL ZSL path
+ */
+bool AtomISP::returnHALZSLBuffer(AtomBuffer *snapshotBuf)
+{
+    LOG1("@%s: %p", __FUNCTION__, snapshotBuf->dataPtr);
+    Mutex::Autolock deviceLock(mDeviceMutex[mPreviewDevice->mId]);
+    Mutex::Autolock lock(mHALZSLLock);
+    bool found = false;
+
+    for (size_t i = 0; i < mHALZSLLentBuffers.size(); i++) {
+        if (mHALZSLLentBuffers[i].dataPtr != snapshotBuf->dataPtr)
+            continue;
+
+        AtomBuffer buf = mHALZSLLentBuffers[i];
+        mHALZSLLentBuffers.removeAt(i);
+        found = true;
+
+        if (mMode == MODE_NONE || buf.ispPrivate != mSessionId) {
+            LOGW("@%s: stale buffer %d, not queued", __FUNCTION__, buf.id);
+        } else if (mPreviewDevice->putFrame(buf.id) < 0) {
+            LOGE("@%s: putFrame failed, id:%d", __FUNCTION__, buf.id);
+        } else {
+            mNumPreviewBuffersQueued++;
+            LOG2("@%s mNumPreviewBuffersQueued:%d", __FUNCTION__, mNumPreviewBuffersQueued);
+        }
+        break;
+    }
+
+    for (size_t i = 0; !found && i < mHALZSLOrphanBuffers.size(); i++) {
+        if (mHALZSLOrphanBuffers[i].dataPtr == snapshotBuf->dataPtr) {
+            MemoryUtils::freeAtomBuffer(mHALZSLOrphanBuffers.editItemAt(i));
+            mHALZSLOrphanBuffers.removeAt(i);
+            found = true;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    const AtomBuffer &localBuf = mSnapshotBuffers[0];
+    snapshotBuf->size = localBuf.size;
+    snapshotBuf->bpl = SGXandDisplayBpl(V4L2_PIX_FMT_NV12, localBuf.width);
+    snapshotBuf->gfxInfo = localBuf.gfxInfo;
+    snapshotBuf->buff = localBuf.buff;
+    snapshotBuf->dataPtr = localBuf.dataPtr;
+    snapshotBuf->shared = localBuf.shared;
+    return true;
+}
+
+bool AtomISP::isHALZSLBufferLent(const void *dataPtr) const
+{
+    for (size_t i = 0; i < mHALZSLLentBuffers.size(); i++) {
+        if (mHALZSLLentBuffers[i].dataPtr == dataPtr)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Picks the held capture frame the user meant to shoot: the one whose
+ * exposure midpoint is closest to the shutter time minus
+ * PlatformData::shutterLagCompensationMs(). Called with mHALZSLLock held
+ * and at least one frame held.
+ *
+ * Without a shutter time the oldest held frame is taken, as before. So is
+ * it for later snapshots of the same takePicture(), e.g. warm-up skips,
+ * as all held frames are then newer than the target.
+ *
+ * \return position in mHALZSLCaptureBuffers
+ */
+int AtomISP::selectHALZSLCaptureFrame()
+{
+    if (mShutterTime == 0)
+        return 0;
+
+    nsecs_t target = mShutterTime - nsecs_t(PlatformData::shutterLagCompensationMs()) * 1000000LL;
+
+    // frames are timestamped at the end of readout, in units of 100us
+    int exposure = 0;
+    if (getExposureTime(&exposure) < 0 || exposure < 0)
+        exposure = 0;
+    nsecs_t halfExposure = nsecs_t(exposure) * 100000LL / 2;
+
+    int index = mHALZSLCaptureBuffers.findClosest(target + halfExposure);
+    nsecs_t midpoint = IndexedFrameRing::timestampOf(mHALZSLCaptureBuffers.itemAt(index)) - halfExposure;
+    // a frame 0 much later than the target means the FIFO is too shallow
+    // for the configured shutter lag
+    LOG1("@%s: frame %d of %d, exposure midpoint %lldus from target", __FUNCTION__,
+         index, mHALZSLCaptureBuffers.size(), (midpoint - target) / 1000);
+
+    return index;
+}
+
+status_t AtomISP::getHALZSLSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf, bool zeroCopy)
 {
     LOG1("@%s", __FUNCTION__);
     Mutex::Autolock mLock(mHALZSLLock);
@@ -4735,7 +4963,8 @@ status_t AtomISP::getHALZSLSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postvie
         return UNKNOWN_ERROR;
     }
 
-    AtomBuffer captureBuf = mHALZSLCaptureBuffers.itemAt(0);
+    int index = selectHALZSLCaptureFrame();
+    AtomBuffer captureBuf = mHALZSLCaptureBuffers.itemAt(index);
     LOG1("@%s capture buffer framecounter %d timestamp %ld.%ld", __FUNCTION__, captureBuf.frameCounter, captureBuf.capture_timestamp.tv_sec, captureBuf.capture_timestamp.tv_usec);
     dumpHALZSLPreviewBufs();
 
@@ -4744,8 +4973,9 @@ status_t AtomISP::getHALZSLSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postvie
     float zoomFactor(static_cast<float>(zoomRatio(mConfig.zoom)) / ZOOM_RATIO);
 
     // snapshot
-    copyOrScaleHALZSLBuffer(captureBuf, matchingPreviewBuf, snapshotBuf, mSnapshotBuffers[0], zoomFactor);
-    // postview
+    if (!zeroCopy || !lendHALZSLBuffer(index, captureBuf, snapshotBuf, zoomFactor))
+        copyOrScaleHALZSLBuffer(captureBuf, matchingPreviewBuf, snapshotBuf, mSnapshotBuffers[0], zoomFactor);
+    // postview, preview sized so it is always copied or scaled
     copyOrScaleHALZSLBuffer(captureBuf, matchingPreviewBuf, postviewBuf, mPostviewBuffers[0], zoomFactor);
 
     return OK;
@@ -4770,7 +5000,12 @@ status_t AtomISP::getMultiStreamsHALZSLSnapshot(AtomBuffer *snapshotBuf, AtomBuf
     return OK;
 }
 
-status_t AtomISP::getSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf)
+/**
+ * \param zeroCopy in HAL ZSL mode, allow handing out the capture ring buffer
+ *        itself instead of a copy. Such a snapshot must be given back with
+ *        returnBuffer(), see lendHALZSLBuffer().
+ */
+status_t AtomISP::getSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf, bool zeroCopy)
 {
     LOG1("@%s", __FUNCTION__);
     struct v4l2_buffer_info vinfo;
@@ -4782,7 +5017,7 @@ status_t AtomISP::getSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf)
     if (postviewBuf && (mHALZSLEnabled || mHALSDVEnabled)) {
         return mUseMultiStreamsForSoC
                 ? getMultiStreamsHALZSLSnapshot(snapshotBuf, postviewBuf)
-                : getHALZSLSnapshot(snapshotBuf, postviewBuf);
+                : getHALZSLSnapshot(snapshotBuf, postviewBuf, zeroCopy);
     }
 
     CLEAR(vinfo);
@@ -4798,6 +5033,7 @@ status_t AtomISP::getSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf)
     mSnapshotBuffers[snapshotIndex].status = (FrameBufferStatus)(vinfo.vbuffer.reserved & FRAME_STATUS_MASK);
     mSnapshotBuffers[snapshotIndex].expId = (vinfo.vbuffer.reserved >> 16) & 0xFFFF;
     mSnapshotBuffers[snapshotIndex].sensorFrameId = getSensorFrameId(mSnapshotBuffers[snapshotIndex].expId);
+    fillFrameResult(&mSnapshotBuffers[snapshotIndex]);
 
     if (isDumpRawImageReady() || postviewBuf == NULL || !isPostviewInitialized()) {
         postviewIndex = snapshotIndex;
@@ -4941,6 +5177,73 @@ int AtomISP::pollCapture(int timeout)
     return mMainDevice->poll(timeout);
 }
 
+/**
+ * Polls the preview device node fd for data
+ *
+ * In video mode the recording node is polled in the same call: the
+ * recording frame of a preview frame is usually ready at the same time,
+ * getRecordingFrame() then dequeues it without polling again. An error on
+ * the recording node is left for getRecordingFrame() to report.
+ *
+ * \param timeout time to wait for data (in ms), timeout of -1
+ *        means to wait indefinitely for data
+ * \return -1 for error, 0 if time out, positive number
+ *         if the preview device has data
+ */
+int AtomISP::pollPreviewDevice(int timeout)
+{
+    LOG2("@%s", __FUNCTION__);
+
+    if (!inVideoMode() || mHALVideoStabilization || !mRecordingDevice->isStarted()
+        || android_atomic_acquire_load(&mRecordingFrameReady))
+        return mPreviewDevice->poll(timeout);
+
+    V4L2VideoNode *nodes[] = { mPreviewDevice.get(), mRecordingDevice.get() };
+    unsigned int readyMask = 0;
+    unsigned int errorMask = 0;
+    nsecs_t start = systemTime();
+    int ret = V4L2VideoNode::pollNodes(nodes, 2, timeout, &readyMask, &errorMask);
+    if (ret <= 0)
+        return ret;
+
+    if (errorMask & 0x1)
+        return -1;
+    if (readyMask & 0x2)
+        android_atomic_release_store(1, &mRecordingFrameReady);
+    if (readyMask & 0x1)
+        return 1;
+
+    // only the recording node woke us up, wait for preview in what is
+    // left of the timeout
+    if (timeout >= 0) {
+        int elapsed = (int)((systemTime() - start) / 1000000);
+        if (elapsed >= timeout)
+            return 0;
+        timeout -= elapsed;
+    }
+    return mPreviewDevice->poll(timeout);
+}
+
+/**
+ * Logs how many ioctl() and poll() calls each device made for the frames
+ * of the session that stops, then starts counting again
+ */
+void AtomISP::logSyscallCounts()
+{
+    sp<V4L2VideoNode> devices[] = { mMainDevice, mPreviewDevice, mPostViewDevice, mRecordingDevice };
+    unsigned int ioctls, polls;
+
+    for (unsigned int i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+        if (devices[i] == NULL)
+            continue;
+        devices[i]->getSyscallCounts(&ioctls, &polls);
+        if (ioctls || polls)
+            LOG1("device %d: %u frames, %u ioctls, %u polls", devices[i]->mId,
+                 devices[i]->getFrameCount(), ioctls, polls);
+        devices[i]->resetSyscallCounts();
+    }
+}
+
 /**
  * Send jpeg capture command to kernel
  *
@@ -5109,7 +5412,6 @@ status_t AtomISP::allocateHALZSLBuffers()
 {
     LOG1("@%s", __FUNCTION__);
     status_t status = OK;
-    void *bufPool[sNumHALZSLBuffers];
 
     if (mHALZSLBuffers == NULL) {
         mHALZSLBuffers = new AtomBuffer[sNumHALZSLBuffers];
@@ -5124,7 +5426,6 @@ status_t AtomISP::allocateHALZSLBuffers()
                 break;
             }
 
-            bufPool[i] = buff->dataPtr;
             mScaler->registerBuffer(*buff, ScalerService::SCALER_INPUT);
         }
     }
@@ -5133,8 +5434,8 @@ status_t AtomISP::allocateHALZSLBuffers()
         delete [] mHALZSLBuffers;
         mHALZSLBuffers = NULL;
     } else {
-        mPreviewDevice->setBufferPool((void**)&bufPool, sNumHALZSLBuffers,
-                                          &mConfig.HALZSL, false);
+        setGraphicBufferPool(mPreviewDevice, mHALZSLBuffers, sNumHALZSLBuffers,
+                             &mConfig.HALZSL, false);
     }
 
     return status;
@@ -5147,13 +5448,18 @@ status_t AtomISP::freeHALZSLBuffers()
     if (mHALZSLBuffers != NULL) {
         for (int i = 0 ; i < sNumHALZSLBuffers; i++) {
             mScaler->unRegisterBuffer(mHALZSLBuffers[i], ScalerService::SCALER_INPUT);
-            MemoryUtils::freeAtomBuffer(mHALZSLBuffers[i]);
+            // still being encoded, freed when returned
+            if (isHALZSLBufferLent(mHALZSLBuffers[i].dataPtr))
+                mHALZSLOrphanBuffers.push(mHALZSLBuffers[i]);
+            else
+                MemoryUtils::freeAtomBuffer(mHALZSLBuffers[i]);
         }
         delete [] mHALZSLBuffers;
         mHALZSLBuffers = NULL;
 
         // HALZSL cleanup..
         mHALZSLCaptureBuffers.clear();
+        mHALZSLLentBuffers.clear();
     }
     return NO_ERROR;
 }
@@ -5269,9 +5575,17 @@ status_t AtomISP::allocatePreviewBuffers()
 {
     LOG1("@%s", __FUNCTION__);
     status_t status = NO_ERROR;
-    void *bufPool[MAX_V4L2_BUFFERS];
 
-    if (mPreviewBuffers.isEmpty()) {
+    if (mPreviewBuffers.isEmpty() && takeKeptPreviewBuffers()) {
+        // same memory as the previous stream, only redo the registrations
+        for (size_t i = 0; i < mPreviewBuffers.size(); i++) {
+            LOG2("reuse preview buffer[%d], buff=%p size=%d", i, mPreviewBuffers[i].dataPtr, mPreviewBuffers[i].size);
+            if ((mHALZSLEnabled || mHALSDVEnabled) && (false == mUseMultiStreamsForSoC)) {
+                mScaler->registerBuffer(mPreviewBuffers.editItemAt(i), ScalerService::SCALER_OUTPUT);
+                mHALZSLPreviewBuffers.push(mPreviewBuffers[i]);
+            }
+        }
+    } else if (mPreviewBuffers.isEmpty()) {
         AtomBuffer tmp = AtomBufferFactory::createAtomBuffer(ATOM_BUFFER_PREVIEW); // init fields
         mPreviewBuffersCached = true;
 
@@ -5288,7 +5602,6 @@ status_t AtomISP::allocatePreviewBuffers()
                 status = NO_MEMORY;
                 goto errorFree;
             }
-            bufPool[i] = tmp.dataPtr;
             LOG2("allocate preview buffer[%d], buff=%p size=%d", i, tmp.dataPtr, tmp.size);
 
             if ((mHALZSLEnabled || mHALSDVEnabled) && (false == mUseMultiStreamsForSoC)) {
@@ -5297,10 +5610,10 @@ status_t AtomISP::allocatePreviewBuffers()
             }
             mPreviewBuffers.push(tmp);
         }
+        mPreviewBuffersFormat = mConfig.preview;
 
     } else {
         for (size_t i = 0; i < mPreviewBuffers.size(); i++) {
-            bufPool[i] = mPreviewBuffers[i].dataPtr;
             LOG2("preview buffer[%d], buff=%p size=%d", i, mPreviewBuffers[i].dataPtr, mPreviewBuffers[i].size);
             mPreviewBuffers.editItemAt(i).shared = true;
             if ((mHALZSLEnabled || mHALSDVEnabled) && (false == mUseMultiStreamsForSoC)) {
@@ -5317,8 +5630,8 @@ status_t AtomISP::allocatePreviewBuffers()
             goto errorFree;
         }
     } else {
-        mPreviewDevice->setBufferPool((void**)&bufPool, mPreviewBuffers.size(),
-                                      &mConfig.preview, mPreviewBuffersCached);
+        setGraphicBufferPool(mPreviewDevice, mPreviewBuffers.array(), mPreviewBuffers.size(),
+                             &mConfig.preview, mPreviewBuffersCached);
     }
 
     if ((mHALZSLEnabled || mHALSDVEnabled) && mUseMultiStreamsForSoC) {
@@ -5342,7 +5655,6 @@ status_t AtomISP::allocateRecordingBuffers()
 {
     LOG1("@%s", __FUNCTION__);
     status_t status = NO_ERROR;
-    void *bufPool[MAX_V4L2_BUFFERS];
     int allocatedBufs = 0;
     bool cached = false;
 
@@ -5377,10 +5689,9 @@ status_t AtomISP::allocateRecordingBuffers()
             goto errorFree;
         }
         allocatedBufs++;
-        bufPool[i] = mRecordingBuffers[i].dataPtr;
     }
-    mRecordingDevice->setBufferPool((void**)&bufPool,mConfig.num_recording_buffers,
-                                     &mConfig.recording,cached);
+    setGraphicBufferPool(mRecordingDevice, mRecordingBuffers, mConfig.num_recording_buffers,
+                         &mConfig.recording, cached);
     return status;
 
 errorFree:
@@ -5395,6 +5706,34 @@ errorFree:
     return status;
 }
 
+/**
+ * Gives the buffers to the device as its pool. Gralloc buffers are
+ * imported as dma-bufs when gralloc provides them, so that the ISP writes
+ * the memory of the compositor and the encoder directly instead of
+ * pinning their CPU mapping as USERPTR. Other buffers, and pools where a
+ * buffer has no dma-buf, fall back to USERPTR.
+ */
+status_t AtomISP::setGraphicBufferPool(sp<V4L2VideoNode> device, const AtomBuffer *buffers, int count,
+                                       AtomBuffer *formatDescriptor, bool cached)
+{
+    LOG1("@%s: %d buffers", __FUNCTION__, count);
+    int fds[MAX_V4L2_BUFFERS];
+    void *bufPool[MAX_V4L2_BUFFERS];
+    bool dmabuf = true;
+
+    for (int i = 0; i < count; i++) {
+        fds[i] = MemoryUtils::getGraphicBufferDmaBufFd(buffers[i]);
+        bufPool[i] = buffers[i].dataPtr;
+        if (fds[i] < 0)
+            dmabuf = false;
+    }
+
+    if (dmabuf && device->setDmaBufPool(fds, count, formatDescriptor) == NO_ERROR)
+        return NO_ERROR;
+
+    return device->setBufferPool((void**)&bufPool, count, formatDescriptor, cached);
+}
+
 /**
  * Prepares V4L2  buffer info's for snapshot and postview buffers
  *
@@ -5430,7 +5769,7 @@ status_t AtomISP::allocateSnapshotBuffers()
         for (int i = 0; i < mConfig.num_snapshot; i++) {
             mSnapshotBuffers[i] = AtomBufferFactory::createAtomBuffer(ATOM_BUFFER_SNAPSHOT);
 
-            MemoryUtils::allocateAtomBuffer(mSnapshotBuffers[i], mConfig.snapshot, mCallbacks);
+            mCallbacks->bufferPool()->acquire(mSnapshotBuffers[i], mConfig.snapshot);
             if (mSnapshotBuffers[i].dataPtr == NULL) {
                 LOGE("Error allocation memory for snapshot buffers!");
                 status = NO_MEMORY;
@@ -5464,11 +5803,8 @@ status_t AtomISP::allocateSnapshotBuffers()
             postv.buff = NULL;
             postv.size = 0;
             postv.dataPtr = NULL;
-            if (mHALZSLEnabled || mHALSDVEnabled) {
-                MemoryUtils::allocateGraphicBuffer(postv, mConfig.postview);
-            } else {
-                MemoryUtils::allocateAtomBuffer(postv, mConfig.postview, mCallbacks);
-            }
+            mCallbacks->bufferPool()->acquire(postv, mConfig.postview,
+                                              mHALZSLEnabled || mHALSDVEnabled);
 
             if (postv.dataPtr == NULL) {
                 LOGE("Error allocation memory for postview buffers!");
@@ -5498,7 +5834,7 @@ status_t AtomISP::allocateSnapshotBuffers()
 errorFree:
     // On error, free the allocated buffers
     for (int i = 0 ; i < allocatedSnaphotBufs; i++)
-        MemoryUtils::freeAtomBuffer(mSnapshotBuffers[i]);
+        mCallbacks->bufferPool()->release(mSnapshotBuffers[i]);
 
     freePostviewBuffers();
     return status;
@@ -5642,17 +5978,36 @@ status_t AtomISP::allocateMetaDataBuffers()
     return allocateMetaDataBuffers(mRecordingBuffers, mConfig.num_recording_buffers);
 }
 
+/**
+ * Releases the preview buffers of the stream that stopped
+ *
+ * A complete set of buffers the HAL allocated itself is kept instead of
+ * freed: a restart with the same preview geometry, e.g. a switch between
+ * still and video mode, takes it back in allocatePreviewBuffers() without
+ * a new allocation. Buffers given with setGraphicPreviewBuffers() are
+ * never kept.
+ */
 status_t AtomISP::freePreviewBuffers()
 {
     LOG1("@%s", __FUNCTION__);
 
     if (!mPreviewBuffers.isEmpty()) {
+        bool keep = true;
         for (size_t i = 0 ; i < mPreviewBuffers.size(); i++) {
             LOG1("@%s mHALZSLEnabled = %d i=%d, mNum = %d", __FUNCTION__, mHALZSLEnabled, i, mConfig.num_preview_buffers);
             if ((mHALZSLEnabled || mHALSDVEnabled) && (false == mUseMultiStreamsForSoC))
                 mScaler->unRegisterBuffer(mPreviewBuffers.editItemAt(i), ScalerService::SCALER_OUTPUT);
+            if (mPreviewBuffers[i].shared || mPreviewBuffers[i].dataPtr == NULL)
+                keep = false;
+        }
 
-            MemoryUtils::freeAtomBuffer(mPreviewBuffers.editItemAt(i));
+        freeKeptPreviewBuffers();
+        if (keep) {
+            LOG1("@%s: keeping %d preview buffers for the next stream", __FUNCTION__, mPreviewBuffers.size());
+            mKeptPreviewBuffers = mPreviewBuffers;
+        } else {
+            for (size_t i = 0 ; i < mPreviewBuffers.size(); i++)
+                MemoryUtils::freeAtomBuffer(mPreviewBuffers.editItemAt(i));
         }
         mPreviewBuffers.clear();
     }
@@ -5669,6 +6024,63 @@ status_t AtomISP::freePreviewBuffers()
     return NO_ERROR;
 }
 
+/**
+ * Gives the buffers kept by freePreviewBuffers() back to mPreviewBuffers
+ * when the preview geometry and buffer count did not change
+ *
+ * \return false when there is nothing to reuse, the kept buffers are
+ *         freed if they do not fit
+ */
+bool AtomISP::takeKeptPreviewBuffers()
+{
+    LOG1("@%s", __FUNCTION__);
+
+    if (mKeptPreviewBuffers.isEmpty())
+        return false;
+
+    if ((int)mKeptPreviewBuffers.size() != mConfig.num_preview_buffers ||
+        mPreviewBuffersFormat.width != mConfig.preview.width ||
+        mPreviewBuffersFormat.height != mConfig.preview.height ||
+        mPreviewBuffersFormat.bpl != mConfig.preview.bpl ||
+        mPreviewBuffersFormat.fourcc != mConfig.preview.fourcc ||
+        mPreviewBuffersFormat.size != mConfig.preview.size) {
+        LOG1("@%s: preview changed from %dx%d %s, reallocating", __FUNCTION__,
+             mPreviewBuffersFormat.width, mPreviewBuffersFormat.height, v4l2Fmt2Str(mPreviewBuffersFormat.fourcc));
+        freeKeptPreviewBuffers();
+        return false;
+    }
+
+    mPreviewBuffers = mKeptPreviewBuffers;
+    mKeptPreviewBuffers.clear();
+    mPreviewBuffersCached = true;
+
+    // drop the per-frame state of the previous stream
+    for (size_t i = 0; i < mPreviewBuffers.size(); i++) {
+        AtomBuffer &buf = mPreviewBuffers.editItemAt(i);
+        buf.id = 0;
+        buf.expId = EXP_ID_INVALID;
+        buf.status = FRAME_STATUS_NA;
+        buf.auxBuf = NULL;
+        buf.returnAfterCB = false;
+        buf.sensorFrameId = -1;
+        buf.size = mPreviewBuffersFormat.size;
+    }
+
+    PERFORMANCE_TRACES_BREAKDOWN_STEP("ReusePreviewBuffers");
+    return true;
+}
+
+void AtomISP::freeKeptPreviewBuffers()
+{
+    if (mKeptPreviewBuffers.isEmpty())
+        return;
+
+    LOG1("@%s: %d buffers", __FUNCTION__, mKeptPreviewBuffers.size());
+    for (size_t i = 0; i < mKeptPreviewBuffers.size(); i++)
+        MemoryUtils::freeAtomBuffer(mKeptPreviewBuffers.editItemAt(i));
+    mKeptPreviewBuffers.clear();
+}
+
 status_t AtomISP::freeRecordingBuffers()
 {
     LOG1("@%s", __FUNCTION__);
@@ -5696,7 +6108,7 @@ status_t AtomISP::freeSnapshotBuffers()
     }
 
     for (int i = 0 ; i < mConfig.num_snapshot; i++)
-        MemoryUtils::freeAtomBuffer(mSnapshotBuffers[i]);
+        mCallbacks->bufferPool()->release(mSnapshotBuffers[i]);
 
     return NO_ERROR;
 }
@@ -5716,7 +6128,7 @@ status_t AtomISP::freePostviewBuffers()
         if (buffer.gfxInfo.scalerId != -1)
             mScaler->unRegisterBuffer(buffer, ScalerService::SCALER_OUTPUT);
 
-        MemoryUtils::freeAtomBuffer(buffer);
+        mCallbacks->bufferPool()->release(buffer);
     }
 
     mPostviewBuffers.clear();
@@ -6278,16 +6690,84 @@ int AtomISP::setAicParameter(struct atomisp_parameters *aic_param)
              aic_param->wb_config->b, aic_param->wb_config->gb);
     }
 
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_PARAMETERS, aic_param);
-    LOG2("%s IOCTL ATOMISP_IOC_S_PARAMETERS ret: %d\n", __FUNCTION__, ret);
-    return ret;
+    if (mIspParamsQueue == NULL) {
+        ret = pxioctl(mMainDevice, ATOMISP_IOC_S_PARAMETERS, aic_param);
+        LOG2("%s IOCTL ATOMISP_IOC_S_PARAMETERS ret: %d\n", __FUNCTION__, ret);
+        ioctlApplied((int)ATOMISP_IOC_S_PARAMETERS, mStatsExpId, ret);
+        return ret;
+    }
+
+    // applied by the queue thread, the result is reported to ioctlApplied()
+    return mIspParamsQueue->submit(ATOMISP_IOC_S_PARAMETERS, aic_param,
+                                   sizeof(*aic_param), mStatsExpId);
+}
+
+/**
+ * Takes back the configurations given to setAicParameter(): parameters
+ * the driver does not have yet are dropped, the next ones replace them
+ */
+void AtomISP::reclaimAicParameter()
+{
+    LOG2("@%s", __FUNCTION__);
+    if (mIspParamsQueue != NULL)
+        mIspParamsQueue->reclaim(ATOMISP_IOC_S_PARAMETERS);
+}
+
+void AtomISP::setIspParamsListener(IIspParamsListener *listener)
+{
+    LOG1("@%s", __FUNCTION__);
+    Mutex::Autolock lock(mIspParamsListenerLock);
+    mIspParamsListener = listener;
+}
+
+/**
+ * Result of a parameter write, from the queue thread or from
+ * setAicParameter() when there is no queue
+ */
+void AtomISP::ioctlApplied(int request, unsigned int frameId, int ret)
+{
+    LOG2("@%s: request 0x%x for exp id %u ret: %d", __FUNCTION__, request, frameId, ret);
+    if (ret < 0)
+        LOGE("ISP parameters of exp id %u not applied: %d", frameId, ret);
+    else if (request == (int)ATOMISP_IOC_S_PARAMETERS)
+        android_atomic_release_store(frameId, &mIspParamsExpId);
+
+    Mutex::Autolock lock(mIspParamsListenerLock);
+    if (mIspParamsListener != NULL)
+        mIspParamsListener->ispParamsApplied(request, frameId, ret);
+}
+
+/**
+ * Fills the settings applied to a dequeued frame from its exposure id
+ *
+ * The ISP parameters are the last ones the driver accepted before the
+ * frame was dequeued: the driver does not tell which frame they reached.
+ */
+void AtomISP::fillFrameResult(AtomBuffer *buf)
+{
+    CLEAR(buf->result);
+    buf->result.requestId = -1;
+    if (mSensorHW != NULL)
+        mSensorHW->getFrameResult(buf->expId, &buf->result);
+    buf->result.ispParamsExpId = android_atomic_acquire_load(&mIspParamsExpId);
+}
+
+/**
+ * Writes ISP configurations after the parameters queued by
+ * setAicParameter(), so that they reach the driver in the order given
+ */
+int AtomISP::applyIspParameter(int request, void *arg)
+{
+    if (mIspParamsQueue == NULL)
+        return pxioctl(mMainDevice, request, arg);
+    return mIspParamsQueue->apply(request, arg);
 }
 
 int AtomISP::setIspParameter(struct atomisp_parm *isp_param)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_PARM, isp_param);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_PARM, isp_param);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_PARM ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6328,6 +6808,8 @@ int AtomISP::getIspStatistics(struct atomisp_3a_statistics *statistics)
     int ret = 0;
     ret = pxioctl(mMainDevice, ATOMISP_IOC_G_3A_STAT, statistics);
     LOG2("%s IOCTL ATOMISP_IOC_G_3A_STAT ret: %d\n", __FUNCTION__, ret);
+    if (ret == 0)
+        mStatsExpId = statistics->exp_id;
 
     if (ret == 0 && isOfflineCaptureRunning()) {
         // Detect the corrupt stats only for offline (continuous) capture.
@@ -6404,7 +6886,7 @@ int AtomISP::setMaccConfig(struct atomisp_macc_config *macc_tbl)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_MACC,macc_tbl);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_MACC,macc_tbl);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_MACC ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6413,7 +6895,7 @@ int AtomISP::setGammaTable(const struct atomisp_gamma_table *gamma_tbl)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_GAMMA, (struct atomisp_gamma_table *)gamma_tbl);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_GAMMA, (struct atomisp_gamma_table *)gamma_tbl);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_GAMMA ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6422,7 +6904,7 @@ int AtomISP::setCtcTable(const struct atomisp_ctc_table *ctc_tbl)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_CTC, (struct atomisp_ctc_table *)ctc_tbl);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_CTC, (struct atomisp_ctc_table *)ctc_tbl);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_CTC ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6431,7 +6913,7 @@ int AtomISP::setNarrowGamma(const struct atomisp_formats_config *formats_config)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_FORMATS_CONFIG, (struct atomisp_formats_config *)formats_config);
+    ret = applyIspParameter(ATOMISP_IOC_S_FORMATS_CONFIG, (struct atomisp_formats_config *)formats_config);
     LOG2("%s ATOMISP_IOC_S_FORMATS_CONFIG ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6440,7 +6922,7 @@ int AtomISP::setGdcConfig(const struct morph_table *tbl)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_GDC_TAB, (struct morph_table *)tbl);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_GDC_TAB, (struct morph_table *)tbl);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_GDC_TAB ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6449,7 +6931,7 @@ int AtomISP::setShadingTable(struct atomisp_shading_table *table)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_SHD_TAB, table);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_SHD_TAB, table);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_SHD_TAB ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6458,7 +6940,7 @@ int AtomISP::setDeConfig(struct atomisp_de_config *de_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_FALSE_COLOR_CORRECTION, de_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_FALSE_COLOR_CORRECTION, de_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_FALSE_COLOR_CORRECTION ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6467,7 +6949,7 @@ int AtomISP::setTnrConfig(struct atomisp_tnr_config *tnr_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_TNR, tnr_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_TNR, tnr_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_TNR ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6476,7 +6958,7 @@ int AtomISP::setEeConfig(struct atomisp_ee_config *ee_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_EE, ee_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_EE, ee_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_EE ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6485,7 +6967,7 @@ int AtomISP::setNrConfig(struct atomisp_nr_config *nr_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_NR, nr_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_NR, nr_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_NR ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6494,7 +6976,7 @@ int AtomISP::setDpConfig(struct atomisp_dp_config *dp_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_BAD_PIXEL_DETECTION, dp_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_BAD_PIXEL_DETECTION, dp_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_BAD_PIXEL_DETECTION ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6503,7 +6985,7 @@ int AtomISP::setWbConfig(struct atomisp_wb_config *wb_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_WHITE_BALANCE, wb_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_WHITE_BALANCE, wb_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_WHITE_BALANCE ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6512,7 +6994,7 @@ int AtomISP::set3aConfig(const struct atomisp_3a_config *cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_3A_CONFIG, (struct atomisp_3a_config *)cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_3A_CONFIG, (struct atomisp_3a_config *)cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_3A_CONFIG ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6521,7 +7003,7 @@ int AtomISP::setObConfig(struct atomisp_ob_config *ob_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_BLACK_LEVEL_COMP, ob_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_BLACK_LEVEL_COMP, ob_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_BLACK_LEVEL_COMP ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6530,7 +7012,7 @@ int AtomISP::setGcConfig(const struct atomisp_gc_config *gc_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_ISP_GAMMA_CORRECTION, (struct atomisp_gc_config *)gc_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_ISP_GAMMA_CORRECTION, (struct atomisp_gc_config *)gc_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_ISP_GAMMA_CORRECTION ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6539,7 +7021,7 @@ int AtomISP::setDvsConfig(const struct atomisp_dvs_6axis_config *dvs_6axis_cfg)
 {
     LOG2("@%s", __FUNCTION__);
     int ret;
-    ret = pxioctl(mMainDevice, ATOMISP_IOC_S_DIS_VECTOR, (struct atomisp_dvs_6axis_config *)dvs_6axis_cfg);
+    ret = applyIspParameter(ATOMISP_IOC_S_DIS_VECTOR, (struct atomisp_dvs_6axis_config *)dvs_6axis_cfg);
     LOG2("%s IOCTL ATOMISP_IOC_S_6AXIS_CONFIG ret: %d\n", __FUNCTION__, ret);
     return ret;
 }
@@ -6873,7 +7355,7 @@ status_t AtomISP::PreviewStreamSource::observe(IAtomIspObserver::Message *msg)
     int maxTimeoutCount = PlatformData::getMaxISPTimeoutCount();
 
 try_again:
-    ret = mISP->mPreviewDevice->poll(ATOMISP_PREVIEW_POLL_TIMEOUT);
+    ret = mISP->pollPreviewDevice(ATOMISP_PREVIEW_POLL_TIMEOUT);
     if (ret > 0) {
         LOG2("@%s Entering dequeue : num-of-buffers queued %d", __FUNCTION__, mISP->mNumPreviewBuffersQueued);
         status = mISP->getPreviewFrame(&msg->data.frameBuffer.buff);
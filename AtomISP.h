@@ -25,6 +25,7 @@
 #include <utils/threads.h>
 #include "AtomCommon.h"
 #include "v4l2device.h"
+#include "v4l2ioctlqueue.h"
 
 #ifdef ENABLE_INTEL_METABUFFER
 #include "IntelMetadataBuffer.h"
@@ -38,6 +39,7 @@
 #include "SensorHWExtIsp.h"
 #include "SensorEmbeddedMetaData.h"
 #include "CamHeapMem.h"
+#include "IndexedFrameRing.h"
 
 namespace android {
 
@@ -77,7 +79,8 @@ class AtomISP :
     public IHWIspControl,
     public IHWFlashControl,
     public IHWLensControl,
-    public IBufferOwner {
+    public IBufferOwner,
+    public V4L2IoctlQueue::IListener {
 
 // constructor/destructor
 public:
@@ -112,9 +115,11 @@ public:
     status_t stopOfflineCapture();
     bool isOfflineCaptureRunning() const;
     int shutterLagZeroAlign() const;
+    void setShutterTime(nsecs_t shutterTime);
     int continuousBurstNegMinOffset(void) const;
     int continuousBurstNegOffset(int skip, int startIndex) const;
     int getContinuousCaptureNumber() const;
+    int getContinuousRingBufferSize() const;
     status_t prepareOfflineCapture(ContinuousCaptureConfig &config);
 
     // APIs for capture with raw buffer lock
@@ -138,7 +143,7 @@ public:
     status_t putRecordingFrame(AtomBuffer *buff);
 
     status_t setSnapshotBuffers(Vector<AtomBuffer> *buffs, int numBuffs, bool cached);
-    status_t getSnapshot(AtomBuffer *snaphotBuf, AtomBuffer *postviewBuf);
+    status_t getSnapshot(AtomBuffer *snaphotBuf, AtomBuffer *postviewBuf, bool zeroCopy = false);
     status_t putSnapshot(AtomBuffer *snaphotBuf, AtomBuffer *postviewBuf);
 
     status_t setPostviewBuffers(Vector<AtomBuffer> *buffs, int numBuffs, bool cached);
@@ -205,6 +210,9 @@ public:
     // IBufferOwner override
     virtual void returnBuffer(AtomBuffer* buff);
 
+    // V4L2IoctlQueue::IListener override
+    virtual void ioctlApplied(int request, unsigned int frameId, int ret);
+
     // high speed fps setting
     status_t setHighSpeedResolutionFps(char* resolution, int fps);
 
@@ -312,6 +320,8 @@ protected:
 
     /* ISP related controls */
     int setAicParameter(struct atomisp_parameters *aic_params);
+    void reclaimAicParameter();
+    void setIspParamsListener(IIspParamsListener *listener);
     int setIspParameter(struct atomisp_parm *isp_params);
     int getIspStatistics(struct atomisp_3a_statistics *statistics);
     int setGdcConfig(const struct morph_table *tbl);
@@ -452,16 +462,29 @@ private:
     AtomBuffer* findMatchingHALZSLPreviewFrame(int frameCounter);
     void copyOrScaleHALZSLBuffer(const AtomBuffer &captureBuf, const AtomBuffer *previewBuf,
             AtomBuffer *targetBuf, const AtomBuffer &localBuf, float zoomFactor) const;
-    status_t getHALZSLSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf);
-    bool waitForHALZSLBuffer(Vector<AtomBuffer> &vector, bool snapshot);
+    status_t getHALZSLSnapshot(AtomBuffer *snapshotBuf, AtomBuffer *postviewBuf, bool zeroCopy);
+    bool lendHALZSLBuffer(int index, const AtomBuffer &captureBuf, AtomBuffer *snapshotBuf, float zoomFactor);
+    bool returnHALZSLBuffer(AtomBuffer *snapshotBuf);
+    bool isHALZSLBufferLent(const void *dataPtr) const;
+    int selectHALZSLCaptureFrame();
+    template <typename Queue>
+    bool waitForHALZSLBuffer(Queue &queue, bool snapshot);
     void dumpHALZSLBufs();
     void dumpHALZSLPreviewBufs();
+    int pollPreviewDevice(int timeout);
+    int applyIspParameter(int request, void *arg);
+    void logSyscallCounts();
+    void fillFrameResult(AtomBuffer *buf);
 
     status_t allocatePreviewBuffers();
     status_t allocateRecordingBuffers();
+    status_t setGraphicBufferPool(sp<V4L2VideoNode> device, const AtomBuffer *buffers, int count,
+                                  AtomBuffer *formatDescriptor, bool cached);
     status_t allocateSnapshotBuffers();
     status_t allocateMetaDataBuffers();
     status_t freePreviewBuffers();
+    bool takeKeptPreviewBuffers();
+    void freeKeptPreviewBuffers();
     status_t freeRecordingBuffers();
     status_t freeSnapshotBuffers();
     status_t freePostviewBuffers();
@@ -571,6 +594,8 @@ private:
 
     Vector <AtomBuffer> mPreviewBuffers;
     bool mPreviewBuffersCached;
+    Vector <AtomBuffer> mKeptPreviewBuffers;    /*!< HAL allocated preview buffers of the last stream, see freePreviewBuffers() */
+    AtomBuffer mPreviewBuffersFormat;           /*!< geometry the HAL allocated the preview buffers with */
     AtomBuffer *mRecordingBuffers;
     bool mSwapRecordingDevice;
     bool mRecordingDeviceSwapped;
@@ -579,10 +604,13 @@ private:
     bool mHALSDVEnabled; // use 4 streams. not use raw ring buffers in driver like the raw sensor, use buffer queue in hal instead.
     bool mUseMultiStreamsForSoC; // this could be configured by according to the configuration file
     AtomBuffer *mHALZSLBuffers; // the 1 stream hal zsl will use it
-    Vector<AtomBuffer> mHALZSLPreviewBuffers; // the 1 stream hal zsl will use it
-    Vector<AtomBuffer> mHALZSLCaptureBuffers; // store the capture data in the hal
+    IndexedFrameRing mHALZSLPreviewBuffers; // the 1 stream hal zsl will use it
+    IndexedFrameRing mHALZSLCaptureBuffers; // store the capture data in the hal, in capture order
+    Vector<AtomBuffer> mHALZSLLentBuffers; // ring buffers handed out as zero-copy snapshots
+    Vector<AtomBuffer> mHALZSLOrphanBuffers; // lent buffers whose ring was freed, freed when returned
     Mutex mHALZSLLock;
     static const unsigned int sMaxHALZSLBuffersHeldInHAL = 2;
+    static const unsigned int sMaxHALZSLBuffersLent = sMaxHALZSLBuffersHeldInHAL;
     static const int sNumHALZSLBuffers = sMaxHALZSLBuffersHeldInHAL + 4;
     static const int sHALZSLRetryCount = 5;
     static const int sHALZSLRetryUSleep = 33000;
@@ -605,11 +633,13 @@ private:
     Vector <AtomBuffer> mPostviewBuffers;
     int mNumPreviewBuffersQueued;       /* TODO: move this tracking var to device video node class */
     int mNumRecordingBuffersQueued;
+    volatile int32_t mRecordingFrameReady;  /*!< set when the preview poll saw a recording frame */
     int mNumCapturegBuffersQueued;
     int mFlashTorchSetting;
     Config mConfig;
     ContinuousCaptureConfig mContCaptConfig;
     bool mContCaptPrepared;
+    int mContRingBufferSize;        /*!< raw frames of the ringbuffer, last configured */
     unsigned int mInitialSkips;
     unsigned int mStatisticSkips;
     unsigned int mDVSFrameSkips;
@@ -625,6 +655,11 @@ private:
     sp<V4L2Subdevice>  m3AEventSubdevice;
     sp<V4L2VideoNode>  mOriginalPreviewDevice;
     sp<V4L2VideoNode>  mFileInjectDevice;
+    sp<V4L2IoctlQueue> mIspParamsQueue;        /* applies the ISP parameter writes on mMainDevice */
+    unsigned int       mStatsExpId;            /* exposure id of the last statistics, tags the parameters */
+    volatile int32_t   mIspParamsExpId;        /* tag of the last parameters the driver accepted */
+    Mutex              mIspParamsListenerLock; /* held while mIspParamsListener is called */
+    IIspParamsListener *mIspParamsListener;
     sp<SensorHW>       mSensorHW;              /* AtomISP owns this! */
 
     int dumpPreviewFrame(int previewIndex);
@@ -650,6 +685,7 @@ private:
     } mFileInject;
 
     int mSessionId; // uniquely identify each session
+    nsecs_t mShutterTime; // when the user pressed the shutter, 0 if unknown
 
     SensorType mSensorType;
 
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _ATOM_SEQLOCK_H_
+#define _ATOM_SEQLOCK_H_
+
+#include <string.h>
+#include <cutils/atomic.h>
+#include <cutils/atomic-inline.h>
+
+/**
+ * \class AtomSeqLock
+ *
+ * A value written by one thread at a time and read without locking.
+ *
+ * The writer brackets its changes with beginWrite() and endWrite(), the
+ * sequence number is odd in between. read() copies the value and retries
+ * when the sequence number was odd or changed during the copy, so a reader
+ * never blocks the writer and never waits longer than one write.
+ *
+ * Writers must be serialized by the caller. X must be plain data: a torn
+ * copy is discarded, never used.
+ */
+template <class X> class AtomSeqLock {
+    X mValue;
+    volatile int32_t mSeq;
+
+public:
+    AtomSeqLock() : mSeq(0) { memset(&mValue, 0, sizeof(mValue)); }
+
+    X &beginWrite()
+    {
+        android_atomic_release_store(mSeq + 1, &mSeq);
+        android_memory_barrier();
+        return mValue;
+    }
+
+    void endWrite()
+    {
+        android_atomic_release_store(mSeq + 1, &mSeq);
+    }
+
+    void read(X *value) const
+    {
+        int32_t seq;
+        do {
+            seq = android_atomic_acquire_load(&mSeq);
+            memcpy(value, &mValue, sizeof(mValue));
+            android_memory_barrier();
+        } while ((seq & 1) || android_atomic_acquire_load(&mSeq) != seq);
+    }
+};
+
+#endif // _ATOM_SEQLOCK_H_
@@ -110,7 +110,7 @@ public:
     virtual status_t initAfBracketing(int stops,  AFBracketingMode mode) { return INVALID_OPERATION; }
     virtual status_t initAeBracketing() { return INVALID_OPERATION; }
     virtual status_t deinitAeBracketing() { return INVALID_OPERATION; }
-    virtual int      applyEvGroup(float biases[], int depth, SensorAeConfig aeConfig[]) { return -1; }
+    virtual int      applyEvGroup(float biases[], int depth, SensorAeConfig aeConfig[], const int requestIds[]) { return -1; }
     virtual status_t getExposureInfo(SensorAeConfig& sensorAeConfig) { return INVALID_OPERATION; }
     virtual status_t getGridWindow(AAAWindowInfo& window);
     virtual bool getAfNeedAssistLight() { return false; }
@@ -118,6 +118,7 @@ public:
     virtual AwbMode getLightSource() { return CAM_AWB_MODE_NOT_SET; }
     virtual status_t setAeBacklightCorrection(bool en) { return INVALID_OPERATION; }
     virtual status_t apply3AProcess(bool read_stats, struct timeval *frame_timestamp, int orientation) { return INVALID_OPERATION; }
+    virtual void dumpTimings(String8 &out) {}
     virtual status_t startStillAf() { return INVALID_OPERATION; }
     virtual status_t stopStillAf() { return INVALID_OPERATION; }
     virtual AfStatus isStillAfComplete() { return CAM_AF_STATUS_FAIL; }
@@ -23,6 +23,7 @@
 #include "PerformanceTraces.h"
 #include "cutils/atomic.h"
 #include "CamHeapMem.h"
+#include "AtomBufferPool.h"
 
 // Use non-empty default path to force always writing burst captures to file system.
 // For example:
@@ -46,13 +47,17 @@ Callbacks::Callbacks() :
     ,mStoreMetaDataInBuffers(false)
     ,mContShootingEnabled(false)
     ,mBurstCount(0)
+    ,mBufferPool(NULL)
 {
     LOG1("@%s", __FUNCTION__);
+    mBufferPool = new AtomBufferPool(this);
 }
 
 Callbacks::~Callbacks()
 {
     LOG1("@%s", __FUNCTION__);
+    delete mBufferPool;
+    mBufferPool = NULL;
     if (mDummyByte != NULL) {
         mDummyByte->release(mDummyByte);
         mDummyByte = NULL;
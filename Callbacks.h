@@ -25,6 +25,8 @@
 
 namespace android {
 
+class AtomBufferPool;
+
 class Callbacks {
 
 public:
@@ -67,6 +69,7 @@ public:
 
     void allocateMemory(AtomBuffer *buff, int size);
     void allocateMemory(camera_memory_t **buff, size_t size);
+    AtomBufferPool *bufferPool() { return mBufferPool; }
     void facesDetected(camera_frame_metadata_t *face_metadata);
     void sceneDetected(camera_scene_detection_metadata &metadata);
     void panoramaDisplUpdate(camera_panorama_metadata &metadata);
@@ -101,6 +104,7 @@ private:
     bool mContShootingEnabled;
     String8 mContShootingFilepath;
     int mBurstCount;
+    AtomBufferPool *mBufferPool;    /*!< recycles the large buffers allocated with this object */
     };
 };
 
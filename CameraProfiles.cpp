@@ -353,6 +353,12 @@ void CameraProfiles::handleSensor(CameraProfiles *profiles, const char *name, co
         pCurrentCam->maxNumYUVBufferForBurst = atoi(atts[1]);
     } else if (strcmp(name, "maxNumYUVBufferForBracket") == 0) {
         pCurrentCam->maxNumYUVBufferForBracket = atoi(atts[1]);
+    } else if (strcmp(name, "captureMemoryBudgetMB") == 0) {
+        pCurrentCam->captureMemoryBudgetMB = atoi(atts[1]);
+    } else if (strcmp(name, "gbceStride") == 0) {
+        pCurrentCam->gbceStride = MAX(atoi(atts[1]), 1);
+    } else if (strcmp(name, "dsdStride") == 0) {
+        pCurrentCam->dsdStride = MAX(atoi(atts[1]), 1);
     } else if (strcmp(name, "verticalFOV") == 0) {
         pCurrentCam->verticalFOV = atts[1];
     } else if (strcmp(name, "horizontalFOV") == 0) {
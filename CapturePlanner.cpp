@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_CapturePlanner"
+
+#include "LogHelper.h"
+#include "AtomCommon.h"
+#include "PlatformData.h"
+#include "IntelParameters.h"
+#include "CapturePlanner.h"
+
+namespace android {
+
+CapturePlanner::CapturePlanner(int cameraId) :
+     mBudget((size_t)PlatformData::getCaptureMemoryBudgetMB(cameraId) * 1024 * 1024)
+{
+    LOG1("@%s: budget %u KB", __FUNCTION__, mBudget / 1024);
+    CLEAR(mPlan);
+    mPlan.mode = MODE_SINGLE;
+}
+
+CapturePlanner::~CapturePlanner()
+{
+    LOG1("@%s", __FUNCTION__);
+}
+
+const CapturePlanner::Plan &CapturePlanner::plan(const Request &request)
+{
+    LOG1("@%s: %s frames %d, buffers %d..%d, ring %d", __FUNCTION__,
+         modeToString(request.mode), request.frames,
+         request.minBuffers, request.maxBuffers, request.ringBuffers);
+
+    int minBuffers = MAX(request.minBuffers, 1);
+    int buffers = CLIP(MAX(request.frames, minBuffers), MAX(request.maxBuffers, minBuffers), 1);
+    size_t bufferSize = request.snapshotSize + request.postviewSize;
+    size_t ringMemory = request.ringBuffers * request.ringBufferSize;
+
+    if (mBudget > 0 && bufferSize > 0) {
+        // the ringbuffer is sized by the ZSL offset and cannot shrink,
+        // the snapshot and postview buffers get what it leaves
+        int fit = mBudget > ringMemory ? (mBudget - ringMemory) / bufferSize : 0;
+        if (buffers > fit) {
+            LOG1("@%s: %d buffers do not fit in %u KB, %d do", __FUNCTION__,
+                 buffers, mBudget / 1024, fit);
+            buffers = MAX(fit, minBuffers);
+            if (buffers > fit)
+                LOGW("%s needs %d buffers at the same time, over the budget of %u KB",
+                     modeToString(request.mode), buffers, mBudget / 1024);
+        }
+    }
+
+    mPlan.mode = request.mode;
+    mPlan.snapshotBuffers = buffers;
+    mPlan.postviewBuffers = buffers;
+    mPlan.ringBuffers = request.ringBuffers;
+    mPlan.jpegSpill = request.mode == MODE_CONTINUOUS_SHOOTING || buffers < request.frames;
+    mPlan.memory = buffers * bufferSize + ringMemory;
+
+    LOG1("@%s: %d snapshot, %d postview, %d ring buffers, %u KB%s", __FUNCTION__,
+         mPlan.snapshotBuffers, mPlan.postviewBuffers, mPlan.ringBuffers,
+         mPlan.memory / 1024, mPlan.jpegSpill ? ", spilling to JPEG" : "");
+    return mPlan;
+}
+
+void CapturePlanner::writeParameters(CameraParameters *params) const
+{
+    params->set(IntelCameraParameters::KEY_CAPTURE_MEMORY_BUDGET, (int)(mBudget / 1024));
+    params->set(IntelCameraParameters::KEY_CAPTURE_PLAN_MODE, modeToString(mPlan.mode));
+    params->set(IntelCameraParameters::KEY_CAPTURE_PLAN_SNAPSHOT_BUFFERS, mPlan.snapshotBuffers);
+    params->set(IntelCameraParameters::KEY_CAPTURE_PLAN_POSTVIEW_BUFFERS, mPlan.postviewBuffers);
+    params->set(IntelCameraParameters::KEY_CAPTURE_PLAN_RING_BUFFERS, mPlan.ringBuffers);
+    params->set(IntelCameraParameters::KEY_CAPTURE_PLAN_JPEG_SPILL,
+                mPlan.jpegSpill ? CameraParameters::TRUE : CameraParameters::FALSE);
+    params->set(IntelCameraParameters::KEY_CAPTURE_PLAN_MEMORY, (int)(mPlan.memory / 1024));
+}
+
+const char *CapturePlanner::modeToString(Mode mode)
+{
+    switch (mode) {
+    case MODE_SINGLE:
+        return "single";
+    case MODE_BURST:
+        return "burst";
+    case MODE_BRACKET:
+        return "bracket";
+    case MODE_ULL:
+        return "ull";
+    case MODE_CONTINUOUS_SHOOTING:
+        return "continuous-shooting";
+    case MODE_TIME_NUDGE:
+        return "time-nudge";
+    }
+    return "unknown";
+}
+
+} // namespace android
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_CAPTURE_PLANNER_H
+#define ANDROID_LIBCAMERA_CAPTURE_PLANNER_H
+
+#include <stddef.h>
+#include <camera/CameraParameters.h>
+
+namespace android {
+
+/**
+ * \class CapturePlanner
+ *
+ * Decides how many snapshot and postview buffers a capture sequence gets,
+ * taking into account the memory they use together with the raw ringbuffer
+ * of continuous mode.
+ *
+ * The counts first follow the platform limits (maxNumYUVBufferForBurst,
+ * maxNumYUVBufferForBracket) and the buffers the shooting mode holds at the
+ * same time (ULL input frames, the continuous capture ringbuffer). Then, if
+ * the camera profile sets captureMemoryBudgetMB, the snapshot and postview
+ * buffers are reduced until everything fits in the budget, but never below
+ * what the mode holds at the same time.
+ *
+ * When the plan gives fewer buffers than frames requested, the sequence
+ * spills to JPEG early: each buffer goes back to the ISP as soon as its
+ * picture is encoded, see ControlThread::handleMessagePictureDone().
+ *
+ * The last plan is reported to the application through read-only
+ * parameters, see writeParameters().
+ */
+class CapturePlanner {
+public:
+    enum Mode {
+        MODE_SINGLE,
+        MODE_BURST,
+        MODE_BRACKET,
+        MODE_ULL,
+        MODE_CONTINUOUS_SHOOTING,
+        MODE_TIME_NUDGE,
+    };
+
+    struct Request {
+        Mode mode;
+        int frames;             /*!< frames the sequence captures (burst length) */
+        int maxBuffers;         /*!< platform limit of YUV buffers for the mode */
+        int minBuffers;         /*!< buffers the mode holds at the same time */
+        size_t snapshotSize;    /*!< bytes of one snapshot buffer */
+        size_t postviewSize;    /*!< bytes of one postview buffer */
+        int ringBuffers;        /*!< raw ringbuffer frames, 0 outside continuous mode */
+        size_t ringBufferSize;  /*!< bytes of one raw ringbuffer frame */
+    };
+
+    struct Plan {
+        Mode mode;
+        int snapshotBuffers;
+        int postviewBuffers;
+        int ringBuffers;
+        bool jpegSpill;         /*!< buffers are recycled after encoding during the sequence,
+                                     always the case in continuous shooting */
+        size_t memory;          /*!< bytes used by the buffers above */
+    };
+
+public:
+    CapturePlanner(int cameraId);
+    ~CapturePlanner();
+
+// prevent copy constructor and assignment operator
+private:
+    CapturePlanner(const CapturePlanner& other);
+    CapturePlanner& operator=(const CapturePlanner& other);
+
+public:
+    /**
+     * Computes the buffer counts of a capture sequence and keeps them as
+     * the current plan
+     *
+     * \param request what the sequence needs
+     * \return the new plan
+     */
+    const Plan &plan(const Request &request);
+
+    const Plan &getPlan() const { return mPlan; }
+
+    /**
+     * Memory budget of the capture buffers in bytes, 0 if there is none
+     */
+    size_t getBudget() const { return mBudget; }
+
+    /**
+     * Sets the read-only parameters describing the current plan
+     */
+    void writeParameters(CameraParameters *params) const;
+
+private:
+    static const char *modeToString(Mode mode);
+
+private:
+    size_t mBudget;
+    Plan mPlan;
+};
+
+} // namespace android
+
+#endif // ANDROID_LIBCAMERA_CAPTURE_PLANNER_H
@@ -20,10 +20,70 @@
 #include <linux/videodev2.h>
 #include "ColorConverter.h"
 #include "LogHelper.h"
+#include "ColorConverterKernels.h"
 #include "AtomCommon.h"
+#include <pthread.h>
 
 namespace android {
 
+static pthread_once_t sKernelsOnce = PTHREAD_ONCE_INIT;
+static ColorConverterIsa sIsa = COLOR_CONVERTER_ISA_C;
+static const ColorConverterKernels *sKernels = NULL;
+
+static const char *isaName(ColorConverterIsa isa)
+{
+    switch (isa) {
+    case COLOR_CONVERTER_ISA_SSE2:
+        return "SSE2";
+    case COLOR_CONVERTER_ISA_SSSE3:
+        return "SSSE3";
+    case COLOR_CONVERTER_ISA_AVX2:
+        return "AVX2";
+    default:
+        return "C";
+    }
+}
+
+static void initColorConverterKernels()
+{
+    sIsa = detectColorConverterIsa();
+    sKernels = getColorConverterKernels(sIsa);
+    LOG1("@%s: color converters use %s kernels", __FUNCTION__, isaName(sIsa));
+}
+
+/**
+ * Returns the SIMD kernel table, or NULL when the scalar reference
+ * converters should be used.
+ */
+static const ColorConverterKernels *colorConverterKernels()
+{
+    pthread_once(&sKernelsOnce, initColorConverterKernels);
+    return sKernels;
+}
+
+ColorConverterIsa getColorConverterIsa()
+{
+    pthread_once(&sKernelsOnce, initColorConverterKernels);
+    return sIsa;
+}
+
+status_t setColorConverterIsa(ColorConverterIsa isa)
+{
+    pthread_once(&sKernelsOnce, initColorConverterKernels);
+    if (isa > detectColorConverterIsa()) {
+        LOGE("@%s: %s not supported by this CPU", __FUNCTION__, isaName(isa));
+        return INVALID_OPERATION;
+    }
+    const ColorConverterKernels *kernels = getColorConverterKernels(isa);
+    if (kernels == NULL && isa != COLOR_CONVERTER_ISA_C) {
+        LOGE("@%s: %s kernels not built in", __FUNCTION__, isaName(isa));
+        return INVALID_OPERATION;
+    }
+    sIsa = isa;
+    sKernels = kernels;
+    return NO_ERROR;
+}
+
 void YUV420ToRGB565(int width, int height, void *src, void *dst)
 {
     int line, col, linewidth;
@@ -80,7 +140,7 @@ void YUV420ToRGB565(int width, int height, void *src, void *dst)
     }
 }
 
-void trimConvertNV12ToRGB565(int width, int height, int srcBpl, void *src, void *dst)
+static void trimConvertNV12ToRGB565Scalar(int width, int height, int srcBpl, void *src, void *dst)
 {
 
     unsigned char *yuvs = (unsigned char *) src;
@@ -132,7 +192,7 @@ void trimConvertNV12ToRGB565(int width, int height, int srcBpl, void *src, void
 }
 
 // covert YV12 (Y plane, V plane, U plane) to NV21 (Y plane, interlaced VU bytes)
-void convertYV12ToNV21(int width, int height, int srcBpl, int dstBpl, void *src, void *dst)
+static void convertYV12ToNV21Scalar(int width, int height, int srcBpl, int dstBpl, void *src, void *dst)
 {
     const int cBpl = srcBpl>>1;
     const int vuBpl = dstBpl;
@@ -222,7 +282,7 @@ void copyNV21ToNV21(int width, int height, int srcBpl, int dstBpl, char *src, ch
 
 // covert NV12 (Y plane, interlaced UV bytes) to
 // NV21 (Y plane, interlaced VU bytes) and trim bpl to real width
-void trimConvertNV12ToNV21(int width, int height, int srcBpl, void *src, void *dst)
+static void trimConvertNV12ToNV21Scalar(int width, int height, int srcBpl, void *src, void *dst)
 {
     const int ysize = width * height;
     unsigned const char *pSrc = (unsigned char *)src;
@@ -332,7 +392,7 @@ void trimConvertNV12ToNV21(int width, int height, int srcBpl, void *src, void *d
 }
 
 // covert NV12 (Y plane, interlaced UV bytes) to YV12 (Y plane, V plane, U plane)
-void align16ConvertNV12ToYV12(int width, int height, int srcBpl, void *src, void *dst)
+static void align16ConvertNV12ToYV12Scalar(int width, int height, int srcBpl, void *src, void *dst)
 {
     int yBpl = ALIGN16(width);
     size_t ySize = yBpl * height;
@@ -410,7 +470,7 @@ void YUY2ToP411(int width, int height, void *src, void *dst)
 }
 
 // P411's Y, U, V are separated. But the NV12's U and V are interleaved.
-void NV12ToP411Separate(int width, int height, void *srcY, void *srcUV, void *dst)
+static void NV12ToP411SeparateScalar(int width, int height, void *srcY, void *srcUV, void *dst)
 {
     int i, j, p, q;
     unsigned char *pdstU, *pdstV;
@@ -437,7 +497,7 @@ void NV12ToP411Separate(int width, int height, void *srcY, void *srcUV, void *ds
 }
 
 // P411's Y, U, V are separated. But the NV21's U and V are interleaved.
-void NV21ToP411Separate(int width, int height, void *srcY, void *srcUV, void *dst)
+static void NV21ToP411SeparateScalar(int width, int height, void *srcY, void *srcUV, void *dst)
 {
     int i, j, p, q;
     unsigned char *pdstU, *pdstV;
@@ -570,7 +630,7 @@ void convertYUYVToYV12(int width, int height, int srcBpl, int dstBpl, void *src,
 }
 
 // covert YUYV(YUY2, YUV422 format) to NV21 (Y plane, interlaced VU bytes)
-void convertYUYVToNV21(int width, int height, int srcBpl, void *src, void *dst)
+static void convertYUYVToNV21Scalar(int width, int height, int srcBpl, void *src, void *dst)
 {
     int ySize = width * height;
     int u_counter=1, v_counter=0;
@@ -602,6 +662,268 @@ void convertYUYVToNV21(int width, int height, int srcBpl, void *src, void *dst)
     }
 }
 
+/*
+ * Dispatchers: run the SIMD kernels row by row when available, otherwise
+ * the scalar reference converters above.
+ */
+
+void trimConvertNV12ToRGB565(int width, int height, int srcBpl, void *src, void *dst)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    if (k == NULL || (width & 1)) {
+        trimConvertNV12ToRGB565Scalar(width, height, srcBpl, src, dst);
+        return;
+    }
+
+    const unsigned char *srcY = (const unsigned char *) src;
+    const unsigned char *srcUV = srcY + srcBpl * height;
+    unsigned char *dstPtr = (unsigned char *) dst;
+    for (int i = 0; i < height; i++) {
+        k->nv12ToRGB565Row(srcY, srcUV + (i / 2) * srcBpl, dstPtr, width);
+        srcY += srcBpl;
+        dstPtr += width * 2;
+    }
+}
+
+void convertYV12ToNV21(int width, int height, int srcBpl, int dstBpl, void *src, void *dst)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    if (k == NULL) {
+        convertYV12ToNV21Scalar(width, height, srcBpl, dstBpl, src, dst);
+        return;
+    }
+
+    const int cBpl = srcBpl >> 1;
+    const int hhalf = height >> 1;
+    const int whalf = width >> 1;
+
+    // copy the entire Y plane
+    unsigned char *srcPtr = (unsigned char *)src;
+    unsigned char *dstPtr = (unsigned char *)dst;
+    if (srcBpl == dstBpl) {
+        memcpy(dstPtr, srcPtr, dstBpl * height);
+    } else {
+        for (int i = 0; i < height; i++) {
+            memcpy(dstPtr, srcPtr, width);
+            srcPtr += srcBpl;
+            dstPtr += dstBpl;
+        }
+    }
+
+    // interlace the VU data
+    const unsigned char *srcPtrV = (unsigned char *)src + height * srcBpl;
+    const unsigned char *srcPtrU = srcPtrV + cBpl * hhalf;
+    dstPtr = (unsigned char *)dst + dstBpl * height;
+    for (int i = 0; i < hhalf; i++) {
+        k->interleaveRow(srcPtrV, srcPtrU, dstPtr, whalf);
+        dstPtr += dstBpl;
+        srcPtrV += cBpl;
+        srcPtrU += cBpl;
+    }
+}
+
+void trimConvertNV12ToNV21(int width, int height, int srcBpl, void *src, void *dst)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    if (k == NULL || (width & 1)) {
+        trimConvertNV12ToNV21Scalar(width, height, srcBpl, src, dst);
+        return;
+    }
+
+    const unsigned char *pSrc = (unsigned char *)src;
+    unsigned char *pDst = (unsigned char *)dst;
+
+    // Copy Y component
+    if (srcBpl == width) {
+        memcpy(pDst, pSrc, width * height);
+    } else if (srcBpl > width) {
+        for (int j = 0; j < height; j++) {
+            memcpy(pDst, pSrc, width);
+            pSrc += srcBpl;
+            pDst += width;
+        }
+    } else {
+        LOGE("bad bpl value");
+        return;
+    }
+
+    // Convert UV to VU
+    pSrc = (unsigned char *)src + srcBpl * height;
+    pDst = (unsigned char *)dst + width * height;
+    for (int j = 0; j < height / 2; j++) {
+        k->swapUVRow(pSrc, pDst, width);
+        pSrc += srcBpl;
+        pDst += width;
+    }
+}
+
+void align16ConvertNV12ToYV12(int width, int height, int srcBpl, void *src, void *dst)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    if (k == NULL) {
+        align16ConvertNV12ToYV12Scalar(width, height, srcBpl, src, dst);
+        return;
+    }
+
+    int yBpl = ALIGN16(width);
+    size_t ySize = yBpl * height;
+    int cBpl = ALIGN16(yBpl/2);
+    size_t cSize = cBpl * height/2;
+
+    unsigned char *srcPtr = (unsigned char *) src;
+    unsigned char *dstPtr = (unsigned char *) dst;
+    unsigned char *dstPtrV = (unsigned char *) dst + ySize;
+    unsigned char *dstPtrU = (unsigned char *) dst + ySize + cSize;
+
+    // copy the entire Y plane
+    if (srcBpl == yBpl) {
+        memcpy(dstPtr, srcPtr, ySize);
+        srcPtr += ySize;
+    } else if (srcBpl > width) {
+        for (int i = 0; i < height; i++) {
+            memcpy(dstPtr, srcPtr, width);
+            srcPtr += srcBpl;
+            dstPtr += yBpl;
+        }
+    } else {
+        LOGE("bad src bpl value");
+        return;
+    }
+
+    // deinterlace the UV data
+    for (int i = 0; i < height / 2; ++i) {
+        k->deinterleaveRow(srcPtr, dstPtrU, dstPtrV, width / 2);
+        srcPtr += srcBpl;
+        dstPtrV += cBpl;
+        dstPtrU += cBpl;
+    }
+}
+
+void NV12ToP411Separate(int width, int height, void *srcY, void *srcUV, void *dst)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    if (k == NULL || (width & 1)) {
+        NV12ToP411SeparateScalar(width, height, srcY, srcUV, dst);
+        return;
+    }
+
+    const int wHalf = width >> 1;
+    const unsigned char *psrcUV = (unsigned char *)srcUV;
+    unsigned char *pdstU = (unsigned char *)dst + width * height;
+    unsigned char *pdstV = pdstU + width * height / 4;
+
+    memcpy(dst, srcY, width * height);
+    for (int i = 0; i < height / 2; i++) {
+        k->deinterleaveRow(psrcUV, pdstU, pdstV, wHalf);
+        psrcUV += width;
+        pdstU += wHalf;
+        pdstV += wHalf;
+    }
+}
+
+void NV21ToP411Separate(int width, int height, void *srcY, void *srcUV, void *dst)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    if (k == NULL || (width & 1)) {
+        NV21ToP411SeparateScalar(width, height, srcY, srcUV, dst);
+        return;
+    }
+
+    const int wHalf = width >> 1;
+    const unsigned char *psrcVU = (unsigned char *)srcUV;
+    unsigned char *pdstU = (unsigned char *)dst + width * height;
+    unsigned char *pdstV = pdstU + width * height / 4;
+
+    memcpy(dst, srcY, width * height);
+    for (int i = 0; i < height / 2; i++) {
+        k->deinterleaveRow(psrcVU, pdstV, pdstU, wHalf);
+        psrcVU += width;
+        pdstU += wHalf;
+        pdstV += wHalf;
+    }
+}
+
+void NV12ToP411Lines(int width, int lines, int srcBpl, const void *srcUV,
+                     void *dstU, void *dstV, int dstBpl)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    const int wHalf = width >> 1;
+    const unsigned char *src = (const unsigned char *) srcUV;
+    unsigned char *pdstU = (unsigned char *) dstU;
+    unsigned char *pdstV = (unsigned char *) dstV;
+
+    for (int i = 0; i < lines; i++) {
+        if (k != NULL) {
+            k->deinterleaveRow(src, pdstU, pdstV, wHalf);
+        } else {
+            for (int j = 0; j < wHalf; j++) {
+                pdstU[j] = src[2 * j];
+                pdstV[j] = src[2 * j + 1];
+            }
+        }
+        src += srcBpl;
+        pdstU += dstBpl;
+        pdstV += dstBpl;
+    }
+}
+
+void YUY2ToP411Lines(int width, int lines, int srcBpl, const void *src,
+                     void *dstY, void *dstU, void *dstV, int dstYBpl, int dstCBpl)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    const int wHalf = width >> 1;
+    const unsigned char *srcPtr = (const unsigned char *) src;
+    unsigned char *dstPtr = (unsigned char *) dstY;
+    unsigned char *dstPtrU = (unsigned char *) dstU;
+    unsigned char *dstPtrV = (unsigned char *) dstV;
+
+    for (int i = 0; i < lines; i++) {
+        if (k != NULL) {
+            k->yuyvToYRow(srcPtr, dstPtr, width);
+        } else {
+            for (int j = 0; j < width; j++)
+                dstPtr[j] = srcPtr[j * 2];
+        }
+
+        if (i & 1) {
+            for (int j = 0; j < wHalf; j++)
+                dstPtrV[j] = srcPtr[j * 4 + 3];
+            dstPtrV += dstCBpl;
+        } else {
+            for (int j = 0; j < wHalf; j++)
+                dstPtrU[j] = srcPtr[j * 4 + 1];
+            dstPtrU += dstCBpl;
+        }
+
+        srcPtr += srcBpl;
+        dstPtr += dstYBpl;
+    }
+}
+
+void convertYUYVToNV21(int width, int height, int srcBpl, void *src, void *dst)
+{
+    const ColorConverterKernels *k = colorConverterKernels();
+    if (k == NULL || (width & 1)) {
+        convertYUYVToNV21Scalar(width, height, srcBpl, src, dst);
+        return;
+    }
+
+    const unsigned char *srcPtr = (unsigned char *) src;
+    unsigned char *dstPtr = (unsigned char *) dst;
+    unsigned char *dstPtrVU = (unsigned char *) dst + width * height;
+
+    for (int i = 0; i < height; i++) {
+        k->yuyvToYRow(srcPtr, dstPtr, width);
+        // chroma is taken from the odd lines
+        if (i & 1) {
+            k->yuyvToVURow(srcPtr, dstPtrVU, width);
+            dstPtrVU += width;
+        }
+        srcPtr += srcBpl;
+        dstPtr += width;
+    }
+}
+
 void convertBuftoYV12(int format, int width, int height, int srcBpl, int
                       dstBpl, void *src, void *dst)
 {
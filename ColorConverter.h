@@ -21,6 +21,23 @@
 
 namespace android {
 
+/**
+ * Instruction sets the color converters can be dispatched to.
+ *
+ * The best one supported by the CPU is selected on first use. The plain C
+ * converters are kept as the reference implementation and fallback.
+ */
+enum ColorConverterIsa {
+    COLOR_CONVERTER_ISA_C = 0,
+    COLOR_CONVERTER_ISA_SSE2,
+    COLOR_CONVERTER_ISA_SSSE3,
+    COLOR_CONVERTER_ISA_AVX2
+};
+
+ColorConverterIsa getColorConverterIsa();
+// Forces the given instruction set, fails if the CPU does not support it
+status_t setColorConverterIsa(ColorConverterIsa isa);
+
 void YUV420ToRGB565(int width, int height, void *src, void *dst);
 
 void trimConvertNV12ToRGB565(int width, int height, int srcBpl, void *src, void *dst);
@@ -40,6 +57,14 @@ void NV21ToP411Separate(int width, int height, void *srcY, void *srcUV, void *ds
 
 void YUY2ToP411(int width, int height, void *src, void *dst);
 
+// Line based variants of the above, used to convert one MCU strip at a time.
+// NV12 chroma lines are split into planar U and V lines of width/2 bytes.
+void NV12ToP411Lines(int width, int lines, int srcBpl, const void *srcUV,
+                     void *dstU, void *dstV, int dstBpl);
+// YUY2 lines give one luma line each, even lines a U line and odd lines a V line
+void YUY2ToP411Lines(int width, int lines, int srcBpl, const void *src,
+                     void *dstY, void *dstU, void *dstV, int dstYBpl, int dstCBpl);
+
 void convertYUYVToYV12(int width, int height, int srcBpl, int dstBpl, void *src, void *dst);
 
 void convertYUYVToNV21(int width, int height, int srcBpl, void *src, void *dst);
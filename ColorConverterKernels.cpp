@@ -0,0 +1,495 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_ColorConverterKernels"
+
+#include "ColorConverterKernels.h"
+#include "AtomCommon.h"
+
+#if defined(__i386__) || defined(__x86_64__)
+#define COLOR_CONVERTER_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace android {
+
+#ifdef COLOR_CONVERTER_X86
+
+// Not all cpuid.h versions know about the leaf 7 and XSAVE feature bits
+#ifndef bit_OSXSAVE
+#define bit_OSXSAVE (1 << 27)
+#endif
+#ifndef bit_AVX
+#define bit_AVX (1 << 28)
+#endif
+#ifndef bit_AVX2
+#define bit_AVX2 (1 << 5)
+#endif
+
+// The kernels are compiled per instruction set, the module itself is built
+// for the baseline ABI and selects the table at runtime.
+#define TARGET_SSE2  __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2  __attribute__((target("avx2")))
+
+/*
+ * Scalar tails, shared by all the instruction sets. These follow the
+ * reference converters in ColorConverter.cpp to the letter.
+ */
+
+static inline void swapUVTail(const unsigned char *src, unsigned char *dst, int i, int bytes)
+{
+    for (; i < bytes; i += 2) {
+        dst[i] = src[i + 1];
+        dst[i + 1] = src[i];
+    }
+}
+
+static inline void interleaveTail(const unsigned char *a, const unsigned char *b,
+                                  unsigned char *dst, int i, int pairs)
+{
+    for (; i < pairs; i++) {
+        dst[2 * i] = a[i];
+        dst[2 * i + 1] = b[i];
+    }
+}
+
+static inline void deinterleaveTail(const unsigned char *src, unsigned char *a,
+                                    unsigned char *b, int i, int pairs)
+{
+    for (; i < pairs; i++) {
+        a[i] = src[2 * i];
+        b[i] = src[2 * i + 1];
+    }
+}
+
+static inline void yuyvToYTail(const unsigned char *src, unsigned char *dstY, int i, int width)
+{
+    for (; i < width; i++)
+        dstY[i] = src[2 * i];
+}
+
+static inline void yuyvToVUTail(const unsigned char *src, unsigned char *dstVU, int i, int width)
+{
+    for (; i < width; i += 2) {
+        dstVU[i] = src[2 * i + 3];     // V
+        dstVU[i + 1] = src[2 * i + 1]; // U
+    }
+}
+
+static inline unsigned short rgb565Pixel(int y, int cb, int cr)
+{
+    int b = y + ((454 * cb) >> 8);
+    int g = y - ((88 * cb + 183 * cr) >> 8);
+    int r = y + ((359 * cr) >> 8);
+    b = CLIP(b, 255, 0);
+    g = CLIP(g, 255, 0);
+    r = CLIP(r, 255, 0);
+    return ((r & 0xf8) << 8) | ((g & 0xfc) << 3) | (b >> 3);
+}
+
+static inline void nv12ToRGB565Tail(const unsigned char *y, const unsigned char *uv,
+                                    unsigned char *dst, int i, int width)
+{
+    for (; i < width; i += 2) {
+        int cb = uv[i] - 128;
+        int cr = uv[i + 1] - 128;
+        unsigned short p0 = rgb565Pixel(y[i], cb, cr);
+        unsigned short p1 = rgb565Pixel(y[i + 1], cb, cr);
+        // NOTE: this assume little-endian encoding
+        dst[2 * i] = p0 & 0xff;
+        dst[2 * i + 1] = p0 >> 8;
+        dst[2 * i + 2] = p1 & 0xff;
+        dst[2 * i + 3] = p1 >> 8;
+    }
+}
+
+/*
+ * SSE2
+ */
+
+TARGET_SSE2
+static void swapUVRowSSE2(const unsigned char *src, unsigned char *dst, int bytes)
+{
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        _mm_storeu_si128((__m128i *)(dst + i), x);
+    }
+    swapUVTail(src, dst, i, bytes);
+}
+
+TARGET_SSE2
+static void interleaveRowSSE2(const unsigned char *a, const unsigned char *b,
+                              unsigned char *dst, int pairs)
+{
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(va, vb));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16), _mm_unpackhi_epi8(va, vb));
+    }
+    interleaveTail(a, b, dst, i, pairs);
+}
+
+TARGET_SSE2
+static void deinterleaveRowSSE2(const unsigned char *src, unsigned char *a,
+                                unsigned char *b, int pairs)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m128i x0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i x1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        __m128i even = _mm_packus_epi16(_mm_and_si128(x0, lowBytes), _mm_and_si128(x1, lowBytes));
+        __m128i odd = _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x1, 8));
+        _mm_storeu_si128((__m128i *)(a + i), even);
+        _mm_storeu_si128((__m128i *)(b + i), odd);
+    }
+    deinterleaveTail(src, a, b, i, pairs);
+}
+
+TARGET_SSE2
+static void yuyvToYRowSSE2(const unsigned char *src, unsigned char *dstY, int width)
+{
+    const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 16 <= width; i += 16) {
+        __m128i x0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i x1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        __m128i y = _mm_packus_epi16(_mm_and_si128(x0, lowBytes), _mm_and_si128(x1, lowBytes));
+        _mm_storeu_si128((__m128i *)(dstY + i), y);
+    }
+    yuyvToYTail(src, dstY, i, width);
+}
+
+TARGET_SSE2
+static void yuyvToVURowSSE2(const unsigned char *src, unsigned char *dstVU, int width)
+{
+    int i = 0;
+    for (; i + 16 <= width; i += 16) {
+        __m128i x0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i x1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        // U0 V0 U1 V1 ...
+        __m128i uv = _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x1, 8));
+        __m128i vu = _mm_or_si128(_mm_slli_epi16(uv, 8), _mm_srli_epi16(uv, 8));
+        _mm_storeu_si128((__m128i *)(dstVU + i), vu);
+    }
+    yuyvToVUTail(src, dstVU, i, width);
+}
+
+/**
+ * Converts 8 pixels. y holds 8 16-bit luma samples, uv 4 16-bit (u,v) pairs
+ * already biased by -128. Returns the 8 RGB565 pixels.
+ */
+TARGET_SSE2
+static inline __m128i nv12ToRGB565SSE2(__m128i y, __m128i uv)
+{
+    const __m128i coefB = _mm_set1_epi32(454);
+    const __m128i coefG = _mm_set1_epi32((183 << 16) | 88);
+    const __m128i coefR = _mm_set1_epi32(359 << 16);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(255);
+
+    __m128i offB = _mm_srai_epi32(_mm_madd_epi16(uv, coefB), 8);
+    __m128i offG = _mm_srai_epi32(_mm_madd_epi16(uv, coefG), 8);
+    __m128i offR = _mm_srai_epi32(_mm_madd_epi16(uv, coefR), 8);
+    // each chroma pair is shared by two horizontally adjacent pixels
+    offB = _mm_packs_epi32(offB, offB);
+    offG = _mm_packs_epi32(offG, offG);
+    offR = _mm_packs_epi32(offR, offR);
+    offB = _mm_unpacklo_epi16(offB, offB);
+    offG = _mm_unpacklo_epi16(offG, offG);
+    offR = _mm_unpacklo_epi16(offR, offR);
+
+    __m128i b = _mm_min_epi16(_mm_max_epi16(_mm_add_epi16(y, offB), zero), max);
+    __m128i g = _mm_min_epi16(_mm_max_epi16(_mm_sub_epi16(y, offG), zero), max);
+    __m128i r = _mm_min_epi16(_mm_max_epi16(_mm_add_epi16(y, offR), zero), max);
+
+    __m128i rgb = _mm_slli_epi16(_mm_and_si128(r, _mm_set1_epi16(0xf8)), 8);
+    rgb = _mm_or_si128(rgb, _mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(0xfc)), 3));
+    return _mm_or_si128(rgb, _mm_srli_epi16(b, 3));
+}
+
+TARGET_SSE2
+static void nv12ToRGB565RowSSE2(const unsigned char *y, const unsigned char *uv,
+                                unsigned char *dst, int width)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    int i = 0;
+    for (; i + 8 <= width; i += 8) {
+        __m128i vy = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(y + i)), zero);
+        __m128i vuv = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(uv + i)), zero);
+        vuv = _mm_sub_epi16(vuv, bias);
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), nv12ToRGB565SSE2(vy, vuv));
+    }
+    nv12ToRGB565Tail(y, uv, dst, i, width);
+}
+
+/*
+ * SSSE3: byte shuffles replace the shift/mask sequences
+ */
+
+TARGET_SSSE3
+static void swapUVRowSSSE3(const unsigned char *src, unsigned char *dst, int bytes)
+{
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(x, mask));
+    }
+    swapUVTail(src, dst, i, bytes);
+}
+
+TARGET_SSSE3
+static void deinterleaveRowSSSE3(const unsigned char *src, unsigned char *a,
+                                 unsigned char *b, int pairs)
+{
+    const __m128i mask = _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    int i = 0;
+    for (; i + 16 <= pairs; i += 16) {
+        __m128i x0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 2 * i)), mask);
+        __m128i x1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(src + 2 * i + 16)), mask);
+        _mm_storeu_si128((__m128i *)(a + i), _mm_unpacklo_epi64(x0, x1));
+        _mm_storeu_si128((__m128i *)(b + i), _mm_unpackhi_epi64(x0, x1));
+    }
+    deinterleaveTail(src, a, b, i, pairs);
+}
+
+TARGET_SSSE3
+static void yuyvToVURowSSSE3(const unsigned char *src, unsigned char *dstVU, int width)
+{
+    const __m128i maskLo = _mm_setr_epi8(3, 1, 7, 5, 11, 9, 15, 13,
+                                         -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i maskHi = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                                         3, 1, 7, 5, 11, 9, 15, 13);
+    int i = 0;
+    for (; i + 16 <= width; i += 16) {
+        __m128i x0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i x1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        __m128i vu = _mm_or_si128(_mm_shuffle_epi8(x0, maskLo), _mm_shuffle_epi8(x1, maskHi));
+        _mm_storeu_si128((__m128i *)(dstVU + i), vu);
+    }
+    yuyvToVUTail(src, dstVU, i, width);
+}
+
+/*
+ * AVX2: 32 bytes per step. The in-lane unpack/pack instructions leave the
+ * 128-bit halves swapped, permute4x64 restores the memory order.
+ */
+
+TARGET_AVX2
+static void swapUVRowAVX2(const unsigned char *src, unsigned char *dst, int bytes)
+{
+    const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_shuffle_epi8(x, mask));
+    }
+    swapUVTail(src, dst, i, bytes);
+}
+
+TARGET_AVX2
+static void interleaveRowAVX2(const unsigned char *a, const unsigned char *b,
+                              unsigned char *dst, int pairs)
+{
+    int i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i lo = _mm256_unpacklo_epi8(va, vb);
+        __m256i hi = _mm256_unpackhi_epi8(va, vb);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    interleaveTail(a, b, dst, i, pairs);
+}
+
+TARGET_AVX2
+static void deinterleaveRowAVX2(const unsigned char *src, unsigned char *a,
+                                unsigned char *b, int pairs)
+{
+    const __m256i mask = _mm256_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15,
+                                          0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+    int i = 0;
+    for (; i + 32 <= pairs; i += 32) {
+        __m256i x0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src + 2 * i)), mask);
+        __m256i x1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(src + 2 * i + 32)), mask);
+        __m256i even = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(x0, x1), _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i odd = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(x0, x1), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(a + i), even);
+        _mm256_storeu_si256((__m256i *)(b + i), odd);
+    }
+    deinterleaveTail(src, a, b, i, pairs);
+}
+
+TARGET_AVX2
+static void yuyvToYRowAVX2(const unsigned char *src, unsigned char *dstY, int width)
+{
+    const __m256i lowBytes = _mm256_set1_epi16(0x00ff);
+    int i = 0;
+    for (; i + 32 <= width; i += 32) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        __m256i x1 = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+        __m256i y = _mm256_packus_epi16(_mm256_and_si256(x0, lowBytes), _mm256_and_si256(x1, lowBytes));
+        _mm256_storeu_si256((__m256i *)(dstY + i), _mm256_permute4x64_epi64(y, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    yuyvToYTail(src, dstY, i, width);
+}
+
+TARGET_AVX2
+static void yuyvToVURowAVX2(const unsigned char *src, unsigned char *dstVU, int width)
+{
+    const __m256i swap = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    int i = 0;
+    for (; i + 32 <= width; i += 32) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        __m256i x1 = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+        __m256i uv = _mm256_packus_epi16(_mm256_srli_epi16(x0, 8), _mm256_srli_epi16(x1, 8));
+        uv = _mm256_permute4x64_epi64(uv, _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)(dstVU + i), _mm256_shuffle_epi8(uv, swap));
+    }
+    yuyvToVUTail(src, dstVU, i, width);
+}
+
+TARGET_AVX2
+static void nv12ToRGB565RowAVX2(const unsigned char *y, const unsigned char *uv,
+                                unsigned char *dst, int width)
+{
+    const __m256i coefB = _mm256_set1_epi32(454);
+    const __m256i coefG = _mm256_set1_epi32((183 << 16) | 88);
+    const __m256i coefR = _mm256_set1_epi32(359 << 16);
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi16(255);
+    int i = 0;
+    for (; i + 16 <= width; i += 16) {
+        __m256i vy = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(y + i)));
+        __m256i vuv = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(uv + i)));
+        vuv = _mm256_sub_epi16(vuv, bias);
+
+        __m256i offB = _mm256_srai_epi32(_mm256_madd_epi16(vuv, coefB), 8);
+        __m256i offG = _mm256_srai_epi32(_mm256_madd_epi16(vuv, coefG), 8);
+        __m256i offR = _mm256_srai_epi32(_mm256_madd_epi16(vuv, coefR), 8);
+        offB = _mm256_packs_epi32(offB, offB);
+        offG = _mm256_packs_epi32(offG, offG);
+        offR = _mm256_packs_epi32(offR, offR);
+        offB = _mm256_unpacklo_epi16(offB, offB);
+        offG = _mm256_unpacklo_epi16(offG, offG);
+        offR = _mm256_unpacklo_epi16(offR, offR);
+
+        __m256i b = _mm256_min_epi16(_mm256_max_epi16(_mm256_add_epi16(vy, offB), zero), max);
+        __m256i g = _mm256_min_epi16(_mm256_max_epi16(_mm256_sub_epi16(vy, offG), zero), max);
+        __m256i r = _mm256_min_epi16(_mm256_max_epi16(_mm256_add_epi16(vy, offR), zero), max);
+
+        __m256i rgb = _mm256_slli_epi16(_mm256_and_si256(r, _mm256_set1_epi16(0xf8)), 8);
+        rgb = _mm256_or_si256(rgb, _mm256_slli_epi16(_mm256_and_si256(g, _mm256_set1_epi16(0xfc)), 3));
+        rgb = _mm256_or_si256(rgb, _mm256_srli_epi16(b, 3));
+        _mm256_storeu_si256((__m256i *)(dst + 2 * i), rgb);
+    }
+    nv12ToRGB565Tail(y, uv, dst, i, width);
+}
+
+static const ColorConverterKernels sKernelsSSE2 = {
+    swapUVRowSSE2,
+    interleaveRowSSE2,
+    deinterleaveRowSSE2,
+    yuyvToYRowSSE2,
+    yuyvToVURowSSE2,
+    nv12ToRGB565RowSSE2
+};
+
+static const ColorConverterKernels sKernelsSSSE3 = {
+    swapUVRowSSSE3,
+    interleaveRowSSE2,
+    deinterleaveRowSSSE3,
+    yuyvToYRowSSE2,
+    yuyvToVURowSSSE3,
+    nv12ToRGB565RowSSE2
+};
+
+static const ColorConverterKernels sKernelsAVX2 = {
+    swapUVRowAVX2,
+    interleaveRowAVX2,
+    deinterleaveRowAVX2,
+    yuyvToYRowAVX2,
+    yuyvToVURowAVX2,
+    nv12ToRGB565RowAVX2
+};
+
+const ColorConverterKernels *getColorConverterKernels(ColorConverterIsa isa)
+{
+    switch (isa) {
+    case COLOR_CONVERTER_ISA_SSE2:
+        return &sKernelsSSE2;
+    case COLOR_CONVERTER_ISA_SSSE3:
+        return &sKernelsSSSE3;
+    case COLOR_CONVERTER_ISA_AVX2:
+        return &sKernelsAVX2;
+    default:
+        return NULL;
+    }
+}
+
+ColorConverterIsa detectColorConverterIsa()
+{
+    unsigned int eax, ebx, ecx, edx;
+    ColorConverterIsa isa = COLOR_CONVERTER_ISA_C;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return isa;
+
+    if (edx & bit_SSE2)
+        isa = COLOR_CONVERTER_ISA_SSE2;
+    if ((ecx & bit_SSSE3) && isa == COLOR_CONVERTER_ISA_SSE2)
+        isa = COLOR_CONVERTER_ISA_SSSE3;
+
+    // AVX2 also needs the OS to save the YMM state on context switches
+    if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX) && __get_cpuid_max(0, NULL) >= 7) {
+        unsigned int xcr0Lo, xcr0Hi;
+        asm volatile(".byte 0x0f, 0x01, 0xd0" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+        if ((xcr0Lo & 0x6) == 0x6) {
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            if ((ebx & bit_AVX2) && isa == COLOR_CONVERTER_ISA_SSSE3)
+                isa = COLOR_CONVERTER_ISA_AVX2;
+        }
+    }
+
+    return isa;
+}
+
+#else // COLOR_CONVERTER_X86
+
+const ColorConverterKernels *getColorConverterKernels(ColorConverterIsa /*isa*/)
+{
+    return NULL;
+}
+
+ColorConverterIsa detectColorConverterIsa()
+{
+    return COLOR_CONVERTER_ISA_C;
+}
+
+#endif // COLOR_CONVERTER_X86
+
+}; // namespace android
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_COLOR_CONVERTER_KERNELS_H
+#define ANDROID_LIBCAMERA_COLOR_CONVERTER_KERNELS_H
+
+#include "ColorConverter.h"
+
+namespace android {
+
+/**
+ * \struct ColorConverterKernels
+ *
+ * Table of the per-scanline kernels used by the color converters in
+ * ColorConverter.cpp when a SIMD instruction set is available.
+ *
+ * Every kernel processes exactly one row and handles any tail that does not
+ * fill a full vector itself, so the callers only deal with plane geometry.
+ * The results must be bit-exact with the scalar reference implementations.
+ */
+struct ColorConverterKernels {
+    // dst[2i] = src[2i + 1], dst[2i + 1] = src[2i] for 'bytes' bytes (NV12 <-> NV21)
+    void (*swapUVRow)(const unsigned char *src, unsigned char *dst, int bytes);
+    // dst[2i] = a[i], dst[2i + 1] = b[i] for 'pairs' pairs (YV12 -> NV21)
+    void (*interleaveRow)(const unsigned char *a, const unsigned char *b,
+                          unsigned char *dst, int pairs);
+    // a[i] = src[2i], b[i] = src[2i + 1] for 'pairs' pairs (NV12 -> YV12, P411)
+    void (*deinterleaveRow)(const unsigned char *src, unsigned char *a,
+                            unsigned char *b, int pairs);
+    // extracts the luma of 'width' YUYV pixels
+    void (*yuyvToYRow)(const unsigned char *src, unsigned char *dstY, int width);
+    // extracts the chroma of 'width' YUYV pixels as interleaved VU bytes
+    void (*yuyvToVURow)(const unsigned char *src, unsigned char *dstVU, int width);
+    // converts 'width' NV12 pixels to little-endian RGB565
+    void (*nv12ToRGB565Row)(const unsigned char *y, const unsigned char *uv,
+                            unsigned char *dst, int width);
+};
+
+/**
+ * Returns the kernel table for the given instruction set, or NULL if the
+ * library was built without support for it.
+ */
+const ColorConverterKernels *getColorConverterKernels(ColorConverterIsa isa);
+
+/**
+ * Detects the best instruction set supported by the running CPU via cpuid
+ */
+ColorConverterIsa detectColorConverterIsa();
+
+}; // namespace android
+
+#endif // ANDROID_LIBCAMERA_COLOR_CONVERTER_KERNELS_H
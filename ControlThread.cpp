@@ -33,8 +33,10 @@
 #include "IntelParameters.h"
 #include "ValidateParameters.h"
 #include "MemoryUtils.h"
+#include "AtomBufferPool.h"
 #include <utils/Vector.h>
 #include <math.h>
+#include <unistd.h>
 #include <cutils/properties.h>
 #include <binder/IServiceManager.h>
 #include "intel_camera_extensions.h"
@@ -147,6 +149,7 @@ ControlThread::ControlThread(int cameraId) :
     ,mBurstCaptureDoneNum(-1)
     ,mBurstBufsToReturn(0)
     ,mUllBurstLength(UltraLowLight::MAX_INPUT_BUFFERS)
+    ,mCapturePlanner(cameraId)
     ,mSmartStabilization(false)
     ,mAELockFlashStage(CAM_FLASH_STAGE_NONE)
     ,mPublicShutter(-1)
@@ -170,6 +173,7 @@ ControlThread::ControlThread(int cameraId) :
     ,mSkipPreview(false)
     ,mCurrentExpID(EXP_ID_INVALID)
     ,mNextExpID(EXP_ID_INVALID)
+    ,mNextRequestId(-1)
     ,mNumCaptures(0)
     ,mNumSounds(0)
     ,mDepthMode(false)
@@ -210,6 +214,32 @@ status_t ControlThread::init()
     bool extIsp = PlatformData::supportsContinuousJpegCapture(mCameraId);
     CameraDump::setDumpDataFlag();
 
+    // parameter calls block the application, serve them ahead of the
+    // messages queued by the worker threads
+    mMessageQueue.setPriority(MESSAGE_ID_SET_PARAMETERS, MESSAGE_PRIORITY_HIGH);
+    mMessageQueue.setPriority(MESSAGE_ID_GET_PARAMETERS, MESSAGE_PRIORITY_HIGH);
+    mMessageQueue.setPriority(MESSAGE_ID_CANCEL_PICTURE, MESSAGE_PRIORITY_HIGH);
+    // the other API calls come from binder threads too, keep them in order
+    // with the ones above whichever thread sends them
+    static const MessageId apiCalls[] = {
+        MESSAGE_ID_EXIT,
+        MESSAGE_ID_SET_PREVIEW_WINDOW,
+        MESSAGE_ID_START_PREVIEW,
+        MESSAGE_ID_STOP_PREVIEW,
+        MESSAGE_ID_START_RECORDING,
+        MESSAGE_ID_STOP_RECORDING,
+        MESSAGE_ID_TAKE_PICTURE,
+        MESSAGE_ID_SMART_SHUTTER_PICTURE,
+        MESSAGE_ID_PANORAMA_PICTURE,
+        MESSAGE_ID_AUTO_FOCUS,
+        MESSAGE_ID_CANCEL_AUTO_FOCUS,
+        MESSAGE_ID_COMMAND,
+        MESSAGE_ID_STORE_METADATA_IN_BUFFER,
+        MESSAGE_ID_RELEASE
+    };
+    for (unsigned int i = 0; i < sizeof(apiCalls) / sizeof(apiCalls[0]); i++)
+        mMessageQueue.setPriority(apiCalls[i], MESSAGE_PRIORITY_ORDERED);
+
     AtomISP * isp = NULL;
     mScalerService = new ScalerService(mCameraId);
     if (mScalerService == NULL) {
@@ -913,6 +943,7 @@ status_t ControlThread::takePicture()
         msg.id = MESSAGE_ID_SMART_SHUTTER_PICTURE;
     else
         msg.id = MESSAGE_ID_TAKE_PICTURE;
+    msg.data.takePicture.shutterTime = systemTime();
 
     status = mMessageQueue.send(&msg);
     if (status == NO_ERROR) {
@@ -1116,6 +1147,22 @@ void ControlThread::sendCommand(int32_t cmd, int32_t arg1, int32_t arg2)
         mMessageQueue.send(&msg);
 }
 
+/**
+ * Writes the buffer pool state to fd, called from the binder thread
+ * serving dumpsys
+ */
+void ControlThread::dump(int fd)
+{
+    LOG1("@%s", __FUNCTION__);
+    String8 out;
+
+    if (mCallbacks != NULL)
+        mCallbacks->bufferPool()->dump(out);
+    if (m3AThread != NULL)
+        m3AThread->dump(out);
+    ::write(fd, out.string(), out.length());
+}
+
 void ControlThread::postProcCaptureTrigger()
 {
     LOG1("@%s", __FUNCTION__);
@@ -2734,6 +2781,8 @@ status_t ControlThread::handleMessageStopPreview()
     // it between stop and start
     mPreviewThread->setPreviewWindow(NULL);
 preview_stopped:
+    // free the capture buffers no one holds, the next preview may not capture
+    mCallbacks->bufferPool()->trim();
     // return status and unblock message sender
     mMessageQueue.reply(MESSAGE_ID_STOP_PREVIEW, status);
     return status;
@@ -3775,19 +3824,33 @@ void ControlThread::resetOfflineCaptureControl()
 {
     mSkipPreview = false;
     mNextExpID   = EXP_ID_INVALID;
+    mNextRequestId = -1;
     mNumSounds   = 0;
     mNumCaptures = 0;
 }
 
-void ControlThread::triggerOfflineCaptureControl(int numSounds, int startId, bool skip)
+/**
+ * Arms the capture of the next mBurstLength frames
+ *
+ * \param startId exposure ID of the first frame, the next ones follow
+ *        every mFpsAdaptSkip + 1 frames
+ * \param startRequestId when not -1, the frames are the ones carrying
+ *        the request ids startRequestId...startRequestId + mBurstLength - 1
+ *        in their FrameResult. startId is only used for the frames whose
+ *        sensor settings are not known.
+ */
+void ControlThread::triggerOfflineCaptureControl(int numSounds, int startId, bool skip,
+                                                 int startRequestId)
 {
-    LOG1("@%s num sound:%d start exp id:%d skip:%d", __FUNCTION__, numSounds, startId, skip);
+    LOG1("@%s num sound:%d start exp id:%d skip:%d request id:%d", __FUNCTION__,
+         numSounds, startId, skip, startRequestId);
     Mutex::Autolock lock(mOfflineControlLock);
     if (startId < EXP_ID_MIN || startId > EXP_ID_MAX)
         return;
 
     mSkipPreview = skip;
     mNextExpID   = startId;
+    mNextRequestId = startRequestId;
     mNumSounds   = numSounds;
     mNumCaptures = mBurstLength;
 }
@@ -3813,16 +3876,26 @@ void ControlThread::handleOfflineCaptureControl(AtomBuffer *buff)
 
     LOG2("@%s for id:%d", __FUNCTION__, mCurrentExpID)
     if (mNumSounds > 0 || mNumCaptures > 0) {
-        LOG1("@%s num sound:%d current ID:%d expected exposure id:%d", __FUNCTION__,
-                mNumSounds, mCurrentExpID, mNextExpID);
-
-        if (mCurrentExpID > mNextExpID && ((mCurrentExpID - mNextExpID) < (EXP_ID_MAX >> 1))) {
-            // trigger late or frame droped
-            LOGW("late trigger comes at :%d while current is :%d", mNextExpID, mCurrentExpID);
-            mNextExpID = mCurrentExpID;
+        LOG1("@%s num sound:%d current ID:%d expected exposure id:%d request id:%d",
+                __FUNCTION__, mNumSounds, mCurrentExpID, mNextExpID, mNextRequestId);
+
+        // a bracket frame is the one its exposure request first reached
+        bool byRequest = mNextRequestId >= 0 && buff->result.valid;
+        bool picked;
+        if (byRequest) {
+            picked = buff->result.requestId >= mNextRequestId;
+            if (buff->result.requestId > mNextRequestId)
+                LOGW("bracket requests %d to %d lost", mNextRequestId, buff->result.requestId - 1);
+        } else {
+            if (mCurrentExpID > mNextExpID && ((mCurrentExpID - mNextExpID) < (EXP_ID_MAX >> 1))) {
+                // trigger late or frame droped
+                LOGW("late trigger comes at :%d while current is :%d", mNextExpID, mCurrentExpID);
+                mNextExpID = mCurrentExpID;
+            }
+            picked = mCurrentExpID == mNextExpID;
         }
 
-        if (mCurrentExpID == mNextExpID) {
+        if (picked) {
             // play shutter sound if need
             if (mNumSounds > 0) {
                 mCallbacksThread->shutterSound();
@@ -3845,9 +3918,16 @@ void ControlThread::handleOfflineCaptureControl(AtomBuffer *buff)
 
             // the next
             if (mFpsAdaptSkip > 0) {
-                mNextExpID = NEXTN_EID(mNextExpID, mFpsAdaptSkip + 1);
+                mNextExpID = NEXTN_EID(mCurrentExpID, mFpsAdaptSkip + 1);
             } else {
-                mNextExpID = NEXT_EID(mNextExpID);
+                mNextExpID = NEXT_EID(mCurrentExpID);
+            }
+            if (byRequest) {
+                // once the requests are used up, lost ones leave captures
+                // to fill with the frames that follow
+                mNextRequestId = buff->result.requestId + 1;
+                if (mNextRequestId >= mBurstLength)
+                    mNextRequestId = -1;
             }
         }
     }
@@ -4065,10 +4145,13 @@ status_t ControlThread::captureStillPic()
         mBracketManager->startBracketing(&startExpId);
         // offline bracketing
         if (mState == STATE_CONTINUOUS_CAPTURE) {
+            // exposure brackets carry their index as request id
+            int startRequestId =
+                (mBracketManager->getBracketMode() == BRACKET_EXPOSURE) ? 0 : -1;
             if (mHdr.enabled) // HDR capture 3 with 1 shutter sound only
-                triggerOfflineCaptureControl(1, startExpId, true);
+                triggerOfflineCaptureControl(1, startExpId, true, startRequestId);
             else
-                triggerOfflineCaptureControl(mBurstLength, startExpId);
+                triggerOfflineCaptureControl(mBurstLength, startExpId, false, startRequestId);
         }
     }
 
@@ -4137,7 +4220,11 @@ status_t ControlThread::captureStillPic()
             PERFORMANCE_TRACES_BREAKDOWN_STEP_PARAM("BreaketGotFrame",
                         snapshotBuffer.frameCounter);
         } else {
-            status = mISP->getSnapshot(&snapshotBuffer, &postviewBuffer);
+            // single HAL ZSL shots are encoded straight from the ISP ring
+            // buffer. HDR, bursts and ULL keep their input frames longer.
+            bool zeroCopy = mISP->isHALZSLEnabled() && !mHdr.enabled && mBurstLength <= 1
+                            && !mULL->isActive();
+            status = mISP->getSnapshot(&snapshotBuffer, &postviewBuffer, zeroCopy);
             PERFORMANCE_TRACES_BREAKDOWN_STEP_PARAM("ISPGotFrame",
                         snapshotBuffer.frameCounter);
         }
@@ -4202,6 +4289,8 @@ status_t ControlThread::captureStillPic()
         // normally this is done by PictureThread, but as no
         // encoding was done, free the allocated metadata
         picMetaData.free(m3AControls);
+        if (mISP->isHALZSLEnabled() && snapshotBuffer.owner == mISP)
+            mISP->returnBuffer(&snapshotBuffer);
     }
 
     if (mState == STATE_CONTINUOUS_CAPTURE && mBurstLength <= 1)
@@ -5183,6 +5272,7 @@ status_t ControlThread::handleMessageRelease()
     status = handleMessageExit(&msg.data.exit);
     // return Gfx buffers
     mPreviewThread->returnPreviewBuffers();
+    mCallbacks->bufferPool()->trim();
     mMessageQueue.reply(MESSAGE_ID_RELEASE, status);
     return status;
 }
@@ -5278,6 +5368,10 @@ status_t ControlThread::handleMessagePictureDone(MessagePicture *msg)
     LOG1("@%s", __FUNCTION__);
     status_t status = NO_ERROR;
 
+    // a zero-copy HAL ZSL snapshot is an ISP ring buffer, give it back first
+    if (mISP->isHALZSLEnabled() && msg->snapshotBuf.owner == mISP)
+        mISP->returnBuffer(&msg->snapshotBuf);
+
     if (msg->snapshotBuf.type == ATOM_BUFFER_PANORAMA) {
         // panorama pictures are special, they use the panorama engine memory.
         // we return them to panorama for releasing
@@ -5817,11 +5911,16 @@ status_t ControlThread::processDynamicParameters(const CameraParameters *oldPara
 
 /**
  * get the number of snapshot buffers that we actually need
+ *
+ * The count comes from mCapturePlanner, which also limits it to the capture
+ * memory budget of the camera. The same number of postview buffers is used.
  */
 int ControlThread::getNeededSnapshotBufNum(bool videoMode)
 {
     LOG1("@%s video mode:%d", __FUNCTION__, videoMode);
-    int maxNum, recommendedNum, contShootingLimit, clipTo;
+    CapturePlanner::Request request;
+    AtomBuffer formatDescriptorSs = AtomBufferFactory::createAtomBuffer(ATOM_BUFFER_FORMAT_DESCRIPTOR);
+    AtomBuffer formatDescriptorPv = AtomBufferFactory::createAtomBuffer(ATOM_BUFFER_FORMAT_DESCRIPTOR);
 
     if (PlatformData::supportsContinuousJpegCapture(mCameraId)) {
         // In continuousJpegCapture use buffers allocated in AtomISP
@@ -5837,29 +5936,61 @@ int ControlThread::getNeededSnapshotBufNum(bool videoMode)
      * Bracketing needs more buffers than burst.
      * so we make a difference between them
      */
-    recommendedNum = ((mBracketManager->getBracketMode() != BRACKET_NONE) ?
+    request.maxBuffers = ((mBracketManager->getBracketMode() != BRACKET_NONE) ?
         PlatformData::getMaxNumYUVBufferForBracket(mCameraId) :
         PlatformData::getMaxNumYUVBufferForBurst(mCameraId));
 
     // continuous shooting need one more buffer reserved
     if (mISP->getContinuousCaptureNumber() > mUllBurstLength) { // timenudge
-        contShootingLimit = mISP->getContinuousCaptureNumber();
+        request.mode = CapturePlanner::MODE_TIME_NUDGE;
+        request.minBuffers = mISP->getContinuousCaptureNumber();
     } else if (mContShootingState !=  CONT_SHOOTING_NONE) { // in continuous shooting
-        contShootingLimit = DEFAULT_BUF_NUM_FOR_CONT_SHOOTING;
+        request.mode = CapturePlanner::MODE_CONTINUOUS_SHOOTING;
+        request.minBuffers = DEFAULT_BUF_NUM_FOR_CONT_SHOOTING;
     } else if (mULL->isActive()) {
-        contShootingLimit = mULL->getULLBurstLength() + 1;
+        request.mode = CapturePlanner::MODE_ULL;
+        request.minBuffers = mULL->getULLBurstLength() + 1;
     } else {
-        contShootingLimit = mISP->getContinuousCaptureNumber() + 1;
+        if (mBracketManager->getBracketMode() != BRACKET_NONE)
+            request.mode = CapturePlanner::MODE_BRACKET;
+        else if (mBurstLength > 1)
+            request.mode = CapturePlanner::MODE_BURST;
+        else
+            request.mode = CapturePlanner::MODE_SINGLE;
+        request.minBuffers = mISP->getContinuousCaptureNumber() + 1;
     }
 
-    /**
-     * Get the buffer required and clip it to ensure we
-     * allocate proper number of YUV buffers.
-     */
-    clipTo = MAX(recommendedNum, contShootingLimit);
-    maxNum = MAX(mBurstLength, contShootingLimit);
+    // HDR composes the whole bracket at once
+    if (mHdr.enabled)
+        request.minBuffers = MAX(request.minBuffers, mHdr.bracketNum);
+
+    request.frames = mBurstLength;
+
+    // snapshot buffers are allocated as NV12, see allocateSnapshotAndPostviewBuffers()
+    mISP->getSnapshotFrameFormat(formatDescriptorSs);
+    mISP->getPostviewFrameFormat(formatDescriptorPv);
+    request.snapshotSize = frameSize(V4L2_PIX_FMT_NV12, formatDescriptorSs.width,
+                                     formatDescriptorSs.height);
+    request.postviewSize = frameSize(formatDescriptorPv.fourcc, formatDescriptorPv.width,
+                                     formatDescriptorPv.height);
+
+    // the raw ringbuffer holds sensor frames, counted at snapshot size
+    if (mState == STATE_CONTINUOUS_CAPTURE) {
+        request.ringBuffers = mISP->getContinuousRingBufferSize();
+        request.ringBufferSize = frameSize(mHwcg.mSensorCI->getRawFormat(),
+                                           formatDescriptorSs.width,
+                                           formatDescriptorSs.height);
+    } else {
+        request.ringBuffers = 0;
+        request.ringBufferSize = 0;
+    }
+
+    const CapturePlanner::Plan &plan = mCapturePlanner.plan(request);
 
-    return CLIP(maxNum, clipTo, 1);
+    // the pool keeps idle what the next capture of this plan allocates
+    mCallbacks->bufferPool()->setMemoryLimit(plan.memory
+                                             - plan.ringBuffers * request.ringBufferSize);
+    return plan.snapshotBuffers;
 }
 
 /**
@@ -8184,6 +8315,7 @@ status_t ControlThread::handleMessageGetParameters(MessageGetParameters *msg)
         // let app know if we support zoom in the preview mode indicated
         mISP->getZoomRatios(&mParameters);
         mISP->getFocusDistances(&mParameters);
+        mCapturePlanner.writeParameters(&mParameters);
 
         String8 params = mParameters.flatten();
         int len = params.length();
@@ -9207,6 +9339,8 @@ status_t ControlThread::waitForAndExecuteMessage()
             break;
 
         case MESSAGE_ID_TAKE_PICTURE:
+            // HAL ZSL picks the frame that was exposed at this time
+            mISP->setShutterTime(msg.data.takePicture.shutterTime);
             status = handleMessageTakePicture();
             break;
 
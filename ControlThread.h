@@ -45,6 +45,7 @@
 #include "AtomCP.h"
 #include "UltraLowLight.h"
 #include "BracketManager.h"
+#include "CapturePlanner.h"
 #include "I3AControls.h"
 #include "IAtomIspObserver.h"
 #include "PictureThread.h"
@@ -117,6 +118,7 @@ public:
     status_t recoverPreview();
 
     void sendCommand( int32_t cmd, int32_t arg1, int32_t arg2);
+    void dump(int fd);
 
     // return true if preview or recording is enabled
     bool previewEnabled();
@@ -222,6 +224,10 @@ private:
         AtomBuffer returnBuf;
     };
 
+    struct MessageTakePicture {
+        nsecs_t shutterTime;    // systemTime() at takePicture()
+    };
+
     struct MessagePicture {
         AtomBuffer snapshotBuf;
         AtomBuffer postviewBuf;
@@ -282,6 +288,9 @@ private:
     // union of all message data
     union MessageData {
 
+        // MESSAGE_ID_TAKE_PICTURE
+        MessageTakePicture takePicture;
+
         // MESSAGE_ID_ENCODING_DONE
         MessagePicture encodingDone;
 
@@ -717,8 +726,9 @@ private:
     bool selectSdvSize(int &width, int &height);
     void encodeVideoSnapshot(AtomBuffer &buff);
 
-    // offline capture control by exposure id
-    void triggerOfflineCaptureControl(int numSounds, int startId, bool skip = false);
+    // offline capture control by exposure id, or by request id for brackets
+    void triggerOfflineCaptureControl(int numSounds, int startId, bool skip = false,
+                                      int startRequestId = -1);
     void resetOfflineCaptureControl();
     void handleOfflineCaptureControl(AtomBuffer *buff);
 
@@ -809,6 +819,7 @@ private:
                                 exp:mBurstLength is 9, mAllocatedSnapshotBuffers is 5,
                                 mBurstBufsToReturn should be 4*/
     int mUllBurstLength;     /*<! Burst length for ULL*/
+    CapturePlanner mCapturePlanner; /*<! snapshot buffer counts under the memory budget */
     bool mSmartStabilization; /*<! Smart stabilization for front camera */
     HdrImaging mHdr;
     ExtIsp mExtIsp;
@@ -875,6 +886,7 @@ private:
     bool mSkipPreview;              /*!< if to skip this frame in preview */
     unsigned int mCurrentExpID;     /*!< exposure ID of current preview frame*/
     unsigned int mNextExpID;        /*!< next expected buffer exposure ID */
+    int mNextRequestId;             /*!< request id of the next bracket frame, -1 to pick by exposure ID */
     int mNumCaptures;               /*!< control the the number of capture */
     int mNumSounds;                 /*!< shutter sound times,trigger shutter sound by EOF/preview buffer event*/
 
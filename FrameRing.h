@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_FRAME_RING_H
+#define ANDROID_LIBCAMERA_FRAME_RING_H
+
+#include <stdint.h>
+#include <cutils/atomic.h>
+
+// Compile time cache line size used to keep the producer and consumer
+// indices apart. PlatformData::cacheLineSize() is only known at runtime.
+#define FRAME_RING_CACHE_LINE 64
+
+namespace android {
+
+/**
+ * \class FrameRing
+ *
+ * Bounded lock-free ring for exactly one producer thread and one consumer
+ * thread.
+ *
+ * The producer only writes mTail and the consumer only writes mHead, each
+ * on its own cache line, so a push or a pop costs one release store and
+ * touches the other side's line only when its cached copy of the other
+ * index says the ring looks full or empty.
+ * The ring never blocks, waking up an idle consumer is left to the user.
+ */
+template <class T>
+class FrameRing {
+public:
+    FrameRing(int capacity) :
+        mSlots(NULL)
+        ,mMask(0)
+        ,mHead(0)
+        ,mCachedTail(0)
+        ,mTail(0)
+        ,mCachedHead(0)
+    {
+        int size = 1;
+        while (size < capacity)
+            size <<= 1;
+        mSlots = new T[size];
+        mMask = size - 1;
+    }
+
+    ~FrameRing()
+    {
+        delete [] mSlots;
+        mSlots = NULL;
+    }
+
+    // Producer side: copy item into the ring, returns false if the ring is full
+    bool push(const T &item)
+    {
+        int32_t tail = mTail;
+        if (tail - mCachedHead > mMask) {
+            mCachedHead = android_atomic_acquire_load(&mHead);
+            if (tail - mCachedHead > mMask)
+                return false;
+        }
+        mSlots[tail & mMask] = item;
+        android_atomic_release_store(tail + 1, &mTail);
+        return true;
+    }
+
+    // Consumer side: the oldest item, or NULL if the ring is empty
+    T *front()
+    {
+        int32_t head = mHead;
+        if (head == mCachedTail) {
+            mCachedTail = android_atomic_acquire_load(&mTail);
+            if (head == mCachedTail)
+                return NULL;
+        }
+        return &mSlots[head & mMask];
+    }
+
+    // Consumer side: release the item returned by front()
+    void pop()
+    {
+        android_atomic_release_store(mHead + 1, &mHead);
+    }
+
+    // Can be called from any thread, the result is only a snapshot
+    int size() const
+    {
+        return android_atomic_acquire_load(&mTail) - android_atomic_acquire_load(&mHead);
+    }
+
+    bool isEmpty() const { return size() == 0; }
+
+    int capacity() const { return mMask + 1; }
+
+// prevent copy constructor and assignment operator
+private:
+    FrameRing(const FrameRing& other);
+    FrameRing& operator=(const FrameRing& other);
+
+private:
+    T *mSlots;
+    int32_t mMask;
+    char mPadStart[FRAME_RING_CACHE_LINE];
+
+    // consumer cache line
+    volatile int32_t mHead;  /*!< next slot to read */
+    int32_t mCachedTail;  /*!< consumer's copy of mTail */
+    char mPadConsumer[FRAME_RING_CACHE_LINE - 2 * sizeof(int32_t)];
+
+    // producer cache line
+    volatile int32_t mTail;  /*!< next slot to write */
+    int32_t mCachedHead;  /*!< producer's copy of mHead */
+    char mPadProducer[FRAME_RING_CACHE_LINE - 2 * sizeof(int32_t)];
+};
+
+}; // namespace android
+
+#endif // ANDROID_LIBCAMERA_FRAME_RING_H
@@ -218,7 +218,7 @@ public:
     virtual status_t initAeBracketing() = 0;
     virtual status_t deinitAeBracketing() = 0;
     virtual status_t applyEv(float bias) = 0;
-    virtual int      applyEvGroup(float values[], int depth, SensorAeConfig aeConfig[]) = 0;
+    virtual int      applyEvGroup(float values[], int depth, SensorAeConfig aeConfig[], const int requestIds[]) = 0;
     virtual status_t getExposureInfo(SensorAeConfig& sensorAeConfig) = 0;
     virtual size_t   getAeMaxNumWindows() = 0;
     virtual size_t   getAfMaxNumWindows() = 0;
@@ -250,6 +250,8 @@ public:
 
     virtual status_t switchModeAndRate(AtomMode mode, float fps) = 0;
     virtual status_t apply3AProcess(bool read_stats, struct timeval *frame_timestamp, int orientation) = 0;
+    // Appends the time spent in each step of apply3AProcess() to out
+    virtual void dumpTimings(String8 &out) = 0;
     virtual status_t startStillAf() = 0;
     virtual status_t stopStillAf() = 0;
     virtual AfStatus isStillAfComplete() = 0;
@@ -69,6 +69,23 @@ enum BatteryStatus {
     BATTERY_STATUS_ALERT,        //flash on with <1A/Unused
     BATTERY_STATUS_CRITICAL,     //disable flash
 };
+/**
+ * Told when the ISP parameters given to IHWIspControl::setAicParameter()
+ * have been applied by the driver, or refused. It is called from the
+ * thread that applies them and must not block.
+ */
+class IIspParamsListener
+{
+public:
+    virtual ~IIspParamsListener() {}
+    /**
+     * \param request ioctl request code of the parameters
+     * \param frameId exposure id of the statistics they were computed from
+     * \param ret result of the ioctl
+     */
+    virtual void ispParamsApplied(int request, unsigned int frameId, int ret) = 0;
+};
+
 /* Abstraction of HW algorithms control interface for 3A support*/
 // Temporarily current AtomISP APIs are in IHWIspControl, as the top level IF for the reset of the HAL.
 // Our target is APIs will be seperated to several interface classes in the near future
@@ -121,7 +138,11 @@ public:
     virtual status_t setLLS(int mode) = 0;
     virtual status_t setShotMode(int mode) = 0;
 
+    // setAicParameter() does not wait for the driver, the configurations the
+    // parameters point to must not be modified before reclaimAicParameter()
     virtual int setAicParameter(struct atomisp_parameters *aic_params) = 0;
+    virtual void reclaimAicParameter() = 0;
+    virtual void setIspParamsListener(IIspParamsListener *listener) = 0;
     virtual int setIspParameter(struct atomisp_parm *isp_params) = 0;
     virtual int getIspStatistics(struct atomisp_3a_statistics *statistics) = 0;
     virtual int setGdcConfig(const struct morph_table *tbl) = 0;
@@ -201,7 +222,20 @@ public:
     virtual unsigned int getExposureDelay() = 0;
 
     virtual int setExposure(struct atomisp_exposure *) = 0;
-    virtual int setExposureGroup(struct atomisp_exposure exposures[], int depth) = 0;
+    /**
+     * Queues one exposure per frame for consecutive frames
+     *
+     * \param requestIds id per exposure reported back by getFrameResult()
+     *        for the first frame it reaches, or NULL
+     * \return exposure id of the frame receiving the first exposure
+     */
+    virtual int setExposureGroup(struct atomisp_exposure exposures[], int depth, const int requestIds[]) = 0;
+    /**
+     * Gives the exposure the sensor had for the frame with the exposure id
+     *
+     * \return false if the frame is too old or was not tracked
+     */
+    virtual bool getFrameResult(unsigned int expId, FrameResult *result) = 0;
     virtual void getSensorData(sensorPrivateData *sensor_data) = 0;
     virtual int  getModeInfo(struct atomisp_sensor_mode_data *mode_data) = 0;
     virtual int  getExposureTime(int *exposure_time) = 0;
@@ -18,13 +18,15 @@
 #include "LogHelper.h"
 #include "ImageScaler.h"
 #include "assert.h"
+#include <utils/threads.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define RESOLUTION_VGA_WIDTH    640
 #define RESOLUTION_VGA_HEIGHT   480
 #define RESOLUTION_QVGA_WIDTH   320
 #define RESOLUTION_QVGA_HEIGHT  240
-#define RESOLUTION_QCIF_WIDTH   176
-#define RESOLUTION_QCIF_HEIGHT  144
 #define MIN(a,b) ((a)<(b)?(a):(b))
 
 namespace android {
@@ -156,7 +158,187 @@ void ImageScaler::trimNv12Image(unsigned char *dst, const unsigned char *src,
     }
 }
 
-// VGA-QCIF begin (Enzo specific)
+/**
+ * Scaling tables are kept for the last few geometries. In practice there is
+ * one entry per thumbnail/postview/preview callback size in use.
+ */
+static const int MAX_CACHED_SCALING_TABLES = 4;
+
+/**
+ * \class Nv12ScalingTable
+ *
+ * Precomputed source offsets and 8-bit fractional weights for the bilinear
+ * NV12 down-scaler of one (src_w, src_h) -> (dest_w, dest_h) geometry,
+ * including the horizontal crop that keeps the destination aspect ratio.
+ */
+class Nv12ScalingTable : public LightRefBase<Nv12ScalingTable> {
+public:
+    Nv12ScalingTable(int dest_w, int dest_h, int src_w, int src_h, int l_skip, int skip);
+    ~Nv12ScalingTable();
+
+    bool matches(int dest_w, int dest_h, int src_w, int src_h) const {
+        return destW == dest_w && destH == dest_h && srcW == src_w && srcH == src_h;
+    }
+
+    const int destW, destH, srcW, srcH;
+    int *xOffsetY;      // left luma sample of each destination column
+    uint16_t *xFracY;   // weight of the right luma sample
+    int *xOffsetUV;     // left chroma byte of each destination U/V byte
+    uint16_t *xFracUV;  // weight of the right chroma sample
+    int *yOffset;       // upper source line of each destination line
+    int *yFrac;         // weight of the lower source line
+};
+
+Nv12ScalingTable::Nv12ScalingTable(int dest_w, int dest_h, int src_w, int src_h,
+                                   int l_skip, int skip) :
+    destW(dest_w)
+    ,destH(dest_h)
+    ,srcW(src_w)
+    ,srcH(src_h)
+{
+    const int scaling_w = ((src_w - skip) << 8) / dest_w;
+    const int scaling_h = (src_h << 8) / dest_h;
+    const int uvWidth = (dest_w >> 1) << 1;
+
+    xOffsetY = new int[dest_w];
+    xFracY = new uint16_t[dest_w];
+    xOffsetUV = new int[uvWidth];
+    xFracUV = new uint16_t[uvWidth];
+    yOffset = new int[dest_h];
+    yFrac = new int[dest_h];
+
+    for (int j = 0; j < dest_w; j++) {
+        int x1 = j * scaling_w;
+        xOffsetY[j] = (x1 >> 8) + l_skip;
+        xFracY[j] = x1 & 0xff;
+    }
+    for (int j = 0; j < uvWidth >> 1; j++) {
+        int x1 = j * scaling_w;
+        int x2 = (x1 >> 8) + l_skip / 2;
+        xOffsetUV[2 * j] = x2 << 1;           // U
+        xOffsetUV[2 * j + 1] = (x2 << 1) + 1; // V
+        xFracUV[2 * j] = xFracUV[2 * j + 1] = x1 & 0xff;
+    }
+    for (int i = 0; i < dest_h; i++) {
+        int y1 = i * scaling_h;
+        yOffset[i] = y1 >> 8;
+        yFrac[i] = y1 & 0xff;
+    }
+}
+
+Nv12ScalingTable::~Nv12ScalingTable()
+{
+    delete [] xOffsetY;
+    delete [] xFracY;
+    delete [] xOffsetUV;
+    delete [] xFracUV;
+    delete [] yOffset;
+    delete [] yFrac;
+}
+
+static Mutex sScalingTableLock;
+// most recently used first
+static sp<Nv12ScalingTable> sScalingTables[MAX_CACHED_SCALING_TABLES];
+
+/**
+ * Returns the cached scaling table of the geometry, building it on a miss.
+ * Returns NULL if the source is too narrow for the destination aspect ratio.
+ */
+static sp<Nv12ScalingTable> getNv12ScalingTable(int dest_w, int dest_h, int src_w, int src_h)
+{
+    Mutex::Autolock lock(sScalingTableLock);
+
+    int i;
+    for (i = 0; i < MAX_CACHED_SCALING_TABLES - 1; i++) {
+        if (sScalingTables[i] == NULL || sScalingTables[i]->matches(dest_w, dest_h, src_w, src_h))
+            break;
+    }
+    sp<Nv12ScalingTable> table = sScalingTables[i];
+
+    if (table == NULL || !table->matches(dest_w, dest_h, src_w, src_h)) {
+        // Correct aspect ratio is defined by destination buffer
+        long int aspect_ratio = (dest_w << 16) / dest_h;
+        // Then, we calculate what should be the width of source image
+        // (should be multiple by four)
+        int proper_source_width = (aspect_ratio * (long int)(src_h) + 0x8000L) >> 16;
+        proper_source_width = (proper_source_width + 2) & ~0x3;
+        // Now, the source image should have some surplus width
+        if (src_w < proper_source_width) {
+            LOGE("%s: source image too narrow", __func__);
+            return NULL;
+        }
+        // Let's divide the surplus to both sides
+        int l_skip = (src_w - proper_source_width) >> 1;
+        int r_skip = src_w - proper_source_width - l_skip;
+
+        LOG1("@%s: new table for %dx%d -> %dx%d", __FUNCTION__, src_w, src_h, dest_w, dest_h);
+        table = new Nv12ScalingTable(dest_w, dest_h, src_w, src_h, l_skip, l_skip + r_skip);
+    }
+
+    // move to the front, the least recently used one falls off the end
+    for (; i > 0; i--)
+        sScalingTables[i] = sScalingTables[i - 1];
+    sScalingTables[0] = table;
+
+    return table;
+}
+
+/**
+ * Horizontal pass: out[k] = (line[off[k]] * (256 - frac[k]) + line[off[k] + step] * frac[k]) >> 8
+ *
+ * The samples are gathered through the offset table into 'gather' (2 * n
+ * entries) and blended eight at a time.
+ */
+static void filterLineHorizontal(const unsigned char *line, const int *off, int step,
+                                 const uint16_t *frac, uint16_t *gather, uint16_t *out, int n)
+{
+    uint16_t *left = gather;
+    uint16_t *right = gather + n;
+    for (int k = 0; k < n; k++) {
+        left[k] = line[off[k]];
+        right[k] = line[off[k] + step];
+    }
+
+    int k = 0;
+#ifdef __SSE2__
+    const __m128i one = _mm_set1_epi16(256);
+    for (; k + 8 <= n; k += 8) {
+        __m128i l = _mm_loadu_si128((const __m128i *)(left + k));
+        __m128i r = _mm_loadu_si128((const __m128i *)(right + k));
+        __m128i w = _mm_loadu_si128((const __m128i *)(frac + k));
+        // at most 255 * 256, the 16-bit sum cannot overflow
+        __m128i v = _mm_add_epi16(_mm_mullo_epi16(l, _mm_sub_epi16(one, w)), _mm_mullo_epi16(r, w));
+        _mm_storeu_si128((__m128i *)(out + k), _mm_srli_epi16(v, 8));
+    }
+#endif
+    for (; k < n; k++)
+        out[k] = (left[k] * (256 - frac[k]) + right[k] * frac[k]) >> 8;
+}
+
+/**
+ * Vertical pass: dest[k] = (upper[k] * (256 - frac) + lower[k] * frac) >> 8
+ */
+static void filterLinesVertical(const uint16_t *upper, const uint16_t *lower, int frac,
+                                unsigned char *dest, int n)
+{
+    int k = 0;
+#ifdef __SSE2__
+    const __m128i w0 = _mm_set1_epi16(256 - frac);
+    const __m128i w1 = _mm_set1_epi16(frac);
+    for (; k + 16 <= n; k += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(upper + k));
+        __m128i b = _mm_loadu_si128((const __m128i *)(lower + k));
+        __m128i lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, w0), _mm_mullo_epi16(b, w1)), 8);
+        a = _mm_loadu_si128((const __m128i *)(upper + k + 8));
+        b = _mm_loadu_si128((const __m128i *)(lower + k + 8));
+        __m128i hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(a, w0), _mm_mullo_epi16(b, w1)), 8);
+        _mm_storeu_si128((__m128i *)(dest + k), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; k < n; k++)
+        dest[k] = MIN(((upper[k] * (256 - frac) + lower[k] * frac) >> 8), 0xff);
+}
+
 void ImageScaler::downScaleAndCropNv12Image(unsigned char *dest, const unsigned char *src,
     const int dest_w, const int dest_h, const int dest_bpl,
     const int src_w, const int src_h, const int src_bpl,
@@ -177,91 +359,82 @@ void ImageScaler::downScaleAndCropNv12Image(unsigned char *dest, const unsigned
         downScaleAndCropNv12ImageQvga(dest, src, dest_bpl, src_bpl);
         return;
     }
-    if (src_w == RESOLUTION_VGA_WIDTH && src_h == RESOLUTION_VGA_HEIGHT
-        && src_skip_lines_top == 0 && src_skip_lines_bottom == 0
-        && dest_w == RESOLUTION_QCIF_WIDTH && dest_h == RESOLUTION_QCIF_WIDTH) {
-        downScaleAndCropNv12ImageQcif(dest, src, dest_bpl, src_bpl);
-        return;
-    }
 
     // skip lines from top
     if (src_skip_lines_top > 0)
         src += src_skip_lines_top * src_bpl;
 
-    // Correct aspect ratio is defined by destination buffer
-    long int aspect_ratio = (dest_w << 16) / dest_h;
-    // Then, we calculate what should be the width of source image
-    // (should be multiple by four)
-    int proper_source_width = (aspect_ratio * (long int)(src_h) + 0x8000L) >> 16;
-    proper_source_width = (proper_source_width + 2) & ~0x3;
-    // Now, the source image should have some surplus width
-    if (src_w < proper_source_width) {
-        LOGE("%s: source image too narrow", __func__);
-        return;
-    }
-    // Let's divide the surplus to both sides
-    int l_skip = (src_w - proper_source_width) >> 1;
-    int r_skip = src_w - proper_source_width - l_skip;
-    int skip = l_skip + r_skip;
-
-    int i, j, x1, y1, x2, y2;
-    unsigned int val_1, val_2;
-    int dx, dy;
-    int src_Y_data = src_bpl * (src_h + src_skip_lines_bottom + (src_skip_lines_top >> 1));
-    int dest_Y_data = dest_bpl * dest_h;
-    int flag, width, height;
     if (0 == dest_w || 0 == dest_h) {
         LOGE("%s,dest_w or dest_h should not be 0", __func__);
         return;
     }
-    const int scaling_w = ((src_w - skip) << 8) / dest_w;
-    const int scaling_h = (src_h << 8) / dest_h;
-    dx = 0;
-    dy = 0;
+
+    sp<Nv12ScalingTable> table = getNv12ScalingTable(dest_w, dest_h, src_w, src_h);
+    if (table == NULL)
+        return;
+
+    const unsigned char *srcUV = src + src_bpl * (src_h + src_skip_lines_bottom + (src_skip_lines_top >> 1));
+    unsigned char *destUV = dest + dest_bpl * dest_h;
+
+    // Separable bilinear filter: horizontally filtered source lines are kept
+    // in 16-bit line buffers, so each source line is filtered only once even
+    // when consecutive destination lines share it.
+    uint16_t *lines = new uint16_t[4 * dest_w];
+    uint16_t *line0 = lines;
+    uint16_t *line1 = lines + dest_w;
+    uint16_t *gather = lines + 2 * dest_w;
+
     // get Y data
-    for (i = 0; i < dest_h; i++) {
-        y1 = i * scaling_h;
-        dy = y1 & 0xff;
-        y2 = y1 >> 8;
-        for (j = 0; j < dest_w; j++) {
-            x1 = j * scaling_w;
-            dx = x1 & 0xff;
-            x2 = (x1 >> 8) + l_skip;
-            val_1 = ((unsigned int)src[y2 * src_bpl + x2] * (256 - dx)
-                    + (unsigned int)src[y2 * src_bpl + x2 + 1] * dx) >> 8;
-            val_2 = ((unsigned int)src[(y2 + 1) * src_bpl + x2] * (256 - dx)
-                    + (unsigned int)src[(y2 + 1) * src_bpl + x2 + 1] * dx) >> 8;
-            dest[i * dest_bpl + j] = MIN(((val_1 * (256 - dy) + val_2 * dy) >> 8), 0xff);
+    int y0 = -1, y1 = -1;
+    for (int i = 0; i < dest_h; i++) {
+        int y = table->yOffset[i];
+        if (y == y1) {
+            // the lower line of the previous destination line becomes the upper one
+            uint16_t *tmp = line0;
+            line0 = line1;
+            line1 = tmp;
+            y0 = y1;
+            y1 = -1;
+        }
+        if (y != y0) {
+            filterLineHorizontal(src + y * src_bpl, table->xOffsetY, 1,
+                                 table->xFracY, gather, line0, dest_w);
+            y0 = y;
+        }
+        if (y + 1 != y1) {
+            filterLineHorizontal(src + (y + 1) * src_bpl, table->xOffsetY, 1,
+                                 table->xFracY, gather, line1, dest_w);
+            y1 = y + 1;
         }
+        filterLinesVertical(line0, line1, table->yFrac[i], dest + i * dest_bpl, dest_w);
     }
-    flag = 0;
-    i = 0;
-    j = 0;
-    width = dest_w >> 1;
-    height = dest_h >> 1;
+
     //get UV data
-    for (i = 0; i < height; i++) {
-        y1 = i * scaling_h;
-        dy = y1 & 0xff;
-        y2 = y1 >> 8;
-        for (j = 0; j < width; j++) {
-            x1 = j * scaling_w;
-            dx = x1 & 0xff;
-            x2 = (x1 >> 8) + l_skip / 2;
-            //fill U data
-            val_1 = ((unsigned int)src[y2 * src_bpl + (x2 << 1) + src_Y_data] * (256 - dx)
-                     + (unsigned int)src[y2 * src_bpl + ((x2 + 1) << 1) + src_Y_data] * dx) >> 8;
-            val_2 = ((unsigned int)src[(y2 + 1) * src_bpl + (x2 << 1) + src_Y_data] * (256 -dx)
-                     + (unsigned int)src[(y2 +1) * src_bpl + ((x2 + 1) << 1) + src_Y_data] * dx) >> 8;
-            dest[i * dest_bpl + (j << 1) + dest_Y_data] = MIN(((val_1 * (256 - dy) + val_2 * dy) >> 8), 0xff);
-            //fill V data
-            val_1 = ((unsigned int)src[y2 * src_bpl + (x2 << 1) + 1 + src_Y_data] * (256 - dx)
-                     + (unsigned int)src[y2 * src_bpl + ((x2 + 1) << 1) + 1 + src_Y_data] * dx) >> 8;
-            val_2 = ((unsigned int)src[(y2 + 1) * src_bpl + (x2 << 1) + 1 + src_Y_data] * (256 -dx)
-                     + (unsigned int)src[(y2 +1) * src_bpl + ((x2 + 1) << 1) + 1 + src_Y_data] * dx) >> 8;
-            dest[i * dest_bpl + (j << 1) + 1 + dest_Y_data] = MIN(((val_1 * (256 - dy) + val_2 * dy) >> 8), 0xff);
+    const int uvWidth = (dest_w >> 1) << 1;
+    y0 = y1 = -1;
+    for (int i = 0; i < dest_h >> 1; i++) {
+        int y = table->yOffset[i];
+        if (y == y1) {
+            uint16_t *tmp = line0;
+            line0 = line1;
+            line1 = tmp;
+            y0 = y1;
+            y1 = -1;
+        }
+        if (y != y0) {
+            filterLineHorizontal(srcUV + y * src_bpl, table->xOffsetUV, 2,
+                                 table->xFracUV, gather, line0, uvWidth);
+            y0 = y;
+        }
+        if (y + 1 != y1) {
+            filterLineHorizontal(srcUV + (y + 1) * src_bpl, table->xOffsetUV, 2,
+                                 table->xFracUV, gather, line1, uvWidth);
+            y1 = y + 1;
         }
+        filterLinesVertical(line0, line1, table->yFrac[i], destUV + i * dest_bpl, uvWidth);
     }
+
+    delete [] lines;
 }
 
 void ImageScaler::downScaleAndCropNv12ImageQvga(unsigned char *dest, const unsigned char *src,
@@ -321,87 +494,6 @@ void ImageScaler::downScaleAndCropNv12ImageQvga(unsigned char *dest, const unsig
     }
 }
 
-void ImageScaler::downScaleAndCropNv12ImageQcif(unsigned char *dest, const unsigned char *src,
-    const int dest_bpl, const int src_bpl)
-{
-    LOG1("@%s", __FUNCTION__);
-    const int dest_w = RESOLUTION_QCIF_WIDTH;
-    const int dest_h = RESOLUTION_QCIF_HEIGHT;
-    const int src_w = RESOLUTION_VGA_WIDTH;
-    const int src_h = RESOLUTION_VGA_HEIGHT;
-
-    // Correct aspect ratio is defined by destination buffer
-    long int aspect_ratio = (dest_w << 16) / dest_h;
-    // Then, we calculate what should be the width of source image
-    // (should be multiple by four)
-    int proper_source_width = (aspect_ratio * (long int)(src_h) + 0x8000L) >> 16;
-    proper_source_width = (proper_source_width + 2) & ~0x3;
-    // Now, the source image should have some surplus width
-    if (src_w < proper_source_width) {
-        LOGE("%s: source image too narrow", __func__);
-        return;
-    }
-    // Let's divide the surplus to both sides
-    int l_skip = (src_w - proper_source_width) >> 1;
-    int r_skip = src_w - proper_source_width - l_skip;
-    int skip = l_skip + r_skip;
-
-    int i, j, x1, y1, x2, y2;
-    unsigned int val_1, val_2;
-    int dx, dy;
-    int src_Y_data = src_bpl * src_h;
-    int dest_Y_data = dest_bpl * dest_h;
-    int flag, width, height;
-    const int scaling_w = ((src_w - skip) << 8) / dest_w;
-    const int scaling_h = (src_h << 8) / dest_h;
-    dx = 0;
-    dy = 0;
-    // get Y data
-    for (i = 0; i < dest_h; i++) {
-        y1 = i * scaling_h;
-        dy = y1 & 0xff;
-        y2 = y1 >> 8;
-        for (j = 0; j < dest_w; j++) {
-            x1 = j * scaling_w;
-            dx = x1 & 0xff;
-            x2 = (x1 >> 8) + l_skip;
-            val_1 = ((unsigned int)src[y2 * src_bpl + x2] * (256 - dx)
-                    + (unsigned int)src[y2 * src_bpl + x2 + 1] * dx) >> 8;
-            val_2 = ((unsigned int)src[(y2 + 1) * src_bpl + x2] * (256 - dx)
-                    + (unsigned int)src[(y2 + 1) * src_bpl + x2 + 1] * dx) >> 8;
-            dest[i * dest_bpl + j] = MIN(((val_1 * (256 - dy) + val_2 * dy) >> 8), 0xff);
-        }
-    }
-    flag = 0;
-    i = 0;
-    j = 0;
-    width = dest_w >> 1;
-    height = dest_h >> 1;
-    //get UV data
-    for (i = 0; i < height; i++) {
-        y1 = i * scaling_h;
-        dy = y1 & 0xff;
-        y2 = y1 >> 8;
-        for (j = 0; j < width; j++) {
-            x1 = j * scaling_w;
-            dx = x1 & 0xff;
-            x2 = (x1 >> 8) + l_skip / 2;
-            //fill U data
-            val_1 = ((unsigned int)src[y2 * src_bpl + (x2 << 1) + src_Y_data] * (256 - dx)
-                     + (unsigned int)src[y2 * src_bpl + ((x2 + 1) << 1) + src_Y_data] * dx) >> 8;
-            val_2 = ((unsigned int)src[(y2 + 1) * src_bpl + (x2 << 1) + src_Y_data] * (256 -dx)
-                     + (unsigned int)src[(y2 +1) * src_bpl + ((x2 + 1) << 1) + src_Y_data] * dx) >> 8;
-            dest[i * dest_bpl + (j << 1) + dest_Y_data] = MIN(((val_1 * (256 - dy) + val_2 * dy) >> 8), 0xff);
-            //fill V data
-            val_1 = ((unsigned int)src[y2 * src_w + (x2 << 1) + 1 + src_Y_data] * (256 - dx)
-                     + (unsigned int)src[y2 * src_w + ((x2 + 1) << 1) + 1 + src_Y_data] * dx) >> 8;
-            val_2 = ((unsigned int)src[(y2 + 1) * src_w + (x2 << 1) + 1 + src_Y_data] * (256 -dx)
-                     + (unsigned int)src[(y2 +1) * src_w + ((x2 + 1) << 1) + 1 + src_Y_data] * dx) >> 8;
-            dest[i * dest_bpl + (j << 1) + 1 + dest_Y_data] = MIN(((val_1 * (256 - dy) + val_2 * dy) >> 8), 0xff);
-        }
-    }
-}
-
 void ImageScaler::downScaleNv12ImageFrom800x600ToQvga(unsigned char *dest, const unsigned char *src,
     const int dest_bpl, const int src_bpl)
 {
@@ -761,7 +853,6 @@ void ImageScaler::downScaleNv12ImageFrom800x600ToQvga(unsigned char *dest, const
     }
 
 }
-// VGA-QCIF end
 
 /**
  * Crops then input image to destination size. The params must be such that
@@ -56,10 +56,6 @@ protected:
         unsigned char *dest, const unsigned char *src,
         const int dest_bpl, const int src_bpl);
 
-    static void downScaleAndCropNv12ImageQcif(
-        unsigned char *dest, const unsigned char *src,
-        const int dest_bpl, const int src_bpl);
-
     static void downScaleNv12ImageFrom800x600ToQvga(
         unsigned char *dest, const unsigned char *src,
         const int dest_bpl, const int src_bpl);
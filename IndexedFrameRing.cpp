@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Camera_IndexedFrameRing"
+
+#include "LogHelper.h"
+#include "IndexedFrameRing.h"
+
+namespace android {
+
+static uint32_t roundUpToPowerOfTwo(size_t n)
+{
+    uint32_t p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+IndexedFrameRing::IndexedFrameRing(size_t capacity) :
+    mCapacity(capacity)
+    ,mSlotMask(roundUpToPowerOfTwo(capacity) - 1)
+    ,mIndexMask(roundUpToPowerOfTwo(capacity * 2) - 1)
+    ,mHead(0)
+    ,mCount(0)
+{
+    mFrames.insertAt(AtomBufferFactory::createAtomBuffer(), 0, mSlotMask + 1);
+    mIndex.insertAt(0, 0, mIndexMask + 1);
+}
+
+nsecs_t IndexedFrameRing::timestampOf(const AtomBuffer &frame)
+{
+    return nsecs_t(frame.capture_timestamp.tv_sec) * 1000000000LL
+           + nsecs_t(frame.capture_timestamp.tv_usec) * 1000LL;
+}
+
+void IndexedFrameRing::updateIndex(uint32_t seq)
+{
+    mIndex.editItemAt(mFrames[slot(seq)].frameCounter & mIndexMask) = seq;
+}
+
+status_t IndexedFrameRing::push(const AtomBuffer &frame)
+{
+    if (mCount >= mCapacity) {
+        LOGE("@%s: ring full (%d frames)", __FUNCTION__, mCount);
+        return NO_MEMORY;
+    }
+
+    uint32_t seq = mHead + mCount;
+    mFrames.editItemAt(slot(seq)) = frame;
+    updateIndex(seq);
+    mCount++;
+    return NO_ERROR;
+}
+
+void IndexedFrameRing::removeAt(size_t i)
+{
+    if (i >= mCount)
+        return;
+
+    // move the older frames up over the removed one
+    for (uint32_t seq = mHead + i; seq != mHead; seq--) {
+        mFrames.editItemAt(slot(seq)) = mFrames[slot(seq - 1)];
+        updateIndex(seq);
+    }
+    mHead++;
+    mCount--;
+}
+
+int IndexedFrameRing::findByFrameCounter(int frameCounter) const
+{
+    uint32_t seq = mIndex[frameCounter & mIndexMask];
+
+    if (seq - mHead < mCount && mFrames[slot(seq)].frameCounter == frameCounter)
+        return seq - mHead;
+
+    // the index slot was taken over by another frame, or it is not held
+    for (size_t i = 0; i < mCount; i++) {
+        if (itemAt(i).frameCounter == frameCounter)
+            return i;
+    }
+    return -1;
+}
+
+int IndexedFrameRing::findClosest(nsecs_t timestamp) const
+{
+    if (mCount == 0)
+        return -1;
+
+    // first frame not older than timestamp
+    size_t lo = 0, hi = mCount;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (timestampOf(itemAt(mid)) < timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == mCount)
+        return mCount - 1;
+    if (lo > 0 && timestamp - timestampOf(itemAt(lo - 1)) < timestampOf(itemAt(lo)) - timestamp)
+        return lo - 1;
+    return lo;
+}
+
+}; // namespace android
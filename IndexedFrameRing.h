@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_INDEXED_FRAME_RING_H
+#define ANDROID_LIBCAMERA_INDEXED_FRAME_RING_H
+
+#include <stdint.h>
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+#include "AtomCommon.h"
+
+namespace android {
+
+/**
+ * \class IndexedFrameRing
+ *
+ * Fixed capacity FIFO of frames used by the HAL ZSL path, replacing a
+ * Vector<AtomBuffer> that was scanned for every lookup.
+ *
+ * Frames are looked up by frameCounter in constant time through a small
+ * direct mapped index, twice the capacity. Only when two held frames
+ * share an index slot, or the frame is not held, the ring is scanned.
+ *
+ * When frames are pushed in capture order, the frame captured closest to
+ * a given time is found with a binary search on capture_timestamp.
+ *
+ * Not thread safe, the owner locks.
+ */
+class IndexedFrameRing {
+public:
+    IndexedFrameRing(size_t capacity);
+
+// prevent copy constructor and assignment operator
+private:
+    IndexedFrameRing(const IndexedFrameRing& other);
+    IndexedFrameRing& operator=(const IndexedFrameRing& other);
+
+public:
+    size_t size() const { return mCount; }
+    bool isEmpty() const { return mCount == 0; }
+    void clear() { mHead += mCount; mCount = 0; }
+
+    /**
+     * Appends a frame as the newest one
+     *
+     * \return NO_MEMORY if the ring is full
+     */
+    status_t push(const AtomBuffer &frame);
+
+    /**
+     * \param i position, 0 is the oldest frame
+     */
+    const AtomBuffer &itemAt(size_t i) const { return mFrames[slot(mHead + i)]; }
+    AtomBuffer &editItemAt(size_t i) { return mFrames.editItemAt(slot(mHead + i)); }
+
+    /**
+     * Removes the frame at position i. Constant time for the oldest frame,
+     * otherwise the older frames are moved up by one.
+     */
+    void removeAt(size_t i);
+
+    /**
+     * \return position of the frame with this frameCounter, -1 if not held
+     */
+    int findByFrameCounter(int frameCounter) const;
+
+    /**
+     * \param timestamp nanoseconds, same clock as capture_timestamp
+     * \return position of the frame whose capture_timestamp is closest to
+     *         timestamp, -1 if the ring is empty
+     */
+    int findClosest(nsecs_t timestamp) const;
+
+    static nsecs_t timestampOf(const AtomBuffer &frame);
+
+private:
+    size_t slot(uint32_t seq) const { return seq & mSlotMask; }
+    void updateIndex(uint32_t seq);
+
+private:
+    size_t mCapacity;
+    Vector<AtomBuffer> mFrames;  /*!< power of two slots, frame seq lives at seq & mSlotMask */
+    uint32_t mSlotMask;
+    Vector<uint32_t> mIndex;     /*!< frameCounter & mIndexMask -> seq */
+    uint32_t mIndexMask;
+    uint32_t mHead;              /*!< seq of the oldest frame */
+    size_t mCount;
+};
+
+}; // namespace android
+
+#endif // ANDROID_LIBCAMERA_INDEXED_FRAME_RING_H
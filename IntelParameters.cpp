@@ -113,6 +113,14 @@ namespace android {
     const char IntelCameraParameters::KEY_BURST_START_INDEX[] = "burst-start-index";
     const char IntelCameraParameters::KEY_SUPPORTED_BURST_START_INDEX[] = "burst-start-index-values";
     const char IntelCameraParameters::KEY_MAX_BURST_LENGTH_WITH_NEGATIVE_START_INDEX[] = "burst-max-length-negative";
+    // capture buffer plan (read only)
+    const char IntelCameraParameters::KEY_CAPTURE_MEMORY_BUDGET[] = "capture-memory-budget";
+    const char IntelCameraParameters::KEY_CAPTURE_PLAN_MODE[] = "capture-plan-mode";
+    const char IntelCameraParameters::KEY_CAPTURE_PLAN_SNAPSHOT_BUFFERS[] = "capture-plan-snapshot-buffers";
+    const char IntelCameraParameters::KEY_CAPTURE_PLAN_POSTVIEW_BUFFERS[] = "capture-plan-postview-buffers";
+    const char IntelCameraParameters::KEY_CAPTURE_PLAN_RING_BUFFERS[] = "capture-plan-ring-buffers";
+    const char IntelCameraParameters::KEY_CAPTURE_PLAN_JPEG_SPILL[] = "capture-plan-jpeg-spill";
+    const char IntelCameraParameters::KEY_CAPTURE_PLAN_MEMORY[] = "capture-plan-memory";
     //values for burst speed
     const char IntelCameraParameters::BURST_SPEED_FAST[] = "fast";
     const char IntelCameraParameters::BURST_SPEED_MEDIUM[] = "medium";
@@ -211,6 +211,15 @@ namespace android {
     static const char KEY_SUPPORTED_BURST_START_INDEX[];
     static const char KEY_MAX_BURST_LENGTH_WITH_NEGATIVE_START_INDEX[];
 
+    // Capture buffer plan, read only. Memory values are in KB.
+    static const char KEY_CAPTURE_MEMORY_BUDGET[];
+    static const char KEY_CAPTURE_PLAN_MODE[];
+    static const char KEY_CAPTURE_PLAN_SNAPSHOT_BUFFERS[];
+    static const char KEY_CAPTURE_PLAN_POSTVIEW_BUFFERS[];
+    static const char KEY_CAPTURE_PLAN_RING_BUFFERS[];
+    static const char KEY_CAPTURE_PLAN_JPEG_SPILL[];
+    static const char KEY_CAPTURE_PLAN_MEMORY[];
+
     // EXIF data
     static const char KEY_EXIF_MAKER[];
     static const char KEY_EXIF_MODEL[];
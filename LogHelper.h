@@ -67,7 +67,10 @@ enum  {
     CAMERA_DEBUG_LOG_PERF_IO_BREAKDOWN = 1<<2,
 
     /* Print out detailed memory information analysis for IOCTL */
-    CAMERA_DEBUG_LOG_PERF_IO_MEMORY = 1<<3
+    CAMERA_DEBUG_LOG_PERF_IO_MEMORY = 1<<3,
+
+    /* Collect MessageQueue latency and depth stats, see MessageQueueStats */
+    CAMERA_DEBUG_LOG_PERF_MESSAGE_QUEUE = 1<<4
 };
 
 enum  {
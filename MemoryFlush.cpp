@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * The cache flushes of MemoryUtils, apart from the buffer allocation so
+ * that the flush benchmark builds without gralloc.
+ */
+
+#define LOG_TAG "Camera_MemoryUtils"
+#include "MemoryUtils.h"
+#include "PlatformData.h"
+#include <cpuid.h>
+
+// cpuid leaf 7 ebx, not known by all cpuid.h versions
+#define CPUID_7_EBX_CLFLUSHOPT (1 << 23)
+#define CPUID_7_EBX_CLWB       (1 << 24)
+
+namespace android {
+    namespace MemoryUtils {
+
+    enum FlushInstruction {
+        FLUSH_CLFLUSH,      /*!< write back and drop, serialized with each other */
+        FLUSH_CLFLUSHOPT,   /*!< write back and drop, runs in parallel until sfence */
+        FLUSH_CLWB,         /*!< write back and keep the line, runs in parallel until sfence */
+    };
+
+    /**
+     * Returns the CPUID_7_EBX_* bits of the flush instructions the CPU has
+     */
+    static unsigned int detectFlushInstructions()
+    {
+        unsigned int eax, ebx, ecx, edx;
+
+        if (__get_cpuid_max(0, NULL) < 7)
+            return 0;
+
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        ebx &= CPUID_7_EBX_CLFLUSHOPT | CPUID_7_EBX_CLWB;
+        LOG1("@%s: clflushopt %d clwb %d", __FUNCTION__,
+             (ebx & CPUID_7_EBX_CLFLUSHOPT) != 0, (ebx & CPUID_7_EBX_CLWB) != 0);
+        return ebx;
+    }
+
+    static FlushInstruction getFlushInstruction(bool invalidate)
+    {
+        static unsigned int instructions = detectFlushInstructions();
+
+        if (!invalidate && (instructions & CPUID_7_EBX_CLWB))
+            return FLUSH_CLWB;
+        if (instructions & CPUID_7_EBX_CLFLUSHOPT)
+            return FLUSH_CLFLUSHOPT;
+        return FLUSH_CLFLUSH;
+    }
+
+    /**
+     * Issues the flush instruction on every cache line of the range,
+     * without waiting for the lines to be written
+     */
+    static void flushLines(char *startAddr, int size, FlushInstruction insn, int cacheLineSize)
+    {
+        char *addr = (char *)((unsigned long)startAddr & ~(unsigned long)(cacheLineSize - 1));
+        char *endAddr = startAddr + size;
+
+        // The encodings are spelled out for assemblers that do not know
+        // the instructions: clflushopt is clflush with a 0x66 prefix, clwb
+        // is 66 0f ae /6, here with the address in eax/rax.
+        switch (insn) {
+        case FLUSH_CLWB:
+            for (; addr < endAddr; addr += cacheLineSize)
+                asm volatile(".byte 0x66, 0x0f, 0xae, 0x30" : "+m" (*addr) : "a" (addr));
+            break;
+        case FLUSH_CLFLUSHOPT:
+            for (; addr < endAddr; addr += cacheLineSize)
+                asm volatile(".byte 0x66; clflush %0" : "+m" (*addr));
+            break;
+        default:
+            for (; addr < endAddr; addr += cacheLineSize)
+                asm volatile("clflush %0" : "+m" (*addr));
+            break;
+        }
+    }
+
+    static void flushRange(char *startAddr, int size, bool invalidate)
+    {
+        static int cacheLineSize = PlatformData::cacheLineSize();
+
+        if (startAddr != NULL && size > 0)
+            flushLines(startAddr, size, getFlushInstruction(invalidate), cacheLineSize);
+
+        // one fence orders all the flushes before the stores that hand the
+        // buffer to the device
+        asm volatile("sfence" ::: "memory");
+    }
+
+    void flushMemory(char *startAddr, int size)
+    {
+        flushRange(startAddr, size, true);
+    }
+
+    void writeBackMemory(char *startAddr, int size)
+    {
+        flushRange(startAddr, size, false);
+    }
+
+    } // namespace MemoryUtils
+} // namespace android
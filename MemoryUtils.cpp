@@ -25,17 +25,6 @@
 namespace android {
     namespace MemoryUtils {
 
-    void flushMemory(char *startAddr, int size)
-    {
-        static int cacheLineSize = PlatformData::cacheLineSize();
-        char *endAddr = startAddr + size;
-
-        endAddr = (char *)ALIGN_WIDTH((unsigned long)endAddr, cacheLineSize);
-
-        for(; startAddr < endAddr; startAddr += cacheLineSize)
-            asm volatile("clflush %0" : "+m" (*startAddr));
-    }
-
     status_t allocateGraphicBuffer(AtomBuffer &aBuff, const AtomBuffer &formatDescriptor)
     {
         LOG1("@%s", __FUNCTION__);
@@ -125,6 +114,17 @@ namespace android {
         return status;
     }
 
+    int getGraphicBufferDmaBufFd(const AtomBuffer &aBuff)
+    {
+#ifdef GRALLOC_DMABUF
+        // the gralloc of these boards keeps the dma-buf as the first fd of the handle
+        if (aBuff.gfxInfo.gfxBufferHandle != NULL && *aBuff.gfxInfo.gfxBufferHandle != NULL
+            && (*aBuff.gfxInfo.gfxBufferHandle)->numFds > 0)
+            return (*aBuff.gfxInfo.gfxBufferHandle)->data[0];
+#endif
+        return -1;
+    }
+
     void freeGraphicBuffer(AtomBuffer &aBuff)
     {
         LOG1("@%s", __FUNCTION__);
@@ -25,9 +25,27 @@ namespace android {
 
     namespace MemoryUtils {
 
+        /**
+         * Cache maintenance before a device accesses memory the CPU wrote.
+         *
+         * flushMemory() writes the cache lines back and drops them, use it
+         * when the CPU reads the buffer again after the device wrote it.
+         * writeBackMemory() keeps the lines cached, enough when the device
+         * only reads the buffer (e.g. the JPEG encoder).
+         * The fastest instruction of the CPU is used (clwb, clflushopt,
+         * clflush) and the function returns once all lines are written.
+         * Uncached and write-combined memory needs none of these.
+         */
         void flushMemory(char *startAddr, int size);
+        void writeBackMemory(char *startAddr, int size);
         status_t allocateGraphicBuffer(AtomBuffer &aBuff, const AtomBuffer &formatDescriptor);
         void freeGraphicBuffer(AtomBuffer &aBuff);
+        /**
+         * dma-buf file descriptor of a gralloc buffer, for the ISP to write
+         * it as V4L2_MEMORY_DMABUF, or -1 if gralloc does not give one.
+         * The descriptor stays owned by the buffer handle.
+         */
+        int getGraphicBufferDmaBufFd(const AtomBuffer &aBuff);
         status_t allocateAtomBuffer(AtomBuffer &aBuff, const AtomBuffer &formatDescriptor, Callbacks *aCallbacks);
         void freeAtomBuffer(AtomBuffer &aBuff);
         status_t allocateAtomBufferMetadata(AtomBuffer &aBuff, uint32_t metaSize, Callbacks *aCallbacks);
@@ -17,36 +17,81 @@
 #ifndef MESSAGE_QUEUE
 #define MESSAGE_QUEUE
 
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
 #include <utils/Errors.h>
 #include <utils/Timers.h>
 #include <utils/threads.h>
 #include <utils/Log.h>
-#include <utils/List.h>
 #include <utils/Vector.h>
+#include <cutils/atomic.h>
+#include <cutils/atomic-inline.h>
+#include "FrameRing.h"
+#include "MessageQueueStats.h"
 
 // By default MessageQueue::receive() waits infinitely for a new message
 #define MESSAGE_QUEUE_RECEIVE_TIMEOUT_MSEC_INFINITE 0
 
+// Frame lane size for the queues carrying one message per frame
+#define MESSAGE_QUEUE_FRAME_LANE_SIZE 32
+
 namespace android {
 
+enum MessagePriority {
+    MESSAGE_PRIORITY_NORMAL = 0,
+    MESSAGE_PRIORITY_HIGH,      // served before the normal messages of other threads
+    MESSAGE_PRIORITY_ORDERED    // normal, but never passed by a high priority message
+};
+
 template <class MessageType, class MessageId>
 class MessageQueue {
 
     // constructor / destructor
 public:
     MessageQueue(const char *name, // for debugging
-            int numReply = 0) :    // set numReply only if you need synchronous messages
+            int numReply = 0,      // set numReply only if you need synchronous messages
+            int frameLaneSize = 0) : // set frameLaneSize only if you use sendFrame()
         mName(name)
+        ,mFreeNodes(NULL)
+        ,mListSize(0)
+        ,mHighPriorityIds(0)
+        ,mOrderedIds(0)
+        ,mOrderedQueued(0)
+        ,mSenderCount(0)
+        ,mUntrackedQueued(0)
+        ,mFrameLane(NULL)
+        ,mFrameSender()
+        ,mHasFrameSender(false)
+        ,mSendSeq(0)
+        ,mConsumerWaiting(0)
+        ,mFrameLaneBusy(0)
         ,mNumReply(numReply)
         ,mReplyMutex(NULL)
         ,mReplyCondition(NULL)
         ,mReplyStatus(NULL)
+        ,mStats(NULL)
+        ,mHandledId(-1)
+        ,mHandledSince(0)
     {
+        for (int i = 0; i < LANE_COUNT; i++) {
+            mLanes[i].head = NULL;
+            mLanes[i].tail = NULL;
+            mLanes[i].size = 0;
+        }
+        memset(mQueuedIds, 0, sizeof(mQueuedIds));
+        growNodePoolLocked();
+
+        if (frameLaneSize > 0)
+            mFrameLane = new FrameRing<QueuedMessage>(frameLaneSize);
         if (mNumReply > 0) {
             mReplyMutex = new Mutex[numReply];
             mReplyCondition = new Condition[numReply];
             mReplyStatus = new status_t[numReply];
         }
+        if (MessageQueueStats::enabled())
+            mStats = new MessageQueueStats(name);
     }
 
     ~MessageQueue()
@@ -59,6 +104,17 @@ public:
             LOGE("Atom_MessageQueue error: %s queue should be empty. Find the bug.", mName);
         }
 
+        delete mFrameLane;
+        mFrameLane = NULL;
+
+        delete mStats;
+        mStats = NULL;
+
+        for (size_t i = 0; i < mNodeChunks.size(); i++)
+            delete [] mNodeChunks[i];
+        mNodeChunks.clear();
+        mFreeNodes = NULL;
+
         if (mNumReply > 0) {
             delete [] mReplyMutex;
             mReplyMutex = NULL;
@@ -72,12 +128,37 @@ public:
     // public methods
 public:
 
+    // Set the priority of a message id, it is meant to be done once when
+    // the owning thread is created. A high priority message is received
+    // before the normal messages queued by other threads, but never before
+    // a message queued earlier by its own sending thread, nor before a
+    // queued high priority or ordered message of any thread. Ids sent by
+    // several threads which must keep their order, like the calls of the
+    // camera API coming from binder threads, are all high or ordered.
+    status_t setPriority(MessageId id, MessagePriority priority)
+    {
+        if ((int) id < 0 || (int) id >= MAX_TRACKED_IDS) {
+            LOGE("Atom_MessageQueue error: %s cannot prioritize id %d\n", mName, (int) id);
+            return BAD_VALUE;
+        }
+
+        Mutex::Autolock lock(mQueueMutex);
+        mHighPriorityIds &= ~(1ULL << id);
+        mOrderedIds &= ~(1ULL << id);
+        if (priority == MESSAGE_PRIORITY_HIGH)
+            mHighPriorityIds |= (1ULL << id);
+        else if (priority == MESSAGE_PRIORITY_ORDERED)
+            mOrderedIds |= (1ULL << id);
+        return NO_ERROR;
+    }
+
     // Push a message onto the queue. If replyId is not -1 function will block until
     // the caller is signalled with a reply. Caller is unblocked when reply method is
     // called with the corresponding message id.
     status_t send(MessageType *msg, MessageId replyId = (MessageId) -1)
     {
         status_t status = NO_ERROR;
+        pthread_t sender = pthread_self();
 
         // someone is misusing the API. replies have not been enabled
         if (replyId != -1 && mNumReply == 0) {
@@ -86,8 +167,7 @@ public:
         }
 
         mQueueMutex.lock();
-        MessageType data = *msg;
-        mList.push_front(data);
+        pushLocked(*msg, android_atomic_inc(&mSendSeq), sender, sendTimestamp());
         if (replyId != -1) {
             mReplyStatus[replyId] = WOULD_BLOCK;
         }
@@ -111,6 +191,44 @@ public:
         return status;
     }
 
+    // Push a frame message without taking the queue lock.
+    // The message goes to the lock-free frame lane, so only one thread may
+    // call sendFrame() and only the thread calling receive() may consume.
+    // The consumer is only signalled if it is waiting for a message, and
+    // messages keep their sending order with the ones pushed by send().
+    status_t sendFrame(MessageType *msg)
+    {
+        if (mFrameLane == NULL)
+            return send(msg);
+
+        QueuedMessage entry;
+        entry.msg = *msg;
+        entry.seq = android_atomic_inc(&mSendSeq);
+        entry.sendTime = sendTimestamp();
+        pthread_t sender = pthread_self();
+        if (!mHasFrameSender) {
+            // written once, before the first frame message is visible
+            mFrameSender = sender;
+            mHasFrameSender = true;
+        }
+        if (!mFrameLane->push(entry)) {
+            // the lane is full, fall back to the locked lanes
+            Mutex::Autolock lock(mQueueMutex);
+            pushLocked(entry.msg, entry.seq, sender, entry.sendTime);
+            mQueueCondition.signal();
+            return NO_ERROR;
+        }
+
+        // pairs with the barrier in receive() before it checks the lane
+        android_memory_barrier();
+        if (android_atomic_acquire_load(&mConsumerWaiting)) {
+            Mutex::Autolock lock(mQueueMutex);
+            mQueueCondition.signal();
+        }
+
+        return NO_ERROR;
+    }
+
     status_t remove(MessageId id, Vector<MessageType> *vect = NULL)
     {
         status_t status = NO_ERROR;
@@ -118,18 +236,43 @@ public:
             return status;
 
         mQueueMutex.lock();
-        typename List<MessageType>::iterator it = mList.begin();
-        while (it != mList.end()) {
-            MessageType msg = *it;
-            if (msg.id == id) {
-                if (vect) {
-                    vect->push(msg);
+        // ids which are tracked and not queued need no scan
+        if ((int) id < 0 || (int) id >= MAX_TRACKED_IDS || mQueuedIds[id] > 0) {
+            for (int i = 0; i < LANE_COUNT; i++) {
+                Node *prev = NULL;
+                Node *node = mLanes[i].head;
+                while (node != NULL) {
+                    Node *next = node->next;
+                    if (node->msg.id == id) {
+                        if (vect) {
+                            vect->push(node->msg);
+                        }
+                        unlinkLocked(i, prev, node);
+                    } else {
+                        prev = node;
+                    }
+                    node = next;
                 }
-                it = mList.erase(it); // returns pointer to next item in list
-            } else {
-                it++;
             }
         }
+        if (mFrameLane != NULL && !mFrameLane->isEmpty()) {
+            // take the consumer side of the lane from receive() and empty
+            // it, the messages which are kept move to the normal lane
+            while (android_atomic_acquire_cas(0, 1, &mFrameLaneBusy) != 0)
+                sched_yield();
+            QueuedMessage *frame;
+            while ((frame = mFrameLane->front()) != NULL) {
+                if (frame->msg.id == id) {
+                    if (vect) {
+                        vect->push(frame->msg);
+                    }
+                } else {
+                    requeueFrameLocked(*frame);
+                }
+                mFrameLane->pop();
+            }
+            android_atomic_release_store(0, &mFrameLaneBusy);
+        }
         mQueueMutex.unlock();
 
         // unblock caller if waiting
@@ -146,27 +289,54 @@ public:
     {
         status_t status = NO_ERROR;
         nsecs_t timeout_val = 0;
+        nsecs_t sendTime = 0;
+
+        if (mStats)
+            statsHandled();
+
+        // only frame messages queued: take one without the lock.
+        // The lanes are checked after reading the frame lane, sendFrame()
+        // may have put older messages in them while the frame lane was full.
+        // remove() empties the lane under the lock, it is skipped meanwhile.
+        if (mFrameLane != NULL && android_atomic_acquire_cas(0, 1, &mFrameLaneBusy) == 0) {
+            QueuedMessage *frame = mFrameLane->front();
+            if (frame != NULL && android_atomic_acquire_load(&mListSize) == 0) {
+                *msg = frame->msg;
+                if (mStats)
+                    statsReceived(*msg, frame->sendTime, mFrameLane->size());
+                mFrameLane->pop();
+                android_atomic_release_store(0, &mFrameLaneBusy);
+                return status;
+            }
+            android_atomic_release_store(0, &mFrameLaneBusy);
+        }
+
         mQueueMutex.lock();
-        while (isEmptyLocked()) {
+        while (!takeLocked(msg, &sendTime)) {
+            if (mFrameLane != NULL) {
+                // pairs with the barrier in sendFrame() after the push
+                android_atomic_release_store(1, &mConsumerWaiting);
+                android_memory_barrier();
+                if (!mFrameLane->isEmpty()) {
+                    android_atomic_release_store(0, &mConsumerWaiting);
+                    continue;
+                }
+            }
             if (timeout_ms) {
                 timeout_val = nsecs_t(timeout_ms) * 1000000LL;
                 status = mQueueCondition.waitRelative(mQueueMutex,timeout_val);
             } else {
                 mQueueCondition.wait(mQueueMutex);
             }
-            // wait() should never complete without a message being
-            // available, but for diagnostic purposes let's check it.
+            if (mFrameLane != NULL)
+                android_atomic_release_store(0, &mConsumerWaiting);
             if (status == TIMED_OUT) {
                 mQueueMutex.unlock();
                 return status;
             }
-            if (isEmptyLocked()) {
-                LOGE("Atom_MessageQueue - woke with mCount == 0\n");
-            }
         }
-
-        *msg = *(--mList.end());
-        mList.erase(--mList.end());
+        if (mStats)
+            statsReceived(*msg, sendTime, sizeLocked() + 1);
         mQueueMutex.unlock();
         return status;
     }
@@ -193,22 +363,294 @@ public:
 
 private:
 
+    enum {
+        LANE_HIGH = 0,
+        LANE_NORMAL,
+        LANE_COUNT
+    };
+
+    // ids below this have a priority bit and a queued message count
+    static const int MAX_TRACKED_IDS = 64;
+    // the pool grows by this many nodes when all of them are queued
+    static const int NODE_CHUNK_SIZE = 16;
+    // senders tracked at once, more than the binder threads of a process
+    static const int MAX_SENDERS = 16;
+
+    struct Node {
+        MessageType msg;
+        int32_t seq;    // send order, shared by the lanes and the frame lane
+        pthread_t sender;
+        nsecs_t sendTime;   // only set when mStats is
+        bool ordered;   // a high priority message must not pass it
+        bool tracked;   // counted in mSenders, see countQueuedLocked()
+        Node *next;
+    };
+
+    struct Lane {
+        Node *head;     // oldest message
+        Node *tail;
+        int size;
+    };
+
+    struct QueuedMessage {
+        MessageType msg;
+        int32_t seq;
+        nsecs_t sendTime;
+    };
+
+    struct SenderCount {
+        pthread_t sender;
+        int count;      // messages of sender in the normal lane
+    };
+
     // Return true if the queue is empty, must be called
     // with mQueueMutex taken
     inline bool isEmptyLocked() { return sizeLocked() == 0; }
 
-    inline int sizeLocked() { return mList.size(); }
+    inline int sizeLocked()
+    {
+        return mLanes[LANE_HIGH].size + mLanes[LANE_NORMAL].size
+               + (mFrameLane ? mFrameLane->size() : 0);
+    }
+
+    // sequence numbers wrap around
+    static inline bool sentBefore(int32_t a, int32_t b) { return (int32_t)(a - b) < 0; }
+
+    // Only called when every node is queued, the queue does not allocate
+    // once it has grown to its high watermark
+    void growNodePoolLocked()
+    {
+        Node *chunk = new Node[NODE_CHUNK_SIZE];
+        for (int i = 0; i < NODE_CHUNK_SIZE - 1; i++)
+            chunk[i].next = &chunk[i + 1];
+        chunk[NODE_CHUNK_SIZE - 1].next = mFreeNodes;
+        mFreeNodes = chunk;
+        mNodeChunks.push(chunk);
+    }
+
+    int senderIndexLocked(pthread_t sender)
+    {
+        for (int i = 0; i < mSenderCount; i++) {
+            if (pthread_equal(mSenders[i].sender, sender))
+                return i;
+        }
+        return -1;
+    }
+
+    // true if sender has messages that a high priority message must not pass
+    bool senderHasQueuedLocked(pthread_t sender)
+    {
+        if (mFrameLane != NULL && !mFrameLane->isEmpty() && pthread_equal(sender, mFrameSender))
+            return true;
+        // an untracked node may belong to any sender
+        return mUntrackedQueued > 0 || senderIndexLocked(sender) >= 0;
+    }
+
+    Node *allocNodeLocked(const MessageType &msg, int32_t seq, pthread_t sender,
+                          nsecs_t sendTime)
+    {
+        if (mFreeNodes == NULL)
+            growNodePoolLocked();
+        Node *node = mFreeNodes;
+        mFreeNodes = node->next;
+
+        node->msg = msg;
+        node->seq = seq;
+        node->sender = sender;
+        node->sendTime = sendTime;
+        int id = (int) msg.id;
+        node->ordered = id >= 0 && id < MAX_TRACKED_IDS
+                        && ((mHighPriorityIds | mOrderedIds) & (1ULL << id));
+        node->next = NULL;
+        return node;
+    }
+
+    // Count node as queued in lane, once it is linked
+    void countQueuedLocked(int lane, Node *node)
+    {
+        if (lane == LANE_NORMAL) {
+            int i = senderIndexLocked(node->sender);
+            if (i < 0 && mSenderCount < MAX_SENDERS) {
+                i = mSenderCount++;
+                mSenders[i].sender = node->sender;
+                mSenders[i].count = 0;
+            }
+            node->tracked = i >= 0;
+            if (node->tracked)
+                mSenders[i].count++;
+            else
+                mUntrackedQueued++;
+            if (node->ordered)
+                mOrderedQueued++;
+        }
+        int id = (int) node->msg.id;
+        if (id >= 0 && id < MAX_TRACKED_IDS)
+            mQueuedIds[id]++;
+
+        mLanes[lane].size++;
+        android_atomic_release_store(mListSize + 1, &mListSize);
+    }
+
+    void pushLocked(const MessageType &msg, int32_t seq, pthread_t sender, nsecs_t sendTime)
+    {
+        Node *node = allocNodeLocked(msg, seq, sender, sendTime);
+
+        int lane = LANE_NORMAL;
+        int id = (int) msg.id;
+        bool tracked = id >= 0 && id < MAX_TRACKED_IDS;
+        if (tracked && (mHighPriorityIds & (1ULL << id))
+            && mOrderedQueued == 0 && !senderHasQueuedLocked(sender))
+            lane = LANE_HIGH;
+
+        Lane &l = mLanes[lane];
+        if (l.tail != NULL)
+            l.tail->next = node;
+        else
+            l.head = node;
+        l.tail = node;
+        countQueuedLocked(lane, node);
+    }
+
+    // Move a message of the frame lane to the normal lane, in sending order
+    void requeueFrameLocked(const QueuedMessage &entry)
+    {
+        Node *node = allocNodeLocked(entry.msg, entry.seq, mFrameSender, entry.sendTime);
+
+        Lane &l = mLanes[LANE_NORMAL];
+        Node *prev = NULL;
+        Node *next = l.head;
+        while (next != NULL && !sentBefore(entry.seq, next->seq)) {
+            prev = next;
+            next = next->next;
+        }
+        node->next = next;
+        if (prev != NULL)
+            prev->next = node;
+        else
+            l.head = node;
+        if (next == NULL)
+            l.tail = node;
+        countQueuedLocked(LANE_NORMAL, node);
+    }
+
+    // Unlink node from lane and return it to the pool
+    void unlinkLocked(int lane, Node *prev, Node *node)
+    {
+        Lane &l = mLanes[lane];
+        if (prev != NULL)
+            prev->next = node->next;
+        else
+            l.head = node->next;
+        if (l.tail == node)
+            l.tail = prev;
+        l.size--;
+        android_atomic_release_store(mListSize - 1, &mListSize);
+
+        if (lane == LANE_NORMAL) {
+            if (node->tracked) {
+                int i = senderIndexLocked(node->sender);
+                if (--mSenders[i].count == 0)
+                    mSenders[i] = mSenders[--mSenderCount];
+            } else {
+                mUntrackedQueued--;
+            }
+            if (node->ordered)
+                mOrderedQueued--;
+        }
+        int id = (int) node->msg.id;
+        if (id >= 0 && id < MAX_TRACKED_IDS)
+            mQueuedIds[id]--;
+
+        node->next = mFreeNodes;
+        mFreeNodes = node;
+    }
+
+    // Take the next message, must be called with mQueueMutex taken by the
+    // consumer thread, which keeps remove() off the frame lane. High
+    // priority messages go first, the normal lane and the frame lane are
+    // merged in sending order.
+    bool takeLocked(MessageType *msg, nsecs_t *sendTime)
+    {
+        QueuedMessage *frame = NULL;
+        Node *node = mLanes[LANE_HIGH].head;
+
+        if (node != NULL) {
+            *msg = node->msg;
+            *sendTime = node->sendTime;
+            unlinkLocked(LANE_HIGH, NULL, node);
+            return true;
+        }
+
+        if (mFrameLane != NULL)
+            frame = mFrameLane->front();
+
+        node = mLanes[LANE_NORMAL].head;
+        if (node != NULL && (frame == NULL || sentBefore(node->seq, frame->seq))) {
+            *msg = node->msg;
+            *sendTime = node->sendTime;
+            unlinkLocked(LANE_NORMAL, NULL, node);
+            return true;
+        }
+        if (frame == NULL)
+            return false;
+
+        *msg = frame->msg;
+        *sendTime = frame->sendTime;
+        mFrameLane->pop();
+        return true;
+    }
+
+    inline nsecs_t sendTimestamp() { return mStats ? systemTime() : 0; }
+
+    // Telemetry of the receiving thread: the time spent on the previous
+    // message ends when it comes back to receive()
+    void statsHandled()
+    {
+        if (mHandledId >= 0) {
+            mStats->handled(mHandledId, systemTime() - mHandledSince);
+            mHandledId = -1;
+        }
+    }
+
+    void statsReceived(const MessageType &msg, nsecs_t sendTime, int depth)
+    {
+        nsecs_t now = systemTime();
+        mStats->received((int) msg.id, sendTime, now, depth);
+        mHandledId = (int) msg.id;
+        mHandledSince = now;
+    }
 
     const char *mName;
     Mutex mQueueMutex;
     Condition mQueueCondition;
-    List<MessageType> mList;
+    Lane mLanes[LANE_COUNT];
+    Node *mFreeNodes;
+    Vector<Node*> mNodeChunks;      // pool storage, freed by the destructor
+    volatile int32_t mListSize;     // nodes in mLanes, readable without the lock
+    uint64_t mHighPriorityIds;      // bit per id set by setPriority()
+    uint64_t mOrderedIds;           // bit per id set by setPriority()
+    int mOrderedQueued;             // ordered nodes in the normal lane
+    int mQueuedIds[MAX_TRACKED_IDS];    // nodes in mLanes per id, see remove()
+    SenderCount mSenders[MAX_SENDERS];  // senders with nodes in the normal lane
+    int mSenderCount;
+    int mUntrackedQueued;           // normal lane nodes of senders beyond MAX_SENDERS
+
+    FrameRing<QueuedMessage> *mFrameLane;  // lock-free lane for sendFrame()
+    pthread_t mFrameSender;         // the thread calling sendFrame()
+    bool mHasFrameSender;
+    volatile int32_t mSendSeq;
+    volatile int32_t mConsumerWaiting;
+    volatile int32_t mFrameLaneBusy;    // a thread is on the consumer side of the lane
 
     int mNumReply;
     Mutex *mReplyMutex;
     Condition *mReplyCondition;
     status_t *mReplyStatus;
 
+    MessageQueueStats *mStats;      // NULL unless enabled by camera.hal.perf
+    int mHandledId;                 // message being handled, -1 if none
+    nsecs_t mHandledSince;
+
 }; // class MessageQueue
 
 }; // namespace android
@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Camera_MessageQueueStats"
+
+#include <string.h>
+#include <unistd.h>
+#include "LogHelper.h"
+#include "MessageQueueStats.h"
+
+namespace android {
+
+Mutex MessageQueueStats::sRegistryLock;
+Vector<MessageQueueStats*> MessageQueueStats::sRegistry;
+
+MessageQueueStats::MessageQueueStats(const char *name) :
+    mName(name)
+{
+    memset(mIds, 0, sizeof(mIds));
+
+    Mutex::Autolock lock(sRegistryLock);
+    sRegistry.push(this);
+}
+
+MessageQueueStats::~MessageQueueStats()
+{
+    {
+        Mutex::Autolock lock(sRegistryLock);
+        for (size_t i = 0; i < sRegistry.size(); i++) {
+            if (sRegistry[i] == this) {
+                sRegistry.removeAt(i);
+                break;
+            }
+        }
+    }
+
+    String8 out;
+    append(out);
+    write(-1, out);
+}
+
+bool MessageQueueStats::enabled()
+{
+    return gPerfLevel & CAMERA_DEBUG_LOG_PERF_MESSAGE_QUEUE;
+}
+
+void MessageQueueStats::addSample(Histogram *h, nsecs_t duration)
+{
+    int64_t us = duration / 1000;
+    int bucket = 0;
+
+    if (us < 0)
+        us = 0;
+    while (bucket < HISTOGRAM_BUCKETS - 1 && us >= (1LL << bucket))
+        bucket++;
+
+    h->buckets[bucket]++;
+    h->count++;
+    h->sumUs += us;
+    if (us > h->maxUs)
+        h->maxUs = us;
+}
+
+void MessageQueueStats::received(int id, nsecs_t sendTime, nsecs_t now, int depth)
+{
+    if (id < 0 || id >= MAX_IDS)
+        id = MAX_IDS - 1;
+
+    Mutex::Autolock lock(mLock);
+    IdStats &stats = mIds[id];
+    addSample(&stats.delay, now - sendTime);
+    if (depth > stats.maxDepth)
+        stats.maxDepth = depth;
+}
+
+void MessageQueueStats::handled(int id, nsecs_t duration)
+{
+    if (id < 0 || id >= MAX_IDS)
+        id = MAX_IDS - 1;
+
+    Mutex::Autolock lock(mLock);
+    addSample(&mIds[id].handling, duration);
+}
+
+void MessageQueueStats::appendHistogram(String8 &out, const char *what, const Histogram &h)
+{
+    out.appendFormat("    %-8s n=%u avg=%lldus max=%lldus |", what, h.count,
+                     h.count ? (long long) (h.sumUs / h.count) : 0LL, (long long) h.maxUs);
+
+    if (h.count == 0) {
+        out.append("\n");
+        return;
+    }
+
+    // only print the range of buckets that has samples
+    int first = 0, last = HISTOGRAM_BUCKETS - 1;
+    while (first < last && h.buckets[first] == 0)
+        first++;
+    while (last > first && h.buckets[last] == 0)
+        last--;
+    for (int i = first; i <= last; i++) {
+        if (i == HISTOGRAM_BUCKETS - 1)
+            out.appendFormat(" >=%lldus:%u", 1LL << (i - 1), h.buckets[i]);
+        else
+            out.appendFormat(" <%lldus:%u", 1LL << i, h.buckets[i]);
+    }
+    out.append("\n");
+}
+
+void MessageQueueStats::append(String8 &out)
+{
+    Mutex::Autolock lock(mLock);
+
+    out.appendFormat("MessageQueue %s\n", mName);
+    for (int id = 0; id < MAX_IDS; id++) {
+        const IdStats &stats = mIds[id];
+        if (stats.delay.count == 0)
+            continue;
+        out.appendFormat("  id %d%s: max depth %d\n", id,
+                         id == MAX_IDS - 1 ? " (and above)" : "", stats.maxDepth);
+        appendHistogram(out, "queued", stats.delay);
+        appendHistogram(out, "handled", stats.handling);
+    }
+}
+
+void MessageQueueStats::write(int fd, const String8 &out)
+{
+    if (fd >= 0) {
+        ::write(fd, out.string(), out.length());
+        return;
+    }
+
+    // one log line per line of the dump
+    const char *line = out.string();
+    while (*line != '\0') {
+        const char *end = strchr(line, '\n');
+        int len = end ? end - line : strlen(line);
+        LOGD("%.*s", len, line);
+        line += end ? len + 1 : len;
+    }
+}
+
+void MessageQueueStats::dumpAll(int fd)
+{
+    String8 out;
+
+    Mutex::Autolock lock(sRegistryLock);
+    if (sRegistry.isEmpty()) {
+        out.append("No MessageQueue stats, set bit 4 of camera.hal.perf to collect them\n");
+    }
+    for (size_t i = 0; i < sRegistry.size(); i++)
+        sRegistry[i]->append(out);
+    write(fd, out);
+}
+
+}; // namespace android
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_MESSAGE_QUEUE_STATS_H
+#define ANDROID_LIBCAMERA_MESSAGE_QUEUE_STATS_H
+
+#include <stdint.h>
+#include <utils/Timers.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+#include <utils/String8.h>
+
+namespace android {
+
+/**
+ * \class MessageQueueStats
+ *
+ * Per message id telemetry of one MessageQueue: how long messages wait in
+ * the queue, how long the receiving thread takes to handle them and how
+ * deep the queue is when they are received.
+ *
+ * A MessageQueue only creates its stats when the camera.hal.perf property
+ * has CAMERA_DEBUG_LOG_PERF_MESSAGE_QUEUE set, and only its receiving
+ * thread records into them. Every live instance is listed by dumpAll(),
+ * which backs the HAL dump() call ("dumpsys media.camera"), and an instance
+ * logs its own summary when its queue is destroyed.
+ */
+class MessageQueueStats {
+public:
+    MessageQueueStats(const char *name);
+    ~MessageQueueStats();
+
+    /**
+     * True if the queues created from now on should collect stats
+     */
+    static bool enabled();
+
+    /**
+     * Records a message taken from the queue
+     *
+     * \param id message id, ids out of range are accounted to the last slot
+     * \param sendTime systemTime() when the message was sent
+     * \param now systemTime() when the message was received
+     * \param depth messages in the queue including the received one
+     */
+    void received(int id, nsecs_t sendTime, nsecs_t now, int depth);
+
+    /**
+     * Records the time the receiving thread spent on a message, i.e. until
+     * it came back to receive()
+     */
+    void handled(int id, nsecs_t duration);
+
+    /**
+     * Writes the stats of every live queue to fd, or to the log if fd < 0
+     */
+    static void dumpAll(int fd);
+
+    static const int MAX_IDS = 64;
+
+// prevent copy constructor and assignment operator
+private:
+    MessageQueueStats(const MessageQueueStats& other);
+    MessageQueueStats& operator=(const MessageQueueStats& other);
+
+private:
+    // bucket i counts durations below 2^i us, the last one the rest
+    static const int HISTOGRAM_BUCKETS = 16;
+
+    struct Histogram {
+        uint32_t buckets[HISTOGRAM_BUCKETS];
+        uint32_t count;
+        int64_t sumUs;
+        int64_t maxUs;
+    };
+
+    struct IdStats {
+        Histogram delay;      /*!< send to receive */
+        Histogram handling;   /*!< receive to next receive */
+        int maxDepth;
+    };
+
+    static void addSample(Histogram *h, nsecs_t duration);
+    static void appendHistogram(String8 &out, const char *what, const Histogram &h);
+    void append(String8 &out);
+    static void write(int fd, const String8 &out);
+
+private:
+    const char *mName;
+    Mutex mLock;    /*!< protects mIds against dumpAll() */
+    IdStats mIds[MAX_IDS];
+
+    static Mutex sRegistryLock;
+    static Vector<MessageQueueStats*> sRegistry;
+};
+
+}; // namespace android
+
+#endif // ANDROID_LIBCAMERA_MESSAGE_QUEUE_STATS_H
@@ -32,6 +32,7 @@ OfflineBracket::OfflineBracket(AtomISP *atomISP, I3AControls *aaaControls, Brack
     ,mBurstLength(-1)
     ,mFpsAdaptSkip(0)
     ,mExpectedExpId(EXP_ID_INVALID)
+    ,mExpectedRequestId(0)
 {
     LOG1("@%s", __FUNCTION__);
     mBracketing = &mManager->mBracketing;
@@ -61,8 +62,13 @@ status_t OfflineBracket::startBracketing(int *expIdFrom)
 
     if (mBracketing->mode == BRACKET_EXPOSURE) {
         SensorAeConfig aeConfig[mBurstLength];
+        int requestIds[mBurstLength];
+        // frames report the index of the bracket value they got
+        for (int i = 0 ; i < mBurstLength ; i++)
+            requestIds[i] = i;
+        mExpectedRequestId = 0;
         // apply EV group
-        mExpectedExpId = m3AControls->applyEvGroup(mBracketing->values.get(), mBurstLength, aeConfig);
+        mExpectedExpId = m3AControls->applyEvGroup(mBracketing->values.get(), mBurstLength, aeConfig, requestIds);
         for (int i = 0 ; i < mBurstLength ; i++)
             mBracketingParams->push_front(aeConfig[i]);
 
@@ -114,7 +120,28 @@ status_t OfflineBracket::getSnapshot(AtomBuffer &snapshotBuf, AtomBuffer &postvi
         return status;
     }
 
-    if (snapshotBuf.expId != mExpectedExpId) {
+    // When the sensor knows the exposure of the frame, its request id says
+    // which bracket value the frame got, otherwise rely on the exp id.
+    // The raw buffers were picked by request id, a skipped one was lost:
+    // drop its aeConfig so that the exif of the frame is its own.
+    const FrameResult &result = snapshotBuf.result;
+    if (mBracketing->mode == BRACKET_EXPOSURE && result.valid) {
+        if (result.requestId > mExpectedRequestId) {
+            LOGW("snapshot exp id:%d got bracket %d, brackets %d to %d lost",
+                 snapshotBuf.expId, result.requestId, mExpectedRequestId,
+                 result.requestId - 1);
+            for (int i = mExpectedRequestId; i < result.requestId
+                 && !mBracketingParams->empty(); i++)
+                mBracketingParams->erase(--mBracketingParams->end());
+        } else if (result.requestId < mExpectedRequestId) {
+            LOGW("snapshot exp id:%d carries no new bracket", snapshotBuf.expId);
+        } else {
+            LOG1("snapshot exp id:%d bracket %d itime:%u gain:%u", snapshotBuf.expId,
+                 result.requestId, result.coarseIntegrationTime, result.analogGain);
+        }
+        if (result.requestId >= mExpectedRequestId)
+            mExpectedRequestId = result.requestId + 1;
+    } else if (snapshotBuf.expId != mExpectedExpId) {
         LOGW("get snapshot exp id:%d expected:%d", snapshotBuf.expId, mExpectedExpId);
     }
 
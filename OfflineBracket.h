@@ -65,6 +65,7 @@ private:
     int  mBurstLength;
     int  mFpsAdaptSkip;
     unsigned int mExpectedExpId;
+    int  mExpectedRequestId;    /*!< index of the bracket value the next frame should carry */
 
 }; // class OfflineBracket
 
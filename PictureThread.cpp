@@ -23,6 +23,7 @@
 #include "CallbacksThread.h"
 #include "ImageScaler.h"
 #include "MemoryUtils.h"
+#include "AtomBufferPool.h"
 #include "PlatformData.h"
 #include <utils/Timers.h>
 #include "SWJpegEncoder.h"
@@ -172,8 +173,9 @@ status_t PictureThread::encodeToJpeg(AtomBuffer *mainBuf, AtomBuffer *thumbBuf,
     // Start encoding main picture using HW encoder (except for panorama, which
     // often has resolution which the HW-encoder can't handle
     if (mainBuf->type != ATOM_BUFFER_PANORAMA && isAligned) {
+        // the encoder only reads the picture, the lines can stay cached
         if (!dataHasBeenFlushed)
-            MemoryUtils::flushMemory((char *)mainBuf->dataPtr, mainBuf->size);
+            MemoryUtils::writeBackMemory((char *)mainBuf->dataPtr, mainBuf->size);
 
         status = startHwEncoding(mainBuf);
         if(status != NO_ERROR) {
@@ -919,10 +921,7 @@ status_t PictureThread::allocateInputBuffers(AtomBuffer& formatDescriptor, int n
          * is signaled by the boolean registerToScaler. In other cases allocate
          * from HEAP as usual
          */
-        if (registerToScaler)
-            MemoryUtils::allocateGraphicBuffer(mInputBufferArray[i], formatDescriptor);
-        else
-            MemoryUtils::allocateAtomBuffer(mInputBufferArray[i], formatDescriptor, mCallbacks);
+        mCallbacks->bufferPool()->acquire(mInputBufferArray[i], formatDescriptor, registerToScaler);
 
         if (mInputBufferArray[i].dataPtr == NULL) {
             mInputBuffers = i;
@@ -970,7 +969,7 @@ void PictureThread::unregisterFromGpuScalerAndFree(AtomBuffer bufferArray[], int
             mScaler->unRegisterBuffer(bufferArray[i], ScalerService::SCALER_OUTPUT);
             bufferArray[i].gfxInfo.scalerId = -1;
         }
-        MemoryUtils::freeAtomBuffer(bufferArray[i]);
+        mCallbacks->bufferPool()->release(bufferArray[i]);
     }
 }
 
@@ -999,11 +998,7 @@ status_t PictureThread::allocatePostviewBuffers(const AtomBuffer &formatDescript
         postv.size = 0;
         postv.dataPtr = NULL;
 
-        if (registerToScaler) {
-            MemoryUtils::allocateGraphicBuffer(postv, formatDescriptor);
-        } else {
-            MemoryUtils::allocateAtomBuffer(postv, formatDescriptor, mCallbacks);
-        }
+        mCallbacks->bufferPool()->acquire(postv, formatDescriptor, registerToScaler);
 
         if (postv.dataPtr == NULL) {
             status = NO_MEMORY;
@@ -1366,7 +1361,6 @@ status_t PictureThread::doSwEncode(AtomBuffer *mainBuf, AtomBuffer* destBuf)
 {
     status_t status= NO_ERROR;
     nsecs_t endTime;
-    SWJpegEncoder swEncoder;
     SWJpegEncoder::InputBuffer inBuf;
     SWJpegEncoder::OutputBuffer outBuf;
     int finalSize = 0;
@@ -1388,7 +1382,7 @@ status_t PictureThread::doSwEncode(AtomBuffer *mainBuf, AtomBuffer* destBuf)
     outBuf.quality = mPictureQuality;
     outBuf.size = mOutBuf.size;
     endTime = systemTime();
-    int mainSize = swEncoder.encode(inBuf, outBuf) - sizeof(JPEG_MARKER_SOI) - SIZE_OF_APP0_MARKER;
+    int mainSize = mSwJpegEncoder.encode(inBuf, outBuf) - sizeof(JPEG_MARKER_SOI) - SIZE_OF_APP0_MARKER;
     LOG1("Picture JPEG size: %d (time to encode: %ums)", mainSize, (unsigned)((systemTime() - endTime) / 1000000));
     if (mainSize > 0) {
         finalSize = mExifBuf.size + mainSize;
@@ -25,6 +25,7 @@
 #include "AtomCommon.h"
 #include "EXIFMaker.h"
 #include "JpegHwEncoder.h"
+#include "SWJpegEncoder.h"
 #include "ScalerService.h"
 #include "IAtomIspObserver.h"
 
@@ -219,6 +220,7 @@ private:
     Callbacks       *mCallbacks;
     sp<CallbacksThread> mCallbacksThread;
     JpegHwEncoder   *mHwCompressor;
+    SWJpegEncoder   mSwJpegEncoder; /*!< kept for the session so its encoder threads are reused */
     EXIFMaker       *mExifMaker;
     AtomBuffer      mExifBuf;
     AtomBuffer      mOutBuf;
@@ -1321,6 +1321,30 @@ int PlatformData::getMaxNumYUVBufferForBracket(int cameraId)
     return getInstance()->mCameras[getActiveCamIdx(cameraId)].maxNumYUVBufferForBracket;
 }
 
+int PlatformData::getCaptureMemoryBudgetMB(int cameraId)
+{
+    if (!validCameraId(cameraId, __FUNCTION__)) {
+        return 0;
+    }
+    return getInstance()->mCameras[getActiveCamIdx(cameraId)].captureMemoryBudgetMB;
+}
+
+int PlatformData::getGbceStride(int cameraId)
+{
+    if (!validCameraId(cameraId, __FUNCTION__)) {
+        return 1;
+    }
+    return getInstance()->mCameras[getActiveCamIdx(cameraId)].gbceStride;
+}
+
+int PlatformData::getDsdStride(int cameraId)
+{
+    if (!validCameraId(cameraId, __FUNCTION__)) {
+        return 1;
+    }
+    return getInstance()->mCameras[getActiveCamIdx(cameraId)].dsdStride;
+}
+
 bool PlatformData::supportDualVideo(void)
 {
     return getInstance()->mSupportDualVideo;
@@ -1028,6 +1028,29 @@ class PlatformData {
     */
     static int getMaxNumYUVBufferForBracket(int cameraId);
 
+    /**
+     * Returns the memory budget of the snapshot, postview and raw
+     * ringbuffer buffers of one capture sequence
+     *
+     * \return the budget in MB, 0 if the counts are not limited by memory
+    */
+    static int getCaptureMemoryBudgetMB(int cameraId);
+
+    /**
+     * Returns how often GBCE runs on preview and video frames
+     *
+     * \return 1 to run it on every 3A iteration, N for every Nth
+    */
+    static int getGbceStride(int cameraId);
+
+    /**
+     * Returns how often smart scene detection (DSD) runs on preview and
+     * video frames
+     *
+     * \return 1 to run it on every 3A iteration, N for every Nth
+    */
+    static int getDsdStride(int cameraId);
+
     /**
      * Returns Graphics HAL pixel format
      * \return the pixel format
@@ -1458,6 +1481,9 @@ protected:
             synchronizeExposure = false;
             maxNumYUVBufferForBurst = 10;
             maxNumYUVBufferForBracket = 10;
+            captureMemoryBudgetMB = 0;
+            gbceStride = 1;
+            dsdStride = 1;
             useHALVS = false;
             // FOV
             verticalFOV = "";
@@ -1618,6 +1644,18 @@ protected:
          */
         int maxNumYUVBufferForBurst;
         int maxNumYUVBufferForBracket;
+        /**
+         * Memory budget (MB) of the capture buffers, the snapshot buffer
+         * counts above are reduced to fit in it. 0 disables the budget.
+         */
+        int captureMemoryBudgetMB;
+
+        /**
+         * GBCE and scene detection run on every Nth 3A iteration of
+         * preview and video, the other algorithms on every one.
+         */
+        int gbceStride;
+        int dsdStride;
 
         // FOV
         String8 verticalFOV;
@@ -35,7 +35,7 @@ PostProcThread::PostProcThread(ICallbackPostProc *postProcDone, PanoramaThread *
     ,Thread(true) // callbacks may call into java
     ,mFaceDetector(NULL)
     ,mPanoramaThread(panoramaThread)
-    ,mMessageQueue("PostProcThread", (int) MESSAGE_ID_MAX)
+    ,mMessageQueue("PostProcThread", (int) MESSAGE_ID_MAX, MESSAGE_QUEUE_FRAME_LANE_SIZE)
     ,mLastReportedNumberOfFaces(0)
     ,mCallbacks(callbacks)
     ,mPostProcDoneCallback(postProcDone)
@@ -593,7 +593,7 @@ int PostProcThread::sendFrame(AtomBuffer *img)
         LOGW("@%s: NULL AtomBuffer frame", __FUNCTION__);
     }
 
-    if (mMessageQueue.send(&msg) == NO_ERROR)
+    if (mMessageQueue.sendFrame(&msg) == NO_ERROR)
         return 0;
     else
         return -1;
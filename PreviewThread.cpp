@@ -47,7 +47,7 @@ void release_camera_memory_t(struct camera_memory *mem)
 
 PreviewThread::PreviewThread(sp<CallbacksThread> callbacksThread, Callbacks* callbacks, int cameraId, IHWIspControl *ispControl) :
     Thread(true) // callbacks may call into java
-    ,mMessageQueue("PreviewThread", (int) MESSAGE_ID_MAX)
+    ,mMessageQueue("PreviewThread", (int) MESSAGE_ID_MAX, MESSAGE_QUEUE_FRAME_LANE_SIZE)
     ,mThreadRunning(false)
     ,mState(STATE_STOPPED)
     ,mLastFrameTs(0)
@@ -441,7 +441,7 @@ status_t PreviewThread::preview(AtomBuffer *buff)
     Message msg;
     msg.id = MESSAGE_ID_PREVIEW;
     msg.data.preview.buff = *buff;
-    return mMessageQueue.send(&msg);
+    return mMessageQueue.sendFrame(&msg);
 }
 
 /**
@@ -2131,9 +2131,11 @@ void PreviewThread::copyPreviewBuffer(AtomBuffer* src, AtomBuffer* dst)
                        (const char*)src->dataPtr,               // source image
                        (char *)dst->dataPtr);                 // target image
         break;
+    case 180:
     case 270:
-        // TODO: Not handled, waiting for Semi
-        LOGE("@%s: 270 case not handled", __FUNCTION__);
+        nv12rotate(mRotation, false,
+                   src->width, src->height, src->bpl, dst->bpl,
+                   (const char*)src->dataPtr, (char *)dst->dataPtr);
         break;
     case 0:
         memcpy((char *)dst->dataPtr, (const char*)src->dataPtr, dst->size);
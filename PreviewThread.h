@@ -152,7 +152,7 @@ public:
     void getDefaultParameters(CameraParameters *params, int cameraId);
     void setCallbackPreviewSize(int width, int height, int videoMode);
     bool isWindowConfigured();
-    status_t preview(AtomBuffer *buff);
+    status_t preview(AtomBuffer *buff); // frame lane, one calling thread only
     status_t postview(AtomBuffer *buff, bool hidePreview = false, bool synchronous = false);
     status_t setPreviewWindow(struct preview_stream_ops *window);
     status_t setPreviewConfig(int preview_width, int preview_height,
@@ -29,6 +29,13 @@ SWJpegEncoder::SWJpegEncoder() :
     ,mTotalWidth(0)
     ,mTotalHeight(0)
     ,mDstBuf(NULL)
+    ,mCPUCoresNum(1)
+    ,mNextStripe(0)
+    ,mMergedStripes(0)
+    ,mMergeBusy(false)
+    ,mMergeFailed(false)
+    ,mMergedSize(0)
+    ,mStopWorkers(false)
 {
     LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
 }
@@ -36,6 +43,7 @@ SWJpegEncoder::SWJpegEncoder() :
 SWJpegEncoder::~SWJpegEncoder()
 {
     LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
+    stopWorkers();
 }
 
 /**
@@ -50,6 +58,7 @@ SWJpegEncoder::~SWJpegEncoder()
  */
 int SWJpegEncoder::encode(const InputBuffer &in, const OutputBuffer &out)
 {
+    Mutex::Autolock lock(mEncodeLock);
     int status;
     nsecs_t startTime = systemTime();
 
@@ -148,7 +157,8 @@ exit:
 /**
  * encode jpeg by calling the SWJpegEncoder which is the libjpeg wrapper
  * multi thread.
- * the thread number depends on the CPU number.
+ * the picture is split into stripes which are encoded by the persistent
+ * worker pool, the thread number depends on the CPU number.
  *
  * \param in: input buffer description
  * \param out: output param description
@@ -160,94 +170,151 @@ int SWJpegEncoder::swEncodeMultiThread(const InputBuffer &in, const OutputBuffer
     LOG1("@%s, line:%d, use the libjpeg to do sw jpeg encoding", __FUNCTION__, __LINE__);
     int status = 0;
 
-    init(mCPUCoresNum);
-    config(in, out);
+    if (startWorkers(mCPUCoresNum) != NO_ERROR) {
+        LOGW("@%s, no encoder threads, fall back to single thread", __FUNCTION__);
+        return swEncode(in, out);
+    }
 
-    status = doJpegEncodingMultiThread();
-    if (status)
-        goto exit;
+    if (config(in, out) != NO_ERROR) {
+        LOGW("@%s, output buffer too small for the stripes, fall back to single thread", __FUNCTION__);
+        return swEncode(in, out);
+    }
 
-exit:
-    mJpegSize = status ? -1 : mergeJpeg();
-    deInit();
+    status = doJpegEncodingMultiThread();
+    if (status) {
+        // usually a stripe coded larger than its part of the output buffer
+        LOGW("@%s, striped encoding failed, encoding again in a single thread", __FUNCTION__);
+        return swEncode(in, out);
+    }
+    mJpegSize = mMergedSize;
 
-    return (status ? -1 : 0);
+    return 0;
 }
 
 /**
- * Initialize for the multi thread jpeg encoding
+ * Start the pool threads for the multi thread jpeg encoding
+ *
+ * The pool is kept across pictures, it is only re-created when the
+ * requested thread number changes.
  *
- * it will create n CodecWorkerThread by according to the thread number.
+ * \param threadNum: the wanted number of threads
+ * \return NO_ERROR if the pool is running
  */
-void SWJpegEncoder::init(unsigned int threadNum)
+status_t SWJpegEncoder::startWorkers(unsigned int threadNum)
 {
     unsigned int num = CLIP(threadNum, MAX_THREAD_NUM, MIN_THREAD_NUM);
     LOG1("@%s, line:%d, thread number, pass:%d, real:%d", __FUNCTION__, __LINE__, threadNum, num);
+    status_t status = NO_ERROR;
+
+    if (mWorkers.size() == num)
+        return NO_ERROR;
+
+    stopWorkers();
 
     for (unsigned int i = 0; i < num; i++) {
-        mSwJpegEncoder.push(new CodecWorkerThread);
+        String8 threadName = String8::format("CamHAL_SWJpegEncoder:%d", i);
+        sp<CodecWorkerThread> encThread = new CodecWorkerThread(this);
+        status = encThread->run(threadName.string());
+        if (status != NO_ERROR) {
+            LOGE("@%s, line:%d, start jpeg thread fail, thread name:%s", __FUNCTION__, __LINE__, threadName.string());
+            stopWorkers();
+            return status;
+        }
+        mWorkers.push(encThread);
     }
+
+    return NO_ERROR;
 }
 
 /**
- * deInit for the multi thread jpeg encoding
- *
- * it will release all n CodecWorkerThread
+ * Stop and release all the pool threads
  */
-void SWJpegEncoder::deInit(void)
+void SWJpegEncoder::stopWorkers(void)
 {
     LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
-    for (unsigned int i = 0; i < mSwJpegEncoder.size(); i++) {
-        mSwJpegEncoder.editItemAt(i).clear();
+    if (mWorkers.isEmpty())
+        return;
+
+    mStripeLock.lock();
+    mStopWorkers = true;
+    mStripeAvailable.broadcast();
+    mStripeLock.unlock();
+
+    for (unsigned int i = 0; i < mWorkers.size(); i++) {
+        mWorkers.editItemAt(i)->requestExitAndWait();
     }
-    mSwJpegEncoder.removeItemsAt(0, mSwJpegEncoder.size());
-    mSwJpegEncoder.clear();
+    mWorkers.clear();
+
+    mStripeLock.lock();
+    mStopWorkers = false;
+    mStripeLock.unlock();
 }
 
 /**
- * configue every thread for multi thread jpeg
+ * split the picture into stripes for the multi thread jpeg encoding
+ *
+ * All stripes but the last one have the same height, aligned to the MCU,
+ * since the stripe height gives the restart interval of the final jpeg.
+ * Each stripe is encoded straight into its own part of the output buffer,
+ * sized in proportion to its lines, and mergeStripe() moves it down to the
+ * end of the stripes stitched before it. The first stripe lands in place.
  *
  * \param in: input buffer description
  * \param out: output param description
+ * \return BAD_VALUE if a part of the output buffer cannot hold a stripe's headers
  */
-void SWJpegEncoder::config(const InputBuffer &in, const OutputBuffer &out)
+status_t SWJpegEncoder::config(const InputBuffer &in, const OutputBuffer &out)
 {
     LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
-    sp<CodecWorkerThread> encThread;
-    CodecWorkerThread::CodecConfig cfg;
-
-    for (unsigned int i = 0; i < mSwJpegEncoder.size(); i++) {
-        cfg.width = in.width;
-        /*
-            for example, there are 4 threads.
-            the first 3 threads must align to 16 which is NV12_MCU_SIZE
-            but for the last thread, it doesn't have this request.
-        */
-        cfg.height = ALIGN16(in.height / mSwJpegEncoder.size());
-        cfg.fourcc = in.fourcc;
-        cfg.inBufY = in.buf + cfg.width * cfg.height * i;
-        cfg.inBufUV = (cfg.fourcc == V4L2_PIX_FMT_NV12)
-            ? (in.buf + in.width * in.height + cfg.width * cfg.height * i / 2)
-            : NULL;
-        cfg.quality = out.quality;
-        cfg.outBufSize = (out.size - DEST_BUF_OFFSET) / mSwJpegEncoder.size();
-        cfg.outBuf = out.buf + DEST_BUF_OFFSET + cfg.outBufSize * i;
-        /* update the last thread's height */
-        if (i == mSwJpegEncoder.size() - 1)
-            cfg.height = in.height - cfg.height * (mSwJpegEncoder.size() - 1);
-
-        encThread = mSwJpegEncoder.editItemAt(i);
-        encThread->setConfig(cfg);
-        LOG1("@%s, line:%d, the %d picture thread cfg", __FUNCTION__, __LINE__, i);
-        LOG1("@%s, line:%d, cfg.width:%d, cfg.height:%d", __FUNCTION__, __LINE__, cfg.width, cfg.height);
-        LOG1("@%s, line:%d, cfg.fourcc:%s 0x%x, cfg.quality:%d", __FUNCTION__, __LINE__, v4l2Fmt2Str(cfg.fourcc), cfg.fourcc, cfg.quality);
-        LOG1("@%s, line:%d, cfg.inBufY:0x%p, cfg.inBufUV:0x%p", __FUNCTION__, __LINE__, cfg.inBufY, cfg.inBufUV);
-        LOG1("@%s, line:%d, cfg.outBuf:0x%p, cfg.outBufSize:%d", __FUNCTION__, __LINE__, cfg.outBuf, cfg.outBufSize);
+    Stripe stripe;
+    const int lumaBpl = (in.fourcc == V4L2_PIX_FMT_YUYV) ? in.width * 2 : in.width;
+    const int mcusPerRow = (in.width + NV12_MCU_SIZE - 1) / NV12_MCU_SIZE;
+    int stripeNum = mWorkers.size() * STRIPES_PER_THREAD;
+    int stripeHeight = ALIGN16((in.height + stripeNum - 1) / stripeNum);
+
+    stripeHeight = MAX(stripeHeight, MIN_STRIPE_HEIGHT);
+    // the restart interval is a 16 bit MCU count
+    stripeHeight = MIN(stripeHeight, (0xFFFF / mcusPerRow) * NV12_MCU_SIZE);
+    stripeNum = (in.height + stripeHeight - 1) / stripeHeight;
+    const int restartInterval = (stripeNum > 1) ? (stripeHeight / NV12_MCU_SIZE) * mcusPerRow : 0;
+    // the EOI is written after the last stripe
+    const int64_t outSize = out.size - 2;
+
+    Mutex::Autolock lock(mStripeLock);
+    mStripes.clear();
+    for (int i = 0; i < stripeNum; i++) {
+        stripe.width = in.width;
+        stripe.height = MIN(stripeHeight, in.height - stripeHeight * i);
+        stripe.fourcc = in.fourcc;
+        stripe.inBufY = in.buf + lumaBpl * stripeHeight * i;
+        stripe.inBufUV = (in.fourcc == V4L2_PIX_FMT_YUYV)
+            ? NULL
+            : (in.buf + in.width * in.height + in.width * stripeHeight * i / 2);
+        stripe.quality = out.quality;
+        int outStart = outSize * stripeHeight * i / in.height;
+        int outEnd = outSize * MIN(stripeHeight * (i + 1), in.height) / in.height;
+        stripe.outBuf = out.buf + outStart;
+        stripe.outBufSize = outEnd - outStart;
+        if (stripe.outBufSize < STRIPE_HEADERS_SIZE) {
+            mStripes.clear();
+            return BAD_VALUE;
+        }
+        stripe.restartInterval = restartInterval;
+        stripe.dataSize = STRIPE_NOT_DONE;
+        mStripes.push(stripe);
     }
+    // nothing to hand out until doJpegEncodingMultiThread() starts the run
+    mNextStripe = mStripes.size();
+    mMergedStripes = mStripes.size();
+
+    LOG1("@%s, line:%d, %d stripes of %d lines, fourcc:%s, quality:%d", __FUNCTION__, __LINE__,
+         stripeNum, stripeHeight, v4l2Fmt2Str(in.fourcc), out.quality);
+    return NO_ERROR;
 }
 
 /**
- * the function will trigger the multi jpeg encoding
+ * the function will hand the configured stripes to the pool and wait
+ * until all of them have been encoded and stitched into mDstBuf
  *
  * \return 0 if encoding was successful
  * \return -1 if encoding failed
@@ -255,201 +322,300 @@ void SWJpegEncoder::config(const InputBuffer &in, const OutputBuffer &out)
 int SWJpegEncoder::doJpegEncodingMultiThread(void)
 {
     LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
-    sp<CodecWorkerThread> encThread;
-    status_t status = UNKNOWN_ERROR;
-    String8 threadName("CamHAL_SWEncodeMultiThread");
-
-    /* run all threads */
-    for (unsigned int i = 0; i <mSwJpegEncoder.size(); i++) {
-        threadName.appendFormat(":%d", i);
-        LOG1("@%s, new sw jpeg thread name:%s", __FUNCTION__, threadName.string());
-        encThread = mSwJpegEncoder.editItemAt(i);
-        status = encThread->runThread(threadName.string());
-        if (status != NO_ERROR) {
-            LOGE("@%s, line:%d, start jpeg thread fail, thread name:%s", __FUNCTION__, __LINE__, threadName.string());
-            return -1;
-        }
-    }
+    Mutex::Autolock lock(mStripeLock);
 
-    /* wait all threads to finish */
-    for (unsigned int i = 0; i < mSwJpegEncoder.size(); i++) {
-        LOG1("@%s, the %d sw jpeg encoder thread before join!", __FUNCTION__, i);
-        encThread = mSwJpegEncoder.editItemAt(i);
-        encThread->waitThreadFinish();
-    }
+    mNextStripe = 0;
+    mMergedStripes = 0;
+    mMergeFailed = false;
+    mMergedSize = 0;
+    mStripeAvailable.broadcast();
+
+    while (mMergedStripes < mStripes.size() || mMergeBusy)
+        mStripesDone.wait(mStripeLock);
+
+    if (mMergeFailed)
+        return -1;
+
+    /* Write EOI */
+    mDstBuf[mMergedSize++] = 0xFF;
+    mDstBuf[mMergedSize++] = 0xD9;
 
     return 0;
 }
 
 /**
- * the function will merge all jpeg pictures which are generated in multi threads
- * to one jpeg picture
+ * take the next stripe to encode, it blocks until one is available
  *
- * \return int the merged jpeg size
+ * \param index: the index of the taken stripe
+ * \param stripe: a copy of the taken stripe
+ * \return false if the pool is stopping
  */
-int SWJpegEncoder::mergeJpeg(void)
+bool SWJpegEncoder::acquireStripe(unsigned int *index, Stripe *stripe)
 {
-#define HEADER_TOTAL_LEN 623
-#define HEADER_SOS_LEN 14
-#define HEADER_EOI_LEN 2
-#define HEADER_HEIGHT_POS 163
-#define HEADER_WIDTH_POS 165
-#define NV12_MCU_SIZE 16
-    LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
-    int size = 0;
-    CodecWorkerThread::CodecConfig cfg;
-    nsecs_t startTime;
-    sp<CodecWorkerThread> encThread = mSwJpegEncoder.editItemAt(0);
-    encThread->getConfig(&cfg);
-
-    /* Write the JPEG header */
-    memcpy(mDstBuf, cfg.outBuf, HEADER_TOTAL_LEN - HEADER_SOS_LEN);
-    size = HEADER_TOTAL_LEN - HEADER_SOS_LEN;
-
-    /* Update the width and height info */
-    mDstBuf[HEADER_HEIGHT_POS] = (mTotalHeight >> 8) & 0xFF;
-    mDstBuf[HEADER_HEIGHT_POS+1] = mTotalHeight & 0xFF;
-    mDstBuf[HEADER_WIDTH_POS] = (mTotalWidth >> 8) & 0xFF;
-    mDstBuf[HEADER_WIDTH_POS+1] = mTotalWidth & 0xFF;
-
-    /* Write the restarting interval */
-    if (mSwJpegEncoder.size() > 1) {
-        unsigned int MCUs = (cfg.height / NV12_MCU_SIZE) * (cfg.width / NV12_MCU_SIZE);
-        mDstBuf[size++] = 0xFF;
-        mDstBuf[size++] = 0xDD;
-        mDstBuf[size++] = 0;
-        mDstBuf[size++] = 4;
-        mDstBuf[size++] = (MCUs >> 8) & 0xFF;
-        mDstBuf[size++] = MCUs & 0xFF;
-    }
+    Mutex::Autolock lock(mStripeLock);
 
-    /* Write the SOS */
-    memcpy((void *)((unsigned int)mDstBuf + size),
-            (void *)((unsigned int)cfg.outBuf + HEADER_TOTAL_LEN - HEADER_SOS_LEN),
-            HEADER_SOS_LEN);
-    size += HEADER_SOS_LEN;
-
-    /* Write coded segments */
-    for (unsigned int i = 0; i <mSwJpegEncoder.size(); i++) {
-        encThread = mSwJpegEncoder.editItemAt(i);
-        startTime = systemTime();
-        encThread->getConfig(&cfg);
-        memmove((void *)((unsigned int)mDstBuf + size),
-               (void *)((unsigned int)cfg.outBuf + HEADER_TOTAL_LEN),
-               (encThread->getJpegDataSize() - HEADER_TOTAL_LEN - HEADER_EOI_LEN));
-        LOG1("@%s, wr %d segments, size:%d, consume:%ums", __FUNCTION__, i, (encThread->getJpegDataSize()- HEADER_TOTAL_LEN - HEADER_EOI_LEN), (unsigned)((systemTime() - startTime) / 1000000));
-        size += (encThread->getJpegDataSize() - HEADER_TOTAL_LEN - HEADER_EOI_LEN);
-
-        if (i != (mSwJpegEncoder.size() - 1)) {
-            mDstBuf[size++] = 0xFF;
-            mDstBuf[size++] = (i & 0x7) | 0xD0;
-        }
-    }
+    while (!mStopWorkers && mNextStripe >= mStripes.size())
+        mStripeAvailable.wait(mStripeLock);
 
-    /* Write EOI */
-    mDstBuf[size++]= 0xFF;
-    mDstBuf[size++]= 0xD9;
+    if (mStopWorkers)
+        return false;
 
-    return size;
+    *index = mNextStripe++;
+    *stripe = mStripes[*index];
+    return true;
 }
 
-SWJpegEncoder::CodecWorkerThread::CodecWorkerThread() :
-    mDataSize(-1)
+/**
+ * record the result of one stripe and stitch every stripe which is now
+ * contiguous with the already stitched ones
+ *
+ * Stitching is done by one worker at a time outside of the lock, while the
+ * other workers keep encoding, and the encode caller is woken up when the
+ * last stripe has been stitched.
+ *
+ * \param index: the index of the stripe
+ * \param dataSize: the coded size, -1 if the encoding failed
+ */
+void SWJpegEncoder::stripeDone(unsigned int index, int dataSize)
 {
-    LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
+    Mutex::Autolock lock(mStripeLock);
+
+    mStripes.editItemAt(index).dataSize = dataSize;
+    if (mMergeBusy)
+        return;
+
+    mMergeBusy = true;
+    while (mMergedStripes < mNextStripe
+           && mStripes[mMergedStripes].dataSize != STRIPE_NOT_DONE) {
+        unsigned int merge = mMergedStripes;
+        Stripe stripe = mStripes[merge];
+        bool failed = mMergeFailed;
+
+        mStripeLock.unlock();
+        if (!failed)
+            failed = !mergeStripe(stripe, merge);
+        mStripeLock.lock();
+
+        mMergeFailed = failed;
+        mMergedStripes++;
+    }
+    mMergeBusy = false;
+    mStripesDone.signal();
 }
 
-SWJpegEncoder::CodecWorkerThread::~CodecWorkerThread()
+/**
+ * stitch one stripe jpeg into the final jpeg at mDstBuf
+ *
+ * The first stripe has been encoded in place, only its SOF dimensions are
+ * rewritten and its EOI dropped. The entropy coded data of the following
+ * stripes is moved down from their part of mDstBuf to right after the data
+ * stitched so far, each preceded by the restart marker that ends the
+ * previous interval. Every stitched stripe ends within its own part, so
+ * the data moved is never overwritten before it is read. Where a stripe's
+ * data ends is only known once the stripes before it are coded, so it
+ * cannot be encoded at its final position and the move is the only copy.
+ *
+ * \param stripe: the encoded stripe
+ * \param index: the stripe index in the picture
+ * \return true if the stripe was stitched
+ */
+bool SWJpegEncoder::mergeStripe(const Stripe &stripe, unsigned int index)
 {
-    LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
+    JpegLayout layout;
+    unsigned char *src = (unsigned char *)stripe.outBuf;
+
+    if (stripe.dataSize < 0 || stripe.dataSize > stripe.outBufSize
+        || !parseJpeg(src, stripe.dataSize, &layout)) {
+        LOGE("@%s, line:%d, bad jpeg for stripe %d, size:%d", __FUNCTION__, __LINE__, index, stripe.dataSize);
+        return false;
+    }
+    if (layout.restartInterval != stripe.restartInterval) {
+        LOGE("@%s, line:%d, stripe %d restart interval %d, expected %d", __FUNCTION__, __LINE__,
+             index, layout.restartInterval, stripe.restartInterval);
+        return false;
+    }
+
+    if (index == 0) {
+        // SOFn: length(2), precision(1), height(2), width(2)
+        src[layout.sofPos + 5] = (mTotalHeight >> 8) & 0xFF;
+        src[layout.sofPos + 6] = mTotalHeight & 0xFF;
+        src[layout.sofPos + 7] = (mTotalWidth >> 8) & 0xFF;
+        src[layout.sofPos + 8] = mTotalWidth & 0xFF;
+        mMergedSize = layout.eoiPos;
+        return true;
+    }
+
+    int segmentSize = layout.eoiPos - layout.entropyPos;
+    // the restart marker must not reach the data to move
+    if (mDstBuf + mMergedSize + 2 > src + layout.entropyPos) {
+        LOGE("@%s, line:%d, stripe %d overlaps the stitched data, merged:%d, offset:%d", __FUNCTION__,
+             __LINE__, index, mMergedSize, (int)(src - mDstBuf));
+        return false;
+    }
+    mDstBuf[mMergedSize++] = 0xFF;
+    mDstBuf[mMergedSize++] = JPEG_MARKER_RST0 | ((index - 1) & 0x7);
+    memmove(mDstBuf + mMergedSize, src + layout.entropyPos, segmentSize);
+    mMergedSize += segmentSize;
+    LOG2("@%s, stripe %d, segment size:%d, total:%d", __FUNCTION__, index, segmentSize, mMergedSize);
+
+    return true;
 }
 
 /**
- * run one thread for multi thread jpeg encoding
- *
- * \param name: the thread name
+ * locate the markers of a baseline jpeg
+ *
+ * It walks the marker segments from SOI to SOS, the entropy coded data
+ * is expected to run from the end of the SOS segment up to the EOI which
+ * ends the buffer. Every segment is checked against the buffer size and
+ * the SOFn and SOS lengths against their component counts, so that the
+ * positions returned can be written to.
+ *
+ * \param buf: the jpeg data
+ * \param size: the jpeg size
+ * \param layout: the found marker positions
+ * \return true if the jpeg has the expected structure
  */
-status_t SWJpegEncoder::CodecWorkerThread::runThread(const char *name)
+bool SWJpegEncoder::parseJpeg(const unsigned char *buf, int size, JpegLayout *layout)
 {
-    LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
-    return this->run(name);
+    int pos = 2;
+
+    layout->sofPos = -1;
+    layout->restartInterval = 0;
+    layout->entropyPos = -1;
+    layout->eoiPos = -1;
+
+    if (size < 4 || buf[0] != 0xFF || buf[1] != JPEG_MARKER_SOI)
+        return false;
+    if (buf[size - 2] != 0xFF || buf[size - 1] != JPEG_MARKER_EOI)
+        return false;
+
+    while (pos + 4 <= size) {
+        if (buf[pos] != 0xFF)
+            return false;
+        unsigned char marker = buf[pos + 1];
+        if (marker == 0xFF) {  // fill byte
+            pos++;
+            continue;
+        }
+        // markers without a segment (TEM, RSTn, SOI, EOI) cannot come before SOS
+        if (marker == 0x01 || (marker >= JPEG_MARKER_RST0 && marker <= JPEG_MARKER_EOI))
+            return false;
+        int length = (buf[pos + 2] << 8) | buf[pos + 3];
+        if (length < 2 || pos + 2 + length > size)
+            return false;
+
+        switch (marker) {
+        case JPEG_MARKER_SOF0:
+        case JPEG_MARKER_SOF1:
+        case JPEG_MARKER_SOF2:
+            // length(2), precision(1), height(2), width(2), components(1), 3 bytes per component
+            if (length < 8 || buf[pos + 9] == 0 || length != 8 + 3 * buf[pos + 9])
+                return false;
+            layout->sofPos = pos;
+            break;
+        case JPEG_MARKER_DRI:
+            if (length != 4)
+                return false;
+            layout->restartInterval = (buf[pos + 4] << 8) | buf[pos + 5];
+            break;
+        case JPEG_MARKER_SOS:
+            // length(2), components(1), 2 bytes per component, spectral selection(3)
+            if (layout->sofPos < 0 || length < 6 || buf[pos + 4] == 0
+                || length != 6 + 2 * buf[pos + 4])
+                return false;
+            layout->entropyPos = pos + 2 + length;
+            layout->eoiPos = size - 2;
+            return layout->entropyPos <= layout->eoiPos;
+        default:
+            break;
+        }
+        pos += 2 + length;
+    }
+
+    return false;
 }
 
-/**
- * wait one thread until it has finished
- *
- */
-void SWJpegEncoder::CodecWorkerThread::waitThreadFinish(void)
+SWJpegEncoder::CodecWorkerThread::CodecWorkerThread(SWJpegEncoder *owner) :
+    Thread(false)
+    ,mOwner(owner)
+    ,mCodec(NULL)
 {
     LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
-    this->join();
-    this->requestExitAndWait();
 }
 
-/**
- * get jpeg size which is done in one thread
- *
- * \return int the coded jpeg size
- */
-int SWJpegEncoder::CodecWorkerThread::getJpegDataSize(void)
+SWJpegEncoder::CodecWorkerThread::~CodecWorkerThread()
 {
     LOG1("@%s, line:%d", __FUNCTION__, __LINE__);
-    return mDataSize;
+    if (mCodec != NULL) {
+        mCodec->deInit();
+        delete mCodec;
+        mCodec = NULL;
+    }
 }
 
 /**
- * the thread exe function for one jpeg thread
- * when the encoding has been done, it will return false to terminate the thread
+ * the thread exe function for one pool thread
+ * it encodes one stripe per loop, and returns false to terminate the thread
+ * when the pool is stopped
  *
- * \return false
+ * \return false if the pool is stopping
  */
 bool SWJpegEncoder::CodecWorkerThread::threadLoop()
 {
-    LOG1("@%s, line:%d, in CodecWorkerThread", __FUNCTION__, __LINE__);
+    unsigned int index;
+    Stripe stripe;
+
+    if (!mOwner->acquireStripe(&index, &stripe))
+        return false;
+
+    LOG1("@%s, line:%d, stripe %d in CodecWorkerThread", __FUNCTION__, __LINE__, index);
     nsecs_t startTime = systemTime();
-    int ret = swEncode();
-    LOG1("@%s one swEncode done!, consume:%ums, ret:%d", __FUNCTION__, (unsigned)((systemTime() - startTime) / 1000000), ret);
+    int dataSize = swEncode(stripe);
+    LOG1("@%s one swEncode done!, consume:%ums, size:%d", __FUNCTION__, (unsigned)((systemTime() - startTime) / 1000000), dataSize);
 
-    return false;
+    mOwner->stripeDone(index, dataSize);
+    return true;
 }
 
 /**
- * this function will call the SWJpegEncoder to encode one jpeg.
+ * this function will call the Codec to encode one stripe.
  * it's the main function of the threadLoop
  *
- * \return 0 if encoding was successful
+ * \param stripe: the stripe to encode
+ * \return the coded size if encoding was successful
  * \return -1 if encoding failed
  */
-int SWJpegEncoder::CodecWorkerThread::swEncode(void)
+int SWJpegEncoder::CodecWorkerThread::swEncode(const Stripe &stripe)
 {
     LOG1("@%s, line:%d, in CodecWorkerThread", __FUNCTION__, __LINE__);
     int status = 0;
-    Codec encoder(mCfg.quality);
+    int dataSize = -1;
 
-    encoder.init();
-    encoder.setJpegQuality(mCfg.quality);
-    status = encoder.configEncoding(mCfg.width, mCfg.height,
-                            (JSAMPLE *)mCfg.outBuf, mCfg.outBufSize);
-    if (status)
-        goto exit;
+    if (mCodec == NULL) {
+        mCodec = new Codec(stripe.quality);
+        mCodec->init();
+    }
 
-    status = encoder.doJpegEncoding(mCfg.inBufY, mCfg.inBufUV, mCfg.fourcc);
+    mCodec->setJpegQuality(stripe.quality);
+    mCodec->setRestartInterval(stripe.restartInterval);
+    status = mCodec->configEncoding(stripe.width, stripe.height,
+                            (JSAMPLE *)stripe.outBuf, stripe.outBufSize);
     if (status)
-        goto exit;
+        return -1;
 
-exit:
+    status = mCodec->doJpegEncoding(stripe.inBufY, stripe.inBufUV, stripe.fourcc);
     if (status)
-        mDataSize = -1;
-    else
-        encoder.getJpegSize(&mDataSize);
-
-    encoder.deInit();
+        return -1;
 
-    return (status ? -1 : 0);
+    mCodec->getJpegSize(&dataSize);
+    return dataSize;
 }
 
 SWJpegEncoder::Codec::Codec(int quality) :
     mJpegQuality(CLIP(quality, 100, 1))
+    ,mRestartInterval(0)
+    ,mStripBuf(NULL)
+    ,mStripBufSize(0)
 {
     LOG1("@%s", __FUNCTION__);
 }
@@ -457,6 +623,8 @@ SWJpegEncoder::Codec::Codec(int quality) :
 SWJpegEncoder::Codec::~Codec()
 {
     LOG1("@%s", __FUNCTION__);
+    free(mStripBuf);
+    mStripBuf = NULL;
 }
 
 /**
@@ -495,6 +663,17 @@ void SWJpegEncoder::Codec::setJpegQuality(int quality)
     mJpegQuality = CLIP(quality, 100, 1);
 }
 
+/**
+ * Set the restart interval
+ *
+ * \param mcus: the number of MCUs between restart markers, 0 for none
+ */
+void SWJpegEncoder::Codec::setRestartInterval(int mcus)
+{
+    LOG1("@%s, mcus:%d", __FUNCTION__, mcus);
+    mRestartInterval = CLIP(mcus, 0xFFFF, 0);
+}
+
 /**
  * Config the SW jpeg encoder.
  *
@@ -526,6 +705,7 @@ configEncoding(int width, int height, void *jpegBuf, int jpegBufSize)
     jpeg_set_defaults(&mCInfo);
     jpeg_set_colorspace(&mCInfo, (J_COLOR_SPACE)SUPPORTED_FORMAT);
     jpeg_set_quality(&mCInfo, mJpegQuality, TRUE);
+    mCInfo.restart_interval = mRestartInterval;
     mCInfo.raw_data_in = TRUE;
     mCInfo.dct_method = JDCT_ISLOW;
     mCInfo.comp_info[0].h_samp_factor = 2;
@@ -542,7 +722,10 @@ configEncoding(int width, int height, void *jpegBuf, int jpegBufSize)
 /**
  * Do the SW jpeg encoding.
  *
- * it will convert the YUV data to P411 and then do jpeg encoding.
+ * The source is fed to libjpeg one MCU row (16 lines) at a time. Luma rows of
+ * the semi-planar formats are passed to libjpeg in place, so only the chroma
+ * of the current MCU row is converted into the small planar strip buffer.
+ * The strip buffer is kept by the codec and reused by the next encoding.
  *
  * \param y_buf: the source buffer for Y data
  * \param uv_buf: the source buffer for UV data,
@@ -555,57 +738,96 @@ doJpegEncoding(const void *y_buf, const void *uv_buf, int fourcc)
 {
     LOG1("@%s, fourcc:%d, yuyv:%d, nv12:%d", __FUNCTION__, fourcc, V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12);
 
-    unsigned char *srcY = NULL;
-    unsigned char *srcUV = NULL;
-    unsigned char *p411 = NULL;
-    JSAMPROW y[16],u[16],v[16];
+    const unsigned char *srcY = (const unsigned char *)y_buf;
+    const unsigned char *srcUV = (const unsigned char *)uv_buf;
+    unsigned char *stripY = NULL;
+    unsigned char *stripU = NULL;
+    unsigned char *stripV = NULL;
+    JSAMPROW y[MCU_LINES], u[MCU_LINES / 2], v[MCU_LINES / 2];
     JSAMPARRAY data[3];
-    int i, j, width, height;
+    int i, j, width, height, yStride, cStride, stripSize;
+
+    // the codec may be reused, leave it ready for the next configEncoding()
+    if (fourcc != V4L2_PIX_FMT_YUYV
+        && fourcc != V4L2_PIX_FMT_NV12
+        && fourcc != V4L2_PIX_FMT_NV21) {
+        LOGE("%s Unsupported fourcc %s 0x%x", __func__, v4l2Fmt2Str(fourcc), fourcc);
+        jpeg_abort_compress(&mCInfo);
+        return -1;
+    }
+    if (fourcc != V4L2_PIX_FMT_YUYV && srcUV == NULL) {
+        LOGE("@%s, line:%d, no UV buffer for %s", __FUNCTION__, __LINE__, v4l2Fmt2Str(fourcc));
+        jpeg_abort_compress(&mCInfo);
+        return -1;
+    }
 
     width = mCInfo.image_width;
     height = mCInfo.image_height;
-    srcY = (unsigned char*)y_buf;
-    srcUV = (unsigned char*)uv_buf;
-    p411 = (unsigned char*)malloc(width * height * 3 / 2);
-    if (NULL == p411) {
-        LOGE("@%s, line:%d, malloc fail", __FUNCTION__, __LINE__);
-        return -1;
+    // libjpeg reads whole DCT blocks, keep the strip lines padded accordingly
+    yStride = ALIGN16(width);
+    cStride = ALIGN8(width / 2);
+    stripSize = cStride * MCU_LINES;
+    if (fourcc == V4L2_PIX_FMT_YUYV)
+        stripSize += yStride * MCU_LINES;
+
+    if (stripSize > mStripBufSize) {
+        free(mStripBuf);
+        mStripBufSize = 0;
+        mStripBuf = (unsigned char *)calloc(1, stripSize);
+        if (NULL == mStripBuf) {
+            LOGE("@%s, line:%d, malloc fail", __FUNCTION__, __LINE__);
+            jpeg_abort_compress(&mCInfo);
+            return -1;
+        }
+        mStripBufSize = stripSize;
     }
+    stripU = mStripBuf;
+    stripV = stripU + cStride * MCU_LINES / 2;
+    stripY = stripV + cStride * MCU_LINES / 2;
 
-    switch (fourcc) {
-    case V4L2_PIX_FMT_YUYV:
-        YUY2ToP411(width, height, srcY, p411);
-        break;
-    case V4L2_PIX_FMT_NV12:
-        NV12ToP411Separate(width, height, srcY, srcUV, p411);
-        break;
-    case V4L2_PIX_FMT_NV21:
-        NV21ToP411Separate(width, height, srcY, srcUV, p411);
-        break;
-    defaut:
-        LOGE("%s Unsupported fourcc %s 0x%x", __func__,v4l2Fmt2Str(fourcc), fourcc);
-        return -1;
-    }
+    const int chromaHeight = (height + 1) / 2;
 
     data[0] = y;
     data[1] = u;
     data[2] = v;
-    for (i = 0; i < height; i += 16) {
-        for (j = 0; j < 16 && (i + j) < height; j++) {
-            y[j] = p411 + width * (j + i);
-            if (j % 2 == 0) {
-                u[j / 2] = p411 + width * height + width / 2 * ((j + i) / 2);
-                v[j / 2] = p411 + width * height + width * height / 4 + width / 2 * ((j + i) / 2);
+    for (i = 0; i < height; i += MCU_LINES) {
+        int lines = MIN(MCU_LINES, height - i);
+        int cLines = (lines + 1) / 2;
+
+        switch (fourcc) {
+        case V4L2_PIX_FMT_YUYV:
+            YUY2ToP411Lines(width, lines, width * 2, srcY + width * 2 * i,
+                            stripY, stripU, stripV, yStride, cStride);
+            for (j = 0; j < MCU_LINES; j++)
+                y[j] = stripY + yStride * MIN(j, lines - 1);
+            for (j = 0; j < MCU_LINES / 2; j++) {
+                u[j] = stripU + cStride * MIN(j, cLines - 1);
+                // odd lines carry V, the last MCU row may not have one
+                v[j] = stripV + cStride * MIN(j, MAX(lines / 2 - 1, 0));
+            }
+            break;
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV21:
+            cLines = MIN(cLines, chromaHeight - i / 2);
+            if (fourcc == V4L2_PIX_FMT_NV12)
+                NV12ToP411Lines(width, cLines, width, srcUV + width * (i / 2),
+                                stripU, stripV, cStride);
+            else
+                NV12ToP411Lines(width, cLines, width, srcUV + width * (i / 2),
+                                stripV, stripU, cStride);
+            for (j = 0; j < MCU_LINES; j++)
+                y[j] = (JSAMPROW)(srcY + width * (i + MIN(j, lines - 1)));
+            for (j = 0; j < MCU_LINES / 2; j++) {
+                u[j] = stripU + cStride * MIN(j, cLines - 1);
+                v[j] = stripV + cStride * MIN(j, cLines - 1);
             }
+            break;
         }
-        jpeg_write_raw_data(&mCInfo, data, 16);
+        jpeg_write_raw_data(&mCInfo, data, MCU_LINES);
     }
 
     jpeg_finish_compress(&mCInfo);
 
-    free(p411);
-    p411 = NULL;
-
     return 0;
 }
 
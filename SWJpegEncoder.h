@@ -48,8 +48,10 @@ namespace android {
  * \class SWJpegEncoder
  *
  * This class is used for sw jpeg encoder.
- * It will use single or multi thread to do the sw jpeg encoding
- * It just support NV12 input currently.
+ * It will use single or multi thread to do the sw jpeg encoding.
+ * The threads of the multi thread encoding are created on the first large
+ * picture and kept until the encoder is destroyed, so one SWJpegEncoder
+ * should live as long as the camera session.
  */
 class SWJpegEncoder {
 public:
@@ -95,6 +97,20 @@ public:
     // Encoder functions
     int encode(const InputBuffer &in, const OutputBuffer &out);
 
+    /**
+     * \struct JpegLayout
+     *
+     * Position of the markers of one stripe jpeg, filled by parseJpeg()
+     */
+    struct JpegLayout {
+        int sofPos;  /*!< offset of the SOFn marker */
+        int restartInterval;  /*!< value of the DRI marker, 0 if there is none */
+        int entropyPos;  /*!< offset of the entropy coded data after SOS */
+        int eoiPos;  /*!< offset of the EOI marker ending the entropy coded data */
+    };
+
+    static bool parseJpeg(const unsigned char *buf, int size, JpegLayout *layout);
+
 // prevent copy constructor and assignment operator
 private:
     SWJpegEncoder(const SWJpegEncoder& other);
@@ -113,56 +129,95 @@ private:
     unsigned int mCPUCoresNum;  /*!< use to remember the CPU Cores number */
 
 private:
+    class Codec;
+
+    /**
+     * \struct Stripe
+     *
+     * One horizontal stripe of the picture. Every stripe is encoded as a
+     * standalone jpeg by the worker pool and stitched into the final jpeg
+     * by mergeStripe(), separated by restart markers.
+     */
+    struct Stripe {
+        // input buffer configuration
+        int width;
+        int height;
+        int fourcc;
+        void *inBufY;
+        void *inBufUV;
+        // output buffer configuration
+        int quality;
+        void *outBuf;
+        int outBufSize;
+        int restartInterval;  /*!< MCUs per restart interval, 0 if none */
+        int dataSize;  /*!< the coded jpeg size, -1 if the encoding failed */
+    };
+
     /**
      * \class CodecWorkerThread
      *
-     * This class will create one thread to do one sw jpeg encoder.
-     * It will call the SWJpegEncoderWrapper directly.
+     * One thread of the persistent encoder pool.
+     * It keeps its own Codec and encodes the stripes taken from the queue of
+     * the owning SWJpegEncoder until the pool is stopped.
      */
-    class CodecWorkerThread : private Thread, public virtual RefBase {
+    class CodecWorkerThread : public Thread {
     public:
-        struct CodecConfig {
-            // input buffer configuration
-            int width;
-            int height;
-            int fourcc;
-            void *inBufY;
-            void *inBufUV;
-            // output buffer configuration
-            int quality;
-            void *outBuf;
-            int outBufSize;
-        };
-
-        CodecWorkerThread();
+        CodecWorkerThread(SWJpegEncoder *owner);
         ~CodecWorkerThread();
 
-        void setConfig(CodecConfig &cfg) {mCfg = cfg;}
-        void getConfig(CodecConfig *cfg){*cfg = mCfg;}
-        status_t runThread(const char *name);
-        void waitThreadFinish(void);
-        int getJpegDataSize(void);
-    private:
-        int mDataSize;  /*!< the jpeg data size in one thread */
-        CodecConfig mCfg;  /*!< the cfg in one thread */
     private:
         virtual bool threadLoop();
-        int swEncode(void);
+        int swEncode(const Stripe &stripe);
+
+        SWJpegEncoder *mOwner;
+        Codec *mCodec;  /*!< the libjpeg context reused by every stripe */
     };
 
 private:
-    void init(unsigned int threadNum = 1);
-    void deInit(void);
-    void config(const InputBuffer &in, const OutputBuffer &out);
+    status_t startWorkers(unsigned int threadNum);
+    void stopWorkers(void);
+    status_t config(const InputBuffer &in, const OutputBuffer &out);
     int doJpegEncodingMultiThread(void);
-    int mergeJpeg(void);
+    bool mergeStripe(const Stripe &stripe, unsigned int index);
+    // called by the pool threads
+    bool acquireStripe(unsigned int *index, Stripe *stripe);
+    void stripeDone(unsigned int index, int dataSize);
 
-    Vector<sp<CodecWorkerThread> > mSwJpegEncoder;
-    static const unsigned int MAX_THREAD_NUM = 8; /*!< the same as max jpeg restart time */
+    Vector<sp<CodecWorkerThread> > mWorkers;
+    Vector<Stripe> mStripes;
+    Mutex mStripeLock;  /*!< protects the stripe queue below */
+    Condition mStripeAvailable;  /*!< signalled when stripes are queued or the pool stops */
+    Condition mStripesDone;  /*!< signalled when the stitching has progressed */
+    unsigned int mNextStripe;  /*!< next stripe to hand out to a worker */
+    unsigned int mMergedStripes;  /*!< stripes already stitched into mDstBuf */
+    bool mMergeBusy;  /*!< a worker is stitching outside of mStripeLock */
+    bool mMergeFailed;
+    int mMergedSize;  /*!< bytes of the final jpeg written to mDstBuf */
+    bool mStopWorkers;
+    Mutex mEncodeLock;  /*!< serializes encode() callers sharing the pool */
+
+    static const unsigned int MAX_THREAD_NUM = 8;
     static const unsigned int MIN_THREAD_NUM = 1;
+    /*!< stripes per worker, more stripes than workers balance uneven cores */
+    static const unsigned int STRIPES_PER_THREAD = 4;
+    /*!< keeps each stripe large enough to amortize its jpeg header */
+    static const int MIN_STRIPE_HEIGHT = 64;
+    static const int NV12_MCU_SIZE = 16;
+    /*!< room for the markers and tables of a stripe jpeg */
+    static const int STRIPE_HEADERS_SIZE = 2048;
+    static const int STRIPE_NOT_DONE = -2;  /*!< Stripe::dataSize before encoding */
 
-    /*!< it's used to use one buffer to merge the multi jpeg data to one jpeg data */
-    static const unsigned int DEST_BUF_OFFSET = 1024;
+    // jpeg marker codes, following the 0xFF prefix
+    enum {
+        JPEG_MARKER_SOF0 = 0xC0,
+        JPEG_MARKER_SOF1 = 0xC1,
+        JPEG_MARKER_SOF2 = 0xC2,
+        JPEG_MARKER_RST0 = 0xD0,
+        JPEG_MARKER_SOI = 0xD8,
+        JPEG_MARKER_EOI = 0xD9,
+        JPEG_MARKER_SOS = 0xDA,
+        JPEG_MARKER_DRI = 0xDD
+    };
 
 private:
     /**
@@ -180,6 +235,7 @@ private:
         void init(void);
         void deInit(void);
         void setJpegQuality(int quality);
+        void setRestartInterval(int mcus);
         int configEncoding(int width, int height, void *jpegBuf, int jpegBufSize);
         /*
             if fourcc is V4L2_PIX_FMT_NV12, y_buf and uv_buf must be passed
@@ -205,7 +261,11 @@ private:
         struct jpeg_compress_struct mCInfo;
         struct jpeg_error_mgr mJErr;
         int mJpegQuality;
+        int mRestartInterval;  /*!< MCUs per restart interval, 0 for none */
+        unsigned char *mStripBuf;  /*!< planar P411 data of one MCU row */
+        int mStripBufSize;
         static const unsigned int SUPPORTED_FORMAT = JCS_YCbCr;
+        static const int MCU_LINES = 16;  /*!< lines in one 4:2:0 MCU row */
 
         int setupJpegDestMgr(j_compress_ptr cInfo, JSAMPLE *jpegBuf, int jpegBufSize);
         // the below three functions are for the dest buffer manager.
@@ -728,6 +728,10 @@ status_t SensorHW::start()
             LOG1("@%s Using SOF event", __FUNCTION__);
         }
     }
+    // results of the previous stream would match the restarted exp ids
+    struct frame_sync_state &state = mFrameSyncState.beginWrite();
+    CLEAR(state);
+    mFrameSyncState.endWrite();
     mStarted = true;
     return NO_ERROR;
 }
@@ -1270,7 +1274,7 @@ status_t SensorHW::observe(IAtomIspObserver::Message *msg)
         LOG2("FrameSync: timestamp offset %lldus, delta %lldus", TIMEVAL2USECS(&msg->data.event.timestamp), systemTime()/1000 - ts);
         mFrameSyncMutex.lock();
     }
-    processExposureHistory(ts);
+    processExposureHistory(ts, event.u.frame_sync.frame_sequence);
     // update mLatestExpId within lock
     mLatestExpId = event.u.frame_sync.frame_sequence;
     mFrameSyncMutex.unlock();
@@ -1340,7 +1344,7 @@ inline void SensorHW::processGainDelay(struct atomisp_exposure *exposure)
 /**
  * Implements IHWSensorControl::setExposureGroup()
  */
-int SensorHW::setExposureGroup(struct atomisp_exposure exposures[], int depth)
+int SensorHW::setExposureGroup(struct atomisp_exposure exposures[], int depth, const int requestIds[])
 {
     int i, numItemNotApplied = 0;
     struct exposure_history_item *item = NULL;
@@ -1374,6 +1378,8 @@ int SensorHW::setExposureGroup(struct atomisp_exposure exposures[], int depth)
             item = produceExposureHistory(&exposures[i], 0);
             mActiveItemIndex++;
         }
+        if (item != NULL)
+            item->requestId = requestIds ? requestIds[i] : -1;
     }
 
     LOG1("@%s depth:%d mActiveItemIndex:%d, current exp id:%d",
@@ -1417,6 +1423,7 @@ int SensorHW::setExposure(struct atomisp_exposure *exposure)
             // gets in before sensor readout.
             LOG1("Received two exposure controls in single frame interval");
             headItem->exposure = *exposure;
+            headItem->requestId = -1;
             // TODO: gain delay not handled here. would need to update filter.
         } else {
             processGainDelay(exposure);
@@ -1613,6 +1620,7 @@ SensorHW::exposure_history_item* SensorHW::produceExposureHistory(struct atomisp
     struct exposure_history_item item;
 
     item.frame_ts = frame_ts;
+    item.requestId = -1;
     item.exposure = *exposure;
     item.applied = false;
     item.received = false;
@@ -1636,8 +1644,11 @@ SensorHW::exposure_history_item* SensorHW::produceExposureHistory(struct atomisp
  *
  * Note: Even when syncronizeExposure=false this function is called to
  *       roll the history and potentially apply the delayed gain(s).
+ *
+ * \param frameSequence exposure id of the frame sync event, the item
+ *        applied now is recorded as the result of the frame it reaches
  */
-void SensorHW::processExposureHistory(nsecs_t ts)
+void SensorHW::processExposureHistory(nsecs_t ts, unsigned int frameSequence)
 {
     LOG2("@%s", __FUNCTION__);
     struct exposure_history_item *item = NULL;
@@ -1708,6 +1719,92 @@ void SensorHW::processExposureHistory(nsecs_t ts)
     }
 
     updateExposureEstimate(ts);
+
+    struct frame_sync_state &state = mFrameSyncState.beginWrite();
+    // Applied at SOF of frame N, the exposure reaches frame N + lag.
+    // At EOF of frame N the next frame has already started.
+    if (item != NULL) {
+        unsigned int lag = mExposureLag + ((mFrameSyncSource == FRAME_SYNC_EOF) ? 1 : 0);
+        recordFrameResult(state, item, NEXTN_EID(frameSequence, lag));
+    }
+    recordFrameTiming(state);
+    mFrameSyncState.endWrite();
+}
+
+/**
+ * Stores the exposure of the item as the settings of frame expId
+ *
+ * The request id of the item is reported for the first frame only,
+ * the following frames keeping the same exposure get -1.
+ */
+void SensorHW::recordFrameResult(frame_sync_state &state, struct exposure_history_item *item, unsigned int expId)
+{
+    struct frame_result_item *resultItem = &state.results[expId % FRAME_RESULT_HISTORY_SIZE];
+
+    resultItem->expId = expId;
+    resultItem->result.valid = true;
+    resultItem->result.requestId = item->requestId;
+    resultItem->result.coarseIntegrationTime = item->exposure.integration_time[0];
+    resultItem->result.fineIntegrationTime = item->exposure.integration_time[1];
+    resultItem->result.analogGain = item->exposure.gain[0];
+    resultItem->result.digitalGain = item->exposure.gain[1];
+    resultItem->result.aperture = item->exposure.aperture;
+    resultItem->result.ispParamsExpId = EXP_ID_INVALID;
+    item->requestId = -1;
+
+    LOG2("@%s: exp id %u request %d itime %u gain %u", __FUNCTION__, expId,
+         resultItem->result.requestId, resultItem->result.coarseIntegrationTime,
+         resultItem->result.analogGain);
+}
+
+/**
+ * Stores the timestamp estimates of the items with a received frame sync
+ * event, for getFrameTimestamp()
+ */
+void SensorHW::recordFrameTiming(frame_sync_state &state)
+{
+    struct exposure_history_item *item = NULL;
+
+    state.timingCount = 0;
+    for (unsigned int i = 0; i < mExposureHistory->getCount()
+         && state.timingCount < FRAME_TIMING_HISTORY_SIZE; i++) {
+        item = mExposureHistory->peek(i);
+        if (item == NULL || !item->received)
+            continue;
+
+        struct frame_timing_item *timing = &state.timing[state.timingCount++];
+        timing->frame_ts = item->frame_ts;
+        if (mFrameSyncSource == FRAME_SYNC_EOF) {
+            //NOTE: In CSS2.0 where FrameSync is delayed from EOF event to
+            //      reprecent the next SOF and Sensor Buffered Mode
+            //      increases the latency of events, we consider that
+            //      receiving ISP events for frame during its vbi is
+            //      impossible.
+            //      Using full frame interval comparison
+            timing->itgInterval = frameIntervalForItem(i);
+        } else {
+            timing->itgInterval = frameIntervalForItem(i) - vbiIntervalForItem(i);
+        }
+    }
+}
+
+/**
+ * Implements IHWSensorControl::getFrameResult()
+ */
+bool SensorHW::getFrameResult(unsigned int expId, FrameResult *result)
+{
+    LOG2("@%s: exp id %u", __FUNCTION__, expId);
+    if (result == NULL || expId == EXP_ID_INVALID)
+        return false;
+
+    struct frame_sync_state state;
+    mFrameSyncState.read(&state);
+    const struct frame_result_item &resultItem = state.results[expId % FRAME_RESULT_HISTORY_SIZE];
+    if (resultItem.expId != expId)
+        return false;
+
+    *result = resultItem.result;
+    return true;
 }
 
 /**
@@ -1720,46 +1817,34 @@ void SensorHW::processExposureHistory(nsecs_t ts)
 nsecs_t SensorHW::getFrameTimestamp(nsecs_t event_ts)
 {
     LOG2("@%s-%lld", __FUNCTION__, event_ts);
-    Mutex::Autolock lock(mFrameSyncMutex);
-    struct exposure_history_item *receivedItem = NULL;
+    struct frame_sync_state state;
     long deltaToReceived = 0;
-    long itgInterval = 0;
     nsecs_t retTs = 0;
 
+    // The estimates published at the last FrameSync are used, so that
+    // this neither waits for the FrameSync handling nor for setExposure().
+    mFrameSyncState.read(&state);
+
     // Travel through items with received frame sync event
     // and consider delta to each. Consider that if delta
     // is smaller than integration interval of that item,
     // any event received at that time must origin from the
     // previous frame.
-    for (unsigned int i = 0; i < mExposureHistory->getCount(); i++) {
-        receivedItem = mExposureHistory->peek(i);
-        if (receivedItem && receivedItem->received) {
-            if (mFrameSyncSource == FRAME_SYNC_EOF) {
-                //NOTE: In CSS2.0 where FrameSync is delayed from EOF event to
-                //      reprecent the next SOF and Sensor Buffered Mode
-                //      increases the latency of events, we consider that
-                //      receiving ISP events for frame during its vbi is
-                //      impossible.
-                //      Using full frame interval comparison
-                itgInterval = frameIntervalForItem(i);
-            } else {
-                itgInterval = frameIntervalForItem(i) - vbiIntervalForItem(i);
-            }
-            retTs = receivedItem->frame_ts;
-            deltaToReceived = (long)(event_ts - retTs);
-            LOG2("%s: received item %i delta %ldus, itg interval %ldus", __FUNCTION__, i, deltaToReceived, itgInterval);
-            if (deltaToReceived > itgInterval) {
-                break;
-            } else {
-                //NOTE: In CSS2.0 where FrameSync is delayed from EOF event to
-                //      reprecent the next SOF, it is usual that we get
-                //      negative delta here. This means we receive 3A stats
-                //      during the VBI, but that origins from frame before.
-                LOG2("%s: negative delta to FrameSync", __FUNCTION__);
-            }
+    for (unsigned int i = 0; i < state.timingCount; i++) {
+        retTs = state.timing[i].frame_ts;
+        deltaToReceived = (long)(event_ts - retTs);
+        LOG2("%s: received item %i delta %ldus, itg interval %ldus", __FUNCTION__, i, deltaToReceived, state.timing[i].itgInterval);
+        if (deltaToReceived > state.timing[i].itgInterval) {
+            break;
+        } else {
+            //NOTE: In CSS2.0 where FrameSync is delayed from EOF event to
+            //      reprecent the next SOF, it is usual that we get
+            //      negative delta here. This means we receive 3A stats
+            //      during the VBI, but that origins from frame before.
+            LOG2("%s: negative delta to FrameSync", __FUNCTION__);
         }
     }
-    assert(receivedItem);
+    assert(state.timingCount > 0);
     // Note: if the above logic fails e.g due heavy cpu burden there isn't
     //       enough exposure history, we returns the closest match there is
     //       or 0 in corner cases. Enable asserts to trace related issues.
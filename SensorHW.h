@@ -24,6 +24,7 @@
 #include "AtomIspObserverManager.h" // IObserverSubject
 #include "AtomDelayFilter.h"
 #include "AtomFifo.h"
+#include "AtomSeqLock.h"
 
 namespace android {
 
@@ -88,7 +89,8 @@ public:
 
     virtual unsigned int getExposureDelay();
     virtual int setExposure(struct atomisp_exposure *exposure);
-    virtual int setExposureGroup(struct atomisp_exposure exposures[], int depth);
+    virtual int setExposureGroup(struct atomisp_exposure exposures[], int depth, const int requestIds[]);
+    virtual bool getFrameResult(unsigned int expId, FrameResult *result);
 
     virtual float getFramerate() const;
     virtual status_t setFramerate(int fps);
@@ -138,8 +140,26 @@ private:
         bool    received;
         bool    applied;
         nsecs_t frame_ts;
+        int     requestId;  /* given with the exposure, -1 once reported */
         struct atomisp_exposure exposure;
     };
+    struct frame_result_item {
+        unsigned int expId;
+        FrameResult result;
+    };
+    // Exposures in effect per frame, indexed by exposure id
+    static const int FRAME_RESULT_HISTORY_SIZE = 16;
+    static const int FRAME_TIMING_HISTORY_SIZE = 16;
+    struct frame_timing_item {
+        nsecs_t frame_ts;
+        long itgInterval;   /* events later than this after frame_ts are of the next frame */
+    };
+    // What the frame sync thread publishes for the other threads
+    struct frame_sync_state {
+        struct frame_result_item results[FRAME_RESULT_HISTORY_SIZE];
+        unsigned int timingCount;
+        struct frame_timing_item timing[FRAME_TIMING_HISTORY_SIZE];  /* received items, newest first */
+    };
     status_t initializeExposureFilter();
     int frameSyncProc(nsecs_t timestamp);
     inline void processGainDelay(struct atomisp_exposure *);
@@ -148,7 +168,9 @@ private:
     unsigned int frameIntervalForItem(unsigned int index);
     unsigned int cumulateFrameIntervals(unsigned int index, unsigned int frames);
     struct exposure_history_item* produceExposureHistory(struct atomisp_exposure *exposure, nsecs_t frame_ts);
-    void processExposureHistory(nsecs_t timestamp);
+    void processExposureHistory(nsecs_t timestamp, unsigned int frameSequence);
+    void recordFrameResult(frame_sync_state &state, struct exposure_history_item *item, unsigned int expId);
+    void recordFrameTiming(frame_sync_state &state);
     void updateExposureEstimate(nsecs_t timestamp);
     struct exposure_history_item* getPrevAppliedItem(int &id);
     void resetEstimates(struct exposure_history_item *activeItem);
@@ -179,6 +201,8 @@ private:
     int mOutputHeight;
 
     // Common frame synchronization
+    // mFrameSyncMutex serializes the writers of the exposure history and
+    // of mFrameSyncState, mFrameSyncState is read without it
     Mutex mFrameSyncMutex;
     Condition mFrameSyncCondition;
     enum FrameSyncSource {
@@ -198,6 +222,7 @@ private:
     AtomFifo <struct exposure_history_item> *mExposureHistory;
     struct atomisp_exposure          mCurrentExposure;
     int mGroupId;
+    AtomSeqLock <struct frame_sync_state> mFrameSyncState;
 }; // class SensorHW
 
 }; // namespace android
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_StatsRecording"
+
+#include <errno.h>
+#include <string.h>
+#include "LogHelper.h"
+#include "AtomCommon.h"
+#include "StatsRecording.h"
+
+namespace android {
+
+static const uint32_t STATS_FILE_MAGIC = 0x53413341;    // "A3AS"
+static const uint32_t STATS_FILE_VERSION = 1;
+
+enum StatsRecordType {
+    RECORD_SENSOR_MODE = 1,
+    RECORD_FRAME = 2,
+};
+
+StatsRecorder::StatsRecorder() :
+     mFile(NULL)
+    ,mFrames(0)
+    ,mBytes(0)
+{
+    LOG1("@%s", __FUNCTION__);
+}
+
+StatsRecorder::~StatsRecorder()
+{
+    LOG1("@%s", __FUNCTION__);
+    close();
+}
+
+status_t StatsRecorder::open(const char *path, int cameraId)
+{
+    LOG1("@%s: %s", __FUNCTION__, path);
+    StatsFileHeader header;
+
+    close();
+    mFile = fopen(path, "wb");
+    if (mFile == NULL) {
+        LOGE("Could not open %s for the 3A statistics: %s", path, strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    mPath = path;
+    mFrames = 0;
+    mBytes = 0;
+
+    header.magic = STATS_FILE_MAGIC;
+    header.version = STATS_FILE_VERSION;
+    header.cameraId = cameraId;
+    header.cellSize = sizeof(struct atomisp_3a_output);
+    return write(&header, sizeof(header));
+}
+
+void StatsRecorder::close()
+{
+    if (mFile == NULL)
+        return;
+
+    LOG1("@%s: %u frames, %zu KB in %s", __FUNCTION__, mFrames, mBytes / 1024, mPath.string());
+    fclose(mFile);
+    mFile = NULL;
+}
+
+status_t StatsRecorder::write(const void *data, size_t size)
+{
+    if (mFile == NULL)
+        return INVALID_OPERATION;
+
+    if (fwrite(data, 1, size, mFile) != size) {
+        LOGE("Writing the 3A statistics to %s failed, recording stopped", mPath.string());
+        close();
+        return UNKNOWN_ERROR;
+    }
+    mBytes += size;
+    return NO_ERROR;
+}
+
+status_t StatsRecorder::writeSensorMode(const struct atomisp_grid_info &grid,
+                                        const ia_aiq_exposure_sensor_descriptor &descriptor)
+{
+    LOG1("@%s: grid %dx%d", __FUNCTION__, grid.s3a_width, grid.s3a_height);
+    StatsRecordHeader header;
+    StatsSensorModeRecord record;
+
+    CLEAR(record);
+    record.grid = grid;
+    record.descriptor = descriptor;
+    header.type = RECORD_SENSOR_MODE;
+    header.size = sizeof(record);
+
+    status_t status = write(&header, sizeof(header));
+    if (status == NO_ERROR)
+        status = write(&record, sizeof(record));
+    return status;
+}
+
+status_t StatsRecorder::writeFrame(const struct atomisp_3a_statistics *stats, int64_t timestamp,
+                                   const ia_aiq_exposure_sensor_parameters *sensorExposure,
+                                   const ia_aiq_exposure_parameters *exposure)
+{
+    LOG2("@%s", __FUNCTION__);
+    StatsRecordHeader header;
+    StatsFrameRecord record;
+    size_t cellsSize;
+
+    CLEAR(record);
+    record.timestamp = timestamp;
+    record.expId = stats->exp_id;
+    if (sensorExposure && exposure) {
+        record.hasExposure = 1;
+        record.sensorExposure = *sensorExposure;
+        record.exposure = *exposure;
+    }
+    record.gridSize = stats->grid_info.s3a_width * stats->grid_info.s3a_height;
+    cellsSize = record.gridSize * sizeof(*stats->data);
+
+    header.type = RECORD_FRAME;
+    header.size = sizeof(record) + cellsSize;
+
+    status_t status = write(&header, sizeof(header));
+    if (status == NO_ERROR)
+        status = write(&record, sizeof(record));
+    if (status == NO_ERROR)
+        status = write(stats->data, cellsSize);
+    if (status == NO_ERROR)
+        mFrames++;
+    return status;
+}
+
+void StatsRecorder::dump(String8 &out) const
+{
+    if (mFile != NULL)
+        out.appendFormat("3A statistics recording: %u frames, %zu KB to %s\n",
+                         mFrames, mBytes / 1024, mPath.string());
+}
+
+StatsPlayer::StatsPlayer() :
+     mFile(NULL)
+    ,mHaveSensorMode(false)
+    ,mHavePendingFrame(false)
+    ,mFrames(0)
+    ,mEnd(false)
+{
+    LOG1("@%s", __FUNCTION__);
+    CLEAR(mSensorMode);
+    CLEAR(mPendingFrame);
+}
+
+StatsPlayer::~StatsPlayer()
+{
+    LOG1("@%s", __FUNCTION__);
+    close();
+}
+
+status_t StatsPlayer::open(const char *path)
+{
+    LOG1("@%s: %s", __FUNCTION__, path);
+    StatsFileHeader header;
+
+    close();
+    mFile = fopen(path, "rb");
+    if (mFile == NULL) {
+        LOGE("Could not open the 3A statistics recording %s: %s", path, strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    mPath = path;
+
+    if (read(&header, sizeof(header)) != NO_ERROR
+        || header.magic != STATS_FILE_MAGIC
+        || header.version != STATS_FILE_VERSION
+        || header.cellSize != sizeof(struct atomisp_3a_output)) {
+        LOGE("%s is not a 3A statistics recording of this build", path);
+        close();
+        return BAD_VALUE;
+    }
+
+    LOG1("@%s: recording of camera %d", __FUNCTION__, header.cameraId);
+    return NO_ERROR;
+}
+
+void StatsPlayer::close()
+{
+    if (mFile == NULL)
+        return;
+
+    LOG1("@%s: %u frames replayed from %s", __FUNCTION__, mFrames, mPath.string());
+    fclose(mFile);
+    mFile = NULL;
+    mHaveSensorMode = false;
+    mHavePendingFrame = false;
+    mFrames = 0;
+    mEnd = false;
+}
+
+status_t StatsPlayer::read(void *data, size_t size)
+{
+    if (fread(data, 1, size, mFile) != size)
+        return NOT_ENOUGH_DATA;
+    return NO_ERROR;
+}
+
+status_t StatsPlayer::skip(size_t size)
+{
+    if (size > 0 && fseek(mFile, size, SEEK_CUR) != 0)
+        return NOT_ENOUGH_DATA;
+    return NO_ERROR;
+}
+
+status_t StatsPlayer::readFrame(struct atomisp_3a_statistics *stats, StatsFrameRecord *frame)
+{
+    LOG2("@%s", __FUNCTION__);
+    StatsRecordHeader header;
+    status_t status = NO_ERROR;
+
+    if (mFile == NULL || mEnd)
+        return NOT_ENOUGH_DATA;
+
+    // records are read up to the next frame, the frame record is kept
+    // when the caller has to reconfigure its buffer first
+    while (!mHavePendingFrame && status == NO_ERROR) {
+        status = read(&header, sizeof(header));
+        if (status != NO_ERROR)
+            break;
+
+        switch (header.type) {
+        case RECORD_SENSOR_MODE:
+            if (header.size < sizeof(mSensorMode)) {
+                status = BAD_VALUE;
+                break;
+            }
+            status = read(&mSensorMode, sizeof(mSensorMode));
+            if (status == NO_ERROR)
+                status = skip(header.size - sizeof(mSensorMode));
+            mHaveSensorMode = true;
+            LOG1("@%s: sensor mode with grid %dx%d", __FUNCTION__,
+                 mSensorMode.grid.s3a_width, mSensorMode.grid.s3a_height);
+            break;
+        case RECORD_FRAME:
+            if (header.size < sizeof(mPendingFrame)) {
+                status = BAD_VALUE;
+                break;
+            }
+            status = read(&mPendingFrame, sizeof(mPendingFrame));
+            if (status == NO_ERROR && header.size !=
+                sizeof(mPendingFrame) + mPendingFrame.gridSize * sizeof(*stats->data))
+                status = BAD_VALUE;
+            mHavePendingFrame = (status == NO_ERROR);
+            break;
+        default:
+            LOGW("@%s: unknown record %u skipped", __FUNCTION__, header.type);
+            status = skip(header.size);
+            break;
+        }
+    }
+
+    if (status != NO_ERROR) {
+        if (status != NOT_ENOUGH_DATA)
+            LOGE("%s is corrupted after %u frames", mPath.string(), mFrames);
+        LOG1("@%s: end of the recording after %u frames", __FUNCTION__, mFrames);
+        mEnd = true;
+        return NOT_ENOUGH_DATA;
+    }
+
+    if (!mHaveSensorMode) {
+        LOGE("%s has a frame before the sensor mode", mPath.string());
+        mEnd = true;
+        return NOT_ENOUGH_DATA;
+    }
+
+    // no buffer configuration can take such a frame, do not ask for one
+    if (mPendingFrame.gridSize != (uint32_t)(mSensorMode.grid.s3a_width * mSensorMode.grid.s3a_height)) {
+        LOGE("%s has a frame of %u cells for a %dx%d grid", mPath.string(),
+             mPendingFrame.gridSize, mSensorMode.grid.s3a_width, mSensorMode.grid.s3a_height);
+        mHavePendingFrame = false;
+        mEnd = true;
+        return BAD_VALUE;
+    }
+
+    if (stats == NULL
+        || stats->grid_info.s3a_width != mSensorMode.grid.s3a_width
+        || stats->grid_info.s3a_height != mSensorMode.grid.s3a_height)
+        return -EAGAIN;
+
+    mHavePendingFrame = false;
+    if (read(stats->data, mPendingFrame.gridSize * sizeof(*stats->data)) != NO_ERROR) {
+        mEnd = true;
+        return NOT_ENOUGH_DATA;
+    }
+    stats->exp_id = mPendingFrame.expId;
+    *frame = mPendingFrame;
+    mFrames++;
+    return NO_ERROR;
+}
+
+void StatsPlayer::dump(String8 &out) const
+{
+    if (mFile != NULL)
+        out.appendFormat("3A statistics replay: %u frames from %s%s\n",
+                         mFrames, mPath.string(), mEnd ? ", ended" : "");
+}
+
+} // namespace android
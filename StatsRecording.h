@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_STATS_RECORDING_H
+#define ANDROID_LIBCAMERA_STATS_RECORDING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <utils/Errors.h>
+#include <utils/String8.h>
+#include <linux/atomisp.h>
+#include <ia_aiq_types.h>
+
+namespace android {
+
+/**
+ * \file StatsRecording.h
+ *
+ * Recording of the 3A statistics of a session, so that the AIQ can be run
+ * again on the same input without the sensor.
+ *
+ * The file starts with a FileHeader, followed by records. Each record is a
+ * RecordHeader and its payload:
+ * - RECORD_SENSOR_MODE: a SensorModeRecord, written when the 3A grid is
+ *   configured for a new sensor mode
+ * - RECORD_FRAME: a FrameRecord followed by gridSize atomisp_3a_output
+ *   cells, written for every statistics buffer given to the AIQ
+ *
+ * The structures are written as they are in memory: a recording is read
+ * back by the same build of the HAL, or a build for the same ABI.
+ */
+
+struct StatsFileHeader {
+    uint32_t magic;         /*!< STATS_FILE_MAGIC */
+    uint32_t version;       /*!< STATS_FILE_VERSION */
+    int32_t cameraId;
+    uint32_t cellSize;      /*!< sizeof(atomisp_3a_output) of the recording build */
+};
+
+struct StatsRecordHeader {
+    uint32_t type;
+    uint32_t size;          /*!< bytes of payload after the header */
+};
+
+struct StatsSensorModeRecord {
+    struct atomisp_grid_info grid;
+    ia_aiq_exposure_sensor_descriptor descriptor;
+};
+
+struct StatsFrameRecord {
+    int64_t timestamp;      /*!< frame timestamp in us */
+    uint32_t expId;
+    uint32_t hasExposure;   /*!< the exposure below was decoded for the frame */
+    ia_aiq_exposure_sensor_parameters sensorExposure;
+    ia_aiq_exposure_parameters exposure;
+    uint32_t gridSize;      /*!< statistics cells following the record */
+};
+
+/**
+ * \class StatsRecorder
+ *
+ * Writes the statistics the AIQ receives to a file, see StatsRecording.h.
+ * Enabled with the CAMERA_DEBUG_DUMP_3A_STATISTICS bit of camera.hal.debug.
+ */
+class StatsRecorder {
+public:
+    StatsRecorder();
+    ~StatsRecorder();
+
+// prevent copy constructor and assignment operator
+private:
+    StatsRecorder(const StatsRecorder& other);
+    StatsRecorder& operator=(const StatsRecorder& other);
+
+public:
+    status_t open(const char *path, int cameraId);
+    void close();
+    bool isOpen() const { return mFile != NULL; }
+
+    status_t writeSensorMode(const struct atomisp_grid_info &grid,
+                             const ia_aiq_exposure_sensor_descriptor &descriptor);
+
+    /**
+     * \param stats statistics as read from the ISP
+     * \param timestamp frame timestamp in us
+     * \param sensorExposure exposure decoded for the frame, NULL if none
+     * \param exposure generic exposure decoded for the frame, NULL if none
+     */
+    status_t writeFrame(const struct atomisp_3a_statistics *stats, int64_t timestamp,
+                        const ia_aiq_exposure_sensor_parameters *sensorExposure,
+                        const ia_aiq_exposure_parameters *exposure);
+
+    void dump(String8 &out) const;
+
+private:
+    status_t write(const void *data, size_t size);
+
+private:
+    FILE *mFile;
+    String8 mPath;
+    unsigned int mFrames;
+    size_t mBytes;
+};
+
+/**
+ * \class StatsPlayer
+ *
+ * Reads a file written by StatsRecorder. It stands in for the ISP: the AIQ
+ * takes the statistics, exposure and sensor descriptor from the player
+ * instead of the driver, frame by frame.
+ */
+class StatsPlayer {
+public:
+    StatsPlayer();
+    ~StatsPlayer();
+
+// prevent copy constructor and assignment operator
+private:
+    StatsPlayer(const StatsPlayer& other);
+    StatsPlayer& operator=(const StatsPlayer& other);
+
+public:
+    status_t open(const char *path);
+    void close();
+    bool isOpen() const { return mFile != NULL; }
+
+    /**
+     * Reads the next frame of the recording
+     *
+     * Like AtomISP::getIspStatistics(), it fails with -EAGAIN when the
+     * statistics buffer does not have the grid of the recording: the
+     * caller configures it from getSensorMode() and calls again.
+     *
+     * \param stats buffer with the grid of getSensorMode(), filled with
+     *        the recorded cells and exp_id
+     * \param frame the rest of the recorded frame
+     * \return NOT_ENOUGH_DATA at the end of the recording, BAD_VALUE when
+     *         the frame does not fit the grid of its sensor mode, which
+     *         also ends the replay
+     */
+    status_t readFrame(struct atomisp_3a_statistics *stats, StatsFrameRecord *frame);
+
+    const StatsSensorModeRecord &getSensorMode() const { return mSensorMode; }
+
+    void dump(String8 &out) const;
+
+private:
+    status_t read(void *data, size_t size);
+    status_t skip(size_t size);
+
+private:
+    FILE *mFile;
+    String8 mPath;
+    StatsSensorModeRecord mSensorMode;
+    bool mHaveSensorMode;
+    StatsFrameRecord mPendingFrame;     /*!< read, its cells are not */
+    bool mHavePendingFrame;
+    unsigned int mFrames;
+    bool mEnd;
+};
+
+} // namespace android
+
+#endif // ANDROID_LIBCAMERA_STATS_RECORDING_H
@@ -23,6 +23,7 @@
 #include "LogHelper.h"
 #include "PlatformData.h"
 #include "MemoryUtils.h"
+#include "AtomBufferPool.h"
 
 #include "morpho_image_stabilizer3.h"
 
@@ -92,8 +93,8 @@ UltraLowLight::~UltraLowLight()
     }
 
     if (mCopyBuffsAllocated) {
-        MemoryUtils::freeAtomBuffer(mSnapshotCopy);
-        MemoryUtils::freeAtomBuffer(mPostviewCopy);
+        mCallbacks->bufferPool()->release(mSnapshotCopy);
+        mCallbacks->bufferPool()->release(mPostviewCopy);
     }
 }
 
@@ -955,10 +956,10 @@ void UltraLowLight::allocateCopyBuffers(AtomBuffer snapshotDescr, AtomBuffer pos
     LOG1("@%s :copyBuffersAllocated=%d", __FUNCTION__, mCopyBuffsAllocated);
     if (!mCopyBuffsAllocated) {
         mSnapshotCopy = AtomBufferFactory::createAtomBuffer(ATOM_BUFFER_SNAPSHOT);
-        MemoryUtils::allocateAtomBuffer(mSnapshotCopy, snapshotDescr, mCallbacks);
+        mCallbacks->bufferPool()->acquire(mSnapshotCopy, snapshotDescr);
 
         mPostviewCopy = AtomBufferFactory::createAtomBuffer(ATOM_BUFFER_POSTVIEW);
-        MemoryUtils::allocateAtomBuffer(mPostviewCopy, postviewDescr, mCallbacks);
+        mCallbacks->bufferPool()->acquire(mPostviewCopy, postviewDescr);
 
         mCopyBuffsAllocated = true;
     }
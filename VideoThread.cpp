@@ -27,7 +27,7 @@ namespace android {
 VideoThread::VideoThread(AtomISP *atomIsp, sp<CallbacksThread> callbacksThread) :
     Thread(true) // callbacks may call into java
     ,mIsp(atomIsp)
-    ,mMessageQueue("VideoThread", MESSAGE_ID_MAX)
+    ,mMessageQueue("VideoThread", MESSAGE_ID_MAX, MESSAGE_QUEUE_FRAME_LANE_SIZE)
     ,mThreadRunning(false)
     ,mCallbacksThread(callbacksThread)
     ,mSlowMotionRate(1)
@@ -97,7 +97,7 @@ bool VideoThread::atomIspNotify(IAtomIspObserver::Message *msg, const ObserverSt
             local_msg.id = MESSAGE_ID_DEQUEUE_RECORDING;
             local_msg.data.dequeueRecording.skipFrame =
                (buff->status == FRAME_STATUS_CORRUPTED) || skipFrame;
-            mMessageQueue.send(&local_msg);
+            mMessageQueue.sendFrame(&local_msg);
         }
     }
 
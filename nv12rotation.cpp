@@ -18,19 +18,17 @@
 // 2. test optimal reading direction for top & right when (ROWS|COLUMNS)%MACROBLOCK
 #include "nv12rotation.h"
 #include "AtomCommon.h"
+#include "PlatformData.h"
 #include <cstdlib>
+#include <stddef.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define STRIZE2(s) #s
 #define STRIZE(s) STRIZE2(s)
 
 
-bool genericRotateBy90(const int   width,
-                        const int   height,
-                        const int   rstride,
-                        const int   wstride,
-                        const char* sptr,
-                        char*       dptr);
-
 #define NV12_ROTATION_STRIDES(RSTRIDE, WSTRIDE, MACROBLOCK) \
 static void rotateXx4x##RSTRIDE##x##WSTRIDE##Y \
     (const unsigned char* source, unsigned char* target, int columns) \
@@ -357,49 +355,283 @@ bool nv12rotateBy90(const int   width,
     } else
 #include "nv12rotationgeometry.h"
     {
-         rotated = genericRotateBy90(width, height, rstride, wstride, sptr, dptr);
+         rotated = android::nv12rotate(90, false, width, height, rstride, wstride, sptr, dptr);
     }
 
     return rotated;
 }
 
+
+/*
+ * Generic tiled rotation engine
+ *
+ * Every rotation/mirror combination is expressed on each plane as an
+ * optional transpose followed by optional horizontal (flipX) and vertical
+ * (flipY) flips of the output. Transposes are done in 16x16 byte micro
+ * tiles in registers; flipX is folded into the order the source lines are
+ * read and flipY into the order the target lines are written, so the micro
+ * kernels only need to support negative strides. Micro tiles are visited in
+ * square cache blocks so that the target lines are written in whole cache
+ * lines. Borders that do not fill a micro tile are done per pixel.
+ */
+
+namespace android {
+
+struct PlaneTransform {
+    bool transpose;
+    bool flipX;
+    bool flipY;
+};
+
+// side length of the micro tiles in bytes
+static const int MICRO_TILE_BYTES = 16;
+
 /**
- * Fall back rotation algorithm in case the resolution requested is not
- * optimized
- **/
-bool genericRotateBy90(const int   width,
-                        const int   height,
-                        const int   rstride,
-                        const int   wstride,
-                        const char* sptr,
-                        char*       dptr)
+ * Side length of the cache blocks in bytes. One block row of micro tiles
+ * writes exactly one cache line to each target line it touches.
+ */
+static int rotationBlockBytes()
 {
-    int i,j;
-    char* a = (char*) sptr;
-    char* b = dptr;
+    static int blockBytes = 0;
+    if (blockBytes == 0) {
+        int cacheLine = PlatformData::cacheLineSize();
+        blockBytes = (cacheLine >= MICRO_TILE_BYTES) ?
+            ALIGN_WIDTH(cacheLine, MICRO_TILE_BYTES) : 64;
+    }
+    return blockBytes;
+}
 
-    LOGW("Unoptimized CPU rotation! "
-         "Disable overlay or optimize for this resolution(%dx%d)",width, height);
+// out[r][c] = in[c][r] for 16x16 bytes
+static inline void transpose16x16x8(const unsigned char* in, ptrdiff_t inStride,
+                                    unsigned char* out, ptrdiff_t outStride)
+{
+#ifdef __SSE2__
+    __m128i a[16], b[16];
+    for (int i = 0; i < 16; i++)
+        a[i] = _mm_loadu_si128((const __m128i*)(in + i * inStride));
+    for (int i = 0; i < 16; i += 2) {
+        b[i]     = _mm_unpacklo_epi8(a[i], a[i + 1]);
+        b[i + 1] = _mm_unpackhi_epi8(a[i], a[i + 1]);
+    }
+    for (int i = 0; i < 16; i += 4) {
+        a[i]     = _mm_unpacklo_epi16(b[i],     b[i + 2]);
+        a[i + 1] = _mm_unpackhi_epi16(b[i],     b[i + 2]);
+        a[i + 2] = _mm_unpacklo_epi16(b[i + 1], b[i + 3]);
+        a[i + 3] = _mm_unpackhi_epi16(b[i + 1], b[i + 3]);
+    }
+    for (int i = 0; i < 16; i += 8) {
+        for (int j = 0; j < 4; j++) {
+            b[i + 2 * j]     = _mm_unpacklo_epi32(a[i + j], a[i + j + 4]);
+            b[i + 2 * j + 1] = _mm_unpackhi_epi32(a[i + j], a[i + j + 4]);
+        }
+    }
+    for (int j = 0; j < 8; j++) {
+        _mm_storeu_si128((__m128i*)(out + (2 * j) * outStride), _mm_unpacklo_epi64(b[j], b[j + 8]));
+        _mm_storeu_si128((__m128i*)(out + (2 * j + 1) * outStride), _mm_unpackhi_epi64(b[j], b[j + 8]));
+    }
+#else
+    for (int r = 0; r < 16; r++)
+        for (int c = 0; c < 16; c++)
+            out[r * outStride + c] = in[c * inStride + r];
+#endif
+}
 
-    // Luma rotation
-    for (i = 0; i < width; i++) {
-        for (j = height-1; j >= 0 ; j--) {
-            b[height - j -1] = a[i + j*rstride];
+// out[r][c] = in[c][r] for 8x8 16-bit elements (UV pairs)
+static inline void transpose8x8x16(const unsigned char* in, ptrdiff_t inStride,
+                                   unsigned char* out, ptrdiff_t outStride)
+{
+#ifdef __SSE2__
+    __m128i a[8], b[8];
+    for (int i = 0; i < 8; i++)
+        a[i] = _mm_loadu_si128((const __m128i*)(in + i * inStride));
+    for (int i = 0; i < 8; i += 2) {
+        b[i]     = _mm_unpacklo_epi16(a[i], a[i + 1]);
+        b[i + 1] = _mm_unpackhi_epi16(a[i], a[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        a[i]     = _mm_unpacklo_epi32(b[i],     b[i + 2]);
+        a[i + 1] = _mm_unpackhi_epi32(b[i],     b[i + 2]);
+        a[i + 2] = _mm_unpacklo_epi32(b[i + 1], b[i + 3]);
+        a[i + 3] = _mm_unpackhi_epi32(b[i + 1], b[i + 3]);
+    }
+    for (int j = 0; j < 4; j++) {
+        _mm_storeu_si128((__m128i*)(out + (2 * j) * outStride), _mm_unpacklo_epi64(a[j], a[j + 4]));
+        _mm_storeu_si128((__m128i*)(out + (2 * j + 1) * outStride), _mm_unpackhi_epi64(a[j], a[j + 4]));
+    }
+#else
+    const unsigned short* s;
+    unsigned short* d;
+    for (int r = 0; r < 8; r++) {
+        d = (unsigned short*)(out + r * outStride);
+        for (int c = 0; c < 8; c++) {
+            s = (const unsigned short*)(in + c * inStride);
+            d[c] = s[r];
         }
-        b += wstride;
     }
+#endif
+}
+
+// Copies a line of 'count' elements of 'elemSize' bytes in reverse order
+static void reverseLine(const unsigned char* src, unsigned char* dst, int count, int elemSize)
+{
+    int i = 0;
+    const int n = count * elemSize;
+#ifdef __SSE2__
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+        if (elemSize == 1)
+            x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+        x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+        x = _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+        _mm_storeu_si128((__m128i*)(dst + n - 16 - i), x);
+    }
+#endif
+    for (; i < n; i += elemSize)
+        for (int k = 0; k < elemSize; k++)
+            dst[n - elemSize - i + k] = src[i + k];
+}
+
+// Per element transform of the source area [x0, x1) x [y0, y1)
+static void transformArea(const unsigned char* src, int sstride,
+                          unsigned char* dst, int dstride,
+                          int width, int height, int elemSize,
+                          const PlaneTransform& t,
+                          int x0, int x1, int y0, int y1)
+{
+    const int dwidth = t.transpose ? height : width;
+    const int dheight = t.transpose ? width : height;
 
-    a += rstride*height;
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int u = t.transpose ? y : x;
+            int v = t.transpose ? x : y;
+            if (t.flipX)
+                u = dwidth - 1 - u;
+            if (t.flipY)
+                v = dheight - 1 - v;
+            for (int k = 0; k < elemSize; k++)
+                dst[v * dstride + u * elemSize + k] = src[y * sstride + x * elemSize + k];
+        }
+    }
+}
 
-    //Chroma rotation
-    for (i = 0; i < width; i+=2) {
-        for (j = height; j > 0 ; j-=2) {
-            b[height -j] = a[i + (j/2-1)*rstride]; //U
-            b[height -j +1] = a[i+1 + (j/2 -1)*rstride]; //V
+static void transformPlane(const unsigned char* src, int sstride,
+                           unsigned char* dst, int dstride,
+                           int width, int height, int elemSize,
+                           const PlaneTransform& t)
+{
+    if (!t.transpose) {
+        for (int y = 0; y < height; y++) {
+            const unsigned char* s = src + y * sstride;
+            unsigned char* d = dst + (t.flipY ? height - 1 - y : y) * dstride;
+            if (t.flipX)
+                reverseLine(s, d, width, elemSize);
+            else
+                memcpy(d, s, width * elemSize);
+        }
+        return;
+    }
 
+    const int micro = MICRO_TILE_BYTES / elemSize;
+    const int block = rotationBlockBytes() / elemSize;
+    const int dwidth = height;
+    const int dheight = width;
+    const int width16 = width - width % micro;
+    const int height16 = height - height % micro;
 
+    for (int by = 0; by < height16; by += block) {
+        const int byEnd = MIN(by + block, height16);
+        for (int bx = 0; bx < width16; bx += block) {
+            const int bxEnd = MIN(bx + block, width16);
+            for (int x = bx; x < bxEnd; x += micro) {
+                // consecutive micro tiles fill the same target lines
+                for (int y = by; y < byEnd; y += micro) {
+                    const unsigned char* in;
+                    ptrdiff_t inStride;
+                    int u;
+                    if (t.flipX) {
+                        in = src + (y + micro - 1) * sstride + x * elemSize;
+                        inStride = -sstride;
+                        u = dwidth - y - micro;
+                    } else {
+                        in = src + y * sstride + x * elemSize;
+                        inStride = sstride;
+                        u = y;
+                    }
+                    unsigned char* out;
+                    ptrdiff_t outStride;
+                    if (t.flipY) {
+                        out = dst + (dheight - 1 - x) * dstride + u * elemSize;
+                        outStride = -dstride;
+                    } else {
+                        out = dst + x * dstride + u * elemSize;
+                        outStride = dstride;
+                    }
+                    if (elemSize == 1)
+                        transpose16x16x8(in, inStride, out, outStride);
+                    else
+                        transpose8x8x16(in, inStride, out, outStride);
+                }
+            }
         }
-        b = b + wstride;
     }
+
+    // right and bottom borders
+    transformArea(src, sstride, dst, dstride, width, height, elemSize, t,
+                  width16, width, 0, height);
+    transformArea(src, sstride, dst, dstride, width, height, elemSize, t,
+                  0, width16, height16, height);
+}
+
+bool nv12rotate(const int   angle,
+                const bool  mirror,
+                const int   width,
+                const int   height,
+                const int   rstride,
+                const int   wstride,
+                const char* sptr,
+                char*       dptr)
+{
+    PlaneTransform t;
+
+    switch (angle) {
+    case 0:
+        t.transpose = false; t.flipX = false; t.flipY = false;
+        break;
+    case 90:
+        t.transpose = true;  t.flipX = true;  t.flipY = false;
+        break;
+    case 180:
+        t.transpose = false; t.flipX = true;  t.flipY = true;
+        break;
+    case 270:
+        t.transpose = true;  t.flipX = false; t.flipY = true;
+        break;
+    default:
+        LOGE("@%s: unsupported angle %d", __FUNCTION__, angle);
+        return false;
+    }
+
+    // mirroring the source columns flips whichever target axis they map to
+    if (mirror) {
+        if (t.transpose)
+            t.flipY = !t.flipY;
+        else
+            t.flipX = !t.flipX;
+    }
+
+    const unsigned char* src = (const unsigned char*)sptr;
+    unsigned char* dst = (unsigned char*)dptr;
+    const int dheight = t.transpose ? width : height;
+
+    // Luma
+    transformPlane(src, rstride, dst, wstride, width, height, 1, t);
+    // Chroma, UV pairs are moved as one 16-bit element
+    transformPlane(src + rstride * height, rstride, dst + wstride * dheight, wstride,
+                   width / 2, height / 2, 2, t);
+
     return true;
 }
+
+} // namespace android
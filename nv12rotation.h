@@ -16,9 +16,9 @@
 #ifndef NV12ROTATION_H
 #define NV12ROTATION_H
 
-// nv12rotateBy90() is an optimized 90 degree rotation for a select
-// set of NV12 images. Since it can only rotate some image geometries,
-// the return value indicates whether the rotation was done or not.
+// nv12rotateBy90() is a 90 degree clockwise rotation of NV12 images. The
+// geometries listed in nv12rotationgeometry.h use hand-tuned kernels, any
+// other geometry goes through nv12rotate().
 // Width, height, rstride and wstride parameters are in pixels.
 bool nv12rotateBy90(const int   width,   // width of the source image
                     const int   height,  // height of the source image
@@ -27,4 +27,21 @@ bool nv12rotateBy90(const int   width,   // width of the source image
                     const char* sptr,    // source image
                     char*       dptr);   // target image
 
+namespace android {
+
+// nv12rotate() rotates an NV12 image clockwise by 0, 90, 180 or 270 degrees,
+// mirroring the source horizontally first if requested. Any geometry and
+// stride is supported, the return value is false only for other angles.
+// Width, height, rstride and wstride parameters are in pixels.
+bool nv12rotate(const int   angle,   // clockwise rotation in degrees
+                const bool  mirror,  // mirror the source image horizontally
+                const int   width,   // width of the source image
+                const int   height,  // height of the source image
+                const int   rstride, // scanline stride of the source image
+                const int   wstride, // scanline stride of the target image
+                const char* sptr,    // source image
+                char*       dptr);   // target image
+
+} // namespace android
+
 #endif
@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_AiqReplayBenchmark"
+
+/**
+ * Replays a 3A statistics recording through the AIQ as fast as it runs,
+ * without the sensor and the ISP.
+ *
+ * The recording is written by StatsRecorder, see StatsRecording.h. Each
+ * frame goes through the stages AtomAIQ runs for a preview frame:
+ * statistics conversion and ia_aiq_statistics_set(), then AF, AE, AWB and
+ * GBCE. The AE gets its previous results back as feedback, with the
+ * exposure recorded for the frame. Every pass starts from a new AIQ
+ * instance, so that it also gives the number of frames AE and AWB take to
+ * converge from the cold start.
+ *
+ * The executable fails when the files cannot be read, when the recording
+ * is corrupted or when a stage returns an error.
+ *
+ * Usage: camera_hal_aiq_replay_benchmark <cpf file> <recording> [passes]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <utils/Timers.h>
+#include <libtbd.h>
+#include <ia_aiq.h>
+#include <ia_cmc_parser.h>
+#ifdef ATOMISP_CSS2
+#include <ia_isp_2_2.h>
+#else
+#include <ia_isp_1_5.h>
+#endif
+#include "AtomCommon.h"
+#include "StatsRecording.h"
+
+using namespace android;
+
+namespace {
+
+// as in AtomAIQ
+const unsigned int MAX_STATISTICS_WIDTH = 150;
+const unsigned int MAX_STATISTICS_HEIGHT = 150;
+const unsigned int NUM_EXPOSURES = 1;
+const float AWB_CONVERGED = 0.001f;
+
+enum Stage {
+    STAGE_CONVERT = 0,      // ISP statistics to the AIQ grids
+    STAGE_STATISTICS,       // ia_aiq_statistics_set()
+    STAGE_AF,
+    STAGE_AE,
+    STAGE_AWB,
+    STAGE_GBCE,
+    STAGE_MAX
+};
+
+const char *stageNames[STAGE_MAX] = { "convert", "statistics", "af", "ae", "awb", "gbce" };
+
+/**
+ * Copy of AE results given back to the AE as the results of the frame,
+ * the pointers of ia_aiq_ae_results are to AIQ memory
+ */
+struct AeFeedback {
+    ia_aiq_ae_results results;
+    ia_aiq_ae_exposure_result exposureResult;
+    ia_aiq_exposure_parameters exposure;
+    ia_aiq_exposure_sensor_parameters sensorExposure;
+    ia_aiq_hist_weight_grid weightGrid;
+    ia_aiq_flash_parameters flash;
+};
+
+struct Timing {
+    nsecs_t total;
+    nsecs_t max;
+    unsigned int runs;
+};
+
+struct PassResult {
+    unsigned int frames;
+    int aeConverged;        // first frame of the pass, -1 if never
+    int awbConverged;
+    bool failed;
+};
+
+/**
+ * The statistics buffer and its grid, as AtomAIQ::setStatisticsGrid()
+ */
+class StatsBuffer {
+public:
+    StatsBuffer() : mCapacity(0) { CLEAR(mStats); }
+    ~StatsBuffer() { free(mStats.data); }
+
+    bool setGrid(const struct atomisp_grid_info &grid) {
+        unsigned int size = grid.s3a_width * grid.s3a_height;
+        if (size == 0)
+            return false;
+        if (size > mCapacity) {
+            free(mStats.data);
+            mStats.data = (atomisp_3a_output *) malloc(size * sizeof(*mStats.data));
+            mCapacity = mStats.data != NULL ? size : 0;
+            if (mStats.data == NULL)
+                return false;
+        }
+        mStats.grid_info = grid;
+        return true;
+    }
+
+    struct atomisp_3a_statistics *get() { return &mStats; }
+
+private:
+    struct atomisp_3a_statistics mStats;
+    unsigned int mCapacity;
+};
+
+/**
+ * Reads a file to memory
+ *
+ * \return the buffer, to free, NULL on error
+ */
+void *readFile(const char *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("cannot open %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    void *data = (length > 0) ? malloc(length) : NULL;
+    if (data != NULL && fread(data, 1, length, file) != (size_t) length) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+    if (data == NULL)
+        printf("cannot read %s\n", path);
+    *size = length;
+    return data;
+}
+
+/**
+ * Finds the AIQ record of a CPF file, as CpfStore::fetchConf()
+ */
+bool getAiqRecord(void *cpf, size_t size, ia_binary_data *aiqb)
+{
+    void *data = NULL;
+    size_t dataSize = 0;
+
+    if (tbd_validate(cpf, size, tbd_tag_cpff)
+        || tbd_get_record(cpf, tbd_class_aiq, tbd_format_any, &data, &dataSize)
+        || data == NULL || dataSize == 0)
+        return false;
+
+    aiqb->data = data;
+    aiqb->size = dataSize;
+    return true;
+}
+
+void storeAeFeedback(const ia_aiq_ae_results *results, AeFeedback *feedback)
+{
+    feedback->results = *results;
+    feedback->exposureResult = results->exposures[0];
+    feedback->exposure = *results->exposures[0].exposure;
+    feedback->sensorExposure = *results->exposures[0].sensor_exposure;
+    feedback->weightGrid = *results->weight_grid;
+    feedback->flash = *results->flash;
+
+    feedback->exposureResult.exposure = &feedback->exposure;
+    feedback->exposureResult.sensor_exposure = &feedback->sensorExposure;
+    feedback->results.exposures = &feedback->exposureResult;
+    feedback->results.weight_grid = &feedback->weightGrid;
+    feedback->results.flash = &feedback->flash;
+}
+
+class Replay {
+public:
+    Replay(const ia_binary_data &aiqb, Timing *timings)
+        :mAiq(NULL)
+        ,mIsp(NULL)
+        ,mTimings(timings)
+        ,mHaveAeFeedback(false)
+    {
+        ia_cmc_t *cmc = ia_cmc_parser_init((ia_binary_data *) &aiqb);
+        mAiq = ia_aiq_init((ia_binary_data *) &aiqb, NULL, NULL, MAX_STATISTICS_WIDTH,
+                           MAX_STATISTICS_HEIGHT, NUM_EXPOSURES, cmc, NULL);
+#ifdef ATOMISP_CSS2
+        mIsp = ia_isp_2_2_init(&aiqb, MAX_STATISTICS_WIDTH, MAX_STATISTICS_HEIGHT, cmc, NULL);
+#else
+        mIsp = ia_isp_1_5_init(&aiqb, MAX_STATISTICS_WIDTH, MAX_STATISTICS_HEIGHT, cmc, NULL);
+#endif
+        ia_cmc_parser_deinit(cmc);
+
+        // the input parameters AtomAIQ starts a preview with
+        CLEAR(mAeInput);
+        CLEAR(mAeLimits);
+        CLEAR(mDescriptor);
+        mAeInput.frame_use = ia_aiq_frame_use_preview;
+        mAeInput.flash_mode = ia_aiq_flash_mode_auto;
+        mAeInput.operation_mode = ia_aiq_ae_operation_mode_automatic;
+        mAeInput.metering_mode = ia_aiq_ae_metering_mode_evaluative;
+        mAeInput.priority_mode = ia_aiq_ae_priority_mode_normal;
+        mAeInput.flicker_reduction_mode = ia_aiq_ae_flicker_reduction_auto;
+        mAeInput.sensor_descriptor = &mDescriptor;
+        mAeInput.manual_exposure_time_us = -1;
+        mAeInput.manual_analog_gain = -1;
+        mAeInput.manual_iso = -1;
+        mAeLimits.manual_exposure_time_min = -1;
+        mAeLimits.manual_exposure_time_max = -1;
+        mAeLimits.manual_frame_time_us_min = -1;
+        mAeLimits.manual_frame_time_us_max = -1;
+        mAeLimits.manual_iso_min = -1;
+        mAeLimits.manual_iso_max = -1;
+        mAeInput.manual_limits = &mAeLimits;
+        mAeInput.num_exposures = NUM_EXPOSURES;
+
+        CLEAR(mAwbInput);
+        mAwbInput.frame_use = ia_aiq_frame_use_preview;
+        mAwbInput.scene_mode = ia_aiq_awb_operation_mode_auto;
+
+        CLEAR(mAfInput);
+        CLEAR(mFocusRect);
+        mAfInput.focus_mode = ia_aiq_af_operation_mode_auto;
+        mAfInput.focus_range = ia_aiq_af_range_extended;
+        mAfInput.focus_metering_mode = ia_aiq_af_metering_mode_auto;
+        mAfInput.flash_mode = ia_aiq_flash_mode_auto;
+        mAfInput.focus_rect = &mFocusRect;
+        mAfInput.frame_use = ia_aiq_frame_use_preview;
+
+        CLEAR(mGbceInput);
+        mGbceInput.gbce_level = ia_aiq_gbce_level_use_tuning;
+        mGbceInput.frame_use = ia_aiq_frame_use_preview;
+    }
+
+    ~Replay() {
+#ifdef ATOMISP_CSS2
+        ia_isp_2_2_deinit(mIsp);
+#else
+        ia_isp_1_5_deinit(mIsp);
+#endif
+        ia_aiq_deinit(mAiq);
+    }
+
+    bool isValid() const { return mAiq != NULL && mIsp != NULL; }
+
+    PassResult run(StatsPlayer &player);
+
+private:
+    bool runFrame(const StatsFrameRecord &frame, struct atomisp_3a_statistics *stats,
+                  bool *aeConverged, bool *awbConverged);
+
+private:
+    ia_aiq *mAiq;
+    ia_isp *mIsp;
+    Timing *mTimings;
+    ia_aiq_ae_input_params mAeInput;
+    ia_aiq_ae_manual_limits mAeLimits;
+    ia_aiq_exposure_sensor_descriptor mDescriptor;
+    ia_aiq_awb_input_params mAwbInput;
+    ia_aiq_af_input_params mAfInput;
+    ia_aiq_rect mFocusRect;
+    ia_aiq_gbce_input_params mGbceInput;
+    AeFeedback mAeFeedback;
+    bool mHaveAeFeedback;
+    StatsBuffer mStats;
+};
+
+#define TIMED(stage, call) \
+    do { \
+        nsecs_t start = systemTime(); \
+        err = call; \
+        nsecs_t elapsed = systemTime() - start; \
+        mTimings[stage].total += elapsed; \
+        mTimings[stage].max = MAX(mTimings[stage].max, elapsed); \
+        mTimings[stage].runs++; \
+        if (err != ia_err_none) { \
+            printf("FAIL %s of frame %u: error %d\n", stageNames[stage], frame.expId, err); \
+            return false; \
+        } \
+    } while (0)
+
+bool Replay::runFrame(const StatsFrameRecord &frame, struct atomisp_3a_statistics *stats,
+                      bool *aeConverged, bool *awbConverged)
+{
+    ia_err err;
+    ia_aiq_statistics_input_params input;
+    const ia_aiq_rgbs_grid *rgbsGrids[NUM_EXPOSURES];
+    const ia_aiq_af_grid *afGrids[NUM_EXPOSURES];
+
+    CLEAR(input);
+    input.frame_timestamp = frame.timestamp;
+    input.frame_id = frame.timestamp + 1;
+    input.rgbs_grids = rgbsGrids;
+    input.num_rgbs_grids = NUM_EXPOSURES;
+    input.af_grids = afGrids;
+    input.num_af_grids = NUM_EXPOSURES;
+    input.camera_orientation = ia_aiq_camera_orientation_unknown;
+    if (mHaveAeFeedback) {
+        if (frame.hasExposure) {
+            mAeFeedback.exposure = frame.exposure;
+            mAeFeedback.sensorExposure = frame.sensorExposure;
+        }
+        input.frame_ae_parameters = &mAeFeedback.results;
+    }
+
+#ifdef ATOMISP_CSS2
+    TIMED(STAGE_CONVERT, ia_isp_2_2_statistics_convert(mIsp, stats,
+          (ia_aiq_rgbs_grid **) &rgbsGrids[0], (ia_aiq_af_grid **) &afGrids[0]));
+#else
+    TIMED(STAGE_CONVERT, ia_isp_1_5_statistics_convert(mIsp, stats,
+          (ia_aiq_rgbs_grid **) &rgbsGrids[0], (ia_aiq_af_grid **) &afGrids[0]));
+#endif
+    TIMED(STAGE_STATISTICS, ia_aiq_statistics_set(mAiq, &input));
+
+    ia_aiq_af_results *afResults = NULL;
+    TIMED(STAGE_AF, ia_aiq_af_run(mAiq, &mAfInput, &afResults));
+    // the lens is where the AF asked it
+    if (afResults->lens_driver_action == ia_aiq_lens_driver_action_move_to_unit) {
+        mAfInput.lens_position = afResults->next_lens_position;
+        mAfInput.lens_movement_start_timestamp = frame.timestamp;
+    }
+
+    ia_aiq_ae_results *aeResults = NULL;
+    TIMED(STAGE_AE, ia_aiq_ae_run(mAiq, &mAeInput, &aeResults));
+    storeAeFeedback(aeResults, &mAeFeedback);
+    mHaveAeFeedback = true;
+    *aeConverged = aeResults->exposures[0].converged;
+
+    ia_aiq_awb_results *awbResults = NULL;
+    TIMED(STAGE_AWB, ia_aiq_awb_run(mAiq, &mAwbInput, &awbResults));
+    *awbConverged = fabs(awbResults->distance_from_convergence) <= AWB_CONVERGED;
+
+    ia_aiq_gbce_results *gbceResults = NULL;
+    TIMED(STAGE_GBCE, ia_aiq_gbce_run(mAiq, &mGbceInput, &gbceResults));
+
+    return true;
+}
+
+#undef TIMED
+
+PassResult Replay::run(StatsPlayer &player)
+{
+    PassResult result;
+    StatsFrameRecord frame;
+
+    result.frames = 0;
+    result.aeConverged = -1;
+    result.awbConverged = -1;
+    result.failed = false;
+
+    for (;;) {
+        status_t status = player.readFrame(mStats.get(), &frame);
+        if (status == -EAGAIN) {
+            // a new sensor mode, as AtomAIQ::applyReplaySensorMode()
+            if (!mStats.setGrid(player.getSensorMode().grid)) {
+                printf("FAIL sensor mode without a statistics grid\n");
+                result.failed = true;
+                break;
+            }
+            mDescriptor = player.getSensorMode().descriptor;
+            status = player.readFrame(mStats.get(), &frame);
+        }
+        if (status == NOT_ENOUGH_DATA)
+            break;
+        if (status != NO_ERROR) {
+            printf("FAIL recording corrupted after %u frames: %d\n", result.frames, status);
+            result.failed = true;
+            break;
+        }
+
+        bool aeConverged = false;
+        bool awbConverged = false;
+        if (!runFrame(frame, mStats.get(), &aeConverged, &awbConverged)) {
+            result.failed = true;
+            break;
+        }
+        if (aeConverged && result.aeConverged < 0)
+            result.aeConverged = result.frames;
+        if (awbConverged && result.awbConverged < 0)
+            result.awbConverged = result.frames;
+        result.frames++;
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3) {
+        printf("Usage: camera_hal_aiq_replay_benchmark <cpf file> <recording> [passes]\n");
+        return 1;
+    }
+    int passes = (argc > 3) ? atoi(argv[3]) : 10;
+    if (passes <= 0)
+        passes = 1;
+
+    size_t cpfSize = 0;
+    void *cpf = readFile(argv[1], &cpfSize);
+    if (cpf == NULL)
+        return 1;
+    ia_binary_data aiqb;
+    if (!getAiqRecord(cpf, cpfSize, &aiqb)) {
+        printf("no AIQ record in %s\n", argv[1]);
+        free(cpf);
+        return 1;
+    }
+
+    Timing timings[STAGE_MAX];
+    memset(timings, 0, sizeof(timings));
+    int failures = 0;
+    unsigned int frames = 0;
+    nsecs_t start = systemTime();
+
+    for (int pass = 0; pass < passes && failures == 0; pass++) {
+        StatsPlayer player;
+        if (player.open(argv[2]) != NO_ERROR) {
+            printf("%s is not a 3A statistics recording of this build\n", argv[2]);
+            failures++;
+            break;
+        }
+        Replay replay(aiqb, timings);
+        if (!replay.isValid()) {
+            printf("FAIL AIQ initialization\n");
+            failures++;
+            break;
+        }
+        PassResult r = replay.run(player);
+        printf("pass %d: %u frames, AE converged at frame %d, AWB at frame %d\n",
+               pass, r.frames, r.aeConverged, r.awbConverged);
+        if (r.frames == 0 && !r.failed) {
+            printf("FAIL no frame in %s\n", argv[2]);
+            r.failed = true;
+        }
+        frames += r.frames;
+        failures += r.failed ? 1 : 0;
+    }
+    nsecs_t elapsed = systemTime() - start;
+
+    if (frames > 0) {
+        nsecs_t aiqTime = 0;
+        printf("stage        mean us    max us\n");
+        for (int s = 0; s < STAGE_MAX; s++) {
+            if (timings[s].runs == 0)
+                continue;
+            printf("%-11s %8.1f %9.1f\n", stageNames[s],
+                   timings[s].total / 1000.0 / timings[s].runs, timings[s].max / 1000.0);
+            aiqTime += timings[s].total;
+        }
+        printf("%u frames, %.1f us of AIQ per frame, %.0f frames/s with the replay\n", frames,
+               aiqTime / 1000.0 / frames, frames * 1000000000.0 / elapsed);
+    }
+
+    free(cpf);
+    return failures ? 1 : 0;
+}
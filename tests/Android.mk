@@ -0,0 +1,165 @@
+# Tests and benchmarks of the camera HAL building blocks.
+#
+# Each one is a standalone executable built from the HAL sources it
+# exercises, installed to /system/bin with the "tests" tag, e.g.
+#   make camera_hal_color_converter_test
+#   adb shell camera_hal_color_converter_test
+# They return non-zero when a check fails.
+#
+# camera_hal_v4l2_device_test runs on the build host instead, against the
+# userspace V4L2 driver of MockV4L2Device.h:
+#   make camera_hal_v4l2_device_test
+#   $(HOST_OUT_EXECUTABLES)/camera_hal_v4l2_device_test
+
+LOCAL_PATH:= $(call my-dir)
+
+camera_hal_test_c_includes := \
+	$(LOCAL_PATH)/.. \
+	$(LOCAL_PATH)/../v4l2dev \
+	$(call include-path-for, frameworks-av)/camera \
+	$(call include-path-for, jpeg) \
+	$(call include-path-for, libhardware)/hardware \
+	$(TARGET_OUT_HEADERS)/cameralibs \
+	$(TARGET_OUT_HEADERS)/libmfldadvci
+
+camera_hal_test_cflags :=
+ifeq ($(USE_CSS_2_0), true)
+camera_hal_test_cflags += -DATOMISP_CSS2
+else
+ifeq ($(USE_CSS_2_1), true)
+camera_hal_test_cflags += -DATOMISP_CSS2 -DATOMISP_CSS21
+endif
+endif
+
+# SIMD color converters against the C reference
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_color_converter_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	ColorConverterTest.cpp \
+	TestGlobals.cpp \
+	../ColorConverter.cpp \
+	../ColorConverterKernels.cpp
+LOCAL_C_INCLUDES := $(camera_hal_test_c_includes)
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_SHARED_LIBRARIES := libcamera_client libutils libcutils
+include $(BUILD_EXECUTABLE)
+
+# Striped SW JPEG encoding decoded back with libjpeg, and the stripe parser
+# against malformed stripes
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_sw_jpeg_encoder_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	SWJpegEncoderTest.cpp \
+	TestGlobals.cpp \
+	TestPlatformData.cpp \
+	../SWJpegEncoder.cpp \
+	../ColorConverter.cpp \
+	../ColorConverterKernels.cpp
+LOCAL_C_INCLUDES := $(camera_hal_test_c_includes)
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_SHARED_LIBRARIES := libjpeg libcamera_client libutils libcutils
+include $(BUILD_EXECUTABLE)
+
+# Tiled NV12 rotation against the rotators it replaced, 90 and 270 degrees
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_rotation_benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	RotationBenchmark.cpp \
+	TestGlobals.cpp \
+	TestPlatformData.cpp \
+	../nv12rotation.cpp
+LOCAL_C_INCLUDES := $(camera_hal_test_c_includes)
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_SHARED_LIBRARIES := libcamera_client libutils libcutils
+include $(BUILD_EXECUTABLE)
+
+# Cache flush cost per MB, clflush against clflushopt and clwb
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_flush_benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	FlushBenchmark.cpp \
+	TestGlobals.cpp \
+	TestPlatformData.cpp \
+	../MemoryFlush.cpp
+LOCAL_C_INCLUDES := $(camera_hal_test_c_includes)
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_SHARED_LIBRARIES := libcamera_client libutils libcutils
+include $(BUILD_EXECUTABLE)
+
+# MessageQueue enqueue/dequeue cost and lane ordering
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_message_queue_benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	MessageQueueBenchmark.cpp \
+	TestGlobals.cpp \
+	../MessageQueueStats.cpp
+LOCAL_C_INCLUDES := $(camera_hal_test_c_includes)
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_SHARED_LIBRARIES := libcamera_client libutils libcutils
+include $(BUILD_EXECUTABLE)
+
+# HAL ZSL frame ring against a plain array of frames
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_indexed_frame_ring_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	IndexedFrameRingTest.cpp \
+	TestGlobals.cpp \
+	TestAtomCommon.cpp \
+	../IndexedFrameRing.cpp
+LOCAL_C_INCLUDES := $(camera_hal_test_c_includes)
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_SHARED_LIBRARIES := libcamera_client libutils libcutils
+include $(BUILD_EXECUTABLE)
+
+# 3A statistics recording replayed through the AIQ stages at full speed,
+# per stage cost and convergence
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_aiq_replay_benchmark
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	AiqReplayBenchmark.cpp \
+	TestGlobals.cpp \
+	../StatsRecording.cpp
+LOCAL_C_INCLUDES := $(camera_hal_test_c_includes) \
+	$(TARGET_OUT_HEADERS)/libtbd
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_SHARED_LIBRARIES := \
+	libia_aiq \
+	libia_isp_1_5 \
+	libia_isp_2_2 \
+	libia_cmc_parser \
+	libtbd \
+	libcamera_client \
+	libutils \
+	libcutils
+include $(BUILD_EXECUTABLE)
+
+# V4L2VideoNode and V4L2Subdevice on the build host, streaming synthetic
+# NV12 frames from a userspace driver: frame order, pacing and syscalls per
+# frame, pollNodes() and controls. host/ stands in for the target kernel
+# headers the sources include.
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera_hal_v4l2_device_test
+LOCAL_MODULE_TAGS := tests
+LOCAL_SRC_FILES := \
+	V4L2DeviceTest.cpp \
+	MockV4L2Device.cpp \
+	TestGlobals.cpp \
+	TestAtomCommon.cpp \
+	../v4l2dev/v4l2devicebase.cpp \
+	../v4l2dev/v4l2videonode.cpp \
+	../v4l2dev/v4l2subdevice.cpp
+LOCAL_C_INCLUDES := \
+	$(LOCAL_PATH)/host \
+	$(camera_hal_test_c_includes) \
+	$(TARGET_OUT_HEADERS)/libtbd
+LOCAL_CFLAGS := $(camera_hal_test_cflags)
+LOCAL_STATIC_LIBRARIES := libutils libcutils liblog
+LOCAL_LDLIBS := -lpthread -lrt
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_ColorConverterTest"
+
+/**
+ * Checks that the SIMD color converters give the same bytes as the plain C
+ * reference converters.
+ *
+ * Every converter runs on random frames of odd, unaligned and padded sizes
+ * under each instruction set the CPU supports, and its output, including
+ * the bytes around it, is compared to the output of COLOR_CONVERTER_ISA_C.
+ *
+ * Usage: camera_hal_color_converter_test [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ColorConverter.h"
+#include "AtomCommon.h"
+
+using namespace android;
+
+namespace {
+
+const int GUARD = 64;   // bytes after the expected output which must stay untouched
+const unsigned char FILL = 0xCD;
+
+const char *isaNames[] = { "C", "SSE2", "SSSE3", "AVX2" };
+
+struct Frame {
+    int width;
+    int height;
+    int srcBpl;         // source line stride, at least the width
+    unsigned char *src;
+    unsigned char *yuyv;
+};
+
+/**
+ * One converter under test, run on frame into dst
+ */
+class Conversion {
+public:
+    Conversion(const char *name) : mName(name) {}
+    virtual ~Conversion() {}
+    const char *name() const { return mName; }
+    virtual size_t dstSize(const Frame &f) const = 0;
+    virtual void run(const Frame &f, unsigned char *dst) const = 0;
+private:
+    const char *mName;
+};
+
+class NV12ToRGB565Check : public Conversion {
+public:
+    NV12ToRGB565Check() : Conversion("trimConvertNV12ToRGB565") {}
+    size_t dstSize(const Frame &f) const { return f.width * f.height * 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        trimConvertNV12ToRGB565(f.width, f.height, f.srcBpl, f.src, dst);
+    }
+};
+
+class NV12ToNV21Check : public Conversion {
+public:
+    NV12ToNV21Check() : Conversion("trimConvertNV12ToNV21") {}
+    size_t dstSize(const Frame &f) const { return f.width * f.height * 3 / 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        trimConvertNV12ToNV21(f.width, f.height, f.srcBpl, f.src, dst);
+    }
+};
+
+class NV12ToYV12Check : public Conversion {
+public:
+    NV12ToYV12Check() : Conversion("align16ConvertNV12ToYV12") {}
+    size_t dstSize(const Frame &f) const { return ALIGN16(f.width) * f.height * 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        align16ConvertNV12ToYV12(f.width, f.height, MAX(f.srcBpl, ALIGN16(f.width)), f.src, dst);
+    }
+};
+
+class YV12ToNV21Check : public Conversion {
+public:
+    YV12ToNV21Check() : Conversion("convertYV12ToNV21") {}
+    size_t dstSize(const Frame &f) const { return (f.srcBpl + 32) * f.height * 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        convertYV12ToNV21(f.width, f.height, f.srcBpl, f.srcBpl + 32, f.src, dst);
+    }
+};
+
+class NV12ToP411Check : public Conversion {
+public:
+    NV12ToP411Check() : Conversion("NV12ToP411Separate") {}
+    size_t dstSize(const Frame &f) const { return f.width * f.height * 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        NV12ToP411Separate(f.width, f.height, f.src, f.src + f.width * f.height, dst);
+    }
+};
+
+class NV21ToP411Check : public Conversion {
+public:
+    NV21ToP411Check() : Conversion("NV21ToP411Separate") {}
+    size_t dstSize(const Frame &f) const { return f.width * f.height * 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        NV21ToP411Separate(f.width, f.height, f.src, f.src + f.width * f.height, dst);
+    }
+};
+
+class NV12ToP411StripCheck : public Conversion {
+public:
+    NV12ToP411StripCheck() : Conversion("NV12ToP411Lines") {}
+    size_t dstSize(const Frame &f) const { return f.width * f.height + 16; }
+    void run(const Frame &f, unsigned char *dst) const {
+        int lines = f.height / 2;
+        NV12ToP411Lines(f.width, lines, f.srcBpl, f.src, dst, dst + f.width * lines / 2 + 16,
+                        f.width / 2);
+    }
+};
+
+class YUYVToNV21Check : public Conversion {
+public:
+    YUYVToNV21Check() : Conversion("convertYUYVToNV21") {}
+    size_t dstSize(const Frame &f) const { return f.width * f.height * 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        convertYUYVToNV21(f.width, f.height, f.width * 2 + 32, f.yuyv, dst);
+    }
+};
+
+class YUYVToP411StripCheck : public Conversion {
+public:
+    YUYVToP411StripCheck() : Conversion("YUY2ToP411Lines") {}
+    size_t dstSize(const Frame &f) const { return f.width * f.height * 2; }
+    void run(const Frame &f, unsigned char *dst) const {
+        int cSize = f.width / 2 * ((f.height + 1) / 2);
+        YUY2ToP411Lines(f.width, f.height, f.width * 2 + 32, f.yuyv, dst,
+                        dst + f.width * f.height, dst + f.width * f.height + cSize,
+                        f.width, f.width / 2);
+    }
+};
+
+void fillRandom(unsigned char *buf, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        buf[i] = rand() & 0xFF;
+}
+
+/**
+ * Runs one conversion under every ISA and compares to the C output
+ *
+ * \return number of ISAs whose output differs
+ */
+int check(const Conversion &conv, const Frame &f, ColorConverterIsa maxIsa)
+{
+    size_t size = conv.dstSize(f) + GUARD;
+    unsigned char *ref = (unsigned char *) malloc(size);
+    unsigned char *out = (unsigned char *) malloc(size);
+    int failures = 0;
+
+    memset(ref, FILL, size);
+    setColorConverterIsa(COLOR_CONVERTER_ISA_C);
+    conv.run(f, ref);
+
+    for (int isa = COLOR_CONVERTER_ISA_SSE2; isa <= maxIsa; isa++) {
+        if (setColorConverterIsa((ColorConverterIsa) isa) != NO_ERROR)
+            continue;
+        memset(out, FILL, size);
+        conv.run(f, out);
+        if (memcmp(ref, out, size) != 0) {
+            size_t first = 0;
+            while (ref[first] == out[first])
+                first++;
+            printf("FAIL %s %s %dx%d bpl %d: first difference at byte %zu of %zu\n",
+                   conv.name(), isaNames[isa], f.width, f.height, f.srcBpl, first, size);
+            failures++;
+        }
+    }
+
+    free(ref);
+    free(out);
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    static const int sizes[][2] = {
+        { 2, 2 }, { 16, 2 }, { 18, 4 }, { 34, 2 }, { 64, 8 }, { 66, 6 }, { 100, 3 },
+        { 176, 144 }, { 640, 480 }, { 1922, 10 }, { 1920, 1080 }
+    };
+    const NV12ToRGB565Check nv12ToRgb565;
+    const NV12ToNV21Check nv12ToNv21;
+    const NV12ToYV12Check nv12ToYv12;
+    const YV12ToNV21Check yv12ToNv21;
+    const NV12ToP411Check nv12ToP411;
+    const NV21ToP411Check nv21ToP411;
+    const NV12ToP411StripCheck nv12ToP411Strip;
+    const YUYVToNV21Check yuyvToNv21;
+    const YUYVToP411StripCheck yuyvToP411Strip;
+    const Conversion *conversions[] = {
+        &nv12ToRgb565, &nv12ToNv21, &nv12ToYv12, &yv12ToNv21, &nv12ToP411,
+        &nv21ToP411, &nv12ToP411Strip, &yuyvToNv21, &yuyvToP411Strip
+    };
+    int iterations = (argc > 1) ? atoi(argv[1]) : 4;
+    int checks = 0;
+    int failures = 0;
+
+    ColorConverterIsa maxIsa = getColorConverterIsa();
+    printf("CPU supports %s color converters\n", isaNames[maxIsa]);
+    srand(1);
+
+    for (int it = 0; it < iterations; it++) {
+        for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            Frame f;
+            f.width = sizes[s][0];
+            f.height = sizes[s][1];
+            f.srcBpl = f.width + (rand() % 3) * 16;
+            if (f.srcBpl & 1)
+                f.srcBpl++;
+
+            size_t srcSize = f.srcBpl * f.height * 2 + GUARD;
+            size_t yuyvSize = (f.width * 2 + 32) * f.height + GUARD;
+            f.src = (unsigned char *) malloc(srcSize);
+            f.yuyv = (unsigned char *) malloc(yuyvSize);
+            fillRandom(f.src, srcSize);
+            fillRandom(f.yuyv, yuyvSize);
+
+            for (unsigned int c = 0; c < sizeof(conversions) / sizeof(conversions[0]); c++) {
+                failures += check(*conversions[c], f, maxIsa);
+                checks++;
+            }
+
+            free(f.src);
+            free(f.yuyv);
+        }
+    }
+
+    setColorConverterIsa(maxIsa);
+    printf("%d conversions checked, %d mismatches\n", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_FlushBenchmark"
+
+/**
+ * Cost per MB of the cache flushes of MemoryUtils, against the clflush
+ * loop they replaced.
+ *
+ * Every run dirties all cache lines of the buffer first, then times one
+ * flush of the whole buffer. The best of the runs is printed for:
+ * - the serialized clflush loop flushMemory() used before
+ * - flushMemory(), clflushopt when the CPU has it, and one sfence
+ * - writeBackMemory(), clwb when the CPU has it, and one sfence
+ *
+ * Silvermont (Bay Trail) has neither clflushopt nor clwb, there both
+ * functions are the clflush loop with one trailing fence.
+ *
+ * Usage: camera_hal_flush_benchmark [megabytes] [runs]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cpuid.h>
+#include <utils/Timers.h>
+#include "MemoryUtils.h"
+#include "PlatformData.h"
+
+using namespace android;
+
+namespace {
+
+/**
+ * flushMemory() before it used clflushopt
+ */
+void clflushLoop(char *startAddr, int size)
+{
+    int cacheLineSize = PlatformData::cacheLineSize();
+    char *endAddr = (char *)ALIGN_WIDTH((unsigned long)(startAddr + size), cacheLineSize);
+
+    for (; startAddr < endAddr; startAddr += cacheLineSize)
+        asm volatile("clflush %0" : "+m" (*startAddr));
+}
+
+/**
+ * Best time of runs flushes of the dirtied buffer, in milliseconds
+ */
+double bestOf(void (*flush)(char *, int), char *buf, int size, int runs)
+{
+    double best = 0;
+
+    for (int i = 0; i < runs; i++) {
+        memset(buf, i, size);
+        nsecs_t start = systemTime();
+        flush(buf, size);
+        double ms = (systemTime() - start) / 1000000.0;
+        if (i == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int megabytes = (argc > 1) ? atoi(argv[1]) : 12;
+    int runs = (argc > 2) ? atoi(argv[2]) : 10;
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+    if (megabytes <= 0)
+        megabytes = 1;
+    if (runs <= 0)
+        runs = 1;
+
+    if (__get_cpuid_max(0, NULL) >= 7)
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    printf("clflushopt %s, clwb %s\n", (ebx & (1 << 23)) ? "yes" : "no",
+           (ebx & (1 << 24)) ? "yes" : "no");
+
+    int size = megabytes * 1024 * 1024;
+    char *buf = (char *) malloc(size);
+    if (buf == NULL) {
+        printf("cannot allocate %d MB\n", megabytes);
+        return 1;
+    }
+
+    struct {
+        const char *name;
+        void (*flush)(char *, int);
+    } flushes[] = {
+        { "clflush loop", clflushLoop },
+        { "flushMemory", MemoryUtils::flushMemory },
+        { "writeBackMemory", MemoryUtils::writeBackMemory },
+    };
+
+    printf("%d MB, best of %d runs\n", megabytes, runs);
+    for (unsigned int i = 0; i < sizeof(flushes) / sizeof(flushes[0]); i++) {
+        double ms = bestOf(flushes[i].flush, buf, size, runs);
+        printf("%-16s %8.2f ms %7.3f ms/MB\n", flushes[i].name, ms, ms / megabytes);
+    }
+
+    free(buf);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_IndexedFrameRingTest"
+
+/**
+ * Checks IndexedFrameRing against a plain array of frames, the Vector
+ * scan the HAL ZSL path used before.
+ *
+ * Random pushes, removals from the front and the middle, and clears run on
+ * rings of every capacity up to 9. Frame counters skip values so that held
+ * frames share index slots. After every step the frame order, each lookup
+ * by frameCounter, a lookup of a frame not held and the closest frame to a
+ * random time are compared to the reference.
+ *
+ * Usage: camera_hal_indexed_frame_ring_test [steps]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "IndexedFrameRing.h"
+
+using namespace android;
+
+namespace {
+
+const int MAX_CAPACITY = 9;
+const int FRAME_INTERVAL_MS = 33;
+
+int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FUNCTION__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+AtomBuffer makeFrame(int frameCounter, long timeMs)
+{
+    AtomBuffer frame = AtomBufferFactory::createAtomBuffer();
+    frame.frameCounter = frameCounter;
+    frame.capture_timestamp.tv_sec = timeMs / 1000;
+    frame.capture_timestamp.tv_usec = (timeMs % 1000) * 1000;
+    return frame;
+}
+
+nsecs_t distance(const AtomBuffer &frame, nsecs_t timestamp)
+{
+    nsecs_t d = IndexedFrameRing::timestampOf(frame) - timestamp;
+    return (d < 0) ? -d : d;
+}
+
+/**
+ * The frames held, oldest first
+ */
+struct Reference {
+    AtomBuffer frames[MAX_CAPACITY];
+    int count;
+
+    void removeAt(int i)
+    {
+        for (count--; i < count; i++)
+            frames[i] = frames[i + 1];
+    }
+
+    int findClosest(nsecs_t timestamp) const
+    {
+        int best = -1;
+        for (int i = 0; i < count; i++) {
+            if (best < 0 || distance(frames[i], timestamp) < distance(frames[best], timestamp))
+                best = i;
+        }
+        return best;
+    }
+};
+
+void compare(int capacity, const IndexedFrameRing &ring, const Reference &ref,
+             int unusedCounter, nsecs_t timestamp)
+{
+    CHECK((int) ring.size() == ref.count, "capacity %d: %d frames, expected %d",
+          capacity, (int) ring.size(), ref.count);
+    if ((int) ring.size() != ref.count)
+        return;
+
+    for (int i = 0; i < ref.count; i++) {
+        int frameCounter = ref.frames[i].frameCounter;
+        CHECK(ring.itemAt(i).frameCounter == frameCounter,
+              "capacity %d: frame %d at %d, expected %d",
+              capacity, ring.itemAt(i).frameCounter, i, frameCounter);
+        int found = ring.findByFrameCounter(frameCounter);
+        CHECK(found == i, "capacity %d: frame %d found at %d, held at %d",
+              capacity, frameCounter, found, i);
+    }
+    CHECK(ring.findByFrameCounter(unusedCounter) == -1,
+          "capacity %d: frame %d found but not held", capacity, unusedCounter);
+
+    int closest = ring.findClosest(timestamp);
+    int expected = ref.findClosest(timestamp);
+    if (expected < 0) {
+        CHECK(closest == -1, "capacity %d: closest %d in an empty ring", capacity, closest);
+    } else {
+        // equal distances may resolve to either frame
+        CHECK(closest >= 0 && closest < ref.count
+              && distance(ref.frames[closest], timestamp)
+                 == distance(ref.frames[expected], timestamp),
+              "capacity %d: closest frame at %d, expected %d", capacity, closest, expected);
+    }
+}
+
+void testCapacity(int capacity, int steps)
+{
+    IndexedFrameRing ring(capacity);
+    Reference ref;
+    ref.count = 0;
+    int frameCounter = 0;
+    long timeMs = 1000;
+
+    for (int step = 0; step < steps && failures == 0; step++) {
+        int op = rand() % 4;
+        if (op < 2) {
+            AtomBuffer frame = makeFrame(frameCounter, timeMs);
+            frameCounter += 1 + rand() % 3;
+            timeMs += FRAME_INTERVAL_MS;
+            status_t status = ring.push(frame);
+            if (ref.count < capacity) {
+                CHECK(status == NO_ERROR, "capacity %d: push failed with %d frames",
+                      capacity, ref.count);
+                ref.frames[ref.count++] = frame;
+            } else {
+                CHECK(status == NO_MEMORY, "capacity %d: push to a full ring gave %d",
+                      capacity, status);
+            }
+        } else if (op == 2 && ref.count > 0) {
+            int i = (rand() % 2) ? 0 : rand() % ref.count;
+            ring.removeAt(i);
+            ref.removeAt(i);
+        } else if (rand() % 50 == 0) {
+            ring.clear();
+            ref.count = 0;
+        }
+
+        nsecs_t timestamp = nsecs_t(timeMs - rand() % (FRAME_INTERVAL_MS * 12)) * 1000000LL;
+        compare(capacity, ring, ref, frameCounter + 100, timestamp);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int steps = (argc > 1) ? atoi(argv[1]) : 20000;
+
+    srand(1);
+    for (int capacity = 1; capacity <= MAX_CAPACITY; capacity++)
+        testCapacity(capacity, steps);
+
+    printf("%d steps on %d ring capacities, %d failures\n", steps, MAX_CAPACITY, failures);
+    return failures ? 1 : 0;
+}
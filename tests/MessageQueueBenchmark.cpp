@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_MessageQueueBenchmark"
+
+/**
+ * Enqueue/dequeue cost of MessageQueue, and the ordering rules of its
+ * lanes.
+ *
+ * The timings cover the locked lanes from one thread and from two, and the
+ * frame lane from two threads. The ordering checks run first and fail the
+ * executable:
+ * - a high priority message passes the normal messages of other threads
+ * - it never passes an earlier message of its own thread, frame or not
+ * - it never passes a queued ordered or high priority message of another
+ *   thread, as the camera API calls of two binder threads
+ *
+ * Usage: camera_hal_message_queue_benchmark [messages]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <utils/Timers.h>
+#include "MessageQueue.h"
+
+using namespace android;
+
+namespace {
+
+enum BenchMessageId {
+    BENCH_ID_EXIT = 0,
+    BENCH_ID_WORK,      // normal, from the worker threads
+    BENCH_ID_FRAME,
+    BENCH_ID_CALL,      // ordered, an API call
+    BENCH_ID_PARAMS,    // high priority, an API call
+    BENCH_ID_MAX
+};
+
+// the size of the ControlThread messages on 32-bit builds
+struct BenchMessage {
+    BenchMessageId id;
+    int value;
+    char payload[56];
+};
+
+typedef MessageQueue<BenchMessage, BenchMessageId> BenchQueue;
+
+int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FUNCTION__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+void setPriorities(BenchQueue &queue)
+{
+    queue.setPriority(BENCH_ID_PARAMS, MESSAGE_PRIORITY_HIGH);
+    queue.setPriority(BENCH_ID_CALL, MESSAGE_PRIORITY_ORDERED);
+}
+
+BenchMessage message(BenchMessageId id, int value)
+{
+    BenchMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.id = id;
+    msg.value = value;
+    return msg;
+}
+
+struct Send {
+    BenchQueue *queue;
+    BenchMessage msg;
+};
+
+void *sendThread(void *arg)
+{
+    Send *send = (Send *) arg;
+    send->queue->send(&send->msg);
+    return NULL;
+}
+
+// send a message from a new thread, as another binder thread would. The
+// main thread sends the others: a thread id can be reused once its thread
+// has exited.
+void sendFromOtherThread(BenchQueue &queue, BenchMessageId id, int value)
+{
+    Send send;
+    pthread_t thread;
+    send.queue = &queue;
+    send.msg = message(id, value);
+    pthread_create(&thread, NULL, sendThread, &send);
+    pthread_join(thread, NULL);
+}
+
+// receive count messages and check their values are 0..count-1
+void expectOrder(BenchQueue &queue, int count, const char *what)
+{
+    for (int i = 0; i < count; i++) {
+        BenchMessage msg;
+        queue.receive(&msg);
+        CHECK(msg.value == i, "%s: got %d at position %d", what, msg.value, i);
+    }
+}
+
+void testOrdering()
+{
+    {
+        BenchQueue queue("bench", 0, MESSAGE_QUEUE_FRAME_LANE_SIZE);
+        setPriorities(queue);
+        for (int i = 1; i <= 4; i++) {
+            BenchMessage msg = message(BENCH_ID_WORK, i);
+            queue.send(&msg);
+        }
+        sendFromOtherThread(queue, BENCH_ID_PARAMS, 0);
+        expectOrder(queue, 5, "high passes the workers");
+    }
+    {
+        BenchQueue queue("bench", 0, MESSAGE_QUEUE_FRAME_LANE_SIZE);
+        setPriorities(queue);
+        BenchMessage msg = message(BENCH_ID_WORK, 0);
+        queue.send(&msg);
+        msg = message(BENCH_ID_FRAME, 1);
+        queue.sendFrame(&msg);
+        msg = message(BENCH_ID_PARAMS, 2);
+        queue.send(&msg);
+        expectOrder(queue, 3, "same thread");
+    }
+    {
+        BenchQueue queue("bench", 0, MESSAGE_QUEUE_FRAME_LANE_SIZE);
+        setPriorities(queue);
+        BenchMessage msg = message(BENCH_ID_WORK, 0);
+        queue.send(&msg);
+        msg = message(BENCH_ID_CALL, 1);
+        queue.send(&msg);
+        sendFromOtherThread(queue, BENCH_ID_PARAMS, 2);
+        expectOrder(queue, 3, "ordered call");
+    }
+    {
+        // the first high message waits behind its thread, the second one
+        // from another thread must not pass it
+        BenchQueue queue("bench", 0, MESSAGE_QUEUE_FRAME_LANE_SIZE);
+        setPriorities(queue);
+        BenchMessage msg = message(BENCH_ID_WORK, 0);
+        queue.send(&msg);
+        msg = message(BENCH_ID_PARAMS, 1);
+        queue.send(&msg);
+        sendFromOtherThread(queue, BENCH_ID_PARAMS, 2);
+        expectOrder(queue, 3, "high behind high");
+    }
+}
+
+struct Consumer {
+    BenchQueue *queue;
+    int received;
+};
+
+void *consumerThread(void *arg)
+{
+    Consumer *consumer = (Consumer *) arg;
+    BenchMessage msg;
+    for (;;) {
+        consumer->queue->receive(&msg);
+        if (msg.id == BENCH_ID_EXIT)
+            break;
+        consumer->received++;
+    }
+    return NULL;
+}
+
+void benchSameThread(int count)
+{
+    BenchQueue queue("bench");
+    BenchMessage msg = message(BENCH_ID_WORK, 0);
+
+    nsecs_t start = systemTime();
+    for (int i = 0; i < count; i += 4) {
+        for (int j = 0; j < 4; j++)
+            queue.send(&msg);
+        for (int j = 0; j < 4; j++)
+            queue.receive(&msg);
+    }
+    printf("send+receive, one thread, bursts of 4: %6.1f ns/msg\n",
+           (systemTime() - start) / (double) count);
+}
+
+void benchTwoThreads(int count, bool frames)
+{
+    BenchQueue queue("bench", 0, frames ? MESSAGE_QUEUE_FRAME_LANE_SIZE : 0);
+    Consumer consumer;
+    pthread_t thread;
+    BenchMessage msg = message(frames ? BENCH_ID_FRAME : BENCH_ID_WORK, 0);
+
+    consumer.queue = &queue;
+    consumer.received = 0;
+    nsecs_t start = systemTime();
+    pthread_create(&thread, NULL, consumerThread, &consumer);
+    for (int i = 0; i < count; i++) {
+        if (frames)
+            queue.sendFrame(&msg);
+        else
+            queue.send(&msg);
+    }
+    BenchMessage exitMsg = message(BENCH_ID_EXIT, 0);
+    queue.send(&exitMsg);
+    pthread_join(thread, NULL);
+
+    printf("%-38s %6.1f ns/msg\n", frames ? "sendFrame, producer and consumer:" :
+           "send, producer and consumer:", (systemTime() - start) / (double) count);
+    CHECK(consumer.received == count, "%d of %d messages received", consumer.received, count);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int count = (argc > 1) ? atoi(argv[1]) : 1000000;
+    if (count < 4)
+        count = 4;
+
+    testOrdering();
+
+    benchSameThread(count);
+    benchTwoThreads(count, false);
+    benchTwoThreads(count, true);
+
+    if (failures)
+        printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,903 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_MockV4L2Device"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/videodev2.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+#include "MockV4L2Device.h"
+
+using namespace android;
+
+namespace {
+
+const int MAX_NODES = 8;
+const int MAX_BUFFERS = VIDEO_MAX_FRAME;
+const int MAX_CONTROLS = 16;
+const int MAX_DMABUFS = 64;
+const int MAX_MEMORIES = MAX_NODES * MAX_BUFFERS + MAX_DMABUFS;
+const size_t PAGE_SIZE_BYTES = 4096;
+const int DEFAULT_WIDTH = 640;
+const int DEFAULT_HEIGHT = 480;
+const int LINE_ALIGNMENT = 64;      /*!< the ISP pads lines like this */
+const unsigned char CHROMA_BYTE = 0x80;
+
+struct Control {
+    unsigned int id;
+    int value;
+};
+
+/**
+ * Memory of MMAP buffers and dma-bufs, freed with its last reference:
+ * the buffer, the mappings and the dma-bufs exported from it
+ */
+struct Memory {
+    char *data;
+    size_t size;
+    int refs;
+};
+
+struct DmaBuf {
+    int fd;
+    Memory *memory;
+};
+
+struct Buffer {
+    bool queued;
+    unsigned long userptr;
+    int dmabufFd;
+    Memory *memory;         /*!< MMAP: allocated by REQBUFS, DMABUF: while queued */
+    size_t length;
+};
+
+struct Node {
+    char path[64];
+    bool subdevice;
+    int fps;
+    int fd;                         /*!< -1 when closed */
+    struct v4l2_pix_format format;
+    enum v4l2_memory memory;
+    unsigned int count;             /*!< buffers of the last VIDIOC_REQBUFS */
+    Buffer buffers[MAX_BUFFERS];
+    unsigned int queue[MAX_BUFFERS];    /*!< indices queued, in order */
+    unsigned int queueHead;
+    unsigned int queued;
+    bool streaming;
+    nsecs_t streamOnTime;
+    unsigned int sequence;          /*!< of the next frame */
+    Control controls[MAX_CONTROLS];
+    int controlCount;
+};
+
+Mutex gLock;
+Node gNodes[MAX_NODES];
+int gNodeCount = 0;
+DmaBuf gDmaBufs[MAX_DMABUFS];
+int gDmaBufCount = 0;
+Memory *gMemories[MAX_MEMORIES];
+int gMemoryCount = 0;
+
+/**
+ * The calls not served by the mock go straight to the kernel, the libc
+ * functions are overridden below.
+ */
+int realOpen(const char *path, int flags, mode_t mode)
+{
+    return syscall(SYS_openat, AT_FDCWD, path, flags, mode);
+}
+
+int realClose(int fd)
+{
+    return syscall(SYS_close, fd);
+}
+
+int realIoctl(int fd, unsigned long request, void *arg)
+{
+    return syscall(SYS_ioctl, fd, request, arg);
+}
+
+int realPoll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    return syscall(SYS_poll, fds, nfds, timeout);
+}
+
+void *realMmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+#ifdef SYS_mmap2
+    return (void *) syscall(SYS_mmap2, addr, length, prot, flags, fd, offset / PAGE_SIZE_BYTES);
+#else
+    return (void *) syscall(SYS_mmap, addr, length, prot, flags, fd, offset);
+#endif
+}
+
+int realMunmap(void *addr, size_t length)
+{
+    return syscall(SYS_munmap, addr, length);
+}
+
+/**
+ * A real descriptor for the devices and dma-bufs, so that they cannot
+ * clash with the ones of files
+ */
+int reserveFd()
+{
+    return realOpen("/dev/null", O_RDWR | O_CLOEXEC, 0);
+}
+
+size_t pageAlign(size_t size)
+{
+    return (size + PAGE_SIZE_BYTES - 1) & ~(PAGE_SIZE_BYTES - 1);
+}
+
+Memory *newMemory(size_t size)
+{
+    void *data = NULL;
+
+    if (gMemoryCount == MAX_MEMORIES || posix_memalign(&data, PAGE_SIZE_BYTES, pageAlign(size)) != 0)
+        return NULL;
+
+    Memory *memory = new Memory;
+    memory->data = (char *) data;
+    memory->size = size;
+    memory->refs = 1;
+    gMemories[gMemoryCount++] = memory;
+    return memory;
+}
+
+void unrefMemory(Memory *memory)
+{
+    if (memory == NULL || --memory->refs > 0)
+        return;
+
+    for (int i = 0; i < gMemoryCount; i++) {
+        if (gMemories[i] == memory) {
+            gMemories[i] = gMemories[--gMemoryCount];
+            break;
+        }
+    }
+    free(memory->data);
+    delete memory;
+}
+
+Memory *findMemory(const void *data)
+{
+    for (int i = 0; i < gMemoryCount; i++) {
+        if (gMemories[i]->data == data)
+            return gMemories[i];
+    }
+    return NULL;
+}
+
+DmaBuf *findDmaBuf(int fd)
+{
+    for (int i = 0; fd >= 0 && i < gDmaBufCount; i++) {
+        if (gDmaBufs[i].fd == fd)
+            return &gDmaBufs[i];
+    }
+    return NULL;
+}
+
+/**
+ * New dma-buf of the memory, takes a reference. Returns its fd or -1.
+ */
+int addDmaBuf(Memory *memory)
+{
+    if (gDmaBufCount == MAX_DMABUFS)
+        return -1;
+
+    int fd = reserveFd();
+    if (fd < 0)
+        return -1;
+
+    memory->refs++;
+    gDmaBufs[gDmaBufCount].fd = fd;
+    gDmaBufs[gDmaBufCount].memory = memory;
+    gDmaBufCount++;
+    return fd;
+}
+
+void removeDmaBuf(DmaBuf *dmabuf)
+{
+    unrefMemory(dmabuf->memory);
+    *dmabuf = gDmaBufs[--gDmaBufCount];
+}
+
+Node *findNode(const char *path)
+{
+    for (int i = 0; i < gNodeCount; i++) {
+        if (strcmp(gNodes[i].path, path) == 0)
+            return &gNodes[i];
+    }
+    return NULL;
+}
+
+Node *findNode(int fd)
+{
+    for (int i = 0; fd >= 0 && i < gNodeCount; i++) {
+        if (gNodes[i].fd == fd)
+            return &gNodes[i];
+    }
+    return NULL;
+}
+
+Node *addNode(const char *path, bool subdevice, int fps)
+{
+    Mutex::Autolock lock(gLock);
+    if (gNodeCount == MAX_NODES || findNode(path) != NULL
+        || strlen(path) >= sizeof(gNodes[0].path)) {
+        fprintf(stderr, "%s: cannot add device %s\n", LOG_TAG, path);
+        return NULL;
+    }
+
+    Node *node = &gNodes[gNodeCount++];
+    memset(node, 0, sizeof(*node));
+    strcpy(node->path, path);
+    node->subdevice = subdevice;
+    node->fps = fps;
+    node->fd = -1;
+    node->memory = V4L2_MEMORY_USERPTR;
+    return node;
+}
+
+void setFormat(Node *node, int width, int height)
+{
+    struct v4l2_pix_format &format = node->format;
+
+    format.width = (width < 2) ? 2 : width & ~1;
+    format.height = (height < 2) ? 2 : height & ~1;
+    format.pixelformat = V4L2_PIX_FMT_NV12;
+    format.field = V4L2_FIELD_NONE;
+    format.bytesperline = (format.width + LINE_ALIGNMENT - 1) & ~(LINE_ALIGNMENT - 1);
+    format.sizeimage = format.bytesperline * format.height * 3 / 2;
+    format.colorspace = V4L2_COLORSPACE_JPEG;
+}
+
+nsecs_t frameDueTime(const Node *node)
+{
+    if (node->fps <= 0)
+        return node->streamOnTime;
+    return node->streamOnTime + node->sequence * (seconds(1) / node->fps);
+}
+
+void fillFrame(char *data, const struct v4l2_pix_format &format, unsigned int sequence)
+{
+    size_t lumaSize = format.bytesperline * format.height;
+
+    for (unsigned int row = 0; row < format.height; row++)
+        memset(data + row * format.bytesperline, (sequence + row) & 0xff,
+               format.bytesperline);
+    memset(data + lumaSize, CHROMA_BYTE, format.sizeimage - lumaSize);
+}
+
+void releaseBuffers(Node *node)
+{
+    for (unsigned int i = 0; i < node->count; i++)
+        unrefMemory(node->buffers[i].memory);
+    memset(node->buffers, 0, sizeof(node->buffers));
+    node->count = 0;
+    node->queued = 0;
+    node->queueHead = 0;
+}
+
+/**
+ * Drops a buffer from the queue, the dma-buf it imported is released
+ */
+void unqueue(Node *node, Buffer &buffer)
+{
+    buffer.queued = false;
+    if (node->memory == V4L2_MEMORY_DMABUF) {
+        unrefMemory(buffer.memory);
+        buffer.memory = NULL;
+    }
+}
+
+void stopStreaming(Node *node)
+{
+    node->streaming = false;
+    for (unsigned int i = 0; i < node->count; i++) {
+        if (node->buffers[i].queued)
+            unqueue(node, node->buffers[i]);
+    }
+    node->queued = 0;
+    node->queueHead = 0;
+}
+
+Control *findControl(Node *node, unsigned int id)
+{
+    for (int i = 0; i < node->controlCount; i++) {
+        if (node->controls[i].id == id)
+            return &node->controls[i];
+    }
+    return NULL;
+}
+
+int setControl(Node *node, unsigned int id, int value)
+{
+    Control *control = findControl(node, id);
+    if (control == NULL) {
+        if (node->controlCount == MAX_CONTROLS)
+            return ENOMEM;
+        control = &node->controls[node->controlCount++];
+        control->id = id;
+    }
+    control->value = value;
+    return 0;
+}
+
+int getControl(Node *node, unsigned int id, int *value)
+{
+    Control *control = findControl(node, id);
+    if (control == NULL)
+        return EINVAL;
+    *value = control->value;
+    return 0;
+}
+
+int queryCap(Node *node, struct v4l2_capability *cap)
+{
+    memset(cap, 0, sizeof(*cap));
+    strncpy((char *)cap->driver, "mock_v4l2", sizeof(cap->driver) - 1);
+    strncpy((char *)cap->card, node->path, sizeof(cap->card) - 1);
+    strncpy((char *)cap->bus_info, "host", sizeof(cap->bus_info) - 1);
+    cap->capabilities = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+    return 0;
+}
+
+int setFormat(Node *node, struct v4l2_format *format)
+{
+    if (format->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        return EINVAL;
+    if (node->streaming || node->count > 0)
+        return EBUSY;
+
+    setFormat(node, format->fmt.pix.width, format->fmt.pix.height);
+    format->fmt.pix = node->format;
+    return 0;
+}
+
+int requestBuffers(Node *node, struct v4l2_requestbuffers *req)
+{
+    if (req->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        return EINVAL;
+    if (req->memory != V4L2_MEMORY_USERPTR && req->memory != V4L2_MEMORY_MMAP
+        && req->memory != V4L2_MEMORY_DMABUF)
+        return EINVAL;
+    if (node->streaming)
+        return EBUSY;
+
+    releaseBuffers(node);
+    node->memory = (enum v4l2_memory) req->memory;
+    unsigned int count = (req->count > (unsigned int) MAX_BUFFERS) ? MAX_BUFFERS : req->count;
+
+    for (node->count = 0; node->count < count; node->count++) {
+        Buffer &buffer = node->buffers[node->count];
+        buffer.dmabufFd = -1;
+        if (node->memory == V4L2_MEMORY_MMAP) {
+            buffer.memory = newMemory(node->format.sizeimage);
+            if (buffer.memory == NULL)
+                break;
+            buffer.length = node->format.sizeimage;
+        }
+    }
+    req->count = node->count;
+    return 0;
+}
+
+int queryBuffer(Node *node, struct v4l2_buffer *buf)
+{
+    if (buf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf->index >= node->count)
+        return EINVAL;
+
+    const Buffer &buffer = node->buffers[buf->index];
+    buf->memory = node->memory;
+    buf->flags = buffer.queued ? V4L2_BUF_FLAG_QUEUED : 0;
+    switch (node->memory) {
+    case V4L2_MEMORY_MMAP:
+        buf->length = buffer.length;
+        buf->m.offset = buf->index * pageAlign(node->format.sizeimage);
+        break;
+    case V4L2_MEMORY_DMABUF:
+        // the size of a dma-buf is only known once it is queued
+        buf->length = buffer.length;
+        buf->m.fd = buffer.dmabufFd;
+        break;
+    default:
+        buf->length = node->format.sizeimage;
+        buf->m.userptr = buffer.userptr;
+        break;
+    }
+    return 0;
+}
+
+int queueBuffer(Node *node, struct v4l2_buffer *buf)
+{
+    if (buf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf->index >= node->count
+        || buf->memory != node->memory)
+        return EINVAL;
+
+    Buffer &buffer = node->buffers[buf->index];
+    if (buffer.queued)
+        return EINVAL;
+
+    if (node->memory == V4L2_MEMORY_USERPTR) {
+        if (buf->m.userptr == 0 || buf->length < node->format.sizeimage)
+            return EFAULT;
+        buffer.userptr = buf->m.userptr;
+        buffer.length = buf->length;
+    } else if (node->memory == V4L2_MEMORY_DMABUF) {
+        DmaBuf *dmabuf = findDmaBuf(buf->m.fd);
+        if (dmabuf == NULL || dmabuf->memory->size < node->format.sizeimage)
+            return EINVAL;
+        buffer.dmabufFd = buf->m.fd;
+        buffer.memory = dmabuf->memory;
+        buffer.memory->refs++;
+        buffer.length = dmabuf->memory->size;
+    }
+    buffer.queued = true;
+    node->queue[(node->queueHead + node->queued) % MAX_BUFFERS] = buf->index;
+    node->queued++;
+    return 0;
+}
+
+/**
+ * Waits until the next frame is due and writes it to the oldest buffer
+ * queued. Called with gLock held, released while waiting.
+ */
+int dequeueBuffer(Node *node, struct v4l2_buffer *buf)
+{
+    if (buf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf->memory != node->memory)
+        return EINVAL;
+
+    for (;;) {
+        // the driver would block forever, the test had better fail
+        if (!node->streaming || node->queued == 0)
+            return EINVAL;
+        nsecs_t wait = frameDueTime(node) - systemTime();
+        if (wait <= 0)
+            break;
+        struct timespec ts = { (time_t)(wait / seconds(1)), (long)(wait % seconds(1)) };
+        gLock.unlock();
+        nanosleep(&ts, NULL);
+        gLock.lock();
+    }
+
+    unsigned int index = node->queue[node->queueHead];
+    node->queueHead = (node->queueHead + 1) % MAX_BUFFERS;
+    node->queued--;
+    Buffer &buffer = node->buffers[index];
+    if (node->memory == V4L2_MEMORY_USERPTR)
+        fillFrame((char *) buffer.userptr, node->format, node->sequence);
+    else
+        fillFrame(buffer.memory->data, node->format, node->sequence);
+    unqueue(node, buffer);
+
+    nsecs_t timestamp = frameDueTime(node);
+    buf->index = index;
+    buf->bytesused = node->format.sizeimage;
+    buf->length = buffer.length;
+    buf->flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+    buf->field = V4L2_FIELD_NONE;
+    buf->timestamp.tv_sec = timestamp / seconds(1);
+    buf->timestamp.tv_usec = (timestamp % seconds(1)) / 1000;
+    buf->sequence = node->sequence++;
+    if (node->memory == V4L2_MEMORY_USERPTR)
+        buf->m.userptr = buffer.userptr;
+    else if (node->memory == V4L2_MEMORY_DMABUF)
+        buf->m.fd = buffer.dmabufFd;
+    else
+        buf->m.offset = index * pageAlign(node->format.sizeimage);
+    buf->reserved = 0;     // ATOMISP_FRAME_STATUS_OK
+    return 0;
+}
+
+int streamOn(Node *node, const int *type)
+{
+    if (*type != V4L2_BUF_TYPE_VIDEO_CAPTURE || node->count == 0)
+        return EINVAL;
+    if (!node->streaming) {
+        node->streaming = true;
+        node->streamOnTime = systemTime();
+        node->sequence = 0;
+    }
+    return 0;
+}
+
+int exportBuffer(Node *node, struct v4l2_exportbuffer *expbuf)
+{
+    if (expbuf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || node->memory != V4L2_MEMORY_MMAP
+        || expbuf->index >= node->count)
+        return EINVAL;
+
+    expbuf->fd = addDmaBuf(node->buffers[expbuf->index].memory);
+    return (expbuf->fd < 0) ? EMFILE : 0;
+}
+
+int setParameters(Node *node, struct v4l2_streamparm *parm)
+{
+    if (parm->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+        return EINVAL;
+    const struct v4l2_fract &interval = parm->parm.capture.timeperframe;
+    if (interval.numerator != 0 && interval.denominator != 0)
+        node->fps = interval.denominator / interval.numerator;
+    return 0;
+}
+
+int extControls(Node *node, struct v4l2_ext_controls *controls, bool set)
+{
+    for (unsigned int i = 0; i < controls->count; i++) {
+        struct v4l2_ext_control &control = controls->controls[i];
+        int value = control.value;
+        int ret = set ? setControl(node, control.id, value)
+                      : getControl(node, control.id, &value);
+        if (ret != 0) {
+            controls->error_idx = i;
+            return ret;
+        }
+        control.value = value;
+    }
+    return 0;
+}
+
+/**
+ * The ioctls of both device types, returns an errno value
+ */
+int serveIoctl(Node *node, unsigned long request, void *arg)
+{
+    switch (request) {
+    case VIDIOC_S_CTRL: {
+        struct v4l2_control *control = (struct v4l2_control *) arg;
+        return setControl(node, control->id, control->value);
+    }
+    case VIDIOC_G_CTRL: {
+        struct v4l2_control *control = (struct v4l2_control *) arg;
+        return getControl(node, control->id, &control->value);
+    }
+    case VIDIOC_S_EXT_CTRLS:
+        return extControls(node, (struct v4l2_ext_controls *) arg, true);
+    case VIDIOC_G_EXT_CTRLS:
+        return extControls(node, (struct v4l2_ext_controls *) arg, false);
+    case VIDIOC_SUBSCRIBE_EVENT:
+    case VIDIOC_UNSUBSCRIBE_EVENT:
+        return 0;
+    case VIDIOC_DQEVENT:
+        return ENOENT;
+    }
+
+    if (node->subdevice)
+        return ENOTTY;
+
+    switch (request) {
+    case VIDIOC_QUERYCAP:
+        return queryCap(node, (struct v4l2_capability *) arg);
+    case VIDIOC_ENUM_FMT: {
+        struct v4l2_fmtdesc *desc = (struct v4l2_fmtdesc *) arg;
+        if (desc->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || desc->index != 0)
+            return EINVAL;
+        desc->pixelformat = V4L2_PIX_FMT_NV12;
+        strncpy((char *)desc->description, "NV12", sizeof(desc->description) - 1);
+        return 0;
+    }
+    case VIDIOC_S_INPUT:
+        return 0;
+    case VIDIOC_G_FMT: {
+        struct v4l2_format *format = (struct v4l2_format *) arg;
+        if (format->type != V4L2_BUF_TYPE_VIDEO_CAPTURE)
+            return EINVAL;
+        format->fmt.pix = node->format;
+        return 0;
+    }
+    case VIDIOC_S_FMT:
+        return setFormat(node, (struct v4l2_format *) arg);
+    case VIDIOC_S_PARM:
+        return setParameters(node, (struct v4l2_streamparm *) arg);
+    case VIDIOC_REQBUFS:
+        return requestBuffers(node, (struct v4l2_requestbuffers *) arg);
+    case VIDIOC_QUERYBUF:
+        return queryBuffer(node, (struct v4l2_buffer *) arg);
+    case VIDIOC_QBUF:
+        return queueBuffer(node, (struct v4l2_buffer *) arg);
+    case VIDIOC_DQBUF:
+        return dequeueBuffer(node, (struct v4l2_buffer *) arg);
+    case VIDIOC_STREAMON:
+        return streamOn(node, (const int *) arg);
+    case VIDIOC_STREAMOFF:
+        stopStreaming(node);
+        return 0;
+    case VIDIOC_EXPBUF:
+        return exportBuffer(node, (struct v4l2_exportbuffer *) arg);
+    }
+    return ENOTTY;
+}
+
+/**
+ * poll() events of a node, sets *due to the time of the next frame when
+ * it is not yet due
+ */
+short pollEvents(const Node *node, nsecs_t now, nsecs_t *due)
+{
+    // subdevices have no events to wait for
+    if (node->subdevice)
+        return 0;
+    // what videobuf2 reports when there is no frame to wait for
+    if (!node->streaming || node->queued == 0)
+        return POLLERR;
+
+    nsecs_t frameDue = frameDueTime(node);
+    if (frameDue <= now)
+        return POLLIN | POLLRDNORM;
+    if (*due < 0 || frameDue < *due)
+        *due = frameDue;
+    return 0;
+}
+
+} // namespace
+
+namespace android {
+namespace MockV4L2Device {
+
+void addVideoNode(const char *path, int fps)
+{
+    Node *node = addNode(path, false, fps);
+    if (node != NULL)
+        setFormat(node, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+}
+
+void addSubdevice(const char *path)
+{
+    addNode(path, true, 0);
+}
+
+int allocateDmaBuf(size_t size)
+{
+    Mutex::Autolock lock(gLock);
+    Memory *memory = newMemory(size);
+    if (memory == NULL)
+        return -1;
+
+    int fd = addDmaBuf(memory);
+    unrefMemory(memory);
+    return fd;
+}
+
+bool checkFrame(const void *data, int bpl, int height, unsigned int sequence)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+
+    for (int row = 0; row < height; row++) {
+        unsigned char luma = (sequence + row) & 0xff;
+        if (bytes[row * bpl] != luma || bytes[row * bpl + bpl - 1] != luma)
+            return false;
+    }
+    const unsigned char *chroma = bytes + bpl * height;
+    return chroma[0] == CHROMA_BYTE && chroma[bpl * height / 2 - 1] == CHROMA_BYTE;
+}
+
+int openFds()
+{
+    Mutex::Autolock lock(gLock);
+    int count = 0;
+
+    for (int i = 0; i < gNodeCount; i++) {
+        if (gNodes[i].fd != -1)
+            count++;
+    }
+    return count + gDmaBufCount;
+}
+
+int buffers()
+{
+    Mutex::Autolock lock(gLock);
+    return gMemoryCount;
+}
+
+} // namespace MockV4L2Device
+} // namespace android
+
+/**
+ * The libc functions V4L2DeviceBase and its subclasses call
+ */
+extern "C" {
+
+int stat(const char *path, struct stat *buf) __THROW
+{
+    {
+        Mutex::Autolock lock(gLock);
+        if (findNode(path) != NULL) {
+            memset(buf, 0, sizeof(*buf));
+            buf->st_mode = S_IFCHR | 0660;
+            return 0;
+        }
+    }
+    return fstatat(AT_FDCWD, path, buf, 0);
+}
+
+#ifdef _STAT_VER
+// older C libraries inline stat() to this
+int __xstat(int ver, const char *path, struct stat *buf) __THROW
+{
+    {
+        Mutex::Autolock lock(gLock);
+        if (findNode(path) != NULL) {
+            memset(buf, 0, sizeof(*buf));
+            buf->st_mode = S_IFCHR | 0660;
+            return 0;
+        }
+    }
+    return __fxstatat(ver, AT_FDCWD, path, buf, 0);
+}
+#endif
+
+int open(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+
+    if (flags & O_CREAT) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+
+    Mutex::Autolock lock(gLock);
+    Node *node = findNode(path);
+    if (node == NULL)
+        return realOpen(path, flags, mode);
+
+    if (node->fd != -1) {
+        errno = EBUSY;
+        return -1;
+    }
+    node->fd = reserveFd();
+    return node->fd;
+}
+
+int close(int fd)
+{
+    {
+        Mutex::Autolock lock(gLock);
+        Node *node = findNode(fd);
+        if (node != NULL) {
+            stopStreaming(node);
+            releaseBuffers(node);
+            node->fd = -1;
+        }
+        DmaBuf *dmabuf = findDmaBuf(fd);
+        if (dmabuf != NULL)
+            removeDmaBuf(dmabuf);
+    }
+    return realClose(fd);
+}
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset) __THROW
+{
+    Mutex::Autolock lock(gLock);
+    Memory *memory = NULL;
+
+    Node *node = findNode(fd);
+    DmaBuf *dmabuf = findDmaBuf(fd);
+    if (node != NULL) {
+        size_t stride = pageAlign(node->format.sizeimage);
+        unsigned int index = offset / stride;
+        if (node->memory == V4L2_MEMORY_MMAP && index < node->count && offset % stride == 0)
+            memory = node->buffers[index].memory;
+    } else if (dmabuf != NULL) {
+        if (offset == 0)
+            memory = dmabuf->memory;
+    } else {
+        return realMmap(addr, length, prot, flags, fd, offset);
+    }
+
+    if (memory == NULL || length > pageAlign(memory->size)) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    memory->refs++;
+    return memory->data;
+}
+
+int munmap(void *addr, size_t length) __THROW
+{
+    Mutex::Autolock lock(gLock);
+    Memory *memory = findMemory(addr);
+    if (memory == NULL)
+        return realMunmap(addr, length);
+
+    unrefMemory(memory);
+    return 0;
+}
+
+int ioctl(int fd, unsigned long request, ...) __THROW
+{
+    va_list ap;
+    va_start(ap, request);
+    void *arg = va_arg(ap, void *);
+    va_end(ap);
+
+    Mutex::Autolock lock(gLock);
+    Node *node = findNode(fd);
+    if (node == NULL)
+        return realIoctl(fd, request, arg);
+
+    int ret = serveIoctl(node, request, arg);
+    if (ret != 0) {
+        errno = ret;
+        return -1;
+    }
+    return 0;
+}
+
+int poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+    nsecs_t deadline = (timeout < 0) ? -1 : systemTime() + milliseconds(timeout);
+    nfds_t mocked = 0;
+
+    gLock.lock();
+    for (nfds_t i = 0; i < nfds; i++) {
+        if (findNode(fds[i].fd) != NULL)
+            mocked++;
+    }
+    gLock.unlock();
+
+    if (mocked == 0)
+        return realPoll(fds, nfds, timeout);
+    if (mocked != nfds) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for (;;) {
+        nsecs_t now = systemTime();
+        nsecs_t due = -1;
+        int ready = 0;
+
+        gLock.lock();
+        for (nfds_t i = 0; i < nfds; i++) {
+            Node *node = findNode(fds[i].fd);
+            if (node == NULL)
+                fds[i].revents = POLLNVAL;
+            else
+                fds[i].revents = pollEvents(node, now, &due) & (fds[i].events | POLLERR);
+            if (fds[i].revents)
+                ready++;
+        }
+        gLock.unlock();
+
+        if (ready > 0 || (deadline >= 0 && now >= deadline))
+            return ready;
+        // nothing will ever be ready, do not block forever
+        if (due < 0 && deadline < 0)
+            return 0;
+
+        nsecs_t wake = (due < 0 || (deadline >= 0 && deadline < due)) ? deadline : due;
+        struct timespec ts = { (time_t)((wake - now) / seconds(1)), (long)((wake - now) % seconds(1)) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+} // extern "C"
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CAMERA_HAL_TESTS_MOCK_V4L2_DEVICE_H
+#define CAMERA_HAL_TESTS_MOCK_V4L2_DEVICE_H
+
+#include <stddef.h>
+
+namespace android {
+
+/**
+ * Userspace stand-in for the V4L2 drivers of the ISP, so that
+ * V4L2VideoNode and V4L2Subdevice run unmodified off-target.
+ *
+ * MockV4L2Device.cpp defines open(), close(), ioctl(), poll(), mmap(),
+ * munmap() and stat() for the executable that links it. Calls on the paths
+ * registered here, and on the file descriptors they return, are served by
+ * the mock, any other file goes to the kernel.
+ *
+ * A video node streams NV12 at the rate it was given, or at the rate set
+ * with VIDIOC_S_PARM, frame n being due n frame intervals after
+ * VIDIOC_STREAMON. A rate of 0 produces frames as fast as they are
+ * dequeued. Frames are written to USERPTR, MMAP or DMABUF buffers, see
+ * checkFrame() for their content. MMAP buffers can be mapped and exported
+ * with VIDIOC_EXPBUF, dma-bufs mapped. Subdevices only keep controls.
+ *
+ * The state is global, one process drives one set of devices.
+ */
+namespace MockV4L2Device {
+
+    void addVideoNode(const char *path, int fps);
+    void addSubdevice(const char *path);
+
+    /**
+     * True if data holds the synthetic frame of the given sequence number:
+     * luma row r is (sequence + r) & 0xff, chroma is 0x80
+     */
+    bool checkFrame(const void *data, int bpl, int height, unsigned int sequence);
+
+    /**
+     * New dma-buf of size bytes, as gralloc or the encoder would hand out.
+     * Returns its file descriptor, released with close(), or -1.
+     */
+    int allocateDmaBuf(size_t size);
+
+    /**
+     * Number of file descriptors of the mock still open, devices and
+     * dma-bufs, for leak checks
+     */
+    int openFds();
+
+    /**
+     * Number of MMAP buffers and dma-bufs not freed yet, for leak checks
+     */
+    int buffers();
+
+} // namespace MockV4L2Device
+} // namespace android
+
+#endif // CAMERA_HAL_TESTS_MOCK_V4L2_DEVICE_H
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_RotationBenchmark"
+
+/**
+ * Throughput of the tiled NV12 rotation engine, nv12rotate(), against the
+ * rotators it replaced:
+ * - the hand-tuned kernels of nv12rotateBy90(), on the geometries listed in
+ *   nv12rotationgeometry.h
+ * - the per-pixel rotation every other geometry used for 90 degrees, and
+ *   its 270 degree counterpart
+ *
+ * Both rotators must give the same image, the executable fails otherwise.
+ *
+ * Usage: camera_hal_rotation_benchmark [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/Timers.h>
+#include "nv12rotation.h"
+
+using namespace android;
+
+namespace {
+
+/**
+ * The per-pixel rotation which was used for the geometries without a
+ * hand-tuned kernel, by 90 or 270 degrees clockwise
+ */
+void perPixelRotate(int angle, int width, int height, int rstride, int wstride,
+                    const char *sptr, char *dptr)
+{
+    const char *a = sptr;
+    char *b = dptr;
+
+    for (int i = 0; i < width; i++) {
+        for (int j = 0; j < height; j++) {
+            if (angle == 90)
+                b[j] = a[i + (height - 1 - j) * rstride];
+            else
+                b[j] = a[(width - 1 - i) + j * rstride];
+        }
+        b += wstride;
+    }
+    a += rstride * height;
+
+    for (int i = 0; i < width; i += 2) {
+        for (int j = 0; j < height / 2; j++) {
+            int x = (angle == 90) ? i : width - 2 - i;
+            int y = (angle == 90) ? height / 2 - 1 - j : j;
+            b[2 * j] = a[x + y * rstride];
+            b[2 * j + 1] = a[x + 1 + y * rstride];
+        }
+        b += wstride;
+    }
+}
+
+struct Result {
+    double oldMs;
+    double tiledMs;
+    bool same;
+};
+
+/**
+ * Times both rotators on one geometry
+ *
+ * \param useKernels the old rotator is nv12rotateBy90(), else the per-pixel one
+ */
+Result run(int angle, int width, int height, int rstride, int wstride, bool useKernels,
+           int iterations)
+{
+    size_t srcSize = rstride * height * 3 / 2;
+    size_t dstSize = wstride * width * 3 / 2;
+    char *src = (char *) malloc(srcSize);
+    char *oldDst = (char *) calloc(1, dstSize);
+    char *tiledDst = (char *) calloc(1, dstSize);
+    Result result;
+
+    for (size_t i = 0; i < srcSize; i++)
+        src[i] = rand();
+
+    nsecs_t start = systemTime();
+    for (int i = 0; i < iterations; i++) {
+        if (useKernels)
+            nv12rotateBy90(width, height, rstride, wstride, src, oldDst);
+        else
+            perPixelRotate(angle, width, height, rstride, wstride, src, oldDst);
+    }
+    result.oldMs = (systemTime() - start) / 1000000.0 / iterations;
+
+    start = systemTime();
+    for (int i = 0; i < iterations; i++)
+        nv12rotate(angle, false, width, height, rstride, wstride, src, tiledDst);
+    result.tiledMs = (systemTime() - start) / 1000000.0 / iterations;
+
+    // only the rotated pixels, not the stride padding
+    result.same = true;
+    for (int line = 0; line < width * 3 / 2 && result.same; line++)
+        result.same = memcmp(oldDst + line * wstride, tiledDst + line * wstride, height) == 0;
+
+    free(src);
+    free(oldDst);
+    free(tiledDst);
+    return result;
+}
+
+void print(const char *oldName, int angle, int width, int height, int rstride, int wstride,
+           const Result &r)
+{
+    double mpix = width * height / 1000000.0;
+    printf("%5d %4dx%-4d %4d->%-4d %-9s %7.2f ms %7.1f Mpix/s  tiled %7.2f ms %7.1f Mpix/s"
+           "  x%.2f%s\n", angle, width, height, rstride, wstride, oldName,
+           r.oldMs, mpix * 1000 / r.oldMs, r.tiledMs, mpix * 1000 / r.tiledMs,
+           r.oldMs / r.tiledMs, r.same ? "" : "  DIFFERENT OUTPUT");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    // geometries without a hand-tuned kernel, strides in pixels
+    static const int generic[][4] = {
+        { 176, 144, 176, 144 }, { 320, 240, 320, 240 }, { 640, 480, 672, 480 },
+        { 1280, 960, 1280, 960 }, { 1920, 1080, 1920, 1080 }, { 2048, 1536, 2048, 1536 }
+    };
+    int iterations = (argc > 1) ? atoi(argv[1]) : 20;
+    int failures = 0;
+
+    if (iterations <= 0)
+        iterations = 1;
+    srand(1);
+
+    printf("angle size      strides   old                          tiled\n");
+
+#define NV12_ROTATION_GEOMETRY(COLUMNS, ROWS, RSTRIDE, WSTRIDE, MACROBLOCK) \
+    { \
+        Result r = run(90, COLUMNS, ROWS, RSTRIDE, WSTRIDE, true, iterations); \
+        print("kernel", 90, COLUMNS, ROWS, RSTRIDE, WSTRIDE, r); \
+        failures += r.same ? 0 : 1; \
+    }
+#include "nv12rotationgeometry.h"
+
+    for (unsigned int g = 0; g < sizeof(generic) / sizeof(generic[0]); g++) {
+        for (int angle = 90; angle <= 270; angle += 180) {
+            const int *geo = generic[g];
+            Result r = run(angle, geo[0], geo[1], geo[2], geo[3], false, iterations);
+            print("per-pixel", angle, geo[0], geo[1], geo[2], geo[3], r);
+            failures += r.same ? 0 : 1;
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_SWJpegEncoderTest"
+
+/**
+ * Tests of the striped SW JPEG encoding.
+ *
+ * - Round trip: pictures large enough for the worker pool are encoded,
+ *   which stitches the stripes with restart markers, then decoded with
+ *   libjpeg. The decoder must not warn and the luma must match the source,
+ *   and nothing may be written past the output buffer. One picture has
+ *   stripes that do not fit in their part of the output buffer.
+ * - Parser: SWJpegEncoder::parseJpeg() gets malformed stripes, hand made
+ *   ones and random truncations and corruptions of real ones. When it
+ *   accepts a buffer, the positions it returns must be inside the buffer.
+ *
+ * Usage: camera_hal_sw_jpeg_encoder_test [fuzz iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/videodev2.h>
+#include "SWJpegEncoder.h"
+#include "jerror.h"
+
+using namespace android;
+
+namespace {
+
+int failures = 0;
+
+const int GUARD = 64;   // bytes after the output buffer which must stay untouched
+const unsigned char FILL = 0xCD;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FUNCTION__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+// libjpeg source manager reading from memory, libjpeg 6b has none
+void initSource(j_decompress_ptr) {}
+
+boolean fillInputBuffer(j_decompress_ptr cinfo)
+{
+    // the data ended without EOI, give one so that the decoder warns and stops
+    static const JOCTET eoi[2] = { 0xFF, JPEG_EOI };
+    WARNMS(cinfo, JWRN_JPEG_EOF);
+    cinfo->src->next_input_byte = eoi;
+    cinfo->src->bytes_in_buffer = 2;
+    return TRUE;
+}
+
+void skipInputData(j_decompress_ptr cinfo, long numBytes)
+{
+    if (numBytes <= 0)
+        return;
+    while (numBytes > (long) cinfo->src->bytes_in_buffer) {
+        numBytes -= cinfo->src->bytes_in_buffer;
+        fillInputBuffer(cinfo);
+    }
+    cinfo->src->next_input_byte += numBytes;
+    cinfo->src->bytes_in_buffer -= numBytes;
+}
+
+void termSource(j_decompress_ptr) {}
+
+/**
+ * Decodes a jpeg to its Y, Cb, Cr samples
+ *
+ * \return the number of libjpeg warnings, -1 if the size is not the expected one
+ */
+int decode(const unsigned char *jpeg, int size, int width, int height, unsigned char *ycc)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    struct jpeg_source_mgr src;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    src.init_source = initSource;
+    src.fill_input_buffer = fillInputBuffer;
+    src.skip_input_data = skipInputData;
+    src.resync_to_restart = jpeg_resync_to_restart;
+    src.term_source = termSource;
+    src.next_input_byte = jpeg;
+    src.bytes_in_buffer = size;
+    cinfo.src = &src;
+
+    jpeg_read_header(&cinfo, TRUE);
+    if ((int) cinfo.image_width != width || (int) cinfo.image_height != height) {
+        jpeg_destroy_decompress(&cinfo);
+        return -1;
+    }
+    cinfo.out_color_space = JCS_YCbCr;
+    jpeg_start_decompress(&cinfo);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = ycc + cinfo.output_scanline * width * 3;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    int warnings = jerr.num_warnings;
+    jpeg_destroy_decompress(&cinfo);
+    return warnings;
+}
+
+unsigned char lumaAt(int x, int y)
+{
+    return (x / 4 + y / 2) & 0xFF;
+}
+
+/**
+ * A gradient picture, with noise in its top quarter so that the stripes
+ * compress unevenly
+ */
+void fillPicture(unsigned char *buf, int width, int height, int fourcc)
+{
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            unsigned char luma = (y < height / 4) ? (rand() & 0xFF) : lumaAt(x, y);
+            if (fourcc == V4L2_PIX_FMT_YUYV) {
+                buf[(y * width + x) * 2] = luma;
+                buf[(y * width + x) * 2 + 1] = 128;
+            } else {
+                buf[y * width + x] = luma;
+            }
+        }
+    }
+    if (fourcc != V4L2_PIX_FMT_YUYV)
+        memset(buf + width * height, 128, width * height / 2);
+}
+
+/**
+ * \param outSize output buffer size, the stripes are encoded in parts of it
+ */
+void testRoundTrip(SWJpegEncoder &encoder, int width, int height, int fourcc, int quality,
+                   int outSize)
+{
+    int inSize = width * height * 2;
+    unsigned char *in = (unsigned char *) malloc(inSize);
+    unsigned char *out = (unsigned char *) malloc(outSize + GUARD);
+    unsigned char *ycc = (unsigned char *) malloc(width * height * 3);
+
+    fillPicture(in, width, height, fourcc);
+    memset(out + outSize, FILL, GUARD);
+
+    SWJpegEncoder::InputBuffer inBuf;
+    SWJpegEncoder::OutputBuffer outBuf;
+    inBuf.clear();
+    inBuf.buf = in;
+    inBuf.width = width;
+    inBuf.height = height;
+    inBuf.fourcc = fourcc;
+    inBuf.size = inSize;
+    outBuf.clear();
+    outBuf.buf = out;
+    outBuf.width = width;
+    outBuf.height = height;
+    outBuf.size = outSize;
+    outBuf.quality = quality;
+
+    int size = encoder.encode(inBuf, outBuf);
+    CHECK(size > 0, "%dx%d %s q%d not encoded", width, height, v4l2Fmt2Str(fourcc), quality);
+    int guard = 0;
+    while (guard < GUARD && out[outSize + guard] == FILL)
+        guard++;
+    CHECK(guard == GUARD, "%dx%d %s q%d: written past the output buffer", width, height,
+          v4l2Fmt2Str(fourcc), quality);
+    if (size > 0) {
+        int warnings = decode(out, size, width, height, ycc);
+        CHECK(warnings == 0, "%dx%d %s q%d: %d decoder warnings", width, height,
+              v4l2Fmt2Str(fourcc), quality, warnings);
+
+        // the gradient part of the picture, away from the noise
+        long error = 0;
+        long samples = 0;
+        for (int y = height / 4 + 16; y < height; y += 3) {
+            for (int x = 0; x < width; x += 5) {
+                error += abs(ycc[(y * width + x) * 3] - lumaAt(x, y));
+                samples++;
+            }
+        }
+        CHECK(error <= samples * 2, "%dx%d %s q%d: mean luma error %ld/%ld", width, height,
+              v4l2Fmt2Str(fourcc), quality, error, samples);
+        printf("%dx%d %s q%d: %d bytes in %d\n", width, height, v4l2Fmt2Str(fourcc), quality,
+               size, outSize);
+    }
+
+    free(in);
+    free(out);
+    free(ycc);
+}
+
+/**
+ * Encodes a small picture, below the worker pool threshold, for the parser
+ *
+ * \return the jpeg size, the caller frees *jpeg
+ */
+int encodeSeed(SWJpegEncoder &encoder, unsigned char **jpeg)
+{
+    const int width = 320;
+    const int height = 240;
+    unsigned char *in = (unsigned char *) malloc(width * height * 3 / 2);
+    *jpeg = (unsigned char *) malloc(width * height * 2);
+
+    fillPicture(in, width, height, V4L2_PIX_FMT_NV12);
+
+    SWJpegEncoder::InputBuffer inBuf;
+    SWJpegEncoder::OutputBuffer outBuf;
+    inBuf.clear();
+    inBuf.buf = in;
+    inBuf.width = width;
+    inBuf.height = height;
+    inBuf.fourcc = V4L2_PIX_FMT_NV12;
+    inBuf.size = width * height * 3 / 2;
+    outBuf.clear();
+    outBuf.buf = *jpeg;
+    outBuf.width = width;
+    outBuf.height = height;
+    outBuf.size = width * height * 2;
+    outBuf.quality = 90;
+
+    int size = encoder.encode(inBuf, outBuf);
+    free(in);
+    return size;
+}
+
+/**
+ * Parses a copy of buf in a buffer of exactly size bytes, and checks the
+ * layout of an accepted buffer
+ *
+ * \return whether the buffer was accepted
+ */
+bool parse(const unsigned char *buf, int size)
+{
+    unsigned char *copy = (unsigned char *) malloc(size > 0 ? size : 1);
+    SWJpegEncoder::JpegLayout layout;
+
+    memcpy(copy, buf, size > 0 ? size : 0);
+    bool accepted = SWJpegEncoder::parseJpeg(copy, size, &layout);
+    if (accepted) {
+        // mergeStripe() writes the SOF dimensions and copies up to the EOI
+        CHECK(layout.sofPos >= 2 && layout.sofPos + 9 <= size, "SOF at %d of %d", layout.sofPos, size);
+        CHECK(layout.entropyPos > layout.sofPos && layout.entropyPos <= layout.eoiPos,
+              "entropy data at %d, EOI at %d", layout.entropyPos, layout.eoiPos);
+        CHECK(layout.eoiPos == size - 2, "EOI at %d of %d", layout.eoiPos, size);
+    }
+    free(copy);
+    return accepted;
+}
+
+void testMalformed(const unsigned char *seed, int seedSize)
+{
+    static const unsigned char empty[] = { 0 };
+    static const unsigned char soiEoi[] = { 0xFF, 0xD8, 0xFF, 0xD9 };
+    // segment length running past the end
+    static const unsigned char longSegment[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x40, 0x00, 0xFF, 0xD9 };
+    // RST0 in the headers
+    static const unsigned char rstInHeader[] = { 0xFF, 0xD8, 0xFF, 0xD0, 0x00, 0x04, 0xFF, 0xD9 };
+    // SOS before SOF
+    static const unsigned char sosFirst[] = {
+        0xFF, 0xD8, 0xFF, 0xDA, 0x00, 0x08, 0x01, 0x01, 0x00, 0x00, 0x3F, 0x00, 0xFF, 0xD9
+    };
+    // SOF0 of 3 components with the length of 1
+    static const unsigned char shortSof[] = {
+        0xFF, 0xD8, 0xFF, 0xC0, 0x00, 0x0B, 0x08, 0x00, 0x10, 0x00, 0x10, 0x03, 0x01, 0x11, 0x00,
+        0xFF, 0xD9
+    };
+
+    CHECK(!parse(empty, 0), "empty buffer accepted");
+    CHECK(!parse(soiEoi, sizeof(soiEoi)), "SOI EOI accepted");
+    CHECK(!parse(longSegment, sizeof(longSegment)), "overlong segment accepted");
+    CHECK(!parse(rstInHeader, sizeof(rstInHeader)), "RST0 in the headers accepted");
+    CHECK(!parse(sosFirst, sizeof(sosFirst)), "SOS before SOF accepted");
+    CHECK(!parse(shortSof, sizeof(shortSof)), "SOF0 shorter than its components accepted");
+
+    CHECK(parse(seed, seedSize), "encoded jpeg rejected");
+    CHECK(!parse(seed, seedSize - 1), "jpeg without its last byte accepted");
+}
+
+/**
+ * Random truncations and byte corruptions of a real jpeg
+ */
+void testFuzz(const unsigned char *seed, int seedSize, int iterations)
+{
+    unsigned char *buf = (unsigned char *) malloc(seedSize);
+    int accepted = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        int size = rand() % (seedSize + 1);
+        memcpy(buf, seed, size);
+        int corruptions = rand() % 8;
+        for (int c = 0; c < corruptions && size > 0; c++) {
+            // the header segments are where the parser looks
+            int pos = rand() % MIN(size, 700);
+            buf[pos] = rand() & 0xFF;
+        }
+        if (parse(buf, size))
+            accepted++;
+    }
+    printf("parser: %d of %d corrupted stripes accepted\n", accepted, iterations);
+    free(buf);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    static const int sizes[][2] = {
+        { 1280, 960 }, { 1296, 976 }, { 1920, 1080 }, { 2048, 1536 }, { 3264, 2448 }
+    };
+    static const int fourccs[] = { V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV21, V4L2_PIX_FMT_YUYV };
+    int iterations = (argc > 1) ? atoi(argv[1]) : 100000;
+    SWJpegEncoder encoder;
+
+    srand(1);
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+        for (unsigned int f = 0; f < sizeof(fourccs) / sizeof(fourccs[0]); f++)
+            testRoundTrip(encoder, sizes[s][0], sizes[s][1], fourccs[f], (s & 1) ? 100 : 85,
+                          sizes[s][0] * sizes[s][1] * 2);
+
+    // the noisy stripes overflow their part of a buffer of 1 byte a pixel
+    // at quality 100, the picture is encoded again in one thread
+    testRoundTrip(encoder, 2048, 1536, V4L2_PIX_FMT_NV12, 100, 2048 * 1536);
+
+    unsigned char *seed = NULL;
+    int seedSize = encodeSeed(encoder, &seed);
+    CHECK(seedSize > 0, "seed jpeg not encoded");
+    if (seedSize > 0) {
+        testMalformed(seed, seedSize);
+        testFuzz(seed, seedSize, iterations);
+    }
+    free(seed);
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * AtomBufferFactory for the test executables, which do not link
+ * AtomCommon.cpp and the graphics and VA libraries behind it.
+ */
+
+#include <string.h>
+#include "AtomCommon.h"
+
+namespace android {
+
+timeval AtomBufferFactory_AtomBufDefTS = {0, 0};
+
+AtomBuffer AtomBufferFactory::createAtomBuffer(AtomBufferType type,
+                                               int fourcc,
+                                               int width,
+                                               int height,
+                                               int bpl,
+                                               int size,
+                                               IBufferOwner *owner,
+                                               camera_memory_t *buff,
+                                               camera_memory_t *metadata_buff,
+                                               int id,
+                                               int frameCounter,
+                                               int ispPrivate,
+                                               bool shared,
+                                               struct timeval capture_timestamp,
+                                               void *dataPtr,
+                                               GFXBufferInfo *gfxInfo)
+{
+    AtomBuffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type = type;
+    buf.fourcc = fourcc;
+    buf.width = width;
+    buf.height = height;
+    buf.bpl = bpl;
+    buf.size = size;
+    buf.owner = owner;
+    buf.buff = buff;
+    buf.metadata_buff = metadata_buff;
+    buf.id = id;
+    buf.expId = EXP_ID_INVALID;
+    buf.frameCounter = frameCounter;
+    buf.ispPrivate = ispPrivate;
+    buf.status = FRAME_STATUS_NA;
+    buf.shared = shared;
+    buf.capture_timestamp = capture_timestamp;
+    buf.dataPtr = (dataPtr == NULL && buff != NULL) ? buff->data : dataPtr;
+    if (gfxInfo)
+        buf.gfxInfo = *gfxInfo;
+    else
+        buf.gfxInfo.scalerId = -1;
+    buf.gfxInfo_rec.scalerId = -1;
+    buf.sensorFrameId = -1;
+    buf.result.requestId = -1;
+    return buf;
+}
+
+} // namespace android
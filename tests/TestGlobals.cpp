@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Log levels of LogHelper.h for the test executables, which do not link
+ * LogHelper.cpp and its dependencies. The debug properties are not read:
+ * the tests log errors only.
+ */
+
+#include "LogHelper.h"
+
+int32_t gLogLevel = 0;
+int32_t gPerfLevel = 0;
+int32_t gPowerLevel = 0;
+int32_t gControlLevel = 0;
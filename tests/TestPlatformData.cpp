@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * PlatformData statics for the test executables, which do not link
+ * PlatformData.cpp and the camera profiles behind it.
+ */
+
+#include <unistd.h>
+#include "PlatformData.h"
+
+namespace android {
+
+unsigned int PlatformData::getNumOfCPUCores()
+{
+    long cores = sysconf(_SC_NPROCESSORS_CONF);
+    return (cores > 0) ? cores : 1;
+}
+
+/**
+ * The cache line size of the Atom cores
+ */
+int PlatformData::cacheLineSize()
+{
+    return 64;
+}
+
+} // namespace android
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "Camera_V4L2DeviceTest"
+
+/**
+ * Runs V4L2VideoNode and V4L2Subdevice on the build host, against the
+ * userspace driver of MockV4L2Device.h.
+ *
+ * - a USERPTR preview stream at the given size and rate: frame order,
+ *   content and pacing, initial skips, and the ioctl() and poll() calls
+ *   per frame
+ * - the same stream with frames due at once, i.e. the cost of the frame
+ *   loop of the HAL itself
+ * - two nodes at different rates waited on with one pollNodes(), and the
+ *   error reported for a node that stopped streaming
+ * - an MMAP pool whose frames are exported with VIDIOC_EXPBUF and read
+ *   through the dma-buf, also after the node stopped
+ * - a DMABUF pool importing dma-bufs allocated elsewhere, as the gralloc
+ *   buffers of preview and recording are
+ * - controls of a subdevice, and the checks of open()
+ *
+ * Usage: camera_hal_v4l2_device_test [width height fps frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <utils/Timers.h>
+#include "AtomCommon.h"
+#include "v4l2device.h"
+#include "MockV4L2Device.h"
+
+using namespace android;
+
+namespace {
+
+const char *PREVIEW_NODE = "/dev/mock-video0";
+const char *UNPACED_NODE = "/dev/mock-video1";
+const char *FAST_NODE = "/dev/mock-video2";
+const char *SLOW_NODE = "/dev/mock-video3";
+const char *EXPORT_NODE = "/dev/mock-video4";
+const char *IMPORT_NODE = "/dev/mock-video5";
+const char *SENSOR_SUBDEV = "/dev/mock-v4l-subdev0";
+const int FAST_FPS = 120;
+const int SLOW_FPS = 30;
+const int NUM_BUFFERS = 6;
+const int INITIAL_SKIPS = 2;
+const int POLL_TIMEOUT_MS = 1000;
+const int POLL_ROUNDS = 40;
+
+int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FUNCTION__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+AtomBuffer nv12Format(int width, int height)
+{
+    AtomBuffer format = AtomBufferFactory::createAtomBuffer();
+    format.width = width;
+    format.height = height;
+    format.fourcc = V4L2_PIX_FMT_NV12;
+    return format;
+}
+
+/**
+ * Opens and configures the node and gives it a pool of malloc()ed buffers.
+ * Returns false on failure, the buffers are allocated in any case.
+ */
+bool prepare(V4L2VideoNode *node, AtomBuffer &format, void **pool, int count)
+{
+    struct v4l2_capability cap;
+
+    for (int i = 0; i < count; i++)
+        pool[i] = NULL;
+
+    CHECK(node->open() == NO_ERROR, "open failed");
+    CHECK(node->queryCap(&cap) == NO_ERROR, "queryCap failed");
+    CHECK(node->setFormat(format) == NO_ERROR, "setFormat failed");
+    if (failures)
+        return false;
+
+    // the stride and size come from the driver
+    CHECK(format.bpl >= format.width && format.size == format.bpl * format.height * 3 / 2,
+          "%dx%d: bpl %d size %d", format.width, format.height, format.bpl, format.size);
+
+    for (int i = 0; i < count; i++)
+        pool[i] = malloc(format.size);
+
+    AtomBuffer otherStride = format;
+    otherStride.bpl += 64;
+    CHECK(node->setBufferPool(pool, count, &otherStride, true) == BAD_VALUE,
+          "pool with a stride the driver did not set was taken");
+    CHECK(node->setBufferPool(pool, count, &format, true) == NO_ERROR, "setBufferPool failed");
+    return failures == 0;
+}
+
+void release(V4L2VideoNode *node, void **pool, int count)
+{
+    if (node->isStarted())
+        node->stop();
+    if (node->isOpen())
+        node->close();
+    for (int i = 0; i < count; i++)
+        free(pool[i]);
+}
+
+void testStream(const char *path, int width, int height, int fps, int frames)
+{
+    sp<V4L2VideoNode> node = new V4L2VideoNode(path, 0);
+    AtomBuffer format = nv12Format(width, height);
+    void *pool[NUM_BUFFERS];
+
+    if (prepare(node.get(), format, pool, NUM_BUFFERS)
+        && node->start(NUM_BUFFERS, INITIAL_SKIPS) == 0) {
+        node->resetSyscallCounts();
+        nsecs_t start = systemTime();
+
+        for (int i = 0; i < frames && failures == 0; i++) {
+            struct v4l2_buffer_info buf;
+            CLEAR(buf);
+
+            CHECK(node->poll(POLL_TIMEOUT_MS) > 0, "frame %d: poll timed out", i);
+            int index = node->grabFrame(&buf);
+            CHECK(index >= 0 && index < NUM_BUFFERS, "frame %d: index %d", i, index);
+            if (index < 0 || index >= NUM_BUFFERS)
+                break;
+
+            bool corrupted = buf.vbuffer.reserved == ATOMISP_FRAME_STATUS_CORRUPTED;
+            CHECK((int) buf.vbuffer.sequence == i, "frame %d: sequence %d", i, buf.vbuffer.sequence);
+            CHECK(corrupted == (i < INITIAL_SKIPS), "frame %d: corrupted %d", i, corrupted);
+            CHECK(MockV4L2Device::checkFrame(pool[index], format.bpl, format.height, i),
+                  "frame %d: not in buffer %d", i, index);
+            CHECK(node->putFrame(index) == 0, "frame %d: putFrame failed", i);
+        }
+
+        double ms = (systemTime() - start) / 1000000.0;
+        unsigned int ioctls, polls;
+        node->getSyscallCounts(&ioctls, &polls);
+        // the frames are due from STREAMON, before start was taken
+        if (fps > 0 && failures == 0)
+            CHECK(ms >= (frames - 1) * 1000.0 / fps - 1.0,
+                  "%d frames at %d fps in %.1f ms", frames, fps, ms);
+        // DQBUF and QBUF
+        CHECK((int) ioctls == 2 * frames, "%u ioctls for %d frames", ioctls, frames);
+        CHECK((int) polls == frames, "%u polls for %d frames", polls, frames);
+
+        printf("%dx%d %s %d fps: %d frames in %.1f ms, %.1f fps, %.2f ioctls and %.2f polls per frame\n",
+               format.width, format.height, (fps > 0) ? "paced at" : "unpaced,", fps, frames, ms,
+               frames * 1000.0 / ms, (double) ioctls / frames, (double) polls / frames);
+    } else {
+        CHECK(false, "%s did not start", path);
+    }
+
+    release(node.get(), pool, NUM_BUFFERS);
+    CHECK(MockV4L2Device::openFds() == 0, "%d devices left open", MockV4L2Device::openFds());
+}
+
+void testPollNodes()
+{
+    sp<V4L2VideoNode> fast = new V4L2VideoNode(FAST_NODE, 0);
+    sp<V4L2VideoNode> slow = new V4L2VideoNode(SLOW_NODE, 1);
+    V4L2VideoNode *nodes[2] = { fast.get(), slow.get() };
+    AtomBuffer fastFormat = nv12Format(320, 240);
+    AtomBuffer slowFormat = nv12Format(160, 120);
+    void *fastPool[NUM_BUFFERS];
+    void *slowPool[NUM_BUFFERS];
+    int frames[2] = { 0, 0 };
+    unsigned int readyMask, errorMask;
+
+    bool ok = prepare(fast.get(), fastFormat, fastPool, NUM_BUFFERS);
+    ok = prepare(slow.get(), slowFormat, slowPool, NUM_BUFFERS) && ok;
+    ok = ok && fast->start(NUM_BUFFERS, 0) == 0 && slow->start(NUM_BUFFERS, 0) == 0;
+    CHECK(ok, "nodes did not start");
+
+    fast->resetSyscallCounts();
+    slow->resetSyscallCounts();
+    for (int round = 0; ok && round < POLL_ROUNDS && failures == 0; round++) {
+        int ret = V4L2VideoNode::pollNodes(nodes, 2, POLL_TIMEOUT_MS, &readyMask, &errorMask);
+        CHECK(ret > 0 && readyMask != 0 && errorMask == 0,
+              "round %d: poll %d ready 0x%x error 0x%x", round, ret, readyMask, errorMask);
+
+        for (int i = 0; i < 2; i++) {
+            if (!(readyMask & (1 << i)))
+                continue;
+            struct v4l2_buffer_info buf;
+            CLEAR(buf);
+            int index = nodes[i]->grabFrame(&buf);
+            CHECK(index >= 0 && nodes[i]->putFrame(index) == 0, "round %d: node %d frame lost", round, i);
+            frames[i]++;
+        }
+    }
+
+    unsigned int fastPolls, slowPolls;
+    fast->getSyscallCounts(NULL, &fastPolls);
+    slow->getSyscallCounts(NULL, &slowPolls);
+    // one poll() per round, counted on the first node
+    CHECK(fastPolls == (unsigned int) POLL_ROUNDS && slowPolls == 0,
+          "polls counted %u and %u for %d rounds", fastPolls, slowPolls, POLL_ROUNDS);
+    CHECK(frames[0] > frames[1] && frames[1] > 0, "%d frames at %d fps, %d at %d fps",
+          frames[0], FAST_FPS, frames[1], SLOW_FPS);
+
+    // a node that stopped streaming reports an error, the others still frames
+    if (ok) {
+        slow->stop(true);
+        int ret = V4L2VideoNode::pollNodes(nodes, 2, POLL_TIMEOUT_MS, &readyMask, &errorMask);
+        CHECK(ret > 0 && errorMask == (1 << 1) && !(readyMask & (1 << 1)),
+              "stopped node: poll %d ready 0x%x error 0x%x", ret, readyMask, errorMask);
+    }
+
+    printf("pollNodes: %d rounds, %d frames at %d fps and %d at %d fps\n",
+           POLL_ROUNDS, frames[0], FAST_FPS, frames[1], SLOW_FPS);
+
+    release(fast.get(), fastPool, NUM_BUFFERS);
+    release(slow.get(), slowPool, NUM_BUFFERS);
+}
+
+/**
+ * Opens and configures the node, for the pools whose memory is not
+ * allocated by prepare()
+ */
+bool configure(V4L2VideoNode *node, AtomBuffer &format)
+{
+    struct v4l2_capability cap;
+
+    CHECK(node->open() == NO_ERROR, "open failed");
+    CHECK(node->queryCap(&cap) == NO_ERROR, "queryCap failed");
+    CHECK(node->setFormat(format) == NO_ERROR, "setFormat failed");
+    return failures == 0;
+}
+
+/**
+ * Dequeues a frame, checks it through a mapping of fd, or of an export of
+ * its buffer if fd is -1, and queues it back. Returns the buffer index or -1.
+ */
+int checkDmaBufFrame(V4L2VideoNode *node, const AtomBuffer &format, int frame, int fd)
+{
+    struct v4l2_buffer_info buf;
+    CLEAR(buf);
+
+    CHECK(node->poll(POLL_TIMEOUT_MS) > 0, "frame %d: poll timed out", frame);
+    int index = node->grabFrame(&buf);
+    CHECK(index >= 0 && index < NUM_BUFFERS, "frame %d: index %d", frame, index);
+    if (index < 0 || index >= NUM_BUFFERS)
+        return -1;
+
+    bool exported = fd < 0;
+    if (exported)
+        fd = node->exportBuffer(index);
+    CHECK(fd >= 0, "frame %d: buffer %d not exported", frame, index);
+    void *data = (fd >= 0) ? mmap(NULL, format.size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    CHECK(data != MAP_FAILED, "frame %d: dma-buf of buffer %d not mapped", frame, index);
+    if (data != MAP_FAILED) {
+        CHECK(MockV4L2Device::checkFrame(data, format.bpl, format.height, frame),
+              "frame %d: not in the dma-buf of buffer %d", frame, index);
+        munmap(data, format.size);
+    }
+    if (exported && fd >= 0)
+        close(fd);
+    CHECK(node->putFrame(index) == 0, "frame %d: putFrame failed", frame);
+    return index;
+}
+
+void testMmapExport()
+{
+    sp<V4L2VideoNode> node = new V4L2VideoNode(EXPORT_NODE, 0);
+    AtomBuffer format = nv12Format(640, 480);
+    int fd = -1;
+    void *data = MAP_FAILED;
+
+    if (configure(node.get(), format)
+        && node->setMmapBufferPool(NUM_BUFFERS, &format) == NO_ERROR
+        && node->start(NUM_BUFFERS, 0) == 0) {
+        CHECK(node->getMemoryType() == V4L2_MEMORY_MMAP, "memory type %d", node->getMemoryType());
+
+        for (int i = 0; i < NUM_BUFFERS && failures == 0; i++) {
+            int index = checkDmaBufFrame(node.get(), format, i, -1);
+            // exports of the other frames were closed after the check
+            if (i == NUM_BUFFERS - 1 && index >= 0) {
+                fd = node->exportBuffer(index);
+                if (fd >= 0)
+                    data = mmap(NULL, format.size, PROT_READ, MAP_SHARED, fd, 0);
+            }
+        }
+        CHECK(node->exportBuffer(NUM_BUFFERS) == -1, "exported a buffer out of the pool");
+    } else {
+        CHECK(false, "%s did not start", EXPORT_NODE);
+    }
+
+    node->stop();
+    node->close();
+    // the dma-buf keeps the frame after the pool is gone
+    CHECK(data != MAP_FAILED && MockV4L2Device::checkFrame(data, format.bpl, format.height, NUM_BUFFERS - 1),
+          "exported frame lost with the pool");
+    if (data != MAP_FAILED)
+        munmap(data, format.size);
+    if (fd >= 0)
+        close(fd);
+    CHECK(MockV4L2Device::openFds() == 0, "%d devices left open", MockV4L2Device::openFds());
+    CHECK(MockV4L2Device::buffers() == 0, "%d buffers not freed", MockV4L2Device::buffers());
+}
+
+void testDmaBufImport()
+{
+    sp<V4L2VideoNode> node = new V4L2VideoNode(IMPORT_NODE, 0);
+    AtomBuffer format = nv12Format(640, 480);
+    int fds[NUM_BUFFERS];
+    bool ok = configure(node.get(), format);
+
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        fds[i] = MockV4L2Device::allocateDmaBuf(format.size);
+        ok = ok && fds[i] >= 0;
+    }
+
+    if (ok && node->setDmaBufPool(fds, NUM_BUFFERS, &format) == NO_ERROR
+        && node->start(NUM_BUFFERS, 0) == 0) {
+        CHECK(node->getMemoryType() == V4L2_MEMORY_DMABUF, "memory type %d", node->getMemoryType());
+
+        // the buffers are dequeued in order, so frame i lands in fds[i % NUM_BUFFERS]
+        for (int i = 0; i < 2 * NUM_BUFFERS && failures == 0; i++)
+            checkDmaBufFrame(node.get(), format, i, fds[i % NUM_BUFFERS]);
+        CHECK(node->exportBuffer(0) == -1, "exported a buffer of a DMABUF pool");
+    } else {
+        CHECK(false, "%s did not start", IMPORT_NODE);
+    }
+
+    node->stop();
+    node->close();
+    for (int i = 0; i < NUM_BUFFERS; i++) {
+        if (fds[i] >= 0)
+            close(fds[i]);
+    }
+    CHECK(MockV4L2Device::openFds() == 0, "%d devices left open", MockV4L2Device::openFds());
+    CHECK(MockV4L2Device::buffers() == 0, "%d buffers not freed", MockV4L2Device::buffers());
+}
+
+void testSubdevice()
+{
+    sp<V4L2Subdevice> sensor = new V4L2Subdevice(SENSOR_SUBDEV, 0);
+    sp<V4L2Subdevice> missing = new V4L2Subdevice("/dev/mock-v4l-subdev9", 1);
+    int value = 0;
+
+    CHECK(missing->open() != NO_ERROR, "opened a device that does not exist");
+    CHECK(sensor->open() == NO_ERROR, "open failed");
+    CHECK(sensor->open() == INVALID_OPERATION, "opened twice");
+
+    CHECK(sensor->setControl(V4L2_CID_EXPOSURE_ABSOLUTE, 400, "exposure") == NO_ERROR,
+          "setControl failed");
+    CHECK(sensor->getControl(V4L2_CID_EXPOSURE_ABSOLUTE, &value) == NO_ERROR && value == 400,
+          "exposure read back as %d", value);
+    CHECK(sensor->getControl(V4L2_CID_GAIN, &value) == UNKNOWN_ERROR,
+          "read a control never set");
+
+    CHECK(sensor->close() == NO_ERROR, "close failed");
+    CHECK(MockV4L2Device::openFds() == 0, "%d devices left open", MockV4L2Device::openFds());
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int width = (argc > 4) ? atoi(argv[1]) : 1920;
+    int height = (argc > 4) ? atoi(argv[2]) : 1080;
+    int fps = (argc > 4) ? atoi(argv[3]) : 30;
+    int frames = (argc > 4) ? atoi(argv[4]) : 60;
+
+    MockV4L2Device::addVideoNode(PREVIEW_NODE, fps);
+    MockV4L2Device::addVideoNode(UNPACED_NODE, 0);
+    MockV4L2Device::addVideoNode(FAST_NODE, FAST_FPS);
+    MockV4L2Device::addVideoNode(SLOW_NODE, SLOW_FPS);
+    MockV4L2Device::addVideoNode(EXPORT_NODE, 0);
+    MockV4L2Device::addVideoNode(IMPORT_NODE, 0);
+    MockV4L2Device::addSubdevice(SENSOR_SUBDEV);
+
+    testStream(PREVIEW_NODE, width, height, fps, frames);
+    testStream(UNPACED_NODE, width, height, 0, frames);
+    testPollNodes();
+    testMmapExport();
+    testDmaBufImport();
+    testSubdevice();
+
+    printf("%d failures\n", failures);
+    return failures ? 1 : 0;
+}
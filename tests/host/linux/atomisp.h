@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Host stand-in for the atomisp kernel header, which only the target kernel
+ * headers have. It carries what the sources of the host test executables
+ * use: the frame status the driver reports in v4l2_buffer.reserved.
+ * The values must stay those of the kernel header.
+ */
+
+#ifndef CAMERA_HAL_TESTS_HOST_ATOMISP_H
+#define CAMERA_HAL_TESTS_HOST_ATOMISP_H
+
+enum atomisp_frame_status {
+    ATOMISP_FRAME_STATUS_OK,
+    ATOMISP_FRAME_STATUS_CORRUPTED,
+    ATOMISP_FRAME_STATUS_FLASH_EXPOSED,
+    ATOMISP_FRAME_STATUS_FLASH_PARTIAL,
+    ATOMISP_FRAME_STATUS_FLASH_FAILED,
+};
+
+#endif // CAMERA_HAL_TESTS_HOST_ATOMISP_H
@@ -21,14 +21,19 @@
 #include <utils/String8.h>
 #include <utils/Vector.h>
 #include <utils/Mutex.h>
+#include <cutils/atomic.h>
+#include <poll.h>
 #include <linux/atomisp.h>
 #include <linux/videodev2.h>
 
+// pioctl and ppoll count the calls of the device, see getSyscallCounts().
+// They are only for use inside V4L2DeviceBase and its subclasses.
 #ifdef USE_CAMERA_IO_BREAKDOWN
 #define pioctl(fd, ctrlId, attr) \
 ({ \
     int reti; \
     PERFORMANCE_TRACES_IO_BREAKDOWN(#ctrlId); \
+    android_atomic_inc(&mIoctlCount); \
     reti = ioctl(fd, ctrlId, attr); \
     reti; \
  })
@@ -61,13 +66,14 @@
 ({ \
     int reti; \
     PERFORMANCE_TRACES_IO_BREAKDOWN("poll"); \
+    android_atomic_inc(&mPollCount); \
     reti = ::poll(fd, value, timeout); \
     reti; \
 })
 
 #else
 #define pioctl(fd, ctrlId, attr) \
-    ioctl(fd, ctrlId, attr)
+    (android_atomic_inc(&mIoctlCount), ioctl(fd, ctrlId, attr))
 
 #define popen(name, attr) \
     ::open(name, attr)
@@ -79,7 +85,7 @@
     device->xioctl(ctrlId, attr)
 
 #define ppoll(fd, value, timeout) \
-    ::poll(fd, value, timeout)
+    (android_atomic_inc(&mPollCount), ::poll(fd, value, timeout))
 
 #endif // USE_CAMERA_IO_BREAKDOWN
 
@@ -98,6 +104,7 @@ struct v4l2_buffer_info {
     int height;
     int format;
     int cache_flags;        /*!< initial flags used when creating buffers */
+    int dmabuf_fd;          /*!< imported buffer in DMABUF pools, -1 otherwise */
     struct v4l2_buffer vbuffer;
 };
 
@@ -132,6 +139,10 @@ public:
 
     bool isOpen() { return mFd != -1; };
 
+    // Number of ioctl() and poll() calls made on the device
+    void getSyscallCounts(unsigned int *ioctls, unsigned int *polls) const;
+    void resetSyscallCounts();
+
 public:
     const int mId;    /*!< Convenient index to identify the device in old AtomISP code
                           (TODO: remove once it is not needed) */
@@ -139,6 +150,8 @@ public:
 protected:
     String8      mName;     /*!< path to device in file system, ex: /dev/video0 */
     int          mFd;       /*!< file descriptor obtained when device is open */
+    mutable volatile int32_t mIoctlCount;   /*!< calls through pioctl, any thread */
+    volatile int32_t mPollCount;            /*!< calls through ppoll, any thread */
 
 };
 
@@ -151,6 +164,16 @@ protected:
  * with the device.
  * This class introduces new methods specifics to control video device nodes
  *
+ * The buffer pool memory is one of:
+ * - USERPTR: memory allocated by the HAL, setBufferPool()
+ * - DMABUF: buffers imported from other devices (gralloc, encoder) as
+ *   dma-buf file descriptors, setDmaBufPool()
+ * - MMAP: memory allocated by the driver, setMmapBufferPool(). These
+ *   buffers can be exported as dma-buf fds with exportBuffer().
+ * DMABUF import and export need kernel headers with VIDIOC_EXPBUF.
+ *
+ * The nodes streaming in one session can be polled together with
+ * pollNodes() instead of one poll() per node.
  */
 class V4L2VideoNode: public V4L2DeviceBase {
 public:
@@ -179,9 +202,13 @@ public:
 
     // Buffer pool management
     status_t setBufferPool(void **pool, int poolSize, AtomBuffer *aFormatDescriptor, bool cached);
+    status_t setDmaBufPool(const int *fds, int poolSize, AtomBuffer *aFormatDescriptor);
+    status_t setMmapBufferPool(int poolSize, AtomBuffer *aFormatDescriptor);
     void destroyBufferPool();
     int createBufferPool(unsigned int buffer_count);
     int activateBufferPool();
+    int exportBuffer(unsigned int index);
+    enum v4l2_memory getMemoryType() const { return mMemoryType; };
 
     // Buffer flow control
     int stop(bool leaveConfigured = false);
@@ -189,6 +216,12 @@ public:
 
     int grabFrame(struct v4l2_buffer_info *buf);
     int putFrame(unsigned int index);
+    int putFrames(const unsigned int *indices, int count);
+
+    // Polling of the nodes of one streaming session
+    static const int MAX_POLL_NODES = 8;
+    static int pollNodes(V4L2VideoNode * const *nodes, int count, int timeout,
+                         unsigned int *readyMask, unsigned int *errorMask);
 
     // Convenience accessors
     bool isStarted() const { return mState == DEVICE_STARTED; };
@@ -201,6 +234,7 @@ private:
     int newBuffer(int index, struct v4l2_buffer_info &buf);
     int freeBuffer(struct v4l2_buffer_info *buf_info);
     int requestBuffers(uint num_buffers);
+    status_t checkPoolFormat(const AtomBuffer *formatDescriptor) const;
 
 private:
 
@@ -224,6 +258,7 @@ private:
 
     Vector<struct v4l2_buffer_info> mSetBufferPool; /*!< This is the buffer pool set before the device is prepared*/
     Vector<struct v4l2_buffer_info> mBufferPool;    /*!< This is the active buffer pool */
+    enum v4l2_memory mMemoryType;   /*!< memory of the buffer pool: USERPTR, DMABUF or MMAP */
 
     VideNodeDirection mDirection;
 };
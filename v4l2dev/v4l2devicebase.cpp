@@ -35,7 +35,9 @@ namespace android {
 
 V4L2DeviceBase::V4L2DeviceBase(const char *name, int anId): mId(anId),
                                                         mName(name),
-                                                        mFd(-1)
+                                                        mFd(-1),
+                                                        mIoctlCount(0),
+                                                        mPollCount(0)
 {
 }
 
@@ -108,6 +110,7 @@ int V4L2DeviceBase::xioctl(int request, void *arg) const
     }
 
     do {
+        android_atomic_inc(&mIoctlCount);
         ret = ioctl (mFd, request, arg);
     } while (-1 == ret && EINTR == errno);
 
@@ -293,6 +296,24 @@ status_t V4L2DeviceBase::getControl (int aControlNum, int *value)
     return UNKNOWN_ERROR;
 }
 
+/**
+ * Reports how many ioctl() and poll() calls the device has made since it
+ * was created or since the last resetSyscallCounts()
+ */
+void V4L2DeviceBase::getSyscallCounts(unsigned int *ioctls, unsigned int *polls) const
+{
+    if (ioctls)
+        *ioctls = android_atomic_acquire_load(&mIoctlCount);
+    if (polls)
+        *polls = android_atomic_acquire_load(&mPollCount);
+}
+
+void V4L2DeviceBase::resetSyscallCounts()
+{
+    android_atomic_release_store(0, &mIoctlCount);
+    android_atomic_release_store(0, &mPollCount);
+}
+
 ////////////////////////////////////////////////////////////////////
 //                          PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "Camera_V4L2IoctlQueue"
+
+#include <stdlib.h>
+#include <string.h>
+#include "AtomCommon.h"
+#include "LogHelper.h"
+#include "v4l2ioctlqueue.h"
+
+namespace android {
+
+V4L2IoctlQueue::V4L2IoctlQueue(sp<V4L2DeviceBase> device) :
+    Thread(false)
+    ,mDevice(device)
+    ,mListener(NULL)
+    ,mBusy(false)
+    ,mBusyRequest(0)
+    ,mExit(false)
+    ,mSubmitted(0)
+    ,mCoalesced(0)
+    ,mFailed(0)
+{
+    LOG1("@%s", __FUNCTION__);
+}
+
+V4L2IoctlQueue::~V4L2IoctlQueue()
+{
+    LOG1("@%s: %u submitted, %u coalesced, %u failed", __FUNCTION__,
+         mSubmitted, mCoalesced, mFailed);
+    for (size_t i = 0; i < mPending.size(); i++)
+        freeCommand(mPending.editItemAt(i));
+}
+
+/**
+ * Applies what is still queued and stops the thread
+ */
+status_t V4L2IoctlQueue::requestExitAndWait()
+{
+    LOG1("@%s", __FUNCTION__);
+    {
+        Mutex::Autolock lock(mLock);
+        mExit = true;
+        mCommandQueued.signal();
+    }
+    return Thread::requestExitAndWait();
+}
+
+void V4L2IoctlQueue::setListener(IListener *listener)
+{
+    Mutex::Autolock lock(mLock);
+    mListener = listener;
+}
+
+void V4L2IoctlQueue::freeCommand(Command &command)
+{
+    if (command.size > 0) {
+        free(command.arg);
+        command.arg = NULL;
+        command.size = 0;
+    }
+}
+
+status_t V4L2IoctlQueue::submit(int request, const void *arg, size_t size, unsigned int frameId)
+{
+    LOG2("@%s: request 0x%x frame %u", __FUNCTION__, request, frameId);
+    Command command;
+
+    command.request = request;
+    command.size = size;
+    command.frameId = frameId;
+    command.result = NULL;
+    command.arg = malloc(size);
+    if (command.arg == NULL) {
+        LOGE("@%s: could not copy %u bytes", __FUNCTION__, size);
+        return NO_MEMORY;
+    }
+    memcpy(command.arg, arg, size);
+
+    Mutex::Autolock lock(mLock);
+    mSubmitted++;
+
+    // the values of the older command are replaced, the new one goes to
+    // the back so that it is still applied after what was submitted before
+    for (size_t i = 0; i < mPending.size(); i++) {
+        if (mPending[i].request == request && mPending[i].result == NULL) {
+            LOG2("@%s: frame %u replaces frame %u", __FUNCTION__, frameId, mPending[i].frameId);
+            freeCommand(mPending.editItemAt(i));
+            mPending.removeAt(i);
+            mCoalesced++;
+            break;
+        }
+    }
+
+    mPending.push(command);
+    mCommandQueued.signal();
+    return NO_ERROR;
+}
+
+int V4L2IoctlQueue::apply(int request, void *arg)
+{
+    LOG2("@%s: request 0x%x", __FUNCTION__, request);
+    Command command;
+    Result result;
+
+    result.ret = 0;
+    result.done = false;
+    command.request = request;
+    command.arg = arg;
+    command.size = 0;
+    command.frameId = 0;
+    command.result = &result;
+
+    Mutex::Autolock lock(mLock);
+    if (mExit)
+        return mDevice->xioctl(request, arg);
+
+    mPending.push(command);
+    mCommandQueued.signal();
+    while (!result.done)
+        mCommandDone.wait(mLock);
+
+    return result.ret;
+}
+
+void V4L2IoctlQueue::reclaim(int request)
+{
+    LOG2("@%s: request 0x%x", __FUNCTION__, request);
+    Mutex::Autolock lock(mLock);
+
+    for (size_t i = 0; i < mPending.size(); i++) {
+        if (mPending[i].request == request && mPending[i].result == NULL) {
+            LOG2("@%s: frame %u dropped", __FUNCTION__, mPending[i].frameId);
+            freeCommand(mPending.editItemAt(i));
+            mPending.removeAt(i);
+            mCoalesced++;
+            break;
+        }
+    }
+
+    while (mBusy && mBusyRequest == request)
+        mCommandDone.wait(mLock);
+}
+
+void V4L2IoctlQueue::flush()
+{
+    LOG2("@%s", __FUNCTION__);
+    Mutex::Autolock lock(mLock);
+
+    while (mBusy || !mPending.isEmpty())
+        mCommandDone.wait(mLock);
+}
+
+bool V4L2IoctlQueue::threadLoop()
+{
+    Command command;
+    IListener *listener;
+
+    {
+        Mutex::Autolock lock(mLock);
+        while (mPending.isEmpty() && !mExit)
+            mCommandQueued.wait(mLock);
+        if (mPending.isEmpty())
+            return false;
+
+        command = mPending[0];
+        mPending.removeAt(0);
+        mBusy = true;
+        mBusyRequest = command.request;
+    }
+
+    int ret = mDevice->xioctl(command.request, command.arg);
+    LOG2("@%s: request 0x%x frame %u ret: %d", __FUNCTION__, command.request, command.frameId, ret);
+
+    {
+        Mutex::Autolock lock(mLock);
+        mBusy = false;
+        if (ret < 0)
+            mFailed++;
+        if (command.result != NULL) {
+            command.result->ret = ret;
+            command.result->done = true;
+        }
+        freeCommand(command);
+        listener = command.result == NULL ? mListener : NULL;
+        mCommandDone.broadcast();
+    }
+
+    if (listener)
+        listener->ioctlApplied(command.request, command.frameId, ret);
+
+    return true;
+}
+
+} /* namespace android */
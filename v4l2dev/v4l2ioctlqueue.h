@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2014 Intel Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_LIBCAMERA_V4L2IOCTLQUEUE_H_
+#define ANDROID_LIBCAMERA_V4L2IOCTLQUEUE_H_
+
+#include <utils/threads.h>
+#include <utils/Vector.h>
+#include "v4l2device.h"
+
+namespace android {
+
+/**
+ * \class V4L2IoctlQueue
+ *
+ * Applies the control writes of one device (ISP parameters, tables) from
+ * its own thread, so that a slow driver ioctl does not hold up the thread
+ * computing the next values.
+ *
+ * Commands are applied in the order they are submitted. A command given
+ * with submit() replaces a pending one with the same request code: only
+ * the latest parameters matter and the older ones never reach the driver.
+ * Each command carries the id of the frame it was computed for, the
+ * listener gets it back with the ioctl result once the command is applied.
+ *
+ * submit() copies the argument of the ioctl, but not the memory the
+ * argument points to: the caller keeps that memory valid until it calls
+ * reclaim() for the request.
+ */
+class V4L2IoctlQueue : public Thread {
+public:
+    class IListener {
+    public:
+        virtual ~IListener() {};
+        /**
+         * Called from the queue thread after a submitted command is applied
+         */
+        virtual void ioctlApplied(int request, unsigned int frameId, int ret) = 0;
+    };
+
+public:
+    V4L2IoctlQueue(sp<V4L2DeviceBase> device);
+    virtual ~V4L2IoctlQueue();
+
+// prevent copy constructor and assignment operator
+private:
+    V4L2IoctlQueue(const V4L2IoctlQueue& other);
+    V4L2IoctlQueue& operator=(const V4L2IoctlQueue& other);
+
+// Thread overrides
+public:
+    status_t requestExitAndWait();
+
+public:
+    void setListener(IListener *listener);
+
+    /**
+     * Queues an ioctl and returns without waiting for it
+     *
+     * \param request ioctl request code
+     * \param arg ioctl argument, size bytes are copied
+     * \param frameId frame the values were computed for, given back to
+     *        the listener
+     * \return NO_MEMORY if the argument could not be copied
+     */
+    status_t submit(int request, const void *arg, size_t size, unsigned int frameId);
+
+    /**
+     * Applies an ioctl after the queued ones and waits for it, for callers
+     * that need the result or free the argument right after the call
+     *
+     * \return the result of the ioctl
+     */
+    int apply(int request, void *arg);
+
+    /**
+     * Gives back the memory of a submitted command: a command not applied
+     * yet is dropped, a command being applied is waited for
+     */
+    void reclaim(int request);
+
+    /**
+     * Waits until every queued command has been applied
+     */
+    void flush();
+
+private:
+    struct Result {
+        int ret;
+        bool done;
+    };
+
+    struct Command {
+        int request;
+        void *arg;          /*!< owned copy, or the caller's argument for apply() */
+        size_t size;        /*!< size of the copy, 0 for apply() */
+        unsigned int frameId;
+        Result *result;     /*!< where apply() waits for the result, NULL for submit() */
+    };
+
+    void freeCommand(Command &command);
+
+// inherited from Thread
+private:
+    virtual bool threadLoop();
+
+private:
+    sp<V4L2DeviceBase> mDevice;
+    IListener *mListener;
+    Mutex mLock;                /*!< protects everything below */
+    Condition mCommandQueued;   /*!< signalled by submit(), apply() and exit */
+    Condition mCommandDone;     /*!< signalled by the thread after each ioctl */
+    Vector<Command> mPending;
+    bool mBusy;                 /*!< the thread is in the ioctl of mBusyRequest */
+    int mBusyRequest;
+    bool mExit;
+    // statistics, logged when the queue goes away
+    unsigned int mSubmitted;
+    unsigned int mCoalesced;
+    unsigned int mFailed;
+};
+
+} /* namespace android */
+#endif /* ANDROID_LIBCAMERA_V4L2IOCTLQUEUE_H_ */
@@ -22,6 +22,8 @@
 #include "v4l2device.h"
 
 #include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
 
 #define MAX_V4L2_BUFFERS    MAX_BURST_BUFFERS
 
@@ -38,6 +40,7 @@ V4L2VideoNode::V4L2VideoNode(const char *name, int anId, VideNodeDirection nodeD
                                                         mState(DEVICE_CLOSED),
                                                         mFrameCounter(0),
                                                         mInitialSkips(0),
+                                                        mMemoryType(V4L2_MEMORY_USERPTR),
                                                         mDirection(nodeDirection)
 {
     LOG1("@%s: device: %s", __FUNCTION__, name);
@@ -531,6 +534,89 @@ int V4L2VideoNode::putFrame(unsigned int index)
     return ret;
 }
 
+/**
+ * Queues several buffers back to the device
+ *
+ * \param indices indices in the active buffer pool
+ * \param count number of buffers
+ *
+ * \return number of buffers queued, it stops at the first failure
+ */
+int V4L2VideoNode::putFrames(const unsigned int *indices, int count)
+{
+    LOG2("@%s: %d frames", __FUNCTION__, count);
+
+    for (int i = 0; i < count; i++) {
+        if (indices[i] >= mBufferPool.size()) {
+            LOGE("%s Invalid index %d pool size %d", __FUNCTION__, indices[i], mBufferPool.size());
+            return i;
+        }
+        struct v4l2_buffer_info vbuf = mBufferPool[indices[i]];
+        if (qbuf(&vbuf) < 0)
+            return i;
+    }
+
+    return count;
+}
+
+/**
+ * Waits for frames on several nodes with a single poll()
+ *
+ * The nodes are the ones streaming in one session, e.g. preview, main and
+ * postview in continuous SoC capture. The poll is counted in the syscall
+ * counts of the first node.
+ *
+ * \param nodes nodes to wait on, at most MAX_POLL_NODES
+ * \param count number of nodes
+ * \param timeout time to wait (in ms), -1 waits indefinitely
+ * \param readyMask [OUT] bit i is set when nodes[i] has a frame to dequeue
+ * \param errorMask [OUT] bit i is set when nodes[i] reported POLLERR, the
+ *        other nodes are still reported in readyMask
+ *
+ * \return 0: timeout, -1: the poll itself failed, positive number: nodes
+ *         with a frame or an error
+ */
+int V4L2VideoNode::pollNodes(V4L2VideoNode * const *nodes, int count, int timeout,
+                             unsigned int *readyMask, unsigned int *errorMask)
+{
+    LOG2("@%s: %d nodes", __FUNCTION__, count);
+    struct pollfd pfd[MAX_POLL_NODES];
+    int ret(0);
+
+    if (nodes == NULL || readyMask == NULL || errorMask == NULL
+        || count <= 0 || count > MAX_POLL_NODES) {
+        LOGE("%s: invalid parameters", __FUNCTION__);
+        return -1;
+    }
+
+    *readyMask = 0;
+    *errorMask = 0;
+    for (int i = 0; i < count; i++) {
+        if (nodes[i]->mFd == -1) {
+            LOG1("Device %s already closed. Do nothing.", nodes[i]->mName.string());
+            return -1;
+        }
+        pfd[i].fd = nodes[i]->mFd;
+        pfd[i].events = POLLPRI | POLLIN | POLLERR;
+        pfd[i].revents = 0;
+    }
+
+    android_atomic_inc(&nodes[0]->mPollCount);
+    ret = ::poll(pfd, count, timeout);
+    if (ret <= 0)
+        return ret;
+
+    for (int i = 0; i < count; i++) {
+        if (pfd[i].revents & POLLERR) {
+            LOG1("%s received POLLERR on %s", __FUNCTION__, nodes[i]->mName.string());
+            *errorMask |= 1 << i;
+        } else if (pfd[i].revents & (POLLIN | POLLPRI))
+            *readyMask |= 1 << i;
+    }
+
+    return ret;
+}
+
 status_t V4L2VideoNode::setParameter (struct v4l2_streamparm *aParam)
 {
     LOG2("@%s", __FUNCTION__);
@@ -621,19 +707,8 @@ status_t V4L2VideoNode::setBufferPool(void **pool, int poolSize,
         return BAD_TYPE;
     }
 
-    /**
-     * check that the configuration of these buffers matches what we have already
-     * told the driver.
-     */
-    if ((formatDescriptor->width != mFormatDescriptor.width) ||
-        (formatDescriptor->height != mFormatDescriptor.height) ||
-        (formatDescriptor->bpl != mFormatDescriptor.bpl) ||
-        (formatDescriptor->fourcc != mFormatDescriptor.fourcc) ) {
-        LOGE("Pool configuration does not match device configuration: (%dx%d) s:%d f:%s Pool is: (%dx%d) s:%d f:%s ",
-                mFormatDescriptor.width, mFormatDescriptor.height, mFormatDescriptor.bpl, v4l2Fmt2Str(mFormatDescriptor.fourcc),
-                formatDescriptor->width, formatDescriptor->height, formatDescriptor->bpl, v4l2Fmt2Str(formatDescriptor->fourcc));
+    if (checkPoolFormat(formatDescriptor) != NO_ERROR)
         return BAD_VALUE;
-    }
 
     mSetBufferPool.clear();
     mSetBufferPool.setCapacity(MAX_V4L2_BUFFERS);
@@ -644,6 +719,7 @@ status_t V4L2VideoNode::setBufferPool(void **pool, int poolSize,
         vinfo.height = formatDescriptor->height;
         vinfo.format = formatDescriptor->fourcc;
         vinfo.length = formatDescriptor->size;
+        vinfo.dmabuf_fd = -1;
         if (cached)
            vinfo.cache_flags = 0;
        else
@@ -652,10 +728,165 @@ status_t V4L2VideoNode::setBufferPool(void **pool, int poolSize,
         mSetBufferPool.push(vinfo);
     }
 
+    mMemoryType = V4L2_MEMORY_USERPTR;
     mState = DEVICE_PREPARED;
     return NO_ERROR;
 }
 
+/**
+ * setDmaBufPool
+ * updates the set buffer pool with buffers of other devices, shared as
+ * dma-buf file descriptors (e.g. gralloc or video encoder buffers), so
+ * that frames reach them without a CPU copy.
+ *
+ * Same state rules as setBufferPool(). The fds stay owned by the caller
+ * and must stay open until the pool is destroyed. The driver does the
+ * cache maintenance of dma-bufs, there is no cached flag.
+ *
+ * \param fds: array of dma-buf file descriptors
+ * \param poolSize: amount of buffers in the pool
+ * \param formatDescriptor: description of the properties of the buffers
+ *                   it should match the configuration passed during setFormat
+ * \return INVALID_OPERATION also if the kernel headers lack DMABUF support
+ */
+status_t V4L2VideoNode::setDmaBufPool(const int *fds, int poolSize,
+                                      AtomBuffer *formatDescriptor)
+{
+    LOG1("@%s: device = %s", __FUNCTION__, mName.string());
+#ifdef VIDIOC_EXPBUF
+    struct v4l2_buffer_info vinfo;
+    CLEAR(vinfo);
+
+    if ((mState != DEVICE_CONFIGURED) && (mState != DEVICE_PREPARED)) {
+        LOGE("%s:Invalid operation, device %s not configured (state = %d)",
+                __FUNCTION__, mName.string(), mState);
+        return INVALID_OPERATION;
+    }
+
+    if (fds == NULL || formatDescriptor == NULL) {
+        LOGE("Invalid parameters, fds %p frameInfo %p", fds, formatDescriptor);
+        return BAD_TYPE;
+    }
+
+    if (checkPoolFormat(formatDescriptor) != NO_ERROR)
+        return BAD_VALUE;
+
+    mSetBufferPool.clear();
+    mSetBufferPool.setCapacity(MAX_V4L2_BUFFERS);
+
+    for (int i = 0; i < poolSize; i++) {
+        vinfo.data = NULL;
+        vinfo.dmabuf_fd = fds[i];
+        vinfo.width = formatDescriptor->width;
+        vinfo.height = formatDescriptor->height;
+        vinfo.format = formatDescriptor->fourcc;
+        vinfo.length = formatDescriptor->size;
+        vinfo.cache_flags = 0;
+
+        mSetBufferPool.push(vinfo);
+    }
+
+    mMemoryType = V4L2_MEMORY_DMABUF;
+    mState = DEVICE_PREPARED;
+    return NO_ERROR;
+#else
+    LOGE("%s: DMABUF not supported by the kernel headers", __FUNCTION__);
+    return INVALID_OPERATION;
+#endif
+}
+
+/**
+ * setMmapBufferPool
+ * makes the driver allocate the memory of the buffer pool. The buffers are
+ * mapped to the HAL when the pool is created in start(), v4l2_buffer_info
+ * data points to them, and can be shared with exportBuffer().
+ *
+ * Same state rules as setBufferPool().
+ *
+ * \param poolSize: amount of buffers in the pool
+ * \param formatDescriptor: description of the properties of the buffers
+ *                   it should match the configuration passed during setFormat
+ */
+status_t V4L2VideoNode::setMmapBufferPool(int poolSize, AtomBuffer *formatDescriptor)
+{
+    LOG1("@%s: device = %s", __FUNCTION__, mName.string());
+    struct v4l2_buffer_info vinfo;
+    CLEAR(vinfo);
+
+    if ((mState != DEVICE_CONFIGURED) && (mState != DEVICE_PREPARED)) {
+        LOGE("%s:Invalid operation, device %s not configured (state = %d)",
+                __FUNCTION__, mName.string(), mState);
+        return INVALID_OPERATION;
+    }
+
+    if (formatDescriptor == NULL) {
+        LOGE("Invalid parameters, frameInfo %p", formatDescriptor);
+        return BAD_TYPE;
+    }
+
+    if (checkPoolFormat(formatDescriptor) != NO_ERROR)
+        return BAD_VALUE;
+
+    mSetBufferPool.clear();
+    mSetBufferPool.setCapacity(MAX_V4L2_BUFFERS);
+
+    for (int i = 0; i < poolSize; i++) {
+        vinfo.data = NULL;
+        vinfo.dmabuf_fd = -1;
+        vinfo.width = formatDescriptor->width;
+        vinfo.height = formatDescriptor->height;
+        vinfo.format = formatDescriptor->fourcc;
+        vinfo.length = formatDescriptor->size;
+        vinfo.cache_flags = 0;
+
+        mSetBufferPool.push(vinfo);
+    }
+
+    mMemoryType = V4L2_MEMORY_MMAP;
+    mState = DEVICE_PREPARED;
+    return NO_ERROR;
+}
+
+/**
+ * Exports a buffer of an MMAP pool as a dma-buf, to be imported by the
+ * video encoder or the display without a copy.
+ *
+ * Allowed once the pool is created, i.e. after start(). The caller owns the
+ * returned fd and closes it, the buffer stays valid as long as the fd is
+ * open even if the pool is destroyed.
+ *
+ * \param index: buffer index as returned by grabFrame()
+ * \return dma-buf file descriptor, -1 on failure
+ */
+int V4L2VideoNode::exportBuffer(unsigned int index)
+{
+    LOG1("@%s: device = %s index %d", __FUNCTION__, mName.string(), index);
+#ifdef VIDIOC_EXPBUF
+    struct v4l2_exportbuffer expbuf;
+    int ret;
+    CLEAR(expbuf);
+
+    if (mMemoryType != V4L2_MEMORY_MMAP || index >= mBufferPool.size()) {
+        LOGE("%s: no MMAP buffer %d to export", __FUNCTION__, index);
+        return -1;
+    }
+
+    expbuf.type = mBufferPool[index].vbuffer.type;
+    expbuf.index = index;
+    expbuf.flags = O_CLOEXEC | O_RDWR;
+    ret = pioctl(mFd, VIDIOC_EXPBUF, &expbuf);
+    if (ret < 0) {
+        LOGE("VIDIOC_EXPBUF failed: %s", strerror(errno));
+        return -1;
+    }
+
+    return expbuf.fd;
+#else
+    LOGE("%s: DMABUF not supported by the kernel headers", __FUNCTION__);
+    return -1;
+#endif
+}
+
 ////////////////////////////////////////////////////////////////////
 //                          PRIVATE METHODS
 ////////////////////////////////////////////////////////////////////
@@ -665,12 +896,33 @@ void V4L2VideoNode::destroyBufferPool()
 
     LOG1("@%s: device = %s", __FUNCTION__, mName.string());
 
+    for (size_t i = 0; i < mBufferPool.size(); i++)
+        freeBuffer(&mBufferPool.editItemAt(i));
+
     mBufferPool.clear();
     mBufferPool.setCapacity(MAX_V4L2_BUFFERS);
 
     requestBuffers(0);
 }
 
+/**
+ * check that the configuration of the pool buffers matches what we have
+ * already told the driver.
+ */
+status_t V4L2VideoNode::checkPoolFormat(const AtomBuffer *formatDescriptor) const
+{
+    if ((formatDescriptor->width != mFormatDescriptor.width) ||
+        (formatDescriptor->height != mFormatDescriptor.height) ||
+        (formatDescriptor->bpl != mFormatDescriptor.bpl) ||
+        (formatDescriptor->fourcc != mFormatDescriptor.fourcc) ) {
+        LOGE("Pool configuration does not match device configuration: (%dx%d) s:%d f:%s Pool is: (%dx%d) s:%d f:%s ",
+                mFormatDescriptor.width, mFormatDescriptor.height, mFormatDescriptor.bpl, v4l2Fmt2Str(mFormatDescriptor.fourcc),
+                formatDescriptor->width, formatDescriptor->height, formatDescriptor->bpl, v4l2Fmt2Str(formatDescriptor->fourcc));
+        return BAD_VALUE;
+    }
+    return NO_ERROR;
+}
+
 int V4L2VideoNode::requestBuffers(uint num_buffers)
 {
     LOG1("@%s", __FUNCTION__);
@@ -681,7 +933,7 @@ int V4L2VideoNode::requestBuffers(uint num_buffers)
     if (mState == DEVICE_CLOSED)
         return 0;
 
-    req_buf.memory = V4L2_MEMORY_USERPTR;
+    req_buf.memory = mMemoryType;
     req_buf.count = num_buffers;
 
     if (mDirection == INPUT_VIDEO_NODE)
@@ -754,7 +1006,7 @@ int V4L2VideoNode::dqbuf(struct v4l2_buffer_info *buf)
     int ret = 0;
 
     v4l2_buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-    v4l2_buf->memory = V4L2_MEMORY_USERPTR;
+    v4l2_buf->memory = mMemoryType;
 
     ret = pioctl(mFd, VIDIOC_DQBUF, v4l2_buf);
     if (ret < 0) {
@@ -830,7 +1082,7 @@ int V4L2VideoNode::newBuffer(int index, struct v4l2_buffer_info &buf)
     struct v4l2_buffer *vbuf = &buf.vbuffer;
 
     vbuf->flags = 0x0;
-    vbuf->memory = V4L2_MEMORY_USERPTR;
+    vbuf->memory = mMemoryType;
 
     if (mDirection == INPUT_VIDEO_NODE)
         vbuf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -850,7 +1102,28 @@ int V4L2VideoNode::newBuffer(int index, struct v4l2_buffer_info &buf)
         return ret;
     }
 
-    vbuf->m.userptr = (unsigned int)(buf.data);
+    switch (mMemoryType) {
+    case V4L2_MEMORY_MMAP:
+        buf.data = mmap(NULL, vbuf->length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                        mFd, vbuf->m.offset);
+        if (buf.data == MAP_FAILED) {
+            LOGE("mmap of buffer %d failed: %s", index, strerror(errno));
+            buf.data = NULL;
+            return -1;
+        }
+        break;
+#ifdef VIDIOC_EXPBUF
+    case V4L2_MEMORY_DMABUF:
+        vbuf->m.fd = buf.dmabuf_fd;
+        // the driver only knows the size of a dma-buf once it is queued
+        if (vbuf->length == 0)
+            vbuf->length = buf.length;
+        break;
+#endif
+    default:
+        vbuf->m.userptr = (unsigned long)(buf.data);
+        break;
+    }
 
     buf.length = vbuf->length;
     LOG1("index %u", vbuf->index);
@@ -858,7 +1131,7 @@ int V4L2VideoNode::newBuffer(int index, struct v4l2_buffer_info &buf)
     LOG1("bytesused %u", vbuf->bytesused);
     LOG1("flags %08x", vbuf->flags);
     LOG1("memory %u", vbuf->memory);
-    LOG1("userptr:  %p", (void*)vbuf->m.userptr);
+    LOG1("data:  %p fd: %d", buf.data, buf.dmabuf_fd);
     LOG1("length %u", vbuf->length);
     return ret;
 }
@@ -866,9 +1139,15 @@ int V4L2VideoNode::newBuffer(int index, struct v4l2_buffer_info &buf)
 int V4L2VideoNode::freeBuffer(struct v4l2_buffer_info *buf_info)
 {
     /**
-     * For devices using usr ptr as data this method is a no-op
+     * Only MMAP buffers are owned by the device. USERPTR memory and
+     * DMABUF fds belong to the users of the pool.
      * TODO: for file-inject device we need to map
      */
+    if (mMemoryType == V4L2_MEMORY_MMAP && buf_info->data != NULL) {
+        if (munmap(buf_info->data, buf_info->vbuffer.length) < 0)
+            LOGW("munmap failed: %s", strerror(errno));
+        buf_info->data = NULL;
+    }
     return 0;
 }
 }; // namespace android